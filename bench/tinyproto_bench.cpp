@@ -0,0 +1,712 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ This is microbenchmark suite for Tiny Protocol library.
+ All input data are generated by fixed-seed generator, so the results of two runs
+ on the same machine can be compared to each other directly.
+*/
+
+#include "proto/crc/crc.h"
+#include "proto/hdlc/low_level/hdlc.h"
+#include "proto/fd/tiny_fd.h"
+#include "proto/fd/tiny_fd_runtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//================================== ALLOCATIONS ======================================
+
+static std::atomic<uint64_t> s_allocations{0};
+
+#if defined(__GLIBC__)
+// Count all heap allocations of the process, including allocations made by C code
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size) noexcept
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) noexcept
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) noexcept
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+//================================== HELPERS ======================================
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double s_minTimeMs = 200;
+static const char *s_filter = nullptr;
+static bool s_csv = false;
+
+struct Measurement
+{
+    double ns_per_iter;
+    double allocs_per_iter;
+};
+
+static bool is_enabled(const std::string &name)
+{
+    return s_filter == nullptr || name.find(s_filter) != std::string::npos;
+}
+
+static Measurement measure(const std::function<void()> &fn)
+{
+    // Warm up caches and branch predictors first
+    fn();
+    uint64_t iterations = 0;
+    uint64_t batch = 1;
+    uint64_t allocs = s_allocations.load();
+    auto start = bench_clock::now();
+    auto end = start;
+    while ( end - start < std::chrono::duration<double, std::milli>(s_minTimeMs) )
+    {
+        for ( uint64_t i = 0; i < batch; i++ )
+        {
+            fn();
+        }
+        iterations += batch;
+        batch *= 2;
+        end = bench_clock::now();
+    }
+    Measurement m;
+    m.ns_per_iter = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    m.allocs_per_iter = (double)(s_allocations.load() - allocs) / iterations;
+    return m;
+}
+
+static void print_header()
+{
+    if ( s_csv )
+    {
+        // Throughput and latency rows share the header, columns of other kind are left empty
+        printf("name,ns_per_byte,mb_per_s,frames_per_s,allocs_per_frame,min_ns,p50_ns,p99_ns,max_ns\n");
+    }
+    else
+    {
+        printf("%-36s %12s %10s %14s %14s\n", "name", "ns/byte", "MB/s", "frames/s", "allocs/frame");
+    }
+}
+
+static void report(const std::string &name, int bytes_per_iter, int frames_per_iter, const Measurement &m)
+{
+    double ns_per_byte = m.ns_per_iter / bytes_per_iter;
+    double mb_per_s = 1000.0 / ns_per_byte;
+    double frames_per_s = frames_per_iter ? 1e9 * frames_per_iter / m.ns_per_iter : 0;
+    double allocs_per_frame = m.allocs_per_iter / (frames_per_iter ? frames_per_iter : 1);
+    if ( s_csv )
+    {
+        printf("%s,%.3f,%.2f,%.0f,%.3f,,,,\n", name.c_str(), ns_per_byte, mb_per_s, frames_per_s, allocs_per_frame);
+    }
+    else
+    {
+        printf("%-36s %12.3f %10.2f %14.0f %14.3f\n", name.c_str(), ns_per_byte, mb_per_s, frames_per_s,
+               allocs_per_frame);
+    }
+    fflush(stdout);
+}
+
+static void report_latency(const std::string &name, std::vector<double> &samples)
+{
+    std::sort(samples.begin(), samples.end());
+    double p50 = samples[samples.size() / 2];
+    double p99 = samples[samples.size() * 99 / 100];
+    if ( s_csv )
+    {
+        printf("%s,,,,,%.0f,%.0f,%.0f,%.0f\n", name.c_str(), samples.front(), p50, p99, samples.back());
+    }
+    else
+    {
+        printf("%-36s min %.0f ns, p50 %.0f ns, p99 %.0f ns, max %.0f ns\n", name.c_str(), samples.front(), p50, p99,
+               samples.back());
+    }
+    fflush(stdout);
+}
+
+/**
+ * Generates payload, where escape_percent of bytes are HDLC special characters (0x7E, 0x7D).
+ */
+static std::vector<uint8_t> make_payload(int size, int escape_percent, uint32_t seed)
+{
+    std::vector<uint8_t> data(size);
+    uint32_t x = seed;
+    for ( auto &byte : data )
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        if ( (int)(x % 100) < escape_percent )
+        {
+            byte = (x & 0x100) ? 0x7E : 0x7D;
+        }
+        else
+        {
+            byte = (uint8_t)(x >> 16);
+            if ( byte == 0x7E || byte == 0x7D )
+            {
+                byte ^= 0x01;
+            }
+        }
+    }
+    return data;
+}
+
+static const char *crc_name(hdlc_crc_t crc)
+{
+    switch ( crc )
+    {
+        case HDLC_CRC_8: return "crc8";
+        case HDLC_CRC_16: return "crc16";
+        case HDLC_CRC_32: return "crc32";
+        default: return "nocrc";
+    }
+}
+
+//================================== CRC ======================================
+
+static void bench_crc()
+{
+    std::vector<uint8_t> data = make_payload(4096, 0, 1);
+    volatile uint32_t sink = 0;
+#ifdef CONFIG_ENABLE_CHECKSUM
+    if ( is_enabled("crc/chksum") )
+        report("crc/chksum", data.size(), 0,
+               measure([&]() { sink = sink + chksum(INITCHECKSUM, data.data(), data.size()); }));
+#endif
+#ifdef CONFIG_ENABLE_FCS16
+    if ( is_enabled("crc/crc16") )
+        report("crc/crc16", data.size(), 0,
+               measure([&]() { sink = sink + crc16(PPPINITFCS16, data.data(), data.size()); }));
+#endif
+#ifdef CONFIG_ENABLE_FCS32
+    if ( is_enabled("crc/crc32") )
+        report("crc/crc32", data.size(), 0,
+               measure([&]() { sink = sink + crc32(PPPINITFCS32, data.data(), data.size()); }));
+#endif
+}
+
+//================================== HDLC ======================================
+
+static int on_hdlc_frame_read(void *user_data, void *data, int len)
+{
+    (*reinterpret_cast<int *>(user_data))++;
+    return 0;
+}
+
+static void bench_hdlc_encode(int size, int escapes, hdlc_crc_t crc)
+{
+    std::string name = "hdlc_encode/" + std::string(crc_name(crc)) + "/" + std::to_string(size) + "B/" +
+                       std::to_string(escapes) + "%esc";
+    if ( !is_enabled(name) )
+        return;
+    std::vector<uint8_t> payload = make_payload(size, escapes, 1);
+    std::vector<uint8_t> hdlc_buf(hdlc_ll_get_buf_size_ex(size, crc));
+    std::vector<uint8_t> out(size * 2 + 16);
+    hdlc_ll_handle_t handle;
+    hdlc_ll_init_t init{};
+    init.buf = hdlc_buf.data();
+    init.buf_size = hdlc_buf.size();
+    init.crc_type = crc;
+    hdlc_ll_init(&handle, &init);
+    report(name, size, 1, measure([&]() {
+               hdlc_ll_put(handle, payload.data(), size);
+               hdlc_ll_run_tx(handle, out.data(), out.size());
+           }));
+    hdlc_ll_close(handle);
+}
+
+static void bench_hdlc_decode(int size, int escapes, hdlc_crc_t crc)
+{
+    std::string name = "hdlc_decode/" + std::string(crc_name(crc)) + "/" + std::to_string(size) + "B/" +
+                       std::to_string(escapes) + "%esc";
+    if ( !is_enabled(name) )
+        return;
+    std::vector<uint8_t> payload = make_payload(size, escapes, 2);
+    std::vector<uint8_t> hdlc_buf(hdlc_ll_get_buf_size_ex(size, crc));
+    int frames = 0;
+    hdlc_ll_handle_t handle;
+    hdlc_ll_init_t init{};
+    init.buf = hdlc_buf.data();
+    init.buf_size = hdlc_buf.size();
+    init.crc_type = crc;
+    init.on_frame_read = on_hdlc_frame_read;
+    init.user_data = &frames;
+    hdlc_ll_init(&handle, &init);
+    // Prepare stream of at least 64 KiB, consisting of encoded frames
+    std::vector<uint8_t> stream;
+    std::vector<uint8_t> out(size * 2 + 16);
+    int frames_in_stream = 0;
+    while ( stream.size() < 65536 )
+    {
+        hdlc_ll_put(handle, payload.data(), size);
+        int len = hdlc_ll_run_tx(handle, out.data(), out.size());
+        stream.insert(stream.end(), out.begin(), out.begin() + len);
+        frames_in_stream++;
+    }
+    report(name, size * frames_in_stream, frames_in_stream, measure([&]() {
+               const uint8_t *ptr = stream.data();
+               int len = stream.size();
+               while ( len > 0 )
+               {
+                   int processed = hdlc_ll_run_rx(handle, ptr, len, nullptr);
+                   ptr += processed;
+                   len -= processed;
+               }
+           }));
+    if ( frames < frames_in_stream )
+    {
+        fprintf(stderr, "%s: decoded %d frames, expected at least %d\n", name.c_str(), frames, frames_in_stream);
+    }
+    hdlc_ll_close(handle);
+}
+
+//================================== FD ======================================
+
+class FdPeer
+{
+public:
+    FdPeer(int mtu, int window, hdlc_crc_t crc, bool single_thread)
+        : m_buffer(tiny_fd_buffer_size_by_mtu_ex(mtu, window, crc))
+    {
+        tiny_fd_init_t init{};
+        init.pdata = this;
+        init.on_frame_cb = onFrame;
+        init.buffer = m_buffer.data();
+        init.buffer_size = m_buffer.size();
+        init.window_frames = window;
+        init.send_timeout = 0;
+        init.retry_timeout = 100;
+        init.retries = 2;
+        init.crc_type = crc;
+        init.mtu = mtu;
+        init.single_thread = single_thread;
+        tiny_fd_init(&handle, &init);
+    }
+
+    ~FdPeer()
+    {
+        tiny_fd_close(handle);
+    }
+
+    tiny_fd_handle_t handle = nullptr;
+    uint64_t rx_frames = 0;
+
+private:
+    std::vector<uint8_t> m_buffer;
+
+    static void onFrame(void *udata, uint8_t *data, int len)
+    {
+        reinterpret_cast<FdPeer *>(udata)->rx_frames++;
+    }
+};
+
+/**
+ * Two FD endpoints, connected to each other in memory. All bytes are transferred
+ * in the context of the caller thread, so there is no any sleeps and waits.
+ */
+class FdPair
+{
+public:
+    FdPair(int mtu, int window, hdlc_crc_t crc, bool single_thread)
+        : a(mtu, window, crc, single_thread)
+        , b(mtu, window, crc, single_thread)
+    {
+    }
+
+    void pump()
+    {
+        // Both directions are filled before delivering, like on the real full duplex line
+        uint8_t buf_a[512];
+        uint8_t buf_b[512];
+        int len_a = tiny_fd_get_tx_data(a.handle, buf_a, sizeof(buf_a));
+        int len_b = tiny_fd_get_tx_data(b.handle, buf_b, sizeof(buf_b));
+        if ( len_a > 0 )
+            tiny_fd_on_rx_data(b.handle, buf_a, len_a);
+        if ( len_b > 0 )
+            tiny_fd_on_rx_data(a.handle, buf_b, len_b);
+    }
+
+    bool connect()
+    {
+        for ( int i = 0; i < 1000; i++ )
+        {
+            if ( tiny_fd_get_status(a.handle) == TINY_SUCCESS && tiny_fd_get_status(b.handle) == TINY_SUCCESS )
+            {
+                return true;
+            }
+            pump();
+        }
+        return false;
+    }
+
+    FdPeer a;
+    FdPeer b;
+};
+
+static void bench_fd_throughput(int size, int window, hdlc_crc_t crc, bool single_thread)
+{
+    std::string name = std::string(single_thread ? "fd_loopback_st/" : "fd_loopback/") + crc_name(crc) + "/" +
+                       std::to_string(size) + "B/w" + std::to_string(window);
+    if ( !is_enabled(name) )
+        return;
+    const int frames_per_iter = 64;
+    std::vector<uint8_t> payload = make_payload(size, 1, 3);
+    FdPair pair(size, window, crc, single_thread);
+    if ( !pair.connect() )
+    {
+        fprintf(stderr, "%s: failed to establish connection\n", name.c_str());
+        return;
+    }
+    report(name, size * frames_per_iter, frames_per_iter, measure([&]() {
+               uint64_t target = pair.b.rx_frames + frames_per_iter;
+               int sent = 0;
+               while ( pair.b.rx_frames < target )
+               {
+                   while ( sent < frames_per_iter &&
+                           tiny_fd_send_packet(pair.a.handle, payload.data(), size) == TINY_SUCCESS )
+                   {
+                       sent++;
+                   }
+                   pair.pump();
+               }
+           }));
+}
+
+static void bench_fd_latency(int size, hdlc_crc_t crc, bool single_thread)
+{
+    std::string name = std::string(single_thread ? "fd_latency_st/" : "fd_latency/") + crc_name(crc) + "/" +
+                       std::to_string(size) + "B";
+    if ( !is_enabled(name) )
+        return;
+    std::vector<uint8_t> payload = make_payload(size, 1, 4);
+    FdPair pair(size, 7, crc, single_thread);
+    if ( !pair.connect() )
+    {
+        fprintf(stderr, "%s: failed to establish connection\n", name.c_str());
+        return;
+    }
+    std::vector<double> samples;
+    auto start = bench_clock::now();
+    while ( samples.size() < 1000 || bench_clock::now() - start < std::chrono::duration<double, std::milli>(s_minTimeMs) )
+    {
+        uint64_t target = pair.b.rx_frames + 1;
+        auto ts = bench_clock::now();
+        if ( tiny_fd_send_packet(pair.a.handle, payload.data(), size) != TINY_SUCCESS )
+        {
+            // Window is full, just let peers to exchange confirmations
+            pair.pump();
+            continue;
+        }
+        while ( pair.b.rx_frames < target )
+        {
+            pair.pump();
+        }
+        samples.push_back(std::chrono::duration<double, std::nano>(bench_clock::now() - ts).count());
+    }
+    report_latency(name, samples);
+}
+
+//================================== FD RUNTIME ======================================
+
+/**
+ * Session of the sharded runtime. Sessions are connected in pairs by in-memory byte rings,
+ * and each write notifies the runtime about new data for the remote session.
+ */
+class RuntimePeer
+{
+public:
+    RuntimePeer(tiny_fd_runtime_handle_t runtime, int mtu)
+        : m_runtime(runtime)
+        , m_buffer(tiny_fd_buffer_size_by_mtu(mtu, 7))
+        , m_ring(4096)
+    {
+        tiny_fd_init_t init{};
+        init.pdata = this;
+        init.on_frame_cb = onFrame;
+        init.buffer = m_buffer.data();
+        init.buffer_size = m_buffer.size();
+        init.window_frames = 7;
+        init.send_timeout = 0;
+        init.retry_timeout = 100;
+        init.retries = 2;
+        init.crc_type = HDLC_CRC_16;
+        init.mtu = mtu;
+        tiny_fd_init(&handle, &init);
+    }
+
+    ~RuntimePeer()
+    {
+        while ( tiny_fd_runtime_remove(m_runtime, session) == TINY_ERR_BUSY )
+        {
+            std::this_thread::yield();
+        }
+        tiny_fd_close(handle);
+    }
+
+    void connect(RuntimePeer &remote)
+    {
+        m_remote = &remote;
+        remote.m_remote = this;
+        session = tiny_fd_runtime_add(m_runtime, handle, readData, writeData, this);
+        remote.session = tiny_fd_runtime_add(m_runtime, remote.handle, readData, writeData, &remote);
+    }
+
+    bool send(const void *data, int len)
+    {
+        if ( tiny_fd_send_packet(handle, data, len) != TINY_SUCCESS )
+        {
+            return false;
+        }
+        tiny_fd_runtime_notify(m_runtime, session);
+        return true;
+    }
+
+    tiny_fd_handle_t handle = nullptr;
+    int session = -1;
+    std::atomic<uint64_t> rx_frames{0};
+
+private:
+    tiny_fd_runtime_handle_t m_runtime;
+    std::vector<uint8_t> m_buffer;
+    RuntimePeer *m_remote = nullptr;
+    std::mutex m_mutex;
+    std::vector<uint8_t> m_ring;
+    size_t m_head = 0;
+    size_t m_size = 0;
+
+    static void onFrame(void *udata, uint8_t *data, int len)
+    {
+        reinterpret_cast<RuntimePeer *>(udata)->rx_frames++;
+    }
+
+    static int readData(void *pdata, void *buffer, int size)
+    {
+        RuntimePeer *peer = reinterpret_cast<RuntimePeer *>(pdata);
+        std::lock_guard<std::mutex> lock(peer->m_mutex);
+        int len = std::min<int>(size, peer->m_size);
+        for ( int i = 0; i < len; i++ )
+        {
+            static_cast<uint8_t *>(buffer)[i] = peer->m_ring[(peer->m_head + i) % peer->m_ring.size()];
+        }
+        peer->m_head = (peer->m_head + len) % peer->m_ring.size();
+        peer->m_size -= len;
+        return len;
+    }
+
+    static int writeData(void *pdata, const void *buffer, int size)
+    {
+        RuntimePeer *remote = reinterpret_cast<RuntimePeer *>(pdata)->m_remote;
+        int len;
+        {
+            std::lock_guard<std::mutex> lock(remote->m_mutex);
+            len = std::min<int>(size, remote->m_ring.size() - remote->m_size);
+            for ( int i = 0; i < len; i++ )
+            {
+                remote->m_ring[(remote->m_head + remote->m_size + i) % remote->m_ring.size()] =
+                    static_cast<const uint8_t *>(buffer)[i];
+            }
+            remote->m_size += len;
+        }
+        tiny_fd_runtime_notify(remote->m_runtime, remote->session);
+        return len;
+    }
+};
+
+static void bench_fd_runtime(uint8_t shards, int pairs)
+{
+    std::string name = "fd_runtime/" + std::to_string(shards) + "shards/" + std::to_string(pairs) + "pairs";
+    if ( !is_enabled(name) )
+        return;
+    const int size = 32;
+    const int frames_per_pair = 8;
+    std::vector<uint8_t> buffer(tiny_fd_runtime_buffer_size(shards, pairs * 2));
+    tiny_fd_runtime_init_t init{};
+    init.buffer = buffer.data();
+    init.buffer_size = buffer.size();
+    init.shards = shards;
+    tiny_fd_runtime_handle_t runtime = nullptr;
+    tiny_fd_runtime_init(&runtime, &init);
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+    for ( uint8_t i = 0; i < shards; i++ )
+    {
+        workers.emplace_back([&, i]() {
+            while ( !stop )
+            {
+                tiny_fd_runtime_run(runtime, i, 10);
+            }
+        });
+    }
+    {
+        std::vector<std::unique_ptr<RuntimePeer>> peers;
+        for ( int i = 0; i < pairs * 2; i++ )
+        {
+            peers.emplace_back(new RuntimePeer(runtime, size));
+        }
+        for ( int i = 0; i < pairs; i++ )
+        {
+            peers[2 * i]->connect(*peers[2 * i + 1]);
+        }
+        auto start = bench_clock::now();
+        for ( auto &peer : peers )
+        {
+            while ( tiny_fd_get_status(peer->handle) != TINY_SUCCESS &&
+                    bench_clock::now() - start < std::chrono::seconds(5) )
+            {
+                std::this_thread::yield();
+            }
+        }
+        std::vector<uint8_t> payload = make_payload(size, 1, 5);
+        report(name, size * frames_per_pair * pairs, frames_per_pair * pairs, measure([&]() {
+                   std::vector<int> sent(pairs);
+                   std::vector<uint64_t> target(pairs);
+                   for ( int i = 0; i < pairs; i++ )
+                   {
+                       target[i] = peers[2 * i + 1]->rx_frames + frames_per_pair;
+                   }
+                   for ( bool done = false; !done; )
+                   {
+                       done = true;
+                       for ( int i = 0; i < pairs; i++ )
+                       {
+                           while ( sent[i] < frames_per_pair && peers[2 * i]->send(payload.data(), size) )
+                           {
+                               sent[i]++;
+                           }
+                           done = done && peers[2 * i + 1]->rx_frames >= target[i];
+                       }
+                       // Sender shares the cores with the workers
+                       std::this_thread::yield();
+                   }
+               }));
+        // Sessions are removed, while workers are still running
+    }
+    stop = true;
+    for ( auto &worker : workers )
+    {
+        worker.join();
+    }
+    tiny_fd_runtime_close(runtime);
+}
+
+//================================== MAIN ======================================
+
+static void print_help()
+{
+    fprintf(stderr, "Usage: tinyproto_bench [-t <ms>] [-f <filter>] [--csv]\n");
+    fprintf(stderr, "    -t <ms>, --time <ms>       minimum run time of each benchmark, can be fractional: 200 (by default)\n");
+    fprintf(stderr, "    -f <str>, --filter <str>   run only benchmarks, which name contains str\n");
+    fprintf(stderr, "    --csv                      print results in csv format\n");
+}
+
+static int parse_args(int argc, char *argv[])
+{
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( (!strcmp(argv[i], "-t")) || (!strcmp(argv[i], "--time")) )
+        {
+            if ( ++i >= argc )
+                return -1;
+            char *end = nullptr;
+            s_minTimeMs = strtod(argv[i], &end);
+            if ( end == argv[i] || *end != '\0' || !(s_minTimeMs > 0) )
+            {
+                fprintf(stderr, "Invalid time: %s\n", argv[i]);
+                return -1;
+            }
+        }
+        else if ( (!strcmp(argv[i], "-f")) || (!strcmp(argv[i], "--filter")) )
+        {
+            if ( ++i >= argc )
+                return -1;
+            s_filter = argv[i];
+        }
+        else if ( !strcmp(argv[i], "--csv") )
+        {
+            s_csv = true;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if ( parse_args(argc, argv) < 0 )
+    {
+        print_help();
+        return 1;
+    }
+    const int sizes[] = {16, 64, 256, 1024};
+    const int escapes[] = {0, 10, 50, 100};
+    const hdlc_crc_t crcs[] = {HDLC_CRC_8, HDLC_CRC_16, HDLC_CRC_32};
+
+    print_header();
+    bench_crc();
+    for ( int size : sizes )
+        for ( int esc : escapes )
+            bench_hdlc_encode(size, esc, HDLC_CRC_16);
+    for ( int size : sizes )
+        for ( int esc : escapes )
+            bench_hdlc_decode(size, esc, HDLC_CRC_16);
+    for ( hdlc_crc_t crc : crcs )
+    {
+        bench_hdlc_encode(256, 10, crc);
+        bench_hdlc_decode(256, 10, crc);
+    }
+    for ( bool single_thread : {false, true} )
+    {
+        for ( int size : sizes )
+            bench_fd_throughput(size, 7, HDLC_CRC_16, single_thread);
+        for ( hdlc_crc_t crc : crcs )
+            bench_fd_throughput(256, 4, crc, single_thread);
+        for ( int size : sizes )
+            bench_fd_latency(size, HDLC_CRC_16, single_thread);
+    }
+    // Throughput of many sessions should grow with the number of shards up to the number of cores
+    for ( uint8_t shards : {1, 2, 4} )
+        bench_fd_runtime(shards, 64);
+    return 0;
+}
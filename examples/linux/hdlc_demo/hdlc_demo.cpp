@@ -33,6 +33,7 @@
 #include "proto/hdlc/high_level/hdlc.h"
 #include "TinyProtocol.h"
 #include <stdio.h>
+#include <stdlib.h>
 //#include <time.h>
 #include <cstring>
 #include <chrono>
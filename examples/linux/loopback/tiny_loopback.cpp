@@ -1,5 +1,5 @@
 /*
-    Copyright 2019-2020 (C) Alexey Dynda
+    Copyright 2019-2021 (C) Alexey Dynda
 
     This file is part of Tiny Protocol Library.
 
@@ -20,9 +20,15 @@
 #include "hal/tiny_serial.h"
 #include "TinyProtocol.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 enum class protocol_type_t : uint8_t
 {
@@ -31,27 +37,54 @@ enum class protocol_type_t : uint8_t
     LIGHT = 3,
 };
 
+enum class output_format_t : uint8_t
+{
+    TEXT = 0,
+    JSON = 1,
+    CSV = 2,
+};
+
 static hdlc_crc_t s_crc = HDLC_CRC_8;
 static char *s_port = nullptr;
+static char *s_peerPort = nullptr;
+static uint32_t s_baud = 115200;
 static bool s_generatorEnabled = false;
 static bool s_loopbackMode = true;
 static protocol_type_t s_protocol = protocol_type_t::FD;
 static int s_packetSize = 64;
 static int s_windowSize = 7;
-static bool s_terminate = false;
+static std::atomic<bool> s_terminate{false};
 static bool s_runTest = false;
 static bool s_isArduinoBoard = false;
+static int s_duration = 15;
+static uint32_t s_rate = 0;
+static output_format_t s_format = output_format_t::TEXT;
+static FILE *s_captureFile = nullptr;
+
+static std::vector<int> s_packetSizes{64};
+static std::vector<int> s_windowSizes{7};
+static std::vector<int> s_crcBits{8};
 
-static int s_receivedBytes = 0;
-static int s_sentBytes = 0;
+static std::atomic<uint64_t> s_receivedBytes{0};
+static std::atomic<uint64_t> s_sentBytes{0};
+static std::atomic<uint64_t> s_receivedFrames{0};
+static std::atomic<uint64_t> s_sentFrames{0};
+static tiny_fd_stats_t s_stats{};
+static bool s_hasStats = false;
+
+static uint16_t s_runId = 0;
+static std::chrono::steady_clock::time_point s_startTs;
+static std::mutex s_rttMutex;
+static std::vector<uint32_t> s_rtt;
 
 static void print_help()
 {
     fprintf(stderr, "Usage: tiny_loopback -p <port> [-c <crc>]\n");
-    fprintf(stderr, "Note: communication runs at 115200\n");
+    fprintf(stderr, "Note: communication runs at 115200 by default\n");
     fprintf(stderr, "    -p <port>, --port <port>   com port to use\n");
     fprintf(stderr, "                               COM1, COM2 ...  for Windows\n");
     fprintf(stderr, "                               /dev/ttyS0, /dev/ttyS1 ...  for Linux\n");
+    fprintf(stderr, "    -b <baud>, --baud <baud>   baud rate of com port: 115200 (by default)\n");
     fprintf(stderr, "    -t <proto>, --protocol <proto> type of protocol to use\n");
     fprintf(stderr, "                               fd - full duplex (default)\n");
     fprintf(stderr, "                               light - full duplex\n");
@@ -59,8 +92,52 @@ static void print_help()
     fprintf(stderr, "    -g, --generator            turn on packet generating\n");
     fprintf(stderr, "    -s, --size                 packet size: 64 (by default)\n");
     fprintf(stderr, "    -w, --window               window size: 7 (by default)\n");
-    fprintf(stderr, "    -r, --run-test             run 15 seconds speed test\n");
+    fprintf(stderr, "    -r, --run-test             run speed test, use together with -g\n");
     fprintf(stderr, "    -a, --arduino-tty          delay test start by 2 seconds for Arduino ttyUSB interfaces\n");
+    fprintf(stderr, "  speed test options:\n");
+    fprintf(stderr, "    -d <sec>, --duration <sec> duration of each test: 15 seconds (by default)\n");
+    fprintf(stderr, "    -R <fps>, --rate <fps>     generate frames at fixed rate, 0 - max rate (by default)\n");
+    fprintf(stderr, "    -f <fmt>, --format <fmt>   output format: text (default), json, csv\n");
+    fprintf(stderr, "    -P <port>, --peer-port <port> run echo side in this process on the specified port\n");
+    fprintf(stderr, "    -C <file>, --capture <file> write fd frames and protocol events to pcapng file\n");
+    fprintf(stderr, "  -s, -w, -c accept comma separated lists, like -s 32,64,128 -w 4,7 -c 8,16.\n");
+    fprintf(stderr, "  In this case the test runs for each combination of packet size, window and crc.\n");
+    fprintf(stderr, "  The remote side must run in loopback mode to measure round trip time. If crc list\n");
+    fprintf(stderr, "  has several values, remote side must be started in this process via -P option.\n");
+}
+
+static bool parse_list(const char *arg, std::vector<int> &list)
+{
+    list.clear();
+    char *end = nullptr;
+    for ( ;; )
+    {
+        long value = strtol(arg, &end, 10);
+        if ( end == arg )
+        {
+            return false;
+        }
+        list.push_back(static_cast<int>(value));
+        if ( *end != ',' )
+        {
+            break;
+        }
+        arg = end + 1;
+    }
+    return *end == '\0';
+}
+
+static bool crc_from_bits(int bits, hdlc_crc_t &crc)
+{
+    switch ( bits )
+    {
+        case 0: crc = HDLC_CRC_OFF; break;
+        case 8: crc = HDLC_CRC_8; break;
+        case 16: crc = HDLC_CRC_16; break;
+        case 32: crc = HDLC_CRC_32; break;
+        default: return false;
+    }
+    return true;
 }
 
 static int parse_args(int argc, char *argv[])
@@ -83,41 +160,74 @@ static int parse_args(int argc, char *argv[])
             else
                 return -1;
         }
-        else if ( (!strcmp(argv[i], "-c")) || (!strcmp(argv[i], "--crc")) )
+        else if ( (!strcmp(argv[i], "-P")) || (!strcmp(argv[i], "--peer-port")) )
+        {
+            if ( ++i < argc )
+                s_peerPort = argv[i];
+            else
+                return -1;
+        }
+        else if ( (!strcmp(argv[i], "-C")) || (!strcmp(argv[i], "--capture")) )
         {
             if ( ++i >= argc )
                 return -1;
-            switch ( strtoul(argv[i], nullptr, 10) )
+            s_captureFile = fopen(argv[i], "wb");
+            if ( s_captureFile == nullptr )
             {
-                case 0: s_crc = HDLC_CRC_OFF; break;
-                case 8: s_crc = HDLC_CRC_8; break;
-                case 16: s_crc = HDLC_CRC_16; break;
-                case 32: s_crc = HDLC_CRC_32; break;
-                default: fprintf(stderr, "CRC type not supported\n"); return -1;
+                fprintf(stderr, "Cannot create capture file %s\n", argv[i]);
+                return -1;
             }
         }
-        else if ( (!strcmp(argv[i], "-s")) || (!strcmp(argv[i], "--size")) )
+        else if ( (!strcmp(argv[i], "-b")) || (!strcmp(argv[i], "--baud")) )
         {
             if ( ++i >= argc )
                 return -1;
-            s_packetSize = strtoul(argv[i], nullptr, 10);
-            if ( s_packetSize < 32 )
-            {
-                fprintf(stderr, "Packets size less than 32 bytes are not supported\n");
+            s_baud = strtoul(argv[i], nullptr, 10);
+        }
+        else if ( (!strcmp(argv[i], "-c")) || (!strcmp(argv[i], "--crc")) )
+        {
+            if ( ++i >= argc )
                 return -1;
+            hdlc_crc_t crc;
+            if ( !parse_list(argv[i], s_crcBits) )
                 return -1;
+            for ( int bits : s_crcBits )
+            {
+                if ( !crc_from_bits(bits, crc) )
+                {
+                    fprintf(stderr, "CRC type not supported\n");
+                    return -1;
+                }
             }
         }
-        else if ( (!strcmp(argv[i], "-w")) || (!strcmp(argv[i], "--window")) )
+        else if ( (!strcmp(argv[i], "-s")) || (!strcmp(argv[i], "--size")) )
         {
             if ( ++i >= argc )
                 return -1;
-            s_windowSize = strtoul(argv[i], nullptr, 10);
-            if ( s_windowSize < 1 || s_windowSize > 7 )
+            if ( !parse_list(argv[i], s_packetSizes) )
+                return -1;
+            for ( int size : s_packetSizes )
             {
-                fprintf(stderr, "Allowable window size is between 1 and 7 inclusively\n");
+                if ( size < 32 )
+                {
+                    fprintf(stderr, "Packets size less than 32 bytes are not supported\n");
+                    return -1;
+                }
+            }
+        }
+        else if ( (!strcmp(argv[i], "-w")) || (!strcmp(argv[i], "--window")) )
+        {
+            if ( ++i >= argc )
                 return -1;
+            if ( !parse_list(argv[i], s_windowSizes) )
                 return -1;
+            for ( int window : s_windowSizes )
+            {
+                if ( window < 1 || window > 7 )
+                {
+                    fprintf(stderr, "Allowable window size is between 1 and 7 inclusively\n");
+                    return -1;
+                }
             }
         }
         else if ( (!strcmp(argv[i], "-g")) || (!strcmp(argv[i], "--generator")) )
@@ -133,6 +243,33 @@ static int parse_args(int argc, char *argv[])
         {
             s_isArduinoBoard = true;
         }
+        else if ( (!strcmp(argv[i], "-d")) || (!strcmp(argv[i], "--duration")) )
+        {
+            if ( ++i >= argc )
+                return -1;
+            s_duration = strtoul(argv[i], nullptr, 10);
+            if ( s_duration < 1 )
+                return -1;
+        }
+        else if ( (!strcmp(argv[i], "-R")) || (!strcmp(argv[i], "--rate")) )
+        {
+            if ( ++i >= argc )
+                return -1;
+            s_rate = strtoul(argv[i], nullptr, 10);
+        }
+        else if ( (!strcmp(argv[i], "-f")) || (!strcmp(argv[i], "--format")) )
+        {
+            if ( ++i >= argc )
+                return -1;
+            else if ( !strcmp(argv[i], "text") )
+                s_format = output_format_t::TEXT;
+            else if ( !strcmp(argv[i], "json") )
+                s_format = output_format_t::JSON;
+            else if ( !strcmp(argv[i], "csv") )
+                s_format = output_format_t::CSV;
+            else
+                return -1;
+        }
         else if ( (!strcmp(argv[i], "-t")) || (!strcmp(argv[i], "--protocol")) )
         {
             if ( ++i >= argc )
@@ -150,19 +287,109 @@ static int parse_args(int argc, char *argv[])
     {
         return -1;
     }
+    if ( s_crcBits.size() > 1 && s_peerPort == nullptr )
+    {
+        fprintf(stderr, "Warning: remote side must use the same crc type, consider -P option\n");
+    }
     return i;
 }
 
+//================================== TEST HELPERS ======================================
+
+static int write_capture(void *pdata, const void *data, int len)
+{
+    return static_cast<int>(fwrite(data, 1, len, s_captureFile));
+}
+
+/**
+ * Writer thread moves captured records from capture rings to the file, so rx and tx threads
+ * never wait for file operations. Each test run is written as separate pcapng section.
+ */
+static void run_capture_writer(tiny_capture_handle_t capture)
+{
+    while ( !s_terminate )
+    {
+        tiny_capture_flush(capture);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+static uint32_t timestamp_us()
+{
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - s_startTs).count());
+}
+
+/**
+ * Test frame contains test run id, sequence number and timestamp, so the echo
+ * from the remote side allows to calculate round trip time.
+ */
+static void fill_test_packet(tinyproto::IPacket &packet, uint32_t seq)
+{
+    static const char text[] = "Generated frame. test in progress";
+    packet.put(s_runId);
+    packet.put(seq);
+    packet.put(timestamp_us());
+    for ( size_t i = 0; packet.size() < packet.maxSize(); i++ )
+    {
+        packet.put(text[i % (sizeof(text) - 1)]);
+    }
+}
+
+static void register_received_packet(tinyproto::IPacket &pkt)
+{
+    s_receivedBytes += pkt.size();
+    s_receivedFrames++;
+    if ( s_generatorEnabled && pkt.size() >= 10 )
+    {
+        uint16_t runId = pkt.getUint16();
+        pkt.getUint32();
+        uint32_t ts = pkt.getUint32();
+        // Frames of previous test runs can come, ignore them
+        if ( runId == s_runId )
+        {
+            std::lock_guard<std::mutex> lock(s_rttMutex);
+            s_rtt.push_back(timestamp_us() - ts);
+        }
+    }
+}
+
+static bool check_test_completed(std::chrono::steady_clock::time_point &progressTs)
+{
+    if ( s_runTest && s_generatorEnabled )
+    {
+        auto ts = std::chrono::steady_clock::now();
+        if ( ts - s_startTs >= std::chrono::seconds(s_duration) )
+            return true;
+        if ( ts - progressTs >= std::chrono::seconds(1) )
+        {
+            progressTs = ts;
+            fprintf(stderr, ".");
+        }
+    }
+    return false;
+}
+
+static void pace_generator(std::chrono::steady_clock::time_point &nextTs)
+{
+    if ( s_rate )
+    {
+        nextTs += std::chrono::microseconds(1000000 / s_rate);
+        std::this_thread::sleep_until(nextTs);
+    }
+}
+
 //================================== FD ======================================
 
 tiny_serial_handle_t s_serialFd;
+tiny_serial_handle_t s_peerSerialFd;
 tinyproto::FdD *s_protoFd = nullptr;
 
 void onReceiveFrameFd(void *userData, tinyproto::IPacket &pkt)
 {
     if ( !s_runTest )
         fprintf(stderr, "<<< Frame received payload len=%d\n", (int)pkt.size());
-    s_receivedBytes += static_cast<int>(pkt.size());
+    register_received_packet(pkt);
     if ( !s_generatorEnabled )
     {
         if ( s_protoFd->write(pkt) < 0 )
@@ -172,11 +399,12 @@ void onReceiveFrameFd(void *userData, tinyproto::IPacket &pkt)
     }
 }
 
-void onSendFrameFd(void *userData,tinyproto::IPacket &pkt)
+void onSendFrameFd(void *userData, tinyproto::IPacket &pkt)
 {
     if ( !s_runTest )
         fprintf(stderr, ">>> Frame sent payload len=%d\n", (int)pkt.size());
-    s_sentBytes += static_cast<int>(pkt.size());
+    s_sentBytes += pkt.size();
+    s_sentFrames++;
 }
 
 static int run_fd(tiny_serial_handle_t port)
@@ -195,6 +423,24 @@ static int run_fd(tiny_serial_handle_t port)
     proto.setSendCallback(onSendFrameFd);
     s_protoFd = &proto;
 
+    std::vector<uint8_t> captureBuffer;
+    tiny_capture_handle_t capture = nullptr;
+    if ( s_captureFile != nullptr )
+    {
+        captureBuffer.resize(256 * 1024);
+        tiny_capture_init_t init{};
+        init.buffer = captureBuffer.data();
+        init.buffer_size = static_cast<int>(captureBuffer.size());
+        init.write_func = write_capture;
+        tiny_capture_init(&capture, &init);
+        proto.setCapture(capture);
+    }
+    std::thread captureThread;
+    if ( capture != nullptr )
+    {
+        captureThread = std::thread(run_capture_writer, capture);
+    }
+
     proto.begin();
     std::thread rxThread(
         [](tinyproto::FdD &proto) -> void {
@@ -213,17 +459,20 @@ static int run_fd(tiny_serial_handle_t port)
         },
         std::ref(proto));
 
-    auto startTs = std::chrono::steady_clock::now();
-    auto progressTs = startTs;
+    auto progressTs = s_startTs;
+    auto nextTs = s_startTs;
+    uint32_t seq = 0;
 
     /* Run main cycle forever */
     while ( !s_terminate )
     {
         if ( s_generatorEnabled )
         {
+            pace_generator(nextTs);
             tinyproto::PacketD packet(s_packetSize);
-            packet.put("Generated frame. test in progress");
-            if ( proto.write(packet.data(), static_cast<int>(packet.size())) < 0 )
+            fill_test_packet(packet, seq++);
+            // write() waits for free slot in the window up to send timeout, so no need to sleep here
+            if ( proto.write(packet.data(), static_cast<int>(packet.size())) < 0 && !s_runTest )
             {
                 fprintf(stderr, "Failed to send packet\n");
             }
@@ -232,22 +481,55 @@ static int run_fd(tiny_serial_handle_t port)
         {
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
-        if ( s_runTest && s_generatorEnabled )
+        if ( check_test_completed(progressTs) )
+            s_terminate = true;
+    }
+    rxThread.join();
+    txThread.join();
+    s_hasStats = proto.getStats(s_stats) == TINY_SUCCESS;
+    proto.end();
+    if ( captureThread.joinable() )
+    {
+        captureThread.join();
+        tiny_capture_close(capture);
+        if ( tiny_capture_get_dropped(capture) )
         {
-            auto ts = std::chrono::steady_clock::now();
-            if ( ts - startTs >= std::chrono::seconds(15) )
-                s_terminate = true;
-            if ( ts - progressTs >= std::chrono::seconds(1) )
+            fprintf(stderr, "Capture: %u records are dropped\n", tiny_capture_get_dropped(capture));
+        }
+        fflush(s_captureFile);
+    }
+    return 0;
+}
+
+/**
+ * Echo side of the test, running in the same process on the other port
+ */
+static void run_fd_peer(tiny_serial_handle_t port)
+{
+    s_peerSerialFd = port;
+    tinyproto::FdD proto(tiny_fd_buffer_size_by_mtu(s_packetSize, s_windowSize));
+    proto.enableCrc(s_crc);
+    proto.setWindowSize(s_windowSize);
+    proto.setSendTimeout(0);
+    proto.setUserData(&proto);
+    proto.setReceiveCallback([](void *userData, tinyproto::IPacket &pkt) -> void {
+        reinterpret_cast<tinyproto::FdD *>(userData)->write(pkt);
+    });
+    proto.begin();
+    std::thread rxThread(
+        [](tinyproto::FdD &proto) -> void {
+            while ( !s_terminate )
             {
-                progressTs = ts;
-                fprintf(stderr, ".");
+                proto.run_rx([](void *u, void *b, int s) -> int { return tiny_serial_read(s_peerSerialFd, b, s); });
             }
-        }
+        },
+        std::ref(proto));
+    while ( !s_terminate )
+    {
+        proto.run_tx([](void *u, const void *b, int s) -> int { return tiny_serial_send(s_peerSerialFd, b, s); });
     }
     rxThread.join();
-    txThread.join();
     proto.end();
-    return 0;
 }
 
 //================================== LIGHT ======================================
@@ -267,7 +549,7 @@ static int run_light(tiny_serial_handle_t port)
             {
                 if ( proto.read(packet) > 0 )
                 {
-                    s_receivedBytes += packet.size();
+                    register_received_packet(packet);
                     if ( !s_runTest )
                         fprintf(stderr, "<<< Frame received payload len=%d\n", (int)packet.size());
                     if ( !s_generatorEnabled )
@@ -282,23 +564,27 @@ static int run_light(tiny_serial_handle_t port)
         },
         std::ref(proto));
 
-    auto startTs = std::chrono::steady_clock::now();
-    auto progressTs = startTs;
+    auto progressTs = s_startTs;
+    auto nextTs = s_startTs;
+    uint32_t seq = 0;
 
     /* Run main cycle forever */
     while ( !s_terminate )
     {
         if ( s_generatorEnabled )
         {
+            pace_generator(nextTs);
             tinyproto::PacketD packet(s_packetSize);
-            packet.put("Generated frame. test in progress");
+            fill_test_packet(packet, seq++);
             if ( proto.write(packet) < 0 )
             {
-                fprintf(stderr, "Failed to send packet\n");
+                if ( !s_runTest )
+                    fprintf(stderr, "Failed to send packet\n");
             }
             else
             {
-                s_sentBytes += static_cast<int>(packet.size());
+                s_sentBytes += packet.size();
+                s_sentFrames++;
                 if ( !s_runTest )
                     fprintf(stderr, ">>> Frame sent payload len=%d\n", (int)packet.size());
             }
@@ -307,23 +593,102 @@ static int run_light(tiny_serial_handle_t port)
         {
             std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
-        if ( s_runTest && s_generatorEnabled )
-        {
-            auto ts = std::chrono::steady_clock::now();
-            if ( ts - startTs >= std::chrono::seconds(15) )
-                s_terminate = true;
-            if ( ts - progressTs >= std::chrono::seconds(1) )
-            {
-                progressTs = ts;
-                fprintf(stderr, ".");
-            }
-        }
+        if ( check_test_completed(progressTs) )
+            s_terminate = true;
     }
     rxThread.join();
+    s_hasStats = false;
     proto.end();
     return 0;
 }
 
+static void run_light_peer(tiny_serial_handle_t port)
+{
+    s_peerSerialFd = port;
+    tinyproto::Light proto;
+    proto.enableCrc(s_crc);
+    proto.begin([](void *a, const void *b, int c) -> int { return tiny_serial_send(s_peerSerialFd, b, c); },
+                [](void *a, void *b, int c) -> int { return tiny_serial_read(s_peerSerialFd, b, c); });
+    tinyproto::PacketD packet(s_packetSize + 4);
+    while ( !s_terminate )
+    {
+        if ( proto.read(packet) > 0 )
+        {
+            proto.write(packet);
+        }
+    }
+    proto.end();
+}
+
+//================================== RESULTS ======================================
+
+static uint32_t percentile(const std::vector<uint32_t> &sorted, int p)
+{
+    return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, sorted.size() * p / 100)];
+}
+
+static void print_result(bool first, double seconds)
+{
+    std::vector<uint32_t> rtt;
+    {
+        std::lock_guard<std::mutex> lock(s_rttMutex);
+        rtt.swap(s_rtt);
+    }
+    std::sort(rtt.begin(), rtt.end());
+    const char *proto = s_protocol == protocol_type_t::FD ? "fd" : "light";
+    int crc = s_crc == HDLC_CRC_OFF ? 0 : static_cast<int>(s_crc);
+    uint64_t txBps = static_cast<uint64_t>(s_sentBytes * 8 / seconds);
+    uint64_t rxBps = static_cast<uint64_t>(s_receivedBytes * 8 / seconds);
+    double txFps = s_sentFrames / seconds;
+    double rxFps = s_receivedFrames / seconds;
+    tiny_fd_stats_t stats = s_hasStats ? s_stats : tiny_fd_stats_t{};
+    uint32_t rttMin = rtt.empty() ? 0 : rtt.front();
+    uint32_t rttMax = rtt.empty() ? 0 : rtt.back();
+    switch ( s_format )
+    {
+        case output_format_t::JSON:
+            printf("%s\n  {\"protocol\": \"%s\", \"size\": %d, \"window\": %d, \"crc\": %d, \"duration_s\": %.3f, "
+                   "\"tx_frames\": %llu, \"rx_frames\": %llu, \"tx_bps\": %llu, \"rx_bps\": %llu, "
+                   "\"tx_fps\": %.1f, \"rx_fps\": %.1f, \"retransmits\": %u, \"timeouts\": %u, \"crc_errors\": %u, "
+                   "\"window_full_ms\": %u, \"rtt_us\": {\"count\": %u, \"min\": %u, \"p50\": %u, \"p90\": %u, \"p99\": %u, \"max\": %u}}",
+                   first ? "" : ",", proto, s_packetSize, s_windowSize, crc, seconds,
+                   (unsigned long long)s_sentFrames, (unsigned long long)s_receivedFrames, (unsigned long long)txBps,
+                   (unsigned long long)rxBps, txFps, rxFps, stats.retransmits, stats.timeouts, stats.crc_errors,
+                   stats.window_full_ms, (unsigned)rtt.size(), rttMin, percentile(rtt, 50), percentile(rtt, 90), percentile(rtt, 99),
+                   rttMax);
+            break;
+        case output_format_t::CSV:
+            if ( first )
+            {
+                printf("protocol,size,window,crc,duration_s,tx_frames,rx_frames,tx_bps,rx_bps,tx_fps,rx_fps,"
+                       "retransmits,timeouts,crc_errors,rtt_count,rtt_min_us,rtt_p50_us,rtt_p90_us,rtt_p99_us,"
+                       "rtt_max_us\n");
+            }
+            printf("%s,%d,%d,%d,%.3f,%llu,%llu,%llu,%llu,%.1f,%.1f,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", proto, s_packetSize,
+                   s_windowSize, crc, seconds, (unsigned long long)s_sentFrames, (unsigned long long)s_receivedFrames,
+                   (unsigned long long)txBps, (unsigned long long)rxBps, txFps, rxFps, stats.retransmits,
+                   stats.timeouts, stats.crc_errors, (unsigned)rtt.size(), rttMin, percentile(rtt, 50),
+                   percentile(rtt, 90), percentile(rtt, 99), rttMax);
+            break;
+        default:
+            printf("\n%s: size %d, window %d, crc %d\n", proto, s_packetSize, s_windowSize, crc);
+            printf("Registered TX speed: %llu bps, %.1f frames/s\n", (unsigned long long)txBps, txFps);
+            printf("Registered RX speed: %llu bps, %.1f frames/s\n", (unsigned long long)rxBps, rxFps);
+            if ( s_hasStats )
+            {
+                printf("Retransmits: %u, timeouts: %u, crc errors: %u, window full: %u ms\n", stats.retransmits,
+                       stats.timeouts, stats.crc_errors, stats.window_full_ms);
+            }
+            if ( !rtt.empty() )
+            {
+                printf("RTT: min %u us, p50 %u us, p90 %u us, p99 %u us, max %u us\n", rttMin, percentile(rtt, 50),
+                       percentile(rtt, 90), percentile(rtt, 99), rttMax);
+            }
+            break;
+    }
+    fflush(stdout);
+}
+
 int main(int argc, char *argv[])
 {
     if ( parse_args(argc, argv) < 0 )
@@ -332,30 +697,92 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    tiny_serial_handle_t hPort = tiny_serial_open(s_port, 115200);
+    tiny_serial_handle_t hPort = tiny_serial_open(s_port, s_baud);
 
     if ( hPort == TINY_SERIAL_INVALID )
     {
         fprintf(stderr, "Error opening serial port\n");
         return 1;
     }
+    tiny_serial_handle_t hPeerPort = TINY_SERIAL_INVALID;
+    if ( s_peerPort != nullptr )
+    {
+        hPeerPort = tiny_serial_open(s_peerPort, s_baud);
+        if ( hPeerPort == TINY_SERIAL_INVALID )
+        {
+            fprintf(stderr, "Error opening peer serial port\n");
+            tiny_serial_close(hPort);
+            return 1;
+        }
+    }
     if ( s_isArduinoBoard )
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(1500));
     }
 
-    int result = -1;
-    switch ( s_protocol )
+    int result = 0;
+    bool first = true;
+    if ( s_runTest && s_format == output_format_t::JSON )
+    {
+        printf("[");
+    }
+    for ( int crcBits : s_crcBits )
+    {
+        for ( int window : s_windowSizes )
+        {
+            for ( int size : s_packetSizes )
+            {
+                crc_from_bits(crcBits, s_crc);
+                s_windowSize = window;
+                s_packetSize = size;
+                s_terminate = false;
+                s_receivedBytes = 0;
+                s_sentBytes = 0;
+                s_receivedFrames = 0;
+                s_sentFrames = 0;
+                s_runId++;
+                s_startTs = std::chrono::steady_clock::now();
+                std::thread peerThread;
+                if ( hPeerPort != TINY_SERIAL_INVALID )
+                {
+                    peerThread = std::thread(s_protocol == protocol_type_t::FD ? run_fd_peer : run_light_peer,
+                                             hPeerPort);
+                }
+                switch ( s_protocol )
+                {
+                    case protocol_type_t::FD: result = run_fd(hPort); break;
+                    case protocol_type_t::LIGHT: result = run_light(hPort); break;
+                    default: fprintf(stderr, "Unknown protocol type"); result = -1; break;
+                }
+                if ( peerThread.joinable() )
+                {
+                    peerThread.join();
+                }
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - s_startTs).count();
+                if ( s_runTest )
+                {
+                    print_result(first, seconds);
+                    first = false;
+                }
+                if ( result < 0 )
+                {
+                    break;
+                }
+            }
+        }
+    }
+    if ( s_runTest && s_format == output_format_t::JSON )
+    {
+        printf("\n]\n");
+    }
+    if ( hPeerPort != TINY_SERIAL_INVALID )
     {
-        case protocol_type_t::FD: result = run_fd(hPort); break;
-        case protocol_type_t::LIGHT: result = run_light(hPort); break;
-        default: fprintf(stderr, "Unknown protocol type"); break;
+        tiny_serial_close(hPeerPort);
     }
     tiny_serial_close(hPort);
-    if ( s_runTest )
+    if ( s_captureFile != nullptr )
     {
-        printf("\nRegistered TX speed: %u bps\n", (s_sentBytes)*8 / 15);
-        printf("Registered RX speed: %u bps\n", (s_receivedBytes)*8 / 15);
+        fclose(s_captureFile);
     }
     return result;
 }
@@ -0,0 +1,109 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Invariant check, which works in release builds too. Fuzzer treats abort() as a crash
+ * and saves the input, which caused it.
+ */
+#define FUZZ_CHECK(cond)                                                                                     \
+    do                                                                                                       \
+    {                                                                                                        \
+        if ( !(cond) )                                                                                       \
+        {                                                                                                    \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                        \
+            abort();                                                                                         \
+        }                                                                                                    \
+    } while ( 0 )
+
+/**
+ * Small deterministic generator, used to derive secondary decisions from fuzzer input
+ */
+class FuzzRandom
+{
+public:
+    explicit FuzzRandom(uint64_t seed)
+        : m_state(seed * 0x9E3779B97F4A7C15ULL + 1)
+    {
+    }
+
+    uint32_t next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 7;
+        m_state ^= m_state << 17;
+        return static_cast<uint32_t>(m_state >> 16);
+    }
+
+private:
+    uint64_t m_state;
+};
+
+/**
+ * Sequential reader of fuzzer input. When input is over, returns zeroes.
+ */
+class FuzzInput
+{
+public:
+    FuzzInput(const uint8_t *data, size_t size)
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    bool empty() const
+    {
+        return m_pos >= m_size;
+    }
+
+    uint8_t byte()
+    {
+        return m_pos < m_size ? m_data[m_pos++] : 0;
+    }
+
+    uint16_t word()
+    {
+        uint16_t value = byte();
+        return value | (static_cast<uint16_t>(byte()) << 8);
+    }
+
+    /**
+     * Returns pointer to next len bytes of input, len is reduced if input is shorter
+     */
+    const uint8_t *bytes(size_t &len)
+    {
+        const uint8_t *ptr = m_data + m_pos;
+        if ( len > m_size - m_pos )
+        {
+            len = m_size - m_pos;
+        }
+        m_pos += len;
+        return ptr;
+    }
+
+private:
+    const uint8_t *m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+};
@@ -0,0 +1,163 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ Standalone driver for fuzz targets, used when compiler doesn't provide libFuzzer.
+ It accepts the same basic options as libFuzzer, so the same command lines work with both:
+
+   fuzzer <file|dir>...        run each input file (crash reproduction, corpus regression)
+   fuzzer -runs=N [-seed=S] [-max_len=L]   run N random inputs (smoke test)
+   fuzzer < input              run single input from stdin (AFL: afl-fuzz -i in -o out -- ./fuzzer)
+*/
+
+#include "fuzz_common.h"
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static const std::vector<uint8_t> *s_current = nullptr;
+
+/**
+ * Saves random input, which caused the crash, so it can be reproduced by passing the file to the fuzzer
+ */
+static void on_crash(int sig)
+{
+    if ( s_current )
+    {
+        FILE *file = fopen("crash-input", "wb");
+        if ( file )
+        {
+            fwrite(s_current->data(), 1, s_current->size(), file);
+            fclose(file);
+            fprintf(stderr, "Input is saved to crash-input\n");
+        }
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+static std::vector<uint8_t> read_file(FILE *file)
+{
+    std::vector<uint8_t> data;
+    uint8_t buf[4096];
+    size_t len;
+    while ( (len = fread(buf, 1, sizeof(buf), file)) > 0 )
+    {
+        data.insert(data.end(), buf, buf + len);
+    }
+    return data;
+}
+
+static int run_file(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if ( !file )
+    {
+        fprintf(stderr, "Cannot open %s\n", path.c_str());
+        return 0;
+    }
+    std::vector<uint8_t> data = read_file(file);
+    fclose(file);
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    return 1;
+}
+
+static int run_path(const std::string &path)
+{
+    struct stat st;
+    if ( stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode) )
+    {
+        return run_file(path);
+    }
+    int count = 0;
+    DIR *dir = opendir(path.c_str());
+    if ( dir )
+    {
+        struct dirent *entry;
+        while ( (entry = readdir(dir)) != nullptr )
+        {
+            if ( entry->d_name[0] != '.' )
+            {
+                count += run_path(path + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    return count;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long runs = 0;
+    unsigned long seed = 1;
+    size_t max_len = 4096;
+    int count = 0;
+    bool has_inputs = false;
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( !strncmp(argv[i], "-runs=", 6) )
+            runs = strtoul(argv[i] + 6, nullptr, 10);
+        else if ( !strncmp(argv[i], "-seed=", 6) )
+            seed = strtoul(argv[i] + 6, nullptr, 10);
+        else if ( !strncmp(argv[i], "-max_len=", 9) )
+            max_len = strtoul(argv[i] + 9, nullptr, 10);
+        else if ( argv[i][0] == '-' )
+            fprintf(stderr, "Option %s is ignored by standalone driver\n", argv[i]);
+        else
+        {
+            count += run_path(argv[i]);
+            has_inputs = true;
+        }
+    }
+    if ( runs )
+    {
+        FuzzRandom rng(seed);
+        std::vector<uint8_t> data;
+        s_current = &data;
+        signal(SIGABRT, on_crash);
+        signal(SIGSEGV, on_crash);
+        for ( unsigned long i = 0; i < runs; i++ )
+        {
+            data.resize(rng.next() % (max_len + 1));
+            for ( auto &byte : data )
+            {
+                byte = static_cast<uint8_t>(rng.next());
+            }
+            LLVMFuzzerTestOneInput(data.data(), data.size());
+        }
+        s_current = nullptr;
+        count += static_cast<int>(runs);
+    }
+    else if ( !has_inputs )
+    {
+        std::vector<uint8_t> data = read_file(stdin);
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+        count++;
+    }
+    fprintf(stderr, "Done %d runs\n", count);
+    return 0;
+}
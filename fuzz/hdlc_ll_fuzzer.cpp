@@ -0,0 +1,379 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ Fuzz target for low level HDLC framing.
+
+ Input layout:
+   byte 0     - crc type (bits 0-1: 0 - off, 1 - 8-bit checksum, 2 - FCS16, 3 - FCS32),
+                framing selector (bits 2-3) and mtu selector (bits 4-7)
+   byte 1     - seed for splitting input stream to chunks
+   bytes 2... - raw byte stream as it comes from the wire
+
+ The target checks for each framing mode, that:
+   - hdlc_ll_run_rx() result does not depend on how the stream is split into chunks;
+   - hdlc_ll_scan() finds the same frames as hdlc_ll_run_rx(), if rx buffer fits everything,
+     and gives the same result, when frames are decoded in place;
+   - any payload, encoded by hdlc_ll_put()/hdlc_ll_run_tx(), matches hdlc_ll_encode() output and
+     is decoded back to the same payload by both decoders, regardless of tx buffer size.
+ For async framing hdlc_ll_run_rx(), hdlc_ll_scan() and the encoder are also compared with simple
+ byte-by-byte reference implementation.
+*/
+
+#include "fuzz_common.h"
+#include "proto/crc/crc.h"
+#include "proto/hdlc/low_level/hdlc.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+static const uint8_t FLAG = 0x7E;
+static const uint8_t ESCAPE = 0x7D;
+static const uint8_t ESCAPE_BIT = 0x20;
+
+struct RxEvent
+{
+    int error;
+    std::vector<uint8_t> data;
+
+    bool operator==(const RxEvent &other) const
+    {
+        return error == other.error && data == other.data;
+    }
+};
+
+static int crc_bytes(hdlc_crc_t crc)
+{
+    return crc == HDLC_CRC_OFF ? 0 : static_cast<int>(crc) / 8;
+}
+
+static uint32_t calc_crc(hdlc_crc_t crc, const uint8_t *data, int len)
+{
+    switch ( crc )
+    {
+        case HDLC_CRC_8: return chksum(INITCHECKSUM, data, len) & 0x00FF;
+        case HDLC_CRC_16: return crc16(PPPINITFCS16, data, len);
+        case HDLC_CRC_32: return crc32(PPPINITFCS32, data, len);
+        default: return 0;
+    }
+}
+
+//================================== REFERENCE ======================================
+
+/**
+ * Straightforward model of RFC 1662 deframer with the same rules as hdlc_ll:
+ * closing flag does not open next frame, two flags in a row are treated as frame start,
+ * bytes above buffer size are dropped and frame is checked as is.
+ */
+static std::vector<RxEvent> reference_decode(const uint8_t *data, size_t len, hdlc_crc_t crc, int buf_size)
+{
+    std::vector<RxEvent> events;
+    std::vector<uint8_t> frame;
+    bool in_frame = false;
+    bool escape = false;
+    for ( size_t i = 0; i < len; i++ )
+    {
+        uint8_t byte = data[i];
+        if ( !in_frame )
+        {
+            if ( byte == FLAG )
+            {
+                in_frame = true;
+                escape = false;
+                frame.clear();
+            }
+            continue;
+        }
+        if ( byte == FLAG )
+        {
+            if ( frame.empty() )
+            {
+                escape = false;
+                continue;
+            }
+            in_frame = false;
+            int size = static_cast<int>(frame.size());
+            int crc_len = crc_bytes(crc);
+            if ( size < crc_len )
+            {
+                events.push_back({TINY_ERR_WRONG_CRC, {}});
+                continue;
+            }
+            uint32_t read_crc = 0;
+            for ( int j = 0; j < crc_len; j++ )
+            {
+                read_crc |= static_cast<uint32_t>(frame[size - crc_len + j]) << (8 * j);
+            }
+            if ( calc_crc(crc, frame.data(), size - crc_len) != read_crc )
+            {
+                events.push_back({TINY_ERR_WRONG_CRC, {}});
+                continue;
+            }
+            frame.resize(size - crc_len);
+            events.push_back({TINY_SUCCESS, frame});
+        }
+        else if ( byte == ESCAPE )
+        {
+            escape = true;
+        }
+        else if ( static_cast<int>(frame.size()) < buf_size )
+        {
+            frame.push_back(escape ? byte ^ ESCAPE_BIT : byte);
+            escape = false;
+        }
+    }
+    return events;
+}
+
+static void put_escaped(std::vector<uint8_t> &out, uint8_t byte)
+{
+    if ( byte == FLAG || byte == ESCAPE )
+    {
+        out.push_back(ESCAPE);
+        out.push_back(byte ^ ESCAPE_BIT);
+    }
+    else
+    {
+        out.push_back(byte);
+    }
+}
+
+static std::vector<uint8_t> reference_encode(const uint8_t *data, int len, hdlc_crc_t crc)
+{
+    std::vector<uint8_t> out;
+    out.push_back(FLAG);
+    for ( int i = 0; i < len; i++ )
+    {
+        put_escaped(out, data[i]);
+    }
+    uint32_t value = calc_crc(crc, data, len);
+    for ( int i = 0; i < crc_bytes(crc); i++ )
+    {
+        put_escaped(out, static_cast<uint8_t>(value >> (8 * i)));
+    }
+    out.push_back(FLAG);
+    return out;
+}
+
+//================================== HDLC LL ======================================
+
+class HdlcDecoder
+{
+public:
+    HdlcDecoder(hdlc_crc_t crc, hdlc_framing_t framing, int mtu)
+        : m_buffer(hdlc_ll_get_buf_size_ex(mtu, crc))
+        , m_rxBufSize(mtu + crc_bytes(crc))
+    {
+        hdlc_ll_init_t init{};
+        init.on_frame_read = onFrameRead;
+        init.user_data = this;
+        init.crc_type = crc;
+        init.framing = framing;
+        init.buf = m_buffer.data();
+        init.buf_size = static_cast<int>(m_buffer.size());
+        FUZZ_CHECK(hdlc_ll_init(&m_handle, &init) == TINY_SUCCESS);
+    }
+
+    ~HdlcDecoder()
+    {
+        hdlc_ll_close(m_handle);
+    }
+
+    void feed(const uint8_t *data, int len)
+    {
+        int stalls = 0;
+        while ( len > 0 )
+        {
+            int error = TINY_SUCCESS;
+            int processed = hdlc_ll_run_rx(m_handle, data, len, &error);
+            FUZZ_CHECK(processed >= 0 && processed <= len);
+            if ( error != TINY_SUCCESS )
+            {
+                m_events.push_back({error, {}});
+            }
+            // hdlc_ll_run_rx() can return 0 once when recovering from frame alignment error
+            stalls = processed ? 0 : stalls + 1;
+            FUZZ_CHECK(stalls < 3);
+            data += processed;
+            len -= processed;
+        }
+    }
+
+    const std::vector<RxEvent> &events() const
+    {
+        return m_events;
+    }
+
+    int rxBufSize() const
+    {
+        return m_rxBufSize;
+    }
+
+private:
+    std::vector<uint8_t> m_buffer;
+    int m_rxBufSize;
+    hdlc_ll_handle_t m_handle = nullptr;
+    std::vector<RxEvent> m_events;
+
+    static int onFrameRead(void *user_data, void *data, int len)
+    {
+        HdlcDecoder *self = static_cast<HdlcDecoder *>(user_data);
+        FUZZ_CHECK(len >= 0 && len <= self->rxBufSize());
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        self->m_events.push_back({TINY_SUCCESS, std::vector<uint8_t>(bytes, bytes + len)});
+        return 0;
+    }
+};
+
+static std::vector<uint8_t> hdlc_encode(const uint8_t *data, int len, hdlc_crc_t crc, hdlc_framing_t framing,
+                                        FuzzRandom &rng)
+{
+    std::vector<uint8_t> buffer(hdlc_ll_get_buf_size_ex(len, crc));
+    hdlc_ll_handle_t handle = nullptr;
+    hdlc_ll_init_t init{};
+    init.crc_type = crc;
+    init.framing = framing;
+    init.buf = buffer.data();
+    init.buf_size = static_cast<int>(buffer.size());
+    FUZZ_CHECK(hdlc_ll_init(&handle, &init) == TINY_SUCCESS);
+    // Copy payload to separate heap block, so ASAN can catch reads beyond the payload end
+    std::vector<uint8_t> payload(data, data + len);
+    FUZZ_CHECK(hdlc_ll_put(handle, payload.data(), len) == TINY_SUCCESS);
+    std::vector<uint8_t> out;
+    uint8_t chunk[16];
+    for ( ;; )
+    {
+        int size = 1 + static_cast<int>(rng.next() % sizeof(chunk));
+        int result = hdlc_ll_run_tx(handle, chunk, size);
+        FUZZ_CHECK(result >= 0 && result <= size);
+        if ( result == 0 )
+        {
+            break;
+        }
+        out.insert(out.end(), chunk, chunk + result);
+        FUZZ_CHECK(out.size() <= static_cast<size_t>(hdlc_ll_get_max_encoded_size(len, crc, framing)));
+    }
+    hdlc_ll_close(handle);
+    return out;
+}
+
+static std::vector<RxEvent> hdlc_scan(const uint8_t *data, int len, hdlc_crc_t crc, hdlc_framing_t framing,
+                                      bool in_place = false)
+{
+    // Output buffer, which is not smaller than the input, fits all frames
+    std::vector<uint8_t> out(len);
+    if ( in_place )
+    {
+        std::copy(data, data + len, out.begin());
+        data = out.data();
+    }
+    // Synchronous frames share flags, so there can be a frame per each byte
+    std::vector<hdlc_ll_frame_info_t> index(len + 1);
+    int processed = 0;
+    int count = hdlc_ll_scan(data, len, out.data(), len, index.data(), static_cast<int>(index.size()), crc, framing,
+                             &processed);
+    FUZZ_CHECK(count >= 0 && count <= static_cast<int>(index.size()));
+    FUZZ_CHECK(processed >= 0 && processed <= len);
+    std::vector<RxEvent> events;
+    for ( int i = 0; i < count; i++ )
+    {
+        FUZZ_CHECK(index[i].offset >= 0 && index[i].len >= 0 && index[i].offset + index[i].len <= len);
+        events.push_back({index[i].error, index[i].error == TINY_SUCCESS
+                                              ? std::vector<uint8_t>(out.data() + index[i].offset,
+                                                                     out.data() + index[i].offset + index[i].len)
+                                              : std::vector<uint8_t>()});
+    }
+    return events;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if ( size < 2 )
+    {
+        return 0;
+    }
+    static const hdlc_crc_t crc_types[] = {HDLC_CRC_OFF, HDLC_CRC_8, HDLC_CRC_16, HDLC_CRC_32};
+    static const hdlc_framing_t framings[] = {HDLC_FRAMING_ASYNC, HDLC_FRAMING_COBS, HDLC_FRAMING_LENGTH,
+                                              HDLC_FRAMING_SYNC};
+    hdlc_crc_t crc = crc_types[data[0] & 0x03];
+    hdlc_framing_t framing = framings[(data[0] >> 2) & 0x03];
+    int mtu = 1 + ((data[0] >> 4) & 0x0F) * 8;
+    FuzzRandom rng(data[1]);
+    const uint8_t *stream = data + 2;
+    int len = static_cast<int>(size - 2);
+
+    HdlcDecoder whole(crc, framing, mtu);
+    whole.feed(stream, len);
+    if ( framing == HDLC_FRAMING_ASYNC )
+    {
+        // Differential check against reference decoder
+        FUZZ_CHECK(whole.events() == reference_decode(stream, len, crc, whole.rxBufSize()));
+    }
+
+    // The same stream, split to random chunks, must give the same result
+    HdlcDecoder chunked(crc, framing, mtu);
+    for ( int offset = 0; offset < len; )
+    {
+        int chunk = std::min(len - offset, 1 + static_cast<int>(rng.next() % 32));
+        chunked.feed(stream + offset, chunk);
+        offset += chunk;
+    }
+    FUZZ_CHECK(chunked.events() == whole.events());
+
+    // Bulk scanner finds the same frames, if rx buffer fits everything
+    std::vector<RxEvent> scanned = hdlc_scan(stream, len, crc, framing);
+    HdlcDecoder unlimited(crc, framing, std::max(len, 1));
+    unlimited.feed(stream, len);
+    FUZZ_CHECK(scanned == unlimited.events());
+    FUZZ_CHECK(hdlc_scan(stream, len, crc, framing, true) == scanned);
+    if ( framing == HDLC_FRAMING_ASYNC )
+    {
+        FUZZ_CHECK(scanned == reference_decode(stream, len, crc, len));
+    }
+
+    // Round trip: stream bytes are used as payloads for encoder
+    HdlcDecoder roundtrip(crc, framing, 64);
+    std::vector<uint8_t> wire;
+    std::vector<RxEvent> sent;
+    for ( int offset = 0; offset < len; )
+    {
+        int payload = std::min(len - offset, 1 + stream[offset] % 64);
+        std::vector<uint8_t> encoded = hdlc_encode(stream + offset, payload, crc, framing, rng);
+        std::vector<uint8_t> expected(hdlc_ll_get_max_encoded_size(payload, crc, framing));
+        int expected_size = hdlc_ll_encode(stream + offset, payload, expected.data(),
+                                           static_cast<int>(expected.size()), crc, framing);
+        FUZZ_CHECK(expected_size > 0);
+        expected.resize(expected_size);
+        FUZZ_CHECK(encoded == expected);
+        if ( framing == HDLC_FRAMING_ASYNC )
+        {
+            FUZZ_CHECK(encoded == reference_encode(stream + offset, payload, crc));
+        }
+        roundtrip.feed(encoded.data(), static_cast<int>(encoded.size()));
+        wire.insert(wire.end(), encoded.begin(), encoded.end());
+        sent.push_back({TINY_SUCCESS, std::vector<uint8_t>(stream + offset, stream + offset + payload)});
+        offset += payload;
+    }
+    FUZZ_CHECK(roundtrip.events() == sent);
+    FUZZ_CHECK(hdlc_scan(wire.data(), static_cast<int>(wire.size()), crc, framing) == sent);
+    FUZZ_CHECK(hdlc_scan(wire.data(), static_cast<int>(wire.size()), crc, framing, true) == sent);
+    return 0;
+}
@@ -0,0 +1,306 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ Fuzz target for tiny_fd state machine.
+
+ Two tiny_fd endpoints A and B run in single thread mode on virtual clock. Fuzzer input
+ is a program for the link between them:
+   byte 0 - configuration: crc type (bits 0-1), window size (bits 2-4), mtu (bits 5-7).
+            Window values 6 and 7 select window 2 and 3 with message aggregation
+   then sequence of operations (see fd_op_t), each operation takes its arguments from
+   following bytes of input.
+
+ After each operation the target checks window invariants of both endpoints. While the
+ link is protected with FCS32 and no foreign frames were injected, it also checks, that
+ every delivered payload is intact and payloads come in the order they were sent.
+*/
+
+#include "fuzz_common.h"
+#include "proto/fd/tiny_fd.h"
+#include "proto/fd/tiny_fd_int.h"
+#include "proto/hdlc/low_level/hdlc.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+enum fd_op_t
+{
+    OP_SEND = 0,          ///< endpoint, length: put new payload to endpoint tx queue
+    OP_TRANSFER = 1,      ///< endpoint, length: move bytes from endpoint to remote side
+    OP_CORRUPT = 2,       ///< endpoint, length, bit: move bytes and invert single bit in them
+    OP_DROP = 3,          ///< endpoint, length: take bytes from endpoint and lose them
+    OP_TIME = 4,          ///< delay: advance virtual clock by delay * 8 milliseconds
+    OP_INJECT_FRAME = 5,  ///< endpoint, address, control, length, data: deliver valid hdlc frame to endpoint
+    OP_INJECT_RAW = 6,    ///< endpoint, length, data: deliver raw bytes to endpoint
+    OP_DISCONNECT = 7,    ///< endpoint: request disconnect
+    OP_COUNT,
+};
+
+static const uint8_t PAYLOAD_MAGIC = 0xA5;
+static const int PAYLOAD_HEADER = 5;
+
+static uint32_t s_now_ms = 0;
+
+static uint32_t virtual_millis()
+{
+    return s_now_ms;
+}
+
+static const tiny_platform_hal_t *virtual_hal()
+{
+    static tiny_platform_hal_t hal{};
+    hal.millis = virtual_millis;
+    return &hal;
+}
+
+class Endpoint
+{
+public:
+    Endpoint(hdlc_crc_t crc, int window, int mtu, bool aggregation)
+        : m_buffer(tiny_fd_buffer_size_by_mtu_ex(mtu, window, crc))
+        , m_window(window)
+        , m_mtu(mtu)
+    {
+        tiny_fd_init_t init{};
+        init.pdata = this;
+        init.on_frame_cb = onFrame;
+        init.on_sent_cb = onSent;
+        init.buffer = m_buffer.data();
+        init.buffer_size = static_cast<uint16_t>(m_buffer.size());
+        init.window_frames = static_cast<uint8_t>(window);
+        init.mtu = mtu;
+        init.crc_type = crc;
+        init.retry_timeout = 100;
+        init.retries = 2;
+        init.hal = virtual_hal();
+        init.single_thread = 1;
+        init.aggregation = aggregation;
+        init.aggregation_delay = 16;
+        FUZZ_CHECK(tiny_fd_init(&m_handle, &init) == TINY_SUCCESS);
+        FUZZ_CHECK(tiny_fd_get_mtu(m_handle) >= mtu);
+    }
+
+    ~Endpoint()
+    {
+        tiny_fd_close(m_handle);
+    }
+
+    tiny_fd_handle_t handle()
+    {
+        return m_handle;
+    }
+
+    int mtu() const
+    {
+        return m_mtu;
+    }
+
+    void send(int len)
+    {
+        std::vector<uint8_t> payload = makePayload(m_nextSeq, len);
+        if ( tiny_fd_send_packet(m_handle, payload.data(), len) == TINY_SUCCESS )
+        {
+            m_nextSeq++;
+        }
+    }
+
+    void checkInvariants(const Endpoint &remote, bool check_data) const
+    {
+        const tiny_frames_info_t &frames = m_handle->frames;
+        FUZZ_CHECK(m_handle->state <= TINY_FD_STATE_DISCONNECTING);
+        FUZZ_CHECK(frames.max_i_frames == m_window);
+        uint8_t awaiting = (frames.last_ns - frames.confirm_ns) & 0x07;
+        uint8_t sent = (frames.next_ns - frames.confirm_ns) & 0x07;
+        FUZZ_CHECK(frames.confirm_ns <= 7 && frames.next_ns <= 7 && frames.last_ns <= 7);
+        FUZZ_CHECK(frames.next_nr <= 7 && frames.sent_nr <= 7);
+        FUZZ_CHECK(awaiting <= frames.max_i_frames);
+        FUZZ_CHECK(sent <= awaiting);
+        FUZZ_CHECK(frames.max_i_frames <= frames.slot_mask + 1 && !(frames.slot_mask & (frames.slot_mask + 1)));
+        FUZZ_CHECK(m_handle->s_u_frames.queue_len <= TINY_FD_U_QUEUE_MAX_SIZE);
+        FUZZ_CHECK(m_handle->s_u_frames.queue_ptr < TINY_FD_U_QUEUE_MAX_SIZE);
+        if ( m_handle->state == TINY_FD_STATE_DISCONNECTED )
+        {
+            FUZZ_CHECK(awaiting == 0);
+        }
+        for ( uint8_t i = 0; i < awaiting; i++ )
+        {
+            uint8_t slot = (frames.confirm_ns + i) & frames.slot_mask;
+            FUZZ_CHECK(frames.i_frames[slot].len > 0 && frames.i_frames[slot].len <= m_mtu);
+        }
+        if ( check_data && checkData && remote.checkData )
+        {
+            // Frame can be confirmed only after remote side received it
+            FUZZ_CHECK(m_lastConfirmedSeq <= remote.m_lastReceivedSeq);
+        }
+    }
+
+    /// Payloads and confirmations from remote side are checked until foreign frames are injected to the endpoint
+    bool checkData = true;
+
+private:
+    std::vector<uint8_t> m_buffer;
+    tiny_fd_handle_t m_handle = nullptr;
+    int m_window;
+    int m_mtu;
+    uint32_t m_nextSeq = 0;
+    int64_t m_lastReceivedSeq = -1;
+    int64_t m_lastConfirmedSeq = -1;
+
+    static std::vector<uint8_t> makePayload(uint32_t seq, int len)
+    {
+        std::vector<uint8_t> payload(len);
+        payload[0] = PAYLOAD_MAGIC;
+        memcpy(&payload[1], &seq, sizeof(seq));
+        for ( int i = PAYLOAD_HEADER; i < len; i++ )
+        {
+            payload[i] = static_cast<uint8_t>(seq + i);
+        }
+        return payload;
+    }
+
+    static uint32_t checkPayload(const uint8_t *data, int len)
+    {
+        FUZZ_CHECK(len >= PAYLOAD_HEADER);
+        uint32_t seq;
+        memcpy(&seq, data + 1, sizeof(seq));
+        FUZZ_CHECK(makePayload(seq, len) == std::vector<uint8_t>(data, data + len));
+        return seq;
+    }
+
+    static void onFrame(void *user_data, uint8_t *data, int len)
+    {
+        Endpoint *self = static_cast<Endpoint *>(user_data);
+        FUZZ_CHECK(len >= 0 && len <= self->m_mtu);
+        if ( self->checkData )
+        {
+            int64_t seq = checkPayload(data, len);
+            FUZZ_CHECK(seq > self->m_lastReceivedSeq);
+            self->m_lastReceivedSeq = seq;
+        }
+    }
+
+    static void onSent(void *user_data, uint8_t *data, int len)
+    {
+        Endpoint *self = static_cast<Endpoint *>(user_data);
+        // Sent frames are always generated by this endpoint, so they are checked even if remote side is attacked
+        int64_t seq = checkPayload(data, len);
+        FUZZ_CHECK(seq > self->m_lastConfirmedSeq);
+        self->m_lastConfirmedSeq = seq;
+    }
+};
+
+static std::vector<uint8_t> encode_frame(hdlc_crc_t crc, const uint8_t *data, int len)
+{
+    std::vector<uint8_t> buffer(hdlc_ll_get_buf_size_ex(len, crc));
+    hdlc_ll_handle_t handle = nullptr;
+    hdlc_ll_init_t init{};
+    init.crc_type = crc;
+    init.buf = buffer.data();
+    init.buf_size = static_cast<int>(buffer.size());
+    FUZZ_CHECK(hdlc_ll_init(&handle, &init) == TINY_SUCCESS);
+    FUZZ_CHECK(hdlc_ll_put(handle, data, len) == TINY_SUCCESS);
+    std::vector<uint8_t> out(2 * (len + 4) + 2);
+    out.resize(hdlc_ll_run_tx(handle, out.data(), static_cast<int>(out.size())));
+    hdlc_ll_close(handle);
+    return out;
+}
+
+static void deliver(Endpoint &to, const uint8_t *data, int len)
+{
+    FUZZ_CHECK(tiny_fd_on_rx_data(to.handle(), data, len) == TINY_SUCCESS);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static const hdlc_crc_t crc_types[] = {HDLC_CRC_32, HDLC_CRC_16, HDLC_CRC_8, HDLC_CRC_OFF};
+    FuzzInput input(data, size);
+    uint8_t config = input.byte();
+    hdlc_crc_t crc = crc_types[config & 0x03];
+    int window = 2 + ((config >> 2) & 0x07) % 6;
+    bool aggregation = ((config >> 2) & 0x07) >= 6;
+    int mtu = PAYLOAD_HEADER + 3 + ((config >> 5) & 0x07) * 8;
+    // Payload integrity can be guaranteed only if corrupted frames are reliably detected
+    bool check_data = crc == HDLC_CRC_32;
+
+    s_now_ms = 0;
+    Endpoint a(crc, window, mtu, aggregation);
+    Endpoint b(crc, window, mtu, aggregation);
+    Endpoint *endpoints[2] = {&a, &b};
+    a.checkData = check_data;
+    b.checkData = check_data;
+    uint8_t buf[256];
+
+    for ( int ops = 0; !input.empty() && ops < 4096; ops++ )
+    {
+        uint8_t op = input.byte();
+        Endpoint &from = *endpoints[op >> 7];
+        Endpoint &to = *endpoints[1 - (op >> 7)];
+        switch ( (op & 0x7F) % OP_COUNT )
+        {
+            case OP_SEND: from.send(PAYLOAD_HEADER + input.byte() % (from.mtu() - PAYLOAD_HEADER + 1)); break;
+            case OP_TRANSFER:
+            case OP_CORRUPT:
+            case OP_DROP:
+            {
+                int len = tiny_fd_get_tx_data(from.handle(), buf, 1 + input.byte());
+                FUZZ_CHECK(len >= 0 && len <= static_cast<int>(sizeof(buf)));
+                if ( (op & 0x7F) % OP_COUNT == OP_CORRUPT && len > 0 )
+                {
+                    uint8_t bit = input.byte();
+                    buf[(bit >> 3) % len] ^= 1 << (bit & 0x07);
+                }
+                if ( (op & 0x7F) % OP_COUNT != OP_DROP )
+                {
+                    deliver(to, buf, len);
+                }
+                break;
+            }
+            case OP_TIME: s_now_ms += input.byte() * 8; break;
+            case OP_INJECT_FRAME:
+            {
+                uint8_t frame[2 + 16];
+                frame[0] = input.byte();
+                frame[1] = input.byte();
+                size_t len = input.byte() % 17;
+                const uint8_t *payload = input.bytes(len);
+                memcpy(&frame[2], payload, len);
+                std::vector<uint8_t> encoded = encode_frame(crc, frame, static_cast<int>(2 + len));
+                to.checkData = false;
+                deliver(to, encoded.data(), static_cast<int>(encoded.size()));
+                break;
+            }
+            case OP_INJECT_RAW:
+            {
+                size_t len = input.byte() % 32;
+                const uint8_t *raw = input.bytes(len);
+                to.checkData = false;
+                deliver(to, raw, static_cast<int>(len));
+                break;
+            }
+            case OP_DISCONNECT: tiny_fd_disconnect(from.handle()); break;
+            default: break;
+        }
+        a.checkInvariants(b, check_data);
+        b.checkInvariants(a, check_data);
+    }
+    return 0;
+}
@@ -55,6 +55,15 @@ void IFd::begin()
     init.retry_timeout = 200;
     init.retries = 2;
     init.crc_type = m_crc;
+    init.capture = m_capture;
+    init.arena = m_arena;
+    init.arena_reserve = m_arenaReserve;
+    init.aggregation = m_aggregation;
+    init.aggregation_delay = m_aggregationDelay;
+    init.fec_roots = m_fecRoots;
+    init.framing = m_framing;
+    init.links = m_links;
+    init.resume = m_resume;
 
     tiny_fd_init(&m_handle, &init);
 }
@@ -71,6 +80,13 @@ int IFd::write(const char *buf, int size)
     return tiny_fd_send_packet(m_handle, buf, size);
 }
 
+int IFd::write(const char *buf, int size, uint32_t ttl)
+{
+    return tiny_fd_send_packet_ttl(m_handle, buf, size, ttl);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 int IFd::write(const IPacket &pkt)
 {
     return tiny_fd_send_packet(m_handle, pkt.m_buf, pkt.m_len);
@@ -97,6 +113,16 @@ int IFd::run_tx(void *data, int max_size)
     return tiny_fd_get_tx_data(m_handle, data, max_size);
 }
 
+int IFd::run_rx(uint8_t link, const void *data, int len)
+{
+    return tiny_fd_on_rx_data_link(m_handle, link, data, len);
+}
+
+int IFd::run_tx(uint8_t link, void *data, int max_size)
+{
+    return tiny_fd_get_tx_data_link(m_handle, link, data, max_size);
+}
+
 int IFd::run_tx(write_block_cb_t write_func)
 {
     uint8_t buf[4];
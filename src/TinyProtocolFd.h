@@ -91,6 +91,17 @@ public:
      */
     int write(const char *buf, int size);
 
+    /**
+     * Sends data block, which expires, if it is not sent in ttl milliseconds.
+     * @param buf - data to send
+     * @param size - length of the data in bytes
+     * @param ttl - time to live in milliseconds, see tiny_fd_send_packet_ttl()
+     * @return negative value in case of error
+     *         zero if nothing is sent
+     *         positive - should be equal to size parameter
+     */
+    int write(const char *buf, int size, uint32_t ttl);
+
     /**
      * Sends packet over communication channel.
      * @param pkt - Packet to send
@@ -135,6 +146,24 @@ public:
      */
     int run_tx(void *data, int max_size);
 
+    /**
+     * Processes incoming rx data of specified bonded link (see setLinks()).
+     * @param link index of the link
+     * @param data pointer to the buffer with incoming data
+     * @param len size of the buffer in bytes
+     * @return TINY_SUCCESS or TINY_ERR_INVALID_DATA for wrong link index
+     */
+    int run_rx(uint8_t link, const void *data, int len);
+
+    /**
+     * Generates tx data of specified bonded link (see setLinks()).
+     * @param link index of the link
+     * @param data buffer to fill with tx data
+     * @param max_size maximum size of the buffer
+     * @return number of bytes written to buffer
+     */
+    int run_tx(uint8_t link, void *data, int max_size);
+
     /**
      * Disable CRC field in the protocol.
      * If CRC field is OFF, then the frame looks like this:
@@ -215,6 +244,89 @@ public:
         m_sendTimeout = timeout;
     }
 
+    /**
+     * Returns protocol statistics. Use this function only after begin() call.
+     * @param stats structure to fill with statistics
+     * @return TINY_SUCCESS or error code, see tiny_fd_get_stats()
+     */
+    int getStats(tiny_fd_stats_t &stats)
+    {
+        return tiny_fd_get_stats(m_handle, &stats);
+    }
+
+    /**
+     * Sets capture object to record frames and protocol events. Use this function only before begin() call.
+     * @param capture capture handle, initialized by tiny_capture_init(), or nullptr to disable capture
+     */
+    void setCapture(tiny_capture_handle_t capture)
+    {
+        m_capture = capture;
+    }
+
+    /**
+     * Sets shared arena to take tx frame slots from. Use this function only before begin() call.
+     * @param arena arena handle, initialized by tiny_fd_arena_init(), or nullptr to use own buffer
+     * @param reserve number of arena slots, reserved for this protocol instance
+     */
+    void setArena(tiny_fd_arena_handle_t arena, uint8_t reserve = 0)
+    {
+        m_arena = arena;
+        m_arenaReserve = reserve;
+    }
+
+    /**
+     * Enables packing of small messages to single I-frame. Remote side must enable aggregation too.
+     * Use this function only before begin() call.
+     * @param delay time in milliseconds to wait for new messages before sending I-frame
+     */
+    void enableAggregation(uint16_t delay = 0)
+    {
+        m_aggregation = 1;
+        m_aggregationDelay = delay;
+    }
+
+    /**
+     * Enables Reed-Solomon forward error correction. Remote side must use the same number of roots.
+     * Parity bytes take part of the buffer, so mtu becomes smaller. Use this function only before begin() call.
+     * Library must be built with CONFIG_ENABLE_FEC.
+     * @param roots number of parity bytes per 255-byte block, up to TINY_FEC_MAX_ROOTS
+     */
+    void enableFec(uint8_t roots)
+    {
+        m_fecRoots = roots;
+    }
+
+    /**
+     * Sets framing mode. Remote side must use the same mode.
+     * Use this function only before begin() call.
+     * @param framing HDLC_FRAMING_ASYNC (default), HDLC_FRAMING_SYNC, HDLC_FRAMING_COBS or HDLC_FRAMING_LENGTH
+     */
+    void setFraming(hdlc_framing_t framing)
+    {
+        m_framing = framing;
+    }
+
+    /**
+     * Sets number of physical links, bonded to the protocol. Remote side must use the same number of links.
+     * The buffer must be bigger by tiny_fd_buffer_size_links_overhead() bytes, and window size
+     * must not exceed TINY_FD_BONDING_MAX_WINDOW. Bonded links don't support capture (see setCapture()).
+     * Use this function only before begin() call.
+     * @param links number of links, up to TINY_FD_MAX_LINKS
+     */
+    void setLinks(uint8_t links)
+    {
+        m_links = links;
+    }
+
+    /**
+     * Keeps unconfirmed frames and sequence numbers, when connection is lost, and continues the session
+     * after reconnect (see tiny_fd_init_t::resume). Use this function only before begin() call.
+     */
+    void enableResume()
+    {
+        m_resume = 1;
+    }
+
     /**
      * Sets user data to pass to callbacks
      * @param userData user data to pass to callback
@@ -279,6 +391,24 @@ private:
 
     void *m_userData = nullptr;
 
+    tiny_capture_handle_t m_capture = nullptr;
+
+    tiny_fd_arena_handle_t m_arena = nullptr;
+
+    uint8_t m_arenaReserve = 0;
+
+    uint8_t m_aggregation = 0;
+
+    uint16_t m_aggregationDelay = 0;
+
+    uint8_t m_fecRoots = 0;
+
+    hdlc_framing_t m_framing = HDLC_FRAMING_ASYNC;
+
+    uint8_t m_links = 1;
+
+    uint8_t m_resume = 0;
+
     /** Internal function */
     static void onReceiveInternal(void *handle, uint8_t *pdata, int size);
 
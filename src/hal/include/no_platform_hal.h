@@ -56,59 +56,10 @@ typedef struct
     uint8_t bits;
 } tiny_events_t;
 
-/**
- * Structure of HAL abstraction layer
- */
-typedef struct
-{
-    /** Optional, but remember, default implementation relies on GCC built-in atomic functions */
-    void (*mutex_create)(tiny_mutex_t *mutex);
-
-    /** Optional, but remember, default implementation relies on GCC built-in atomic functions */
-    void (*mutex_destroy)(tiny_mutex_t *mutex);
-
-    /** Optional, but remember, default implementation relies on GCC built-in atomic functions */
-    uint8_t (*mutex_try_lock)(tiny_mutex_t *mutex);
-
-    /** Optional, but remember, default implementation relies on GCC built-in atomic functions */
-    void (*mutex_unlock)(tiny_mutex_t *mutex);
-
-    /**
-     * Optional, but remember, default implementation relies on GCC built-in atomic functions
-     * and tiny_sleep() implementation
-     */
-    void (*mutex_lock)(tiny_mutex_t *mutex);
-
-    /** Optional, but remember, default implementation relies on GCC built-in atomic functions */
-    void (*events_create)(tiny_events_t *events);
-
-    /** Optional, but remember, default implementation relies on GCC built-in atomic functions */
-    void (*events_destroy)(tiny_events_t *events);
-
-    /**
-     * Optional, but remember, default implementation relies on GCC built-in atomic functions
-     * and tiny_sleep() implementation
-     */
-    uint8_t (*events_wait)(tiny_events_t *events, uint8_t bits, uint8_t clear, uint32_t timeout);
-
-    /** Optional, but remember, default implementation relies on GCC built-in atomic functions */
-    uint8_t (*events_check_int)(tiny_events_t *events, uint8_t bits, uint8_t clear);
-
-    /** Optional, but remember, default implementation relies on GCC built-in atomic functions */
-    void (*events_set)(tiny_events_t *events, uint8_t bits);
-
-    /** Optional, but remember, default implementation relies on GCC built-in atomic functions */
-    void (*events_clear)(tiny_events_t *events, uint8_t bits);
-
-    /** Must have for Full duplex protocol. Default implementation does not do any sleep operation */
-    void (*sleep)(uint32_t ms);
-
-    /** Must have for Full duplex protocol. Default implementation does not cound milliseconds */
-    uint32_t (*millis)(void);
-} tiny_platform_hal_t;
+struct tiny_platform_hal_t;
 
 /**
  * Sets custom specific HAL functions.
  * @param hal pointer to HAL functions structure.
  */
-extern void tiny_hal_init(tiny_platform_hal_t *hal);
+extern void tiny_hal_init(struct tiny_platform_hal_t *hal);
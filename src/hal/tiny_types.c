@@ -39,6 +39,22 @@
 #include "impl/no_platform_hal.inl"
 #endif
 
+const tiny_platform_hal_t tiny_platform_hal_default = {
+    .mutex_create = tiny_mutex_create,
+    .mutex_destroy = tiny_mutex_destroy,
+    .mutex_try_lock = tiny_mutex_try_lock,
+    .mutex_unlock = tiny_mutex_unlock,
+    .mutex_lock = tiny_mutex_lock,
+    .events_create = tiny_events_create,
+    .events_destroy = tiny_events_destroy,
+    .events_wait = tiny_events_wait,
+    .events_check_int = tiny_events_check_int,
+    .events_set = tiny_events_set,
+    .events_clear = tiny_events_clear,
+    .sleep = tiny_sleep,
+    .millis = tiny_millis,
+};
+
 uint8_t g_tiny_log_level = TINY_LOG_LEVEL_DEFAULT;
 
 void tiny_log_level(uint8_t level)
@@ -242,6 +242,75 @@ extern "C"
 
     /** @} */
 
+    /**
+     * Set of platform functions. It is used to set custom HAL functions on platforms
+     * without built-in HAL (see tiny_hal_init()), and to override platform functions
+     * for separate protocol instances (see tiny_fd_init_t). For protocol instances all members
+     * are optional: NULL members fall back to global platform functions.
+     */
+    typedef struct tiny_platform_hal_t
+    {
+        /** Creates mutex, see tiny_mutex_create(). Optional, but remember, default implementation relies on GCC built-in atomic functions */
+        void (*mutex_create)(tiny_mutex_t *mutex);
+
+        /** Destroys mutex, see tiny_mutex_destroy(). Optional, but remember, default implementation relies on GCC built-in atomic functions */
+        void (*mutex_destroy)(tiny_mutex_t *mutex);
+
+        /** Attempts to lock mutex, see tiny_mutex_try_lock(). Optional, but remember, default implementation relies on GCC built-in atomic functions */
+        uint8_t (*mutex_try_lock)(tiny_mutex_t *mutex);
+
+        /** Unlocks mutex, see tiny_mutex_unlock(). Optional, but remember, default implementation relies on GCC built-in atomic functions */
+        void (*mutex_unlock)(tiny_mutex_t *mutex);
+
+        /**
+         * Locks mutex, see tiny_mutex_lock(). Optional, but remember, default implementation relies on GCC built-in atomic functions
+         * and tiny_sleep() implementation
+         */
+        void (*mutex_lock)(tiny_mutex_t *mutex);
+
+        /** Creates event group, see tiny_events_create(). Optional, but remember, default implementation relies on GCC built-in atomic functions */
+        void (*events_create)(tiny_events_t *events);
+
+        /** Destroys event group, see tiny_events_destroy(). Optional, but remember, default implementation relies on GCC built-in atomic functions */
+        void (*events_destroy)(tiny_events_t *events);
+
+        /**
+         * Waits for event bits, see tiny_events_wait(). Optional, but remember, default implementation relies on GCC built-in atomic functions
+         * and tiny_sleep() implementation
+         */
+        uint8_t (*events_wait)(tiny_events_t *events, uint8_t bits, uint8_t clear, uint32_t timeout);
+
+        /** Checks event bits, see tiny_events_check_int(). Optional, but remember, default implementation relies on GCC built-in atomic functions */
+        uint8_t (*events_check_int)(tiny_events_t *events, uint8_t bits, uint8_t clear);
+
+        /** Sets event bits, see tiny_events_set(). Optional, but remember, default implementation relies on GCC built-in atomic functions */
+        void (*events_set)(tiny_events_t *events, uint8_t bits);
+
+        /** Clears event bits, see tiny_events_clear(). Optional, but remember, default implementation relies on GCC built-in atomic functions */
+        void (*events_clear)(tiny_events_t *events, uint8_t bits);
+
+        /**
+         * Sleeps for specified number of milliseconds, see tiny_sleep().
+         * Must have for Full duplex protocol. Default implementation does not do any sleep operation
+         */
+        void (*sleep)(uint32_t ms);
+
+        /**
+         * Returns timestamp in milliseconds, see tiny_millis().
+         * Must have for Full duplex protocol. Default implementation does not cound milliseconds
+         */
+        uint32_t (*millis)(void);
+    } tiny_platform_hal_t;
+
+    /**
+     * Global platform functions (tiny_millis(), tiny_mutex_lock(), etc.) in the form of HAL structure.
+     * Protocol instances use them, if custom HAL is not set, or some of its members are NULL.
+     */
+    extern const tiny_platform_hal_t tiny_platform_hal_default;
+
+/** Returns platform function of custom HAL, or global platform function, if the member of custom HAL is NULL */
+#define TINY_HAL_FUNC(hal, name) ((hal)->name ? (hal)->name : tiny_platform_hal_default.name)
+
     /**
      * Sets logging level if tiny library is compiled with logs
      * @param level log level to set, or 0 to disable logs
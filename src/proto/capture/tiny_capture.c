@@ -0,0 +1,421 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tiny_capture.h"
+#include <string.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <time.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CAPTURE_BARRIER() __sync_synchronize()
+#elif defined(_MSC_VER)
+#define CAPTURE_BARRIER() MemoryBarrier()
+#else
+#define CAPTURE_BARRIER()
+#endif
+
+#define PCAPNG_SHB 0x0A0D0D0A
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_ISB 0x00000005
+#define PCAPNG_EPB 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+
+#define PCAPNG_OPT_END 0
+#define PCAPNG_OPT_COMMENT 1
+#define PCAPNG_OPT_EPB_FLAGS 2
+#define PCAPNG_OPT_IF_TSRESOL 9
+#define PCAPNG_OPT_ISB_IFDROP 5
+
+#define PCAPNG_FLAG_INBOUND 0x01
+#define PCAPNG_FLAG_OUTBOUND 0x02
+
+#define ALIGN(x, a) (((x) + (a)-1) & ~((a)-1))
+
+/**
+ * Record in the ring. Frame data follows the header.
+ * Record with zero size marks the end of data before ring wrap.
+ */
+typedef struct
+{
+    uint32_t size; ///< size of record in the ring, including header and alignment
+    uint16_t len;  ///< number of captured bytes
+    uint16_t orig_len;
+    uint32_t flags;
+    const char *comment;
+    uint64_t ts;
+} tiny_capture_record_t;
+
+typedef struct
+{
+    uint8_t *data;
+    uint32_t size;
+    volatile uint32_t head; ///< written by producer only
+    volatile uint32_t tail; ///< written by consumer only
+    volatile uint32_t dropped;
+} tiny_capture_ring_t;
+
+struct tiny_capture_t
+{
+    tiny_capture_ring_t rings[2];
+    uint16_t linktype;
+    uint16_t snaplen;
+    uint64_t (*timestamp)(void);
+    write_block_cb_t write_func;
+    void *pdata;
+    uint8_t header_written;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint64_t __default_timestamp(void)
+{
+#if defined(__linux__) || defined(__APPLE__)
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000;
+#elif defined(_WIN32)
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    // FILETIME counts 100ns intervals since 1601
+    return (t - 116444736000000000ULL) / 10;
+#else
+    return (uint64_t)tiny_millis() * 1000;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_capture_init(tiny_capture_handle_t *handle, const tiny_capture_init_t *init)
+{
+    *handle = NULL;
+    uint32_t header = ALIGN(sizeof(struct tiny_capture_t), 8);
+    if ( !init->buffer || !init->write_func || init->buffer_size < 0 ||
+         (uint32_t)init->buffer_size < header + 2 * 4 * sizeof(tiny_capture_record_t) )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    // Buffer can be not aligned, all records in the rings are 8-byte aligned
+    uint8_t *ptr = (uint8_t *)ALIGN((uintptr_t)init->buffer, 8);
+    uint32_t available = init->buffer_size - (uint32_t)(ptr - (uint8_t *)init->buffer) - header;
+    struct tiny_capture_t *capture = (struct tiny_capture_t *)ptr;
+    memset(capture, 0, sizeof(struct tiny_capture_t));
+    ptr += header;
+    for ( int i = 0; i < 2; i++ )
+    {
+        capture->rings[i].data = ptr;
+        capture->rings[i].size = (available / 2) & ~7U;
+        ptr += capture->rings[i].size;
+    }
+    capture->linktype = init->linktype ? init->linktype : TINY_CAPTURE_LINKTYPE_LAPB_WITH_DIR;
+    capture->snaplen = init->snaplen;
+    capture->timestamp = init->timestamp ? init->timestamp : __default_timestamp;
+    capture->write_func = init->write_func;
+    capture->pdata = init->pdata;
+    *handle = capture;
+    return TINY_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __ring_put(tiny_capture_ring_t *ring, const tiny_capture_record_t *record, const void *data)
+{
+    uint32_t need = ALIGN(sizeof(tiny_capture_record_t) + record->len, 8);
+    uint32_t head = ring->head;
+    uint32_t tail = ring->tail;
+    uint32_t pos;
+    // Keep at least one free byte, so head == tail always means empty ring
+    if ( head >= tail )
+    {
+        if ( ring->size - head > need || (ring->size - head == need && tail > 0) )
+        {
+            pos = head;
+        }
+        else if ( tail > need )
+        {
+            ((tiny_capture_record_t *)(ring->data + head))->size = 0;
+            pos = 0;
+        }
+        else
+        {
+            ring->dropped++;
+            return;
+        }
+    }
+    else if ( tail - head > need )
+    {
+        pos = head;
+    }
+    else
+    {
+        ring->dropped++;
+        return;
+    }
+    tiny_capture_record_t *dst = (tiny_capture_record_t *)(ring->data + pos);
+    *dst = *record;
+    dst->size = need;
+    if ( record->len )
+    {
+        memcpy(dst + 1, data, record->len);
+    }
+    // Publish the record only after its content is written
+    CAPTURE_BARRIER();
+    pos += need;
+    ring->head = pos == ring->size ? 0 : pos;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static tiny_capture_record_t *__ring_peek(tiny_capture_ring_t *ring)
+{
+    uint32_t tail = ring->tail;
+    if ( tail == ring->head )
+    {
+        return NULL;
+    }
+    CAPTURE_BARRIER();
+    tiny_capture_record_t *record = (tiny_capture_record_t *)(ring->data + tail);
+    if ( record->size == 0 )
+    {
+        ring->tail = 0;
+        return __ring_peek(ring);
+    }
+    return record;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __ring_pop(tiny_capture_ring_t *ring, const tiny_capture_record_t *record)
+{
+    uint32_t tail = ring->tail + record->size;
+    // Release the space only after record is processed
+    CAPTURE_BARRIER();
+    ring->tail = tail == ring->size ? 0 : tail;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_capture_frame(tiny_capture_handle_t handle, tiny_capture_dir_t dir, const void *data, int len,
+                        uint32_t flags)
+{
+    if ( !handle || len < 0 )
+    {
+        return;
+    }
+    tiny_capture_record_t record = {0};
+    record.orig_len = (uint16_t)len;
+    record.len = (handle->snaplen && len > handle->snaplen) ? handle->snaplen : (uint16_t)len;
+    record.flags = flags | (dir == TINY_CAPTURE_RX ? PCAPNG_FLAG_INBOUND : PCAPNG_FLAG_OUTBOUND);
+    record.ts = handle->timestamp();
+    __ring_put(&handle->rings[dir], &record, data);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_capture_event(tiny_capture_handle_t handle, tiny_capture_dir_t dir, const char *comment)
+{
+    if ( !handle )
+    {
+        return;
+    }
+    tiny_capture_record_t record = {0};
+    record.comment = comment;
+    record.ts = handle->timestamp();
+    __ring_put(&handle->rings[dir], &record, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int __write(tiny_capture_handle_t handle, const void *data, int len)
+{
+    const uint8_t *ptr = (const uint8_t *)data;
+    while ( len > 0 )
+    {
+        int result = handle->write_func(handle->pdata, ptr, len);
+        if ( result <= 0 )
+        {
+            return TINY_ERR_FAILED;
+        }
+        ptr += result;
+        len -= result;
+    }
+    return TINY_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int __write_option(tiny_capture_handle_t handle, uint16_t code, const void *data, uint16_t len)
+{
+    static const uint8_t padding[4] = {0};
+    uint16_t header[2] = {code, len};
+    int result = __write(handle, header, sizeof(header));
+    if ( result == TINY_SUCCESS && len )
+    {
+        result = __write(handle, data, len);
+    }
+    if ( result == TINY_SUCCESS && (len & 3) )
+    {
+        result = __write(handle, padding, 4 - (len & 3));
+    }
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int __write_header(tiny_capture_handle_t handle)
+{
+    uint32_t shb[7] = {PCAPNG_SHB, 28, PCAPNG_BYTE_ORDER_MAGIC, 0x00000001, 0xFFFFFFFF, 0xFFFFFFFF, 28};
+    int result = __write(handle, shb, sizeof(shb));
+    if ( result != TINY_SUCCESS )
+    {
+        return result;
+    }
+    // Interface description block with microsecond resolution of timestamps
+    struct
+    {
+        uint32_t type;
+        uint32_t total;
+        uint16_t linktype;
+        uint16_t reserved;
+        uint32_t snaplen;
+    } idb = {PCAPNG_IDB, 32, handle->linktype, 0, handle->snaplen};
+    uint8_t tsresol = 6;
+    uint32_t total = 32;
+    result = __write(handle, &idb, sizeof(idb));
+    if ( result == TINY_SUCCESS )
+        result = __write_option(handle, PCAPNG_OPT_IF_TSRESOL, &tsresol, 1);
+    if ( result == TINY_SUCCESS )
+        result = __write_option(handle, PCAPNG_OPT_END, NULL, 0);
+    if ( result == TINY_SUCCESS )
+        result = __write(handle, &total, sizeof(total));
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int __write_record(tiny_capture_handle_t handle, int dir, const tiny_capture_record_t *record)
+{
+    static const uint8_t padding[4] = {0};
+    uint8_t with_dir = handle->linktype == TINY_CAPTURE_LINKTYPE_LAPB_WITH_DIR && !record->comment;
+    uint32_t caplen = record->len + with_dir;
+    uint16_t comment_len = record->comment ? (uint16_t)strlen(record->comment) : 0;
+    uint32_t total = 28 + ALIGN(caplen, 4) + 8 + (comment_len ? 4 + ALIGN(comment_len, 4) : 0) + 4 + 4;
+    uint32_t epb[7] = {PCAPNG_EPB,
+                       total,
+                       0,
+                       (uint32_t)(record->ts >> 32),
+                       (uint32_t)record->ts,
+                       caplen,
+                       record->orig_len + with_dir};
+    int result = __write(handle, epb, sizeof(epb));
+    if ( result == TINY_SUCCESS && with_dir )
+    {
+        // LINKTYPE_LAPB_WITH_DIR: 0 - received by this host, 1 - sent by this host
+        uint8_t direction = (uint8_t)dir;
+        result = __write(handle, &direction, 1);
+    }
+    if ( result == TINY_SUCCESS && record->len )
+        result = __write(handle, record + 1, record->len);
+    if ( result == TINY_SUCCESS && (caplen & 3) )
+        result = __write(handle, padding, 4 - (caplen & 3));
+    if ( result == TINY_SUCCESS )
+        result = __write_option(handle, PCAPNG_OPT_EPB_FLAGS, &record->flags, 4);
+    if ( result == TINY_SUCCESS && comment_len )
+        result = __write_option(handle, PCAPNG_OPT_COMMENT, record->comment, comment_len);
+    if ( result == TINY_SUCCESS )
+        result = __write_option(handle, PCAPNG_OPT_END, NULL, 0);
+    if ( result == TINY_SUCCESS )
+        result = __write(handle, &total, sizeof(total));
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_capture_flush(tiny_capture_handle_t handle)
+{
+    if ( !handle )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    if ( !handle->header_written )
+    {
+        int result = __write_header(handle);
+        if ( result != TINY_SUCCESS )
+        {
+            return result;
+        }
+        handle->header_written = 1;
+    }
+    int count = 0;
+    for ( ;; )
+    {
+        tiny_capture_record_t *rx = __ring_peek(&handle->rings[TINY_CAPTURE_RX]);
+        tiny_capture_record_t *tx = __ring_peek(&handle->rings[TINY_CAPTURE_TX]);
+        if ( !rx && !tx )
+        {
+            break;
+        }
+        // Merge both rings in time order
+        int dir = (!tx || (rx && rx->ts <= tx->ts)) ? TINY_CAPTURE_RX : TINY_CAPTURE_TX;
+        tiny_capture_record_t *record = dir == TINY_CAPTURE_RX ? rx : tx;
+        int result = __write_record(handle, dir, record);
+        __ring_pop(&handle->rings[dir], record);
+        if ( result != TINY_SUCCESS )
+        {
+            return result;
+        }
+        count++;
+    }
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_capture_close(tiny_capture_handle_t handle)
+{
+    if ( !handle || tiny_capture_flush(handle) < 0 )
+    {
+        return;
+    }
+    uint64_t ts = handle->timestamp();
+    uint64_t dropped = tiny_capture_get_dropped(handle);
+    uint32_t total = 20 + 12 + 4 + 4;
+    uint32_t isb[4] = {PCAPNG_ISB, total, 0, (uint32_t)(ts >> 32)};
+    uint32_t ts_low = (uint32_t)ts;
+    int result = __write(handle, isb, sizeof(isb));
+    if ( result == TINY_SUCCESS )
+        result = __write(handle, &ts_low, sizeof(ts_low));
+    if ( result == TINY_SUCCESS )
+        result = __write_option(handle, PCAPNG_OPT_ISB_IFDROP, &dropped, sizeof(dropped));
+    if ( result == TINY_SUCCESS )
+        result = __write_option(handle, PCAPNG_OPT_END, NULL, 0);
+    if ( result == TINY_SUCCESS )
+        __write(handle, &total, sizeof(total));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint32_t tiny_capture_get_dropped(tiny_capture_handle_t handle)
+{
+    return handle ? handle->rings[0].dropped + handle->rings[1].dropped : 0;
+}
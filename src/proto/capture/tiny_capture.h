@@ -0,0 +1,167 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ This is frame capture facility for Tiny Protocol
+
+ @file
+ @brief Capture of hdlc frames and protocol events to pcapng format
+*/
+#pragma once
+
+#include "hal/tiny_types.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @defgroup CAPTURE_API Frame capture API functions
+ * @{
+ *
+ * @brief frame capture to pcapng stream
+ *
+ * @details Capture object collects frames, received and sent by hdlc low level, and protocol
+ *          events of tiny_fd (retransmissions, timeouts, connection state). Records are put to
+ *          two lock-free single-producer rings: one is filled from rx context (hdlc_ll_run_rx(),
+ *          tiny_fd_on_rx_data()), another one from tx context (hdlc_ll_run_tx(), tiny_fd_get_tx_data()).
+ *          The producers never block: if ring is full, the record is dropped and counted.
+ *          Writer thread periodically calls tiny_capture_flush(), which converts records to pcapng
+ *          blocks and passes them to user write callback. One capture object serves single protocol instance.
+ *          Capture hooks in the protocol are compiled only if CONFIG_ENABLE_CAPTURE is defined.
+ */
+
+/** LINKTYPE_LAPB_WITH_DIR: LAPB frame, preceded by 1 byte direction pseudo header, default link type */
+#define TINY_CAPTURE_LINKTYPE_LAPB_WITH_DIR 207
+
+/** pcapng epb_flags bit for frames with wrong crc */
+#define TINY_CAPTURE_FLAG_CRC_ERROR (1UL << 24)
+
+    /**
+     * Direction of captured record. Each direction is served by separate ring, and records of
+     * the same direction must be produced from single thread.
+     */
+    typedef enum
+    {
+        TINY_CAPTURE_RX = 0, ///< frame received, or event in rx context
+        TINY_CAPTURE_TX = 1, ///< frame sent, or event in tx context
+    } tiny_capture_dir_t;
+
+    struct tiny_capture_t;
+
+    /**
+     * Handle of capture object
+     */
+    typedef struct tiny_capture_t *tiny_capture_handle_t;
+
+    /**
+     * Capture initialization parameters. Initialize this structure by 0 before filling.
+     */
+    typedef struct
+    {
+        /// buffer for capture object and two rings. The more frames per flush period, the bigger buffer is required
+        void *buffer;
+
+        /// size of buffer in bytes
+        int buffer_size;
+
+        /// link type of pcapng interface. If 0, TINY_CAPTURE_LINKTYPE_LAPB_WITH_DIR is used.
+        uint16_t linktype;
+
+        /// maximum number of frame bytes to keep. If 0, whole frames are captured.
+        uint16_t snaplen;
+
+        /**
+         * Timestamp source in microseconds since epoch. If NULL, system clock is used on
+         * Linux and Windows, and tiny_millis() on other platforms.
+         */
+        uint64_t (*timestamp)(void);
+
+        /// callback to write pcapng stream, called from tiny_capture_flush() context only
+        write_block_cb_t write_func;
+
+        /// user data for write callback
+        void *pdata;
+    } tiny_capture_init_t;
+
+    /**
+     * Initializes capture object in the user buffer.
+     *
+     * @param handle pointer to capture handle variable
+     * @param init initialization parameters
+     * @return TINY_SUCCESS or TINY_ERR_INVALID_DATA if parameters are wrong or buffer is too small
+     */
+    extern int tiny_capture_init(tiny_capture_handle_t *handle, const tiny_capture_init_t *init);
+
+    /**
+     * Puts hdlc frame to the capture ring. Never blocks. Does nothing if handle is NULL.
+     *
+     * @param handle capture handle
+     * @param dir direction of the frame
+     * @param data frame data (address, control and information fields)
+     * @param len frame length
+     * @param flags additional pcapng epb_flags bits, for example TINY_CAPTURE_FLAG_CRC_ERROR
+     */
+    extern void tiny_capture_frame(tiny_capture_handle_t handle, tiny_capture_dir_t dir, const void *data, int len,
+                                   uint32_t flags);
+
+    /**
+     * Puts protocol event to the capture ring. Event is written as empty packet with comment.
+     * Never blocks. Does nothing if handle is NULL.
+     *
+     * @param handle capture handle
+     * @param dir ring to use: context, where the event happens
+     * @param comment static string, describing the event
+     */
+    extern void tiny_capture_event(tiny_capture_handle_t handle, tiny_capture_dir_t dir, const char *comment);
+
+    /**
+     * Writes captured records to user callback. pcapng header is written on first call.
+     * Must be called from single thread.
+     *
+     * @param handle capture handle
+     * @return number of written records, or negative error code if write callback failed
+     */
+    extern int tiny_capture_flush(tiny_capture_handle_t handle);
+
+    /**
+     * Flushes remaining records and writes interface statistics block with number of dropped records.
+     * Protocol must be stopped before calling this function.
+     *
+     * @param handle capture handle
+     */
+    extern void tiny_capture_close(tiny_capture_handle_t handle);
+
+    /**
+     * Returns number of records, dropped because of ring overflow
+     *
+     * @param handle capture handle
+     * @return number of dropped records
+     */
+    extern uint32_t tiny_capture_get_dropped(tiny_capture_handle_t handle);
+
+    /**
+     * @}
+     */
+
+#ifdef __cplusplus
+}
+#endif
@@ -77,6 +77,52 @@ uint32_t crc32(uint32_t crc, const uint8_t *buf, int size)
     return crc ^ ~0U;
 }
 
+/*
+ * Combining crc values (the same math as zlib crc32_combine()): crc register is shifted through
+ * len2 zero bytes by multiplying it by x^(8 * len2) modulo generator polynomial. Polynomials are
+ * bit-reflected, so x^0 is the most significant bit.
+ */
+
+/* x^(2^k) modulo FCS-32 polynomial */
+static const uint32_t x2n_32[32] = {
+    0x40000000, 0x20000000, 0x08000000, 0x00800000, 0x00008000, 0xedb88320, 0xb1e6b092, 0xa06a2517,
+    0xed627dae, 0x88d14467, 0xd7bbfe6a, 0xec447f11, 0x8e7ea170, 0x6427800e, 0x4d47bae0, 0x09fe548f,
+    0x83852d0f, 0x30362f1a, 0x7b5a9cc3, 0x31fec169, 0x9fec022a, 0x6c8dedc4, 0x15d6874d, 0x5fde7a4e,
+    0xbad90e37, 0x2e4e5eef, 0x4eaba214, 0xa8a472c0, 0x429a969e, 0x148d302a, 0xc40ba6d0, 0xc4e22c3c};
+
+static uint32_t crc32_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = (uint32_t)1 << 31;
+    uint32_t p = 0;
+    for ( ;; )
+    {
+        if ( a & m )
+        {
+            p ^= b;
+            if ( (a & (m - 1)) == 0 )
+                break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ 0xedb88320 : b >> 1;
+    }
+    return p;
+}
+
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, int len2)
+{
+    // x^(8 * len2): start from x^(2^3)
+    uint32_t p = (uint32_t)1 << 31;
+    unsigned k = 3;
+    while ( len2 > 0 )
+    {
+        if ( len2 & 1 )
+            p = crc32_multmodp(x2n_32[k & 31], p);
+        len2 >>= 1;
+        k++;
+    }
+    return crc32_multmodp(p, crc1) ^ crc2;
+}
+
 #endif
 
 /*
@@ -127,6 +173,42 @@ uint16_t crc16(uint16_t crc, const uint8_t *data, int data_length)
     return crc ^ ~0U;
 }
 
+/* x^(2^k) modulo FCS-16 polynomial, the sequence repeats every 15 entries */
+static const uint16_t x2n_16[15] = {0x4000, 0x2000, 0x0800, 0x0080, 0x8408, 0x0cec, 0x861d, 0x3f75,
+                                    0x9471, 0x3fc8, 0x236c, 0x0abf, 0x7955, 0x3811, 0x1a22};
+
+static uint16_t crc16_multmodp(uint16_t a, uint16_t b)
+{
+    uint16_t m = (uint16_t)1 << 15;
+    uint16_t p = 0;
+    for ( ;; )
+    {
+        if ( a & m )
+        {
+            p ^= b;
+            if ( (a & (m - 1)) == 0 )
+                break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ 0x8408 : b >> 1;
+    }
+    return p;
+}
+
+uint16_t crc16_combine(uint16_t crc1, uint16_t crc2, int len2)
+{
+    uint16_t p = (uint16_t)1 << 15;
+    unsigned k = 3;
+    while ( len2 > 0 )
+    {
+        if ( len2 & 1 )
+            p = crc16_multmodp(x2n_16[k % 15], p);
+        len2 >>= 1;
+        k++;
+    }
+    return crc16_multmodp(p, crc1) ^ crc2;
+}
+
 #endif
 
 #ifdef CONFIG_ENABLE_CHECKSUM
@@ -148,6 +230,12 @@ uint16_t chksum(uint16_t sum, const uint8_t *data, int data_length)
     return 0xFFFF - sum;
 }
 
+uint16_t chksum_combine(uint16_t sum1, uint16_t sum2)
+{
+    // (0xFFFF - a) + (0xFFFF - b) - 0xFFFF == 0xFFFF - (a + b)
+    return (uint16_t)(sum1 + sum2 - 0xFFFF);
+}
+
 #endif
 
 int get_crc_field_size(hdlc_crc_t crc_type)
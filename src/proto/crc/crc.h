@@ -32,6 +32,8 @@ extern "C"
 #define GOODCHECKSUM 0x0000
     uint16_t chksum_byte(uint16_t sum, uint8_t data);
     uint16_t chksum(uint16_t sum, const uint8_t *data, int data_length);
+    /* Returns checksum of concatenated blocks A and B from checksums of both blocks */
+    uint16_t chksum_combine(uint16_t sum1, uint16_t sum2);
 #endif
 
 #ifdef CONFIG_ENABLE_FCS16
@@ -39,6 +41,8 @@ extern "C"
 #define PPPGOODFCS16 0xf0b8 /* Good final FCS value */
     uint16_t crc16_byte(uint16_t crc, uint8_t data);
     uint16_t crc16(uint16_t crc, const uint8_t *data, int data_length);
+    /* Returns crc of concatenated blocks A and B from crc of both blocks and the length of block B */
+    uint16_t crc16_combine(uint16_t crc1, uint16_t crc2, int len2);
 #endif
 
 #ifdef CONFIG_ENABLE_FCS32
@@ -46,6 +50,8 @@ extern "C"
 #define PPPGOODFCS32 0xdebb20e3 /* Good final FCS value */
     uint32_t crc32_byte(uint32_t crc, uint8_t data);
     uint32_t crc32(uint32_t crc, const uint8_t *buf, int size);
+    /* Returns crc of concatenated blocks A and B from crc of both blocks and the length of block B */
+    uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, int len2);
 #endif
 
 /// \cond
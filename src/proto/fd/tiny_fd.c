@@ -57,16 +57,119 @@
 
 enum
 {
-    FD_EVENT_TX_SENDING = 0x01,
     FD_EVENT_TX_DATA_AVAILABLE = 0x02,
     FD_EVENT_QUEUE_HAS_FREE_SLOTS = 0x04,
 };
 
 static const uint8_t seq_bits_mask = 0x07;
 
+/*
+ * Late copy of a frame can stay on the wire of slow bonded link, while faster links wrap 3-bit sequence
+ * numbers. So bonded links extend N(S) and N(R) to 7 bits: the address field of I- and S-frames carries
+ * high bits of N(S) in low nibble, and high bits of N(R) in high nibble.
+ */
+static const uint8_t bonding_seq_mask = 0x7F;
+
+/* Link doesn't send I-frame */
+#define FD_NO_NS 0xFF
+
+#ifdef CONFIG_ENABLE_STATS
+#define STATS(x) x
+#else
+#define STATS(x)
+#endif
+
+#ifdef CONFIG_ENABLE_CAPTURE
+#define CAPTURE_EVENT(handle, dir, text) tiny_capture_event((handle)->capture, dir, text)
+#else
+#define CAPTURE_EVENT(handle, dir, text)
+#endif
+
+#ifdef CONFIG_ENABLE_FD_AGGREGATION
+#define AGGREGATION(x) x
+#else
+#define AGGREGATION(x)
+#endif
+
+#ifdef CONFIG_ENABLE_FD_BONDING
+#define BONDING(x) x
+#else
+#define BONDING(x)
+#endif
+
 static int on_frame_read(void *user_data, void *data, int len);
 static int on_frame_sent(void *user_data, const void *data, int len);
 
+///////////////////////////////////////////////////////////////////////////////
+// Synchronization functions. In single thread mode plain variables are used.
+///////////////////////////////////////////////////////////////////////////////
+
+static inline void __fd_lock(tiny_fd_handle_t handle)
+{
+    if ( !handle->single_thread )
+    {
+        TINY_HAL_FUNC(handle->hal, mutex_lock)(&handle->frames.mutex);
+    }
+}
+
+static inline void __fd_unlock(tiny_fd_handle_t handle)
+{
+    if ( !handle->single_thread )
+    {
+        TINY_HAL_FUNC(handle->hal, mutex_unlock)(&handle->frames.mutex);
+    }
+}
+
+static inline void __fd_events_set(tiny_fd_handle_t handle, uint8_t bits)
+{
+    if ( handle->single_thread )
+    {
+        handle->frames.event_bits |= bits;
+    }
+    else
+    {
+        TINY_HAL_FUNC(handle->hal, events_set)(&handle->frames.events, bits);
+    }
+}
+
+static inline void __fd_events_clear(tiny_fd_handle_t handle, uint8_t bits)
+{
+    if ( handle->single_thread )
+    {
+        handle->frames.event_bits &= ~bits;
+    }
+    else
+    {
+        TINY_HAL_FUNC(handle->hal, events_clear)(&handle->frames.events, bits);
+    }
+}
+
+static inline uint32_t __fd_millis(tiny_fd_handle_t handle)
+{
+    return TINY_HAL_FUNC(handle->hal, millis)();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint8_t __fd_events_wait(tiny_fd_handle_t handle, uint8_t bits, uint8_t clear, uint32_t timeout)
+{
+    if ( !handle->single_thread )
+    {
+        return TINY_HAL_FUNC(handle->hal, events_wait)(&handle->frames.events, bits, clear, timeout);
+    }
+    // Nobody can set bits while we wait in single thread mode, so timeout is ignored
+    uint8_t locked = handle->frames.event_bits;
+    if ( !(locked & bits) )
+    {
+        return 0;
+    }
+    if ( clear )
+    {
+        handle->frames.event_bits &= ~bits;
+    }
+    return locked;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Helper functions
 ///////////////////////////////////////////////////////////////////////////////
@@ -101,31 +204,140 @@ static inline bool __all_frames_are_sent(tiny_fd_handle_t handle)
 
 static inline uint32_t __time_passed_since_last_i_frame(tiny_fd_handle_t handle)
 {
-    return (uint32_t)(tiny_millis() - handle->frames.last_i_ts);
+    return (uint32_t)(__fd_millis(handle) - handle->frames.last_i_ts);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 static inline uint32_t __time_passed_since_last_frame_received(tiny_fd_handle_t handle)
 {
-    return (uint32_t)(tiny_millis() - handle->frames.last_ka_ts);
+    return (uint32_t)(__fd_millis(handle) - handle->frames.last_ka_ts);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Returns true, if the frame with N(S) leaves single free slot in the window (or fills the window of 1 frame) */
+static inline bool __is_last_but_one_window_frame(tiny_fd_handle_t handle, uint8_t ns)
+{
+    uint8_t outstanding = ((uint8_t)(ns + 1 - handle->frames.confirm_ns) & seq_bits_mask);
+    return outstanding == (handle->frames.max_i_frames > 1 ? handle->frames.max_i_frames - 1 : 1);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 static inline bool __has_non_sent_s_u_frames(tiny_fd_handle_t handle)
 {
-    return handle->s_u_frames.queue_len > 0;
+    return handle->s_u_frames.queue_len > 0 || handle->s_u_frames.s_control;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline bool __is_bonded(tiny_fd_handle_t handle)
+{
+#ifdef CONFIG_ENABLE_FD_BONDING
+    return handle->link_count > 1;
+#else
+    return false;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline bool __link_is_alive(tiny_fd_handle_t handle, tiny_fd_link_t *link)
+{
+    return (uint32_t)(__fd_millis(handle) - link->last_rx_ts) <= handle->ka_timeout;
 }
 
-static inline uint8_t __get_i_frame_to_send_index(tiny_fd_handle_t handle)
+///////////////////////////////////////////////////////////////////////////////
+
+/* Link, which doesn't receive anything, doesn't take frames, while other links work */
+static bool __link_is_usable(tiny_fd_handle_t handle, tiny_fd_link_t *link)
 {
-    return (handle->frames.next_ns - handle->frames.confirm_ns) & seq_bits_mask;
+    if ( !__is_bonded(handle) || handle->state != TINY_FD_STATE_CONNECTED_ABM || __link_is_alive(handle, link) )
+    {
+        return true;
+    }
+    for ( uint8_t i = 0; i < handle->link_count; i++ )
+    {
+        if ( __link_is_alive(handle, &handle->links[i]) )
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static bool __put_u_s_frame_to_tx_queue(tiny_fd_handle_t handle, const void *data, int len)
+/* Link sends I-frame directly from the slot, so the slot can't be changed until the link completes */
+static bool __i_frame_is_sending(tiny_fd_handle_t handle, uint8_t ns)
+{
+    for ( uint8_t i = 0; i < handle->link_count; i++ )
+    {
+        if ( handle->links[i].ns != FD_NO_NS &&
+             (handle->links[i].ns & handle->frames.slot_mask) == (ns & handle->frames.slot_mask) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Returns 7-bit N(S) of queued I-frame for bonded links */
+static inline uint8_t __get_bonding_ns(tiny_fd_handle_t handle, uint8_t ns)
+{
+#ifdef CONFIG_ENABLE_FD_BONDING
+    return (handle->frames.confirm_seq + ((uint8_t)(ns - handle->frames.confirm_ns) & seq_bits_mask)) &
+           bonding_seq_mask;
+#else
+    return ns;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Returns the address field of I- or S-frame, which carries high bits of 7-bit N(S) and N(R) over bonded links */
+static inline uint8_t __get_frame_address(tiny_fd_handle_t handle, uint8_t seq)
+{
+#ifdef CONFIG_ENABLE_FD_BONDING
+    if ( __is_bonded(handle) )
+    {
+        return (uint8_t)(((handle->frames.next_seq >> 3) << 4) | (seq >> 3));
+    }
+#endif
+    return 0xFF;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Frames can overtake each other over bonded links, so N(R) of late frame can be older than confirmed one */
+static inline bool __is_stale_nr(tiny_fd_handle_t handle, uint8_t address, uint8_t nr)
+{
+#ifdef CONFIG_ENABLE_FD_BONDING
+    uint8_t seq = ((address >> 4) << 3) | nr;
+    return __is_bonded(handle) && ((uint8_t)(seq - handle->frames.confirm_seq) & bonding_seq_mask) >
+                                      __number_of_awaiting_tx_i_frames(handle);
+#else
+    return false;
+#endif
+}
+
+static inline tiny_i_frame_slot_t *__get_i_frame_slot(tiny_fd_handle_t handle, uint8_t ns)
+{
+#ifdef CONFIG_ENABLE_FD_ARENA
+    if ( handle->frames.arena )
+    {
+        return handle->frames.i_frames[ns & handle->frames.slot_mask].slot;
+    }
+#endif
+    return (tiny_i_frame_slot_t *)(handle->frames.i_slots + (ns & handle->frames.slot_mask) * handle->frames.slot_size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static bool __put_u_frame_to_tx_queue(tiny_fd_handle_t handle, const void *data, int len)
 {
     if ( handle->s_u_frames.queue_len < TINY_FD_U_QUEUE_MAX_SIZE )
     {
@@ -135,7 +347,7 @@ static bool __put_u_s_frame_to_tx_queue(tiny_fd_handle_t handle, const void *dat
         handle->s_u_frames.queue[index].len = len;
         memcpy(&handle->s_u_frames.queue[index].u_frame, data, len);
         handle->s_u_frames.queue_len++;
-        tiny_events_set(&handle->frames.events, FD_EVENT_TX_DATA_AVAILABLE);
+        __fd_events_set(handle, FD_EVENT_TX_DATA_AVAILABLE);
         //        fprintf( stderr, "QUEUE PTR=%d, LEN=%d\n", handle->s_u_frames.queue_ptr, handle->s_u_frames.queue_len
         //        );
         return true;
@@ -145,7 +357,24 @@ static bool __put_u_s_frame_to_tx_queue(tiny_fd_handle_t handle, const void *dat
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static void __remove_u_s_frame_from_tx_queue(tiny_fd_handle_t handle)
+/*
+ * There is at most one pending S-frame. New acknowledgement is merged into the pending one: REJ
+ * replaces RR, P bit is kept, and N(R) is filled right before sending, so it is never stale.
+ */
+static void __put_s_frame(tiny_fd_handle_t handle, uint8_t control)
+{
+    uint8_t pending = handle->s_u_frames.s_control;
+    if ( (pending & HDLC_S_FRAME_TYPE_MASK) == HDLC_S_FRAME_TYPE_REJ )
+    {
+        control = (control & ~HDLC_S_FRAME_TYPE_MASK) | HDLC_S_FRAME_TYPE_REJ;
+    }
+    handle->s_u_frames.s_control = HDLC_S_FRAME_BITS | control | (pending & HDLC_P_BIT);
+    __fd_events_set(handle, FD_EVENT_TX_DATA_AVAILABLE);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __remove_u_frame_from_tx_queue(tiny_fd_handle_t handle)
 {
     handle->s_u_frames.queue_ptr++;
     if ( handle->s_u_frames.queue_ptr >= TINY_FD_U_QUEUE_MAX_SIZE )
@@ -155,23 +384,408 @@ static void __remove_u_s_frame_from_tx_queue(tiny_fd_handle_t handle)
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static bool __put_i_frame_to_tx_queue(tiny_fd_handle_t handle, const void *data, int len)
+static inline int __message_prefix_size(int len)
+{
+    return len < 0x80 ? 1 : (len < 0x4000 ? 2 : 3);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline bool __aggregation_enabled(tiny_fd_handle_t handle)
+{
+#ifdef CONFIG_ENABLE_FD_AGGREGATION
+    return handle->aggregation.enabled;
+#else
+    return false;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline int __message_size(tiny_fd_handle_t handle, int len)
+{
+    return __aggregation_enabled(handle) ? len + __message_prefix_size(len) : len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __add_message_to_i_frame(tiny_fd_handle_t handle, uint8_t ns, const void *data, int len, uint32_t ttl)
+{
+    tiny_i_frame_info_t *info = &handle->frames.i_frames[ns & handle->frames.slot_mask];
+    // I-frame expires, when all its messages expire
+    uint32_t deadline = ttl ? __fd_millis(handle) + ttl : 0;
+    if ( info->len == 0 )
+    {
+        info->expires = ttl != 0;
+        info->deadline = deadline;
+    }
+    else if ( !ttl )
+    {
+        info->expires = 0;
+    }
+    else if ( info->expires && (int32_t)(deadline - info->deadline) > 0 )
+    {
+        info->deadline = deadline;
+    }
+    uint8_t *ptr = &__get_i_frame_slot(handle, ns)->user_payload + info->len;
+    if ( __aggregation_enabled(handle) )
+    {
+        // Length prefix: 7 bits per byte, high bit is set, if next byte follows
+        int value = len;
+        while ( value >= 0x80 )
+        {
+            *ptr++ = (uint8_t)(value | 0x80);
+            value >>= 7;
+        }
+        *ptr++ = (uint8_t)value;
+    }
+    memcpy(ptr, data, len);
+    info->len += __message_size(handle, len);
+    info->crc_valid = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static bool __add_message_to_open_i_frame(tiny_fd_handle_t handle, const void *data, int len, uint32_t ttl)
+{
+    bool result = false;
+#ifdef CONFIG_ENABLE_FD_AGGREGATION
+    if ( !handle->aggregation.enabled )
+    {
+        return false;
+    }
+    __fd_lock(handle);
+    // Open I-frame is always the last one in the queue, and it is not sent yet
+    uint8_t ns = (handle->frames.last_ns - 1) & seq_bits_mask;
+    if ( handle->aggregation.open &&
+         handle->frames.i_frames[ns & handle->frames.slot_mask].len + __message_size(handle, len) <=
+             handle->frames.mtu )
+    {
+        __add_message_to_i_frame(handle, ns, data, len, ttl);
+        result = true;
+    }
+    __fd_unlock(handle);
+#endif
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static bool __i_frame_is_open(tiny_fd_handle_t handle)
+{
+#ifdef CONFIG_ENABLE_FD_AGGREGATION
+    if ( !handle->aggregation.open || handle->frames.next_ns != ((handle->frames.last_ns - 1) & seq_bits_mask) )
+    {
+        return false;
+    }
+    // Keep I-frame until delay expires, if there is room for one more message
+    if ( (uint32_t)(__fd_millis(handle) - handle->aggregation.ts) < handle->aggregation.delay &&
+         handle->frames.i_frames[handle->frames.next_ns & handle->frames.slot_mask].len + 2 <= handle->frames.mtu )
+    {
+        // Tx side must check the frame once again later
+        __fd_events_set(handle, FD_EVENT_TX_DATA_AVAILABLE);
+        return true;
+    }
+    handle->aggregation.open = 0;
+#endif
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Messages are collected to the batch on the stack, and passed to the application at once, so
+ * the lock is released once per batch. If batch callback is not set, every message is passed to
+ * the legacy per-message callback right away.
+ */
+typedef struct
+{
+    tiny_fd_messages_cb_t cb;
+    uint8_t batch;
+    int count;
+    tiny_fd_message_t messages[CONFIG_FD_BATCH_SIZE];
+} tiny_fd_batch_t;
+
+static inline void __init_batch(tiny_fd_handle_t handle, tiny_fd_batch_t *batch, tiny_fd_messages_cb_t cb,
+                                uint8_t batch_flag)
+{
+    batch->cb = cb;
+    batch->batch = !!(handle->batch_cb & batch_flag);
+    batch->count = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __flush_messages(tiny_fd_handle_t handle, tiny_fd_batch_t *batch)
+{
+    if ( batch->count )
+    {
+        __fd_unlock(handle);
+        batch->cb.batch(handle->user_data, batch->messages, batch->count);
+        __fd_lock(handle);
+        batch->count = 0;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __add_message(tiny_fd_handle_t handle, tiny_fd_batch_t *batch, uint8_t *data, int len)
+{
+    if ( !batch->batch )
+    {
+        if ( batch->cb.single )
+        {
+            __fd_unlock(handle);
+            batch->cb.single(handle->user_data, data, len);
+            __fd_lock(handle);
+        }
+        return;
+    }
+    batch->messages[batch->count].data = data;
+    batch->messages[batch->count].len = len;
+    if ( ++batch->count == CONFIG_FD_BATCH_SIZE )
+    {
+        __flush_messages(handle, batch);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __add_frame_messages(tiny_fd_handle_t handle, tiny_fd_batch_t *batch, uint8_t *data, int len)
+{
+    if ( !__aggregation_enabled(handle) )
+    {
+        __add_message(handle, batch, data, len);
+        return;
+    }
+    while ( len > 0 )
+    {
+        int size = 0;
+        int prefix = 0;
+        do
+        {
+            if ( prefix == len || prefix == 3 )
+            {
+                LOG(TINY_LOG_ERR, "[%p] Invalid aggregated I-frame\n", handle);
+                return;
+            }
+            size |= (data[prefix] & 0x7F) << (7 * prefix);
+        } while ( data[prefix++] & 0x80 );
+        if ( size > len - prefix )
+        {
+            LOG(TINY_LOG_ERR, "[%p] Invalid aggregated I-frame\n", handle);
+            return;
+        }
+        __add_message(handle, batch, data + prefix, size);
+        data += prefix + size;
+        len -= prefix + size;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Tracks the time, when all slots of the window are taken and the application waits for free ones */
+static void __update_window_state(tiny_fd_handle_t handle)
+{
+#ifdef CONFIG_ENABLE_STATS
+    bool full = __number_of_awaiting_tx_i_frames(handle) >= handle->frames.max_i_frames;
+    if ( full && !handle->frames.window_full )
+    {
+        handle->frames.full_ts = __fd_millis(handle);
+        handle->frames.window_full = 1;
+    }
+    else if ( !full && handle->frames.window_full )
+    {
+        handle->stats.window_full_ms += (uint32_t)(__fd_millis(handle) - handle->frames.full_ts);
+        handle->frames.window_full = 0;
+    }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int __put_i_frame_to_tx_queue(tiny_fd_handle_t handle, const void *data, int len, uint32_t ttl)
 {
     uint8_t busy_slots = __number_of_awaiting_tx_i_frames(handle);
     // Check if space is actually available
     if ( busy_slots < handle->frames.max_i_frames )
     {
-        uint8_t free_slot = busy_slots + handle->frames.head_ptr;
-        while ( free_slot >= handle->frames.max_i_frames )
-            free_slot -= handle->frames.max_i_frames;
-
-        handle->frames.i_frames[free_slot]->len = len;
-        memcpy(&handle->frames.i_frames[free_slot]->user_payload, data, len);
+        uint8_t ns = handle->frames.last_ns;
+        tiny_i_frame_info_t *info = &handle->frames.i_frames[ns & handle->frames.slot_mask];
+        if ( __is_bonded(handle) && __i_frame_is_sending(handle, ns) )
+        {
+            // Slow bonded link still sends confirmed copy of the frame, which used the slot
+            return TINY_ERR_BUSY;
+        }
+#ifdef CONFIG_ENABLE_FD_ARENA
+        if ( handle->frames.arena )
+        {
+            info->slot = (tiny_i_frame_slot_t *)tiny_fd_arena_alloc(handle->frames.arena, handle->frames.arena_reserve,
+                                                                    handle->frames.arena_held);
+            if ( !info->slot )
+            {
+                return TINY_ERR_BUSY;
+            }
+            handle->frames.arena_held++;
+        }
+#endif
+        info->len = 0;
+        info->sent = 0;
+        info->expired = 0;
+        __add_message_to_i_frame(handle, ns, data, len, ttl);
         handle->frames.last_ns = (handle->frames.last_ns + 1) & seq_bits_mask;
-        tiny_events_set(&handle->frames.events, FD_EVENT_TX_DATA_AVAILABLE);
-        return true;
+        AGGREGATION(handle->aggregation.open = handle->aggregation.enabled);
+        AGGREGATION(handle->aggregation.ts = __fd_millis(handle));
+        __update_window_state(handle);
+        __fd_events_set(handle, FD_EVENT_TX_DATA_AVAILABLE);
+        return TINY_SUCCESS;
     }
-    return false;
+    return TINY_ERR_TIMEOUT;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __release_i_frame_slot(tiny_fd_handle_t handle, uint8_t ns)
+{
+#ifdef CONFIG_ENABLE_FD_ARENA
+    if ( handle->frames.arena )
+    {
+        handle->frames.arena_held--;
+        tiny_fd_arena_free(handle->frames.arena, __get_i_frame_slot(handle, ns), handle->frames.arena_reserve,
+                           handle->frames.arena_held);
+    }
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __release_all_i_frame_slots(tiny_fd_handle_t handle)
+{
+    // Frames, which are not confirmed, are dropped on connection reset
+    AGGREGATION(handle->aggregation.open = 0);
+    while ( handle->frames.confirm_ns != handle->frames.last_ns )
+    {
+        __release_i_frame_slot(handle, handle->frames.confirm_ns);
+        handle->frames.confirm_ns = (handle->frames.confirm_ns + 1) & seq_bits_mask;
+    }
+    __update_window_state(handle);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Moves unsent I-frame to lower N(S). Arena slots are swapped, so the slot of dropped frame can be released */
+static void __move_i_frame(tiny_fd_handle_t handle, uint8_t from, uint8_t to)
+{
+    tiny_i_frame_info_t *src = &handle->frames.i_frames[from & handle->frames.slot_mask];
+    tiny_i_frame_info_t *dst = &handle->frames.i_frames[to & handle->frames.slot_mask];
+#ifdef CONFIG_ENABLE_FD_ARENA
+    if ( !handle->frames.arena )
+#endif
+    {
+        memcpy(&__get_i_frame_slot(handle, to)->user_payload, &__get_i_frame_slot(handle, from)->user_payload,
+               src->len);
+    }
+    tiny_i_frame_info_t info = *dst;
+    *dst = *src;
+    *src = info;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Drops I-frames, which deadline passed before they were sent. N(S) is assigned, when I-frame is
+ * sent for the first time, so remaining unsent frames are moved down to keep sequence numbers
+ * contiguous. Expired frames are reported to the application without the lock first: they are
+ * marked, so tx side doesn't send them, and new frames are queued after them. Returns number of
+ * dropped frames. Tx capture ring has single producer, so the event is recorded only, if the
+ * function is called from tx context.
+ */
+static uint8_t __drop_expired_i_frames(tiny_fd_handle_t handle, bool tx_context)
+{
+    uint32_t ts = __fd_millis(handle);
+    // Frames are sent in order, so unsent ones are at the end of the queue, even after go-back-N
+    uint8_t first = handle->frames.next_ns;
+    while ( first != handle->frames.last_ns && handle->frames.i_frames[first & handle->frames.slot_mask].sent )
+    {
+        first = (first + 1) & seq_bits_mask;
+    }
+    uint8_t found = 0;
+    for ( uint8_t ns = first; ns != handle->frames.last_ns; ns = (ns + 1) & seq_bits_mask )
+    {
+        tiny_i_frame_info_t *info = &handle->frames.i_frames[ns & handle->frames.slot_mask];
+        if ( info->expired )
+        {
+            // Other thread reports expired frames, or the application calls the protocol from the callback
+            return 0;
+        }
+        found += info->expires && (int32_t)(ts - info->deadline) >= 0;
+    }
+    if ( !found )
+    {
+        return 0;
+    }
+    for ( uint8_t ns = first; ns != handle->frames.last_ns; ns = (ns + 1) & seq_bits_mask )
+    {
+        tiny_i_frame_info_t *info = &handle->frames.i_frames[ns & handle->frames.slot_mask];
+        info->expired = info->expires && (int32_t)(ts - info->deadline) >= 0;
+    }
+#ifdef CONFIG_ENABLE_FD_AGGREGATION
+    if ( handle->frames.i_frames[(uint8_t)(handle->frames.last_ns - 1) & handle->frames.slot_mask].expired )
+    {
+        // Open I-frame is dropped, so new messages start new I-frame
+        handle->aggregation.open = 0;
+    }
+#endif
+    tiny_fd_messages_cb_t cb = {.single = handle->on_expired_cb};
+    tiny_fd_batch_t batch;
+    __init_batch(handle, &batch, cb, 0);
+    for ( uint8_t ns = first; ns != handle->frames.last_ns; ns = (ns + 1) & seq_bits_mask )
+    {
+        tiny_i_frame_info_t *info = &handle->frames.i_frames[ns & handle->frames.slot_mask];
+        if ( info->expired )
+        {
+            __add_frame_messages(handle, &batch, &__get_i_frame_slot(handle, ns)->user_payload, info->len);
+        }
+    }
+    // The queue can be changed, while the lock was released: new frames are added, or the window is reset
+    first = handle->frames.next_ns;
+    while ( first != handle->frames.last_ns && handle->frames.i_frames[first & handle->frames.slot_mask].sent )
+    {
+        first = (first + 1) & seq_bits_mask;
+    }
+    uint8_t dropped = 0;
+    uint8_t to = first;
+    for ( uint8_t ns = first; ns != handle->frames.last_ns; ns = (ns + 1) & seq_bits_mask )
+    {
+        if ( handle->frames.i_frames[ns & handle->frames.slot_mask].expired )
+        {
+            dropped++;
+            continue;
+        }
+        if ( to != ns )
+        {
+            __move_i_frame(handle, ns, to);
+        }
+        to = (to + 1) & seq_bits_mask;
+    }
+    if ( !dropped )
+    {
+        return 0;
+    }
+    while ( handle->frames.last_ns != to )
+    {
+        handle->frames.last_ns = (handle->frames.last_ns - 1) & seq_bits_mask;
+        __release_i_frame_slot(handle, handle->frames.last_ns);
+    }
+    LOG(TINY_LOG_WRN, "[%p] %d expired I-frames are dropped\n", handle, dropped);
+    STATS(handle->stats.expired += dropped);
+    if ( tx_context )
+    {
+        CAPTURE_EVENT(handle, TINY_CAPTURE_TX, "Expired I-frames are dropped");
+    }
+    __update_window_state(handle);
+    __fd_events_set(handle, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
+    return dropped;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -185,19 +799,21 @@ static int __check_received_frame(tiny_fd_handle_t handle, uint8_t ns)
         // LOG("[%p] Confirming received frame <= %d\n", handle, ns);
         handle->frames.next_nr = (handle->frames.next_nr + 1) & seq_bits_mask;
         handle->frames.sent_reject = 0;
+        // Missing frame is received before REJ is sent: remote side already resends frames, and
+        // the following ones come next, so it is enough to confirm them
+        handle->s_u_frames.s_control &= ~HDLC_S_FRAME_TYPE_MASK;
     }
     else
     {
         // definitely we need to send reject. We want to see next_nr frame
         LOG(TINY_LOG_ERR, "[%p] Out of order I-Frame N(s)=%d\n", handle, ns);
+        STATS(handle->stats.out_of_order++);
+        CAPTURE_EVENT(handle, TINY_CAPTURE_RX, "Out of order I-frame");
         if ( !handle->frames.sent_reject )
         {
-            tiny_s_frame_info_t frame = {
-                .header.address = 0xFF,
-                .header.control = HDLC_S_FRAME_BITS | HDLC_S_FRAME_TYPE_REJ | (handle->frames.next_nr << 5),
-            };
+            STATS(handle->stats.rej_sent++);
             handle->frames.sent_reject = 1;
-            __put_u_s_frame_to_tx_queue(handle, &frame, 2);
+            __put_s_frame(handle, HDLC_S_FRAME_TYPE_REJ);
         }
         result = TINY_ERR_FAILED;
     }
@@ -208,6 +824,19 @@ static int __check_received_frame(tiny_fd_handle_t handle, uint8_t ns)
 
 static void __confirm_sent_frames(tiny_fd_handle_t handle, uint8_t nr)
 {
+    if ( handle->on_sent_cb.single || (handle->batch_cb & FD_BATCH_ON_SENT) )
+    {
+        // Notify application first: slots of confirmed frames stay valid, until they are released below
+        tiny_fd_batch_t batch;
+        __init_batch(handle, &batch, handle->on_sent_cb, FD_BATCH_ON_SENT);
+        for ( uint8_t ns = handle->frames.confirm_ns; ns != nr && ns != handle->frames.last_ns;
+              ns = (ns + 1) & seq_bits_mask )
+        {
+            __add_frame_messages(handle, &batch, &__get_i_frame_slot(handle, ns)->user_payload,
+                                 handle->frames.i_frames[ns & handle->frames.slot_mask].len);
+        }
+        __flush_messages(handle, &batch);
+    }
     // all frames below nr are received
     while ( nr != handle->frames.confirm_ns )
     {
@@ -218,22 +847,26 @@ static void __confirm_sent_frames(tiny_fd_handle_t handle, uint8_t nr)
             break;
         }
         // LOG("[%p] Confirming sent frames %d\n", handle, handle->frames.confirm_ns);
-        if ( handle->on_sent_cb )
+#ifdef CONFIG_ENABLE_FD_JOURNAL
+        if ( handle->journal )
+        {
+            tiny_journal_confirm(handle->journal,
+                                 handle->frames.i_frames[handle->frames.confirm_ns & handle->frames.slot_mask].journal_pos);
+        }
+#endif
+        __release_i_frame_slot(handle, handle->frames.confirm_ns);
+        if ( handle->frames.next_ns == handle->frames.confirm_ns )
         {
-            uint8_t i = handle->frames.head_ptr;
-            tiny_mutex_unlock(&handle->frames.mutex);
-            handle->on_sent_cb(handle->user_data, &handle->frames.i_frames[i]->user_payload,
-                               handle->frames.i_frames[i]->len);
-            tiny_mutex_lock(&handle->frames.mutex);
+            // Remote side confirms frame, which is waiting for (re)sending. There is no need to send it anymore
+            handle->frames.next_ns = (handle->frames.next_ns + 1) & seq_bits_mask;
         }
         handle->frames.confirm_ns = (handle->frames.confirm_ns + 1) & seq_bits_mask;
-        handle->frames.head_ptr++;
-        if ( handle->frames.head_ptr >= handle->frames.max_i_frames )
-            handle->frames.head_ptr -= handle->frames.max_i_frames;
+        BONDING(handle->frames.confirm_seq = (handle->frames.confirm_seq + 1) & bonding_seq_mask);
         handle->frames.retries = handle->retries;
         // Unblock tx queue to allow application to put new frames for sending
-        tiny_events_set(&handle->frames.events, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
+        __fd_events_set(handle, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
     }
+    __update_window_state(handle);
     LOG(TINY_LOG_DEB, "[%p] Last confirmed frame: %02X\n", handle, handle->frames.confirm_ns);
     // LOG("[%p] N(S)=%d, N(R)=%d\n", handle, handle->frames.confirm_ns, handle->frames.next_nr);
 }
@@ -256,13 +889,14 @@ static void __resend_all_unconfirmed_frames(tiny_fd_handle_t handle, uint8_t con
                 .data2 = (handle->frames.next_nr << 5) | (handle->frames.next_ns << 1),
             };
             // Send 2-byte header + 2 extra bytes
-            __put_u_s_frame_to_tx_queue(handle, &frame, 4);
+            __put_u_frame_to_tx_queue(handle, &frame, 4);
             break;
         }
         handle->frames.next_ns = (handle->frames.next_ns - 1) & seq_bits_mask;
+        STATS(handle->stats.retransmits++);
     }
     LOG(TINY_LOG_DEB, "[%p] N(s) is set to %02X\n", handle, handle->frames.next_ns);
-    tiny_events_set(&handle->frames.events, FD_EVENT_TX_DATA_AVAILABLE);
+    __fd_events_set(handle, FD_EVENT_TX_DATA_AVAILABLE);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -272,16 +906,33 @@ static void __switch_to_connected_state(tiny_fd_handle_t handle)
     if ( handle->state != TINY_FD_STATE_CONNECTED_ABM )
     {
         handle->state = TINY_FD_STATE_CONNECTED_ABM;
+        __release_all_i_frame_slots(handle);
         handle->frames.confirm_ns = 0;
         handle->frames.last_ns = 0;
         handle->frames.next_ns = 0;
         handle->frames.next_nr = 0;
+        BONDING(handle->frames.next_seq = 0);
+        BONDING(handle->frames.confirm_seq = 0);
         handle->frames.sent_nr = 0;
         handle->frames.sent_reject = 0;
-        handle->frames.head_ptr = 0;
-        handle->frames.last_ka_ts = tiny_millis();
-        tiny_events_set(&handle->frames.events, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
-        tiny_events_set(&handle->frames.events, FD_EVENT_TX_DATA_AVAILABLE);
+        handle->s_u_frames.s_control = 0;
+        handle->frames.last_ka_ts = __fd_millis(handle);
+        BONDING(handle->reorder.filled = 0);
+        for ( uint8_t i = 0; i < handle->link_count; i++ )
+        {
+            // All links are considered alive until keep alive timeout
+            handle->links[i].last_rx_ts = handle->frames.last_ka_ts;
+        }
+#ifdef CONFIG_ENABLE_FD_JOURNAL
+        if ( handle->journal )
+        {
+            // Frames, which were not confirmed before, are sent once again
+            tiny_journal_restart(handle->journal);
+        }
+#endif
+        handle->resume.valid = handle->resume.enabled;
+        __fd_events_set(handle, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
+        __fd_events_set(handle, FD_EVENT_TX_DATA_AVAILABLE);
         LOG(TINY_LOG_INFO, "[%p] ABM connection is established\n", handle);
     }
 }
@@ -293,20 +944,91 @@ static void __switch_to_disconnected_state(tiny_fd_handle_t handle)
     if ( handle->state != TINY_FD_STATE_DISCONNECTED )
     {
         handle->state = TINY_FD_STATE_DISCONNECTED;
+        __release_all_i_frame_slots(handle);
         handle->frames.confirm_ns = 0;
         handle->frames.last_ns = 0;
         handle->frames.next_ns = 0;
         handle->frames.next_nr = 0;
+        BONDING(handle->frames.next_seq = 0);
+        BONDING(handle->frames.confirm_seq = 0);
         handle->frames.sent_nr = 0;
         handle->frames.sent_reject = 0;
-        handle->frames.head_ptr = 0;
-        tiny_events_clear(&handle->frames.events, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
+        handle->s_u_frames.s_control = 0;
+        BONDING(handle->reorder.filled = 0);
+        handle->resume.valid = 0;
+        __fd_events_clear(handle, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
         LOG(TINY_LOG_INFO, "[%p] Disconnected\n", handle);
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/* Connection is lost, but unconfirmed frames and sequence numbers are kept until remote side comes back */
+static void __switch_to_suspended_state(tiny_fd_handle_t handle)
+{
+    if ( !handle->resume.valid || handle->state != TINY_FD_STATE_CONNECTED_ABM )
+    {
+        __switch_to_disconnected_state(handle);
+        return;
+    }
+    handle->state = TINY_FD_STATE_DISCONNECTED;
+    LOG(TINY_LOG_INFO, "[%p] Connection is lost, the session is suspended\n", handle);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Continues suspended session from N(R), received from remote side on reconnect.
+ * Returns false, if there is no session to resume, or N(R) doesn't match the window.
+ */
+static bool __resume_session(tiny_fd_handle_t handle, uint8_t nr)
+{
+    if ( !handle->resume.valid || ((uint8_t)(nr - handle->frames.confirm_ns) & seq_bits_mask) >
+                                      ((uint8_t)(handle->frames.last_ns - handle->frames.confirm_ns) & seq_bits_mask) )
+    {
+        return false;
+    }
+    __confirm_sent_frames(handle, nr);
+    // Frames, which were not received by remote side, are sent once again
+    __resend_all_unconfirmed_frames(handle, 0, nr);
+    handle->state = TINY_FD_STATE_CONNECTED_ABM;
+    handle->frames.sent_reject = 0;
+    handle->frames.retries = handle->retries;
+    handle->frames.ka_confirmed = 1;
+    handle->frames.last_ka_ts = __fd_millis(handle);
+    BONDING(handle->reorder.filled = 0);
+    for ( uint8_t i = 0; i < handle->link_count; i++ )
+    {
+        handle->links[i].last_rx_ts = handle->frames.last_ka_ts;
+    }
+    __fd_events_set(handle, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
+    STATS(handle->stats.resumes++);
+    LOG(TINY_LOG_INFO, "[%p] Session is resumed from N(R)=%02X\n", handle, nr);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __put_sabm_frame(tiny_fd_handle_t handle)
+{
+    tiny_u_frame_info_t frame = {
+        .header.address = 0xFF,
+        .header.control = HDLC_P_BIT | HDLC_U_FRAME_TYPE_SABM | HDLC_U_FRAME_BITS,
+        .data1 = handle->frames.next_nr,
+    };
+    // Suspended session passes N(R) in information field to continue from the same frames
+    __put_u_frame_to_tx_queue(handle, &frame, handle->resume.valid ? 3 : 2);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __put_rr_frame(tiny_fd_handle_t handle)
+{
+    __put_s_frame(handle, HDLC_S_FRAME_TYPE_RR);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 static int __on_i_frame_read(tiny_fd_handle_t handle, void *data, int len)
 {
     uint8_t control = ((uint8_t *)data)[1];
@@ -318,26 +1040,119 @@ static int __on_i_frame_read(tiny_fd_handle_t handle, void *data, int len)
     // Provide data to user only if we expect this frame
     if ( result == TINY_SUCCESS )
     {
-        if ( handle->on_frame_cb )
-        {
-            tiny_mutex_unlock(&handle->frames.mutex);
-            handle->on_frame_cb(handle->user_data, (uint8_t *)data + 2, len - 2);
-            tiny_mutex_lock(&handle->frames.mutex);
-        }
+        STATS(handle->stats.rx_i_frames++);
+        tiny_fd_batch_t batch;
+        __init_batch(handle, &batch, handle->on_frame_cb, FD_BATCH_ON_FRAME);
+        __add_frame_messages(handle, &batch, (uint8_t *)data + 2, len - 2);
+        __flush_messages(handle, &batch);
         // Decide whenever we need to send RR after user callback
         // Check if we need to send confirmations separately. If we have something to send, just skip RR S-frame.
         // Also at this point, since we received expected frame, sent_reject will be cleared to 0.
         if ( __all_frames_are_sent(handle) && handle->frames.sent_nr != handle->frames.next_nr )
         {
-            tiny_s_frame_info_t frame = {
-                .header.address = 0xFF,
-                .header.control = HDLC_S_FRAME_BITS | HDLC_S_FRAME_TYPE_RR | (handle->frames.next_nr << 5),
-            };
-            __put_u_s_frame_to_tx_queue(handle, &frame, 2);
+            __put_rr_frame(handle);
+        }
+    }
+    if ( control & HDLC_P_BIT )
+    {
+        // Remote side is about to fill its window, and can't wait for I-frame to carry N(R)
+        __put_rr_frame(handle);
+    }
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef CONFIG_ENABLE_FD_BONDING
+static inline uint8_t *__get_reorder_slot(tiny_fd_handle_t handle, uint8_t ns)
+{
+    return handle->reorder.slots + ns * FD_SLOT_SIZE(handle->frames.mtu);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline int *__get_reorder_len(tiny_fd_handle_t handle, uint8_t ns)
+{
+    return (int *)__get_reorder_slot(handle, FD_REORDER_SLOTS) + ns;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * I-frames, sent over different links, can arrive in any order. Frames ahead of N(R) are kept in
+ * reorder slots, and delivered to the application, when missing frames arrive. Only one link
+ * delivers frames at a time, so the application receives them in order.
+ */
+static int __on_bonded_i_frame_read(tiny_fd_handle_t handle, void *data, int len)
+{
+    uint8_t control = ((uint8_t *)data)[1];
+    uint8_t nr = control >> 5;
+    uint8_t ns = (control >> 1) & 0x07;
+    uint8_t address = ((uint8_t *)data)[0];
+    // Late copy of the frame, which is already delivered, has the same 3-bit N(S) as new frame, but not 7-bit one
+    uint8_t distance = ((uint8_t)((((address & 0x0F) << 3) | ns) - handle->frames.next_seq)) & bonding_seq_mask;
+    LOG(TINY_LOG_INFO, "[%p] Receiving I-Frame N(R)=%02X,N(S)=%02X\n", handle, nr, ns);
+    if ( !__is_stale_nr(handle, address, nr) )
+    {
+        __confirm_sent_frames(handle, nr);
+    }
+    if ( distance >= TINY_FD_BONDING_MAX_WINDOW || (handle->reorder.filled & (1 << ns)) )
+    {
+        // Retransmission of the frame, which is already received. Remote side needs confirmation once again
+        if ( __all_frames_are_sent(handle) )
+        {
+            __put_rr_frame(handle);
+        }
+        return TINY_ERR_FAILED;
+    }
+    if ( distance || handle->reorder.delivering )
+    {
+        if ( distance )
+        {
+            STATS(handle->stats.reordered++);
         }
+        memcpy(__get_reorder_slot(handle, ns), (uint8_t *)data + 2, len - 2);
+        *__get_reorder_len(handle, ns) = len - 2;
+        handle->reorder.filled |= 1 << ns;
+        return TINY_SUCCESS;
     }
-    return result;
+    handle->reorder.delivering = 1;
+    uint8_t *payload = (uint8_t *)data + 2;
+    len -= 2;
+    tiny_fd_batch_t batch;
+    __init_batch(handle, &batch, handle->on_frame_cb, FD_BATCH_ON_FRAME);
+    for ( ;; )
+    {
+        handle->frames.next_nr = (handle->frames.next_nr + 1) & seq_bits_mask;
+        handle->frames.next_seq = (handle->frames.next_seq + 1) & bonding_seq_mask;
+        STATS(handle->stats.rx_i_frames++);
+        // The slot can't be taken by new frame, because N(R) is already moved forward,
+        // and remote side can't send more than TINY_FD_BONDING_MAX_WINDOW frames ahead of it
+        __add_frame_messages(handle, &batch, payload, len);
+        ns = handle->frames.next_nr;
+        if ( !(handle->reorder.filled & (1 << ns)) )
+        {
+            // Other links can put next frame to reorder slots, while the lock is released
+            __flush_messages(handle, &batch);
+            if ( !(handle->reorder.filled & (1 << ns)) )
+            {
+                break;
+            }
+        }
+        handle->reorder.filled &= ~(1 << ns);
+        payload = __get_reorder_slot(handle, ns);
+        len = *__get_reorder_len(handle, ns);
+    }
+    handle->reorder.delivering = 0;
+    // Several frames can be delivered at once, and N(R) can return to the value, sent in the last I-frame.
+    // Also that I-frame can go over slow link, so confirmation is always sent separately
+    if ( __all_frames_are_sent(handle) || (control & HDLC_P_BIT) )
+    {
+        __put_rr_frame(handle);
+    }
+    return TINY_SUCCESS;
 }
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -346,10 +1161,16 @@ static int __on_s_frame_read(tiny_fd_handle_t handle, void *data, int len)
     uint8_t control = ((uint8_t *)data)[1];
     uint8_t nr = control >> 5;
     int result = TINY_ERR_FAILED;
+    if ( __is_stale_nr(handle, ((uint8_t *)data)[0], nr) )
+    {
+        LOG(TINY_LOG_INFO, "[%p] Late S-Frame N(R)=%02X is ignored\n", handle, nr);
+        return result;
+    }
     LOG(TINY_LOG_INFO, "[%p] Receiving S-Frame N(R)=%02X, type=%s\n", handle, nr,
         ((control >> 2) & 0x03) == 0x00 ? "RR" : "REJ");
     if ( (control & HDLC_S_FRAME_TYPE_MASK) == HDLC_S_FRAME_TYPE_REJ )
     {
+        CAPTURE_EVENT(handle, TINY_CAPTURE_RX, "REJ received, resending unconfirmed I-frames");
         __confirm_sent_frames(handle, nr);
         __resend_all_unconfirmed_frames(handle, control, nr);
     }
@@ -361,11 +1182,7 @@ static int __on_s_frame_read(tiny_fd_handle_t handle, void *data, int len)
             // Send answer if we don't have frames to send
             if ( handle->frames.next_ns == handle->frames.last_ns )
             {
-                tiny_s_frame_info_t frame = {
-                    .header.address = 0xFF,
-                    .header.control = HDLC_S_FRAME_BITS | HDLC_S_FRAME_TYPE_RR | (handle->frames.next_nr << 5),
-                };
-                __put_u_s_frame_to_tx_queue(handle, &frame, 2);
+                __put_rr_frame(handle);
             }
         }
     }
@@ -386,8 +1203,17 @@ static int __on_u_frame_read(tiny_fd_handle_t handle, void *data, int len)
             .header.address = 0xFF,
             .header.control = HDLC_U_FRAME_TYPE_UA | HDLC_F_BIT | HDLC_U_FRAME_BITS,
         };
-        __put_u_s_frame_to_tx_queue(handle, &frame, 2);
-        __switch_to_connected_state(handle);
+        if ( len > 2 && __resume_session(handle, ((uint8_t *)data)[2]) )
+        {
+            // Remote side continues from our N(R), and we continue from its one
+            frame.data1 = handle->frames.next_nr;
+            __put_u_frame_to_tx_queue(handle, &frame, 3);
+        }
+        else
+        {
+            __put_u_frame_to_tx_queue(handle, &frame, 2);
+            __switch_to_connected_state(handle);
+        }
     }
     else if ( type == HDLC_U_FRAME_TYPE_DISC )
     {
@@ -395,7 +1221,7 @@ static int __on_u_frame_read(tiny_fd_handle_t handle, void *data, int len)
             .header.address = 0xFF,
             .header.control = HDLC_U_FRAME_TYPE_UA | HDLC_F_BIT | HDLC_U_FRAME_BITS,
         };
-        __put_u_s_frame_to_tx_queue(handle, &frame, 2);
+        __put_u_frame_to_tx_queue(handle, &frame, 2);
         __switch_to_disconnected_state(handle);
     }
     else if ( type == HDLC_U_FRAME_TYPE_RSET )
@@ -412,8 +1238,11 @@ static int __on_u_frame_read(tiny_fd_handle_t handle, void *data, int len)
     {
         if ( handle->state == TINY_FD_STATE_CONNECTING )
         {
-            // confirmation received
-            __switch_to_connected_state(handle);
+            // confirmation received. UA without N(R) means, that remote side starts new session
+            if ( len <= 2 || !__resume_session(handle, ((uint8_t *)data)[2]) )
+            {
+                __switch_to_connected_state(handle);
+            }
         }
         else if ( handle->state == TINY_FD_STATE_DISCONNECTING )
         {
@@ -431,15 +1260,17 @@ static int __on_u_frame_read(tiny_fd_handle_t handle, void *data, int len)
 
 static int on_frame_read(void *user_data, void *data, int len)
 {
-    tiny_fd_handle_t handle = (tiny_fd_handle_t)user_data;
+    tiny_fd_link_t *link = (tiny_fd_link_t *)user_data;
+    tiny_fd_handle_t handle = link->fd;
     // printf("[%p] Incoming frame of size %i\n", handle, len);
-    handle->frames.last_ka_ts = tiny_millis();
+    handle->frames.last_ka_ts = __fd_millis(handle);
+    link->last_rx_ts = handle->frames.last_ka_ts;
     if ( len < 2 )
     {
         LOG(TINY_LOG_WRN, "FD: received too small frame\n");
         return TINY_ERR_FAILED;
     }
-    tiny_mutex_lock(&handle->frames.mutex);
+    __fd_lock(handle);
     handle->frames.ka_confirmed = 1;
     uint8_t control = ((uint8_t *)data)[1];
     if ( (control & HDLC_U_FRAME_MASK) == HDLC_U_FRAME_MASK )
@@ -451,16 +1282,21 @@ static int on_frame_read(void *user_data, void *data, int len)
         // Should send DM in case we receive here S- or I-frames.
         // If connection is not established, we should ignore all frames except U-frames
         LOG(TINY_LOG_ERR, "[%p] ABM connection is not established\n", handle);
-        tiny_u_frame_info_t frame = {
-            .header.address = 0xFF,
-            .header.control = HDLC_P_BIT | HDLC_U_FRAME_TYPE_SABM | HDLC_U_FRAME_BITS,
-        };
-        __put_u_s_frame_to_tx_queue(handle, &frame, 2);
+        __put_sabm_frame(handle);
         handle->state = TINY_FD_STATE_CONNECTING;
     }
     else if ( (control & HDLC_I_FRAME_MASK) == HDLC_I_FRAME_BITS )
     {
-        __on_i_frame_read(handle, data, len);
+#ifdef CONFIG_ENABLE_FD_BONDING
+        if ( __is_bonded(handle) )
+        {
+            __on_bonded_i_frame_read(handle, data, len);
+        }
+        else
+#endif
+        {
+            __on_i_frame_read(handle, data, len);
+        }
     }
     else if ( (control & HDLC_S_FRAME_MASK) == HDLC_S_FRAME_BITS )
     {
@@ -470,50 +1306,49 @@ static int on_frame_read(void *user_data, void *data, int len)
     {
         LOG(TINY_LOG_WRN, "[%p] Unknown hdlc frame received\n", handle);
     }
-    tiny_mutex_unlock(&handle->frames.mutex);
+    __fd_unlock(handle);
     return len;
 }
 
 static int on_frame_sent(void *user_data, const void *data, int len)
 {
-    tiny_fd_handle_t handle = (tiny_fd_handle_t)user_data;
-    uint8_t control = ((uint8_t *)data)[1];
-    tiny_mutex_lock(&handle->frames.mutex);
-    if ( (control & HDLC_I_FRAME_MASK) == HDLC_I_FRAME_BITS )
-    {
-        // nothing to do
-        // we need to wait for confirmation from remote side
-    }
-    else if ( (control & HDLC_S_FRAME_MASK) == HDLC_S_FRAME_BITS )
-    {
-        __remove_u_s_frame_from_tx_queue(handle);
-        //        fprintf( stderr, "QUEUE PTR=%d, LEN=%d\n", handle->s_u_frames.queue_ptr, handle->s_u_frames.queue_len
-        //        );
-    }
-    else if ( (control & HDLC_U_FRAME_MASK) == HDLC_U_FRAME_BITS )
-    {
-        __remove_u_s_frame_from_tx_queue(handle);
-        //        fprintf( stderr, "QUEUE PTR=%d, LEN=%d\n", handle->s_u_frames.queue_ptr, handle->s_u_frames.queue_len
-        //        );
-    }
-    tiny_mutex_unlock(&handle->frames.mutex);
-    tiny_events_clear(&handle->frames.events, FD_EVENT_TX_SENDING);
+    tiny_fd_link_t *link = (tiny_fd_link_t *)user_data;
+    tiny_fd_handle_t handle = link->fd;
+    __fd_lock(handle);
+    // S- and U-frames are removed from the queue, when the link takes them.
+    // I-frames wait for confirmation from remote side
+    link->ns = FD_NO_NS;
+    __fd_unlock(handle);
+    link->sending = 0;
     return len;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static int tiny_fd_calculate_mtu_size(int buffer_size, int window, hdlc_crc_t crc_type)
+static int tiny_fd_calculate_mtu_size(int buffer_size, int window, hdlc_crc_t crc_type, uint8_t fec_roots,
+                                      uint8_t links)
 {
-    return (buffer_size -
-            sizeof(tiny_fd_data_t)
-            // RX overhead
-            - sizeof(hdlc_ll_data_t) - sizeof(tiny_frame_header_t) -
-            get_crc_field_size(crc_type)
-            // TX overhead
-            - window * (sizeof(tiny_i_frame_info_t *) + sizeof(tiny_i_frame_info_t) -
-                        sizeof(((tiny_i_frame_info_t *)0)->user_payload))) /
-           (window + 1);
+    int slots = FD_SLOTS(window);
+    int reorder_slots = links > 1 ? FD_REORDER_SLOTS : 0;
+    int mtu = (buffer_size -
+               (int)sizeof(tiny_fd_data_t) - (CONFIG_FD_SLOT_ALIGN - 1)
+               // RX overhead of each link
+               - links * (int)(sizeof(tiny_fd_link_t) + sizeof(hdlc_ll_data_t) + sizeof(tiny_frame_header_t) +
+                               get_crc_field_size(crc_type) + CONFIG_FD_SLOT_ALIGN - 1)
+               // TX overhead
+               - slots * (int)(sizeof(tiny_i_frame_info_t) + sizeof(tiny_frame_header_t))
+               // Reorder overhead
+               - reorder_slots * (int)(sizeof(int) + sizeof(tiny_frame_header_t))) /
+              (slots + links + reorder_slots);
+    // Slots are aligned, so exact mtu is found by decreasing the estimation
+    while ( mtu > 0 && tiny_fd_buffer_size_by_mtu_ex(mtu, window, crc_type) +
+                              tiny_fd_buffer_size_fec_overhead(mtu, crc_type, fec_roots) +
+                              tiny_fd_buffer_size_links_overhead(mtu, crc_type, fec_roots, links) >
+                          buffer_size )
+    {
+        mtu--;
+    }
+    return mtu;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -521,23 +1356,87 @@ static int tiny_fd_calculate_mtu_size(int buffer_size, int window, hdlc_crc_t cr
 int tiny_fd_init(tiny_fd_handle_t *handle, tiny_fd_init_t *init)
 {
     *handle = NULL;
-    if ( (0 == init->on_frame_cb) || (0 == init->buffer) || (0 == init->buffer_size) )
+    if ( (0 == init->on_frame_cb && 0 == init->on_frame_batch_cb) || (0 == init->buffer) || (0 == init->buffer_size) )
     {
         return TINY_ERR_FAILED;
     }
+#ifndef CONFIG_ENABLE_FD_BONDING
+    if ( init->links > 1 )
+    {
+        LOG(TINY_LOG_CRIT, "Library is built without links bonding support\n");
+        return TINY_ERR_INVALID_DATA;
+    }
+#endif
+#ifndef CONFIG_ENABLE_FD_ARENA
+    if ( init->arena )
+    {
+        LOG(TINY_LOG_CRIT, "Library is built without shared arena support\n");
+        return TINY_ERR_INVALID_DATA;
+    }
+#endif
+#ifndef CONFIG_ENABLE_FD_JOURNAL
+    if ( init->journal )
+    {
+        LOG(TINY_LOG_CRIT, "Library is built without tx journal support\n");
+        return TINY_ERR_INVALID_DATA;
+    }
+#endif
+#ifndef CONFIG_ENABLE_FD_AGGREGATION
+    if ( init->aggregation )
+    {
+        LOG(TINY_LOG_CRIT, "Library is built without messages aggregation support\n");
+        return TINY_ERR_INVALID_DATA;
+    }
+#endif
+    if ( init->arena && (init->mtu > tiny_fd_arena_get_mtu(init->arena) || init->arena_reserve > init->window_frames) )
+    {
+        LOG(TINY_LOG_CRIT, "mtu or reserve is too big for the arena\n");
+        return TINY_ERR_INVALID_DATA;
+    }
+    uint8_t links = init->links ? init->links : 1;
+    if ( links > TINY_FD_MAX_LINKS )
+    {
+        LOG(TINY_LOG_CRIT, "Too many links, maximum is %i\n", TINY_FD_MAX_LINKS);
+        return TINY_ERR_INVALID_DATA;
+    }
+    if ( links > 1 && init->window_frames > TINY_FD_BONDING_MAX_WINDOW )
+    {
+        LOG(TINY_LOG_CRIT, "Bonded links don't support more than %i-frames queue\n", TINY_FD_BONDING_MAX_WINDOW);
+        return TINY_ERR_INVALID_DATA;
+    }
+    if ( links > 1 && init->arena )
+    {
+        // Confirmed frame can be still sent by slow link, so its slot can't be returned to the arena
+        LOG(TINY_LOG_CRIT, "Bonded links don't support shared arena\n");
+        return TINY_ERR_INVALID_DATA;
+    }
+    if ( links > 1 && init->capture && !init->single_thread )
+    {
+        // All links share the capture, which has single producer per direction
+        LOG(TINY_LOG_CRIT, "Bonded links support capture only in single thread mode\n");
+        return TINY_ERR_INVALID_DATA;
+    }
+    if ( init->mtu == 0 && init->arena )
+    {
+        init->mtu = tiny_fd_arena_get_mtu(init->arena);
+    }
     if ( init->mtu == 0 )
     {
-        init->mtu = tiny_fd_calculate_mtu_size(init->buffer_size, init->window_frames, init->crc_type);
+        init->mtu = tiny_fd_calculate_mtu_size(init->buffer_size, init->window_frames, init->crc_type,
+                                               init->fec_roots, links);
         if ( init->mtu < 1 )
         {
             LOG(TINY_LOG_CRIT, "Calculated mtu size is zero, no payload transfer is available\n");
             return TINY_ERR_INVALID_DATA;
         }
     }
-    if ( init->buffer_size < tiny_fd_buffer_size_by_mtu_ex(init->mtu, init->window_frames, init->crc_type) )
+    int required_size = init->arena ? tiny_fd_buffer_size_with_arena(init->mtu, init->window_frames, init->crc_type)
+                                    : tiny_fd_buffer_size_by_mtu_ex(init->mtu, init->window_frames, init->crc_type);
+    required_size += tiny_fd_buffer_size_fec_overhead(init->mtu, init->crc_type, init->fec_roots);
+    required_size += tiny_fd_buffer_size_links_overhead(init->mtu, init->crc_type, init->fec_roots, links);
+    if ( init->buffer_size < required_size )
     {
-        LOG(TINY_LOG_CRIT, "Too small buffer for FD protocol %i < %i\n", init->buffer_size,
-            tiny_fd_buffer_size_by_mtu_ex(init->mtu, init->window_frames, init->crc_type));
+        LOG(TINY_LOG_CRIT, "Too small buffer for FD protocol %i < %i\n", init->buffer_size, required_size);
         return TINY_ERR_INVALID_DATA;
     }
     if ( init->window_frames > 7 )
@@ -555,51 +1454,124 @@ int tiny_fd_init(tiny_fd_handle_t *handle, tiny_fd_init_t *init)
         LOG(TINY_LOG_CRIT, "HDLC uses timeouts for ACK, at least retry_timeout, or send_timeout must be specified\n");
         return TINY_ERR_INVALID_DATA;
     }
+    if ( init->arena && tiny_fd_arena_attach(init->arena, init->arena_reserve) != TINY_SUCCESS )
+    {
+        LOG(TINY_LOG_CRIT, "Not enough slots in the arena to reserve\n");
+        return TINY_ERR_INVALID_DATA;
+    }
     memset(init->buffer, 0, init->buffer_size);
 
     uint8_t *ptr = (uint8_t *)init->buffer;
     /* Lets locate main FD protocol data at the beginning of specified buffer */
     tiny_fd_data_t *protocol = (tiny_fd_data_t *)ptr;
     ptr += sizeof(tiny_fd_data_t);
-    /* Next we need some space to hold pointers to tiny_i_frame_info_t records (window_frames pointers) */
-    protocol->frames.i_frames = (tiny_i_frame_info_t **)(ptr);
-    ptr += sizeof(tiny_i_frame_info_t *) * init->window_frames;
+    protocol->hal = init->hal ? init->hal : &tiny_platform_hal_default;
+    /* Next goes array of physical links */
+    protocol->links = (tiny_fd_link_t *)(ptr);
+    protocol->link_count = links;
+    ptr += sizeof(tiny_fd_link_t) * links;
+    /* TX frames are kept in power of 2 ring, indexed by N(S). Next goes compact metadata array */
+    protocol->frames.i_frames = (tiny_i_frame_info_t *)(ptr);
+    ptr += sizeof(tiny_i_frame_info_t) * FD_SLOTS(init->window_frames);
     protocol->frames.max_i_frames = init->window_frames;
+    protocol->frames.slot_mask = FD_SLOTS(init->window_frames) - 1;
     protocol->frames.mtu = init->mtu;
-    /* Lets allocate memory for TX frames, we have <window_frames> TX frames */
-    for ( int i = 0; i < init->window_frames; i++ )
+    /* Lets allocate memory for TX frames. We do not allocate space for CRC field since, it is calculated only
+     * during send operation by HDLC low level. Each slot starts at aligned address.
+     * With shared arena the slots are taken from the arena on demand */
+#ifdef CONFIG_ENABLE_FD_ARENA
+    protocol->frames.arena = init->arena;
+    protocol->frames.arena_reserve = init->arena_reserve;
+#endif
+    if ( !init->arena )
     {
-        protocol->frames.i_frames[i] = (tiny_i_frame_info_t *)ptr;
-        /* We do not allocate space for CRC field since, it is calculated only during send operation by HDLC low level
-         */
-        ptr += protocol->frames.mtu + sizeof(tiny_i_frame_info_t) - sizeof(((tiny_i_frame_info_t *)0)->user_payload);
+        ptr = (uint8_t *)(((uintptr_t)ptr + CONFIG_FD_SLOT_ALIGN - 1) & ~(uintptr_t)(CONFIG_FD_SLOT_ALIGN - 1));
+        protocol->frames.i_slots = ptr;
+        protocol->frames.slot_size = FD_SLOT_SIZE(init->mtu);
+        ptr += protocol->frames.slot_size * FD_SLOTS(init->window_frames);
     }
-    /* Lets allocate memory for HDLC low level protocol */
+    /* Lets allocate memory for HDLC low level protocol of each link */
     hdlc_ll_init_t _init = { 0 };
     _init.on_frame_read = on_frame_read;
     _init.on_frame_sent = on_frame_sent;
-    _init.user_data = protocol;
     _init.crc_type = init->crc_type;
-    _init.buf_size = hdlc_ll_get_buf_size_ex(protocol->frames.mtu + sizeof(tiny_frame_header_t), init->crc_type);
-    _init.buf = ptr;
-    ptr += _init.buf_size;
+    _init.capture = init->capture;
+    _init.fec_roots = init->fec_roots;
+    _init.framing = init->framing;
+    _init.buf_size = hdlc_ll_get_buf_size_fec(protocol->frames.mtu + sizeof(tiny_frame_header_t), init->crc_type,
+                                              init->fec_roots);
+    int result = TINY_SUCCESS;
+    for ( uint8_t i = 0; i < links && result == TINY_SUCCESS; i++ )
+    {
+        tiny_fd_link_t *link = &protocol->links[i];
+        if ( i )
+        {
+            ptr = (uint8_t *)(((uintptr_t)ptr + CONFIG_FD_SLOT_ALIGN - 1) & ~(uintptr_t)(CONFIG_FD_SLOT_ALIGN - 1));
+        }
+        link->fd = protocol;
+        link->ns = FD_NO_NS;
+        _init.user_data = link;
+        _init.buf = ptr;
+        ptr += _init.buf_size;
+        if ( ptr > (uint8_t *)init->buffer + init->buffer_size )
+        {
+            result = TINY_ERR_INVALID_DATA;
+            break;
+        }
+        result = hdlc_ll_init(&link->hdlc, &_init);
+    }
+#ifdef CONFIG_ENABLE_FD_BONDING
+    /* Bonded links deliver received frames in order, using reorder slots */
+    if ( result == TINY_SUCCESS && links > 1 )
+    {
+        ptr = (uint8_t *)(((uintptr_t)ptr + CONFIG_FD_SLOT_ALIGN - 1) & ~(uintptr_t)(CONFIG_FD_SLOT_ALIGN - 1));
+        protocol->reorder.slots = ptr;
+        ptr += (FD_SLOT_SIZE(init->mtu) + sizeof(int)) * FD_REORDER_SLOTS;
+    }
+#endif
     if ( ptr > (uint8_t *)init->buffer + init->buffer_size )
     {
         LOG(TINY_LOG_CRIT, "Out of provided memory: provided %i bytes, used %i bytes\n", init->buffer_size,
             (int)(ptr - (uint8_t *)init->buffer));
-        return TINY_ERR_INVALID_DATA;
+        result = TINY_ERR_INVALID_DATA;
     }
-
-    int result = hdlc_ll_init(&protocol->_hdlc, &_init);
     if ( result != TINY_SUCCESS )
     {
         LOG(TINY_LOG_CRIT, "HDLC low level initialization failed");
+        for ( uint8_t i = 0; i < links; i++ )
+        {
+            if ( protocol->links[i].hdlc )
+            {
+                hdlc_ll_close(protocol->links[i].hdlc);
+            }
+        }
+        if ( init->arena )
+        {
+            tiny_fd_arena_detach(init->arena, init->arena_reserve);
+        }
         return result;
     }
 
     protocol->user_data = init->pdata;
-    protocol->on_frame_cb = init->on_frame_cb;
-    protocol->on_sent_cb = init->on_sent_cb;
+    if ( init->on_frame_batch_cb )
+    {
+        protocol->on_frame_cb.batch = init->on_frame_batch_cb;
+        protocol->batch_cb |= FD_BATCH_ON_FRAME;
+    }
+    else
+    {
+        protocol->on_frame_cb.single = init->on_frame_cb;
+    }
+    if ( init->on_sent_batch_cb )
+    {
+        protocol->on_sent_cb.batch = init->on_sent_batch_cb;
+        protocol->batch_cb |= FD_BATCH_ON_SENT;
+    }
+    else
+    {
+        protocol->on_sent_cb.single = init->on_sent_cb;
+    }
+    protocol->on_expired_cb = init->on_expired_cb;
     protocol->send_timeout = init->send_timeout;
     protocol->ka_timeout = 5000;
     protocol->retry_timeout =
@@ -608,8 +1580,23 @@ int tiny_fd_init(tiny_fd_handle_t *handle, tiny_fd_init_t *init)
     protocol->frames.retries = init->retries;
     protocol->state = TINY_FD_STATE_DISCONNECTED;
 
-    tiny_mutex_create(&protocol->frames.mutex);
-    tiny_events_create(&protocol->frames.events);
+#ifdef CONFIG_ENABLE_CAPTURE
+    protocol->capture = init->capture;
+#endif
+#ifdef CONFIG_ENABLE_FD_JOURNAL
+    protocol->journal = init->journal;
+#endif
+#ifdef CONFIG_ENABLE_FD_AGGREGATION
+    protocol->aggregation.enabled = init->aggregation;
+    protocol->aggregation.delay = init->aggregation_delay;
+#endif
+    protocol->single_thread = init->single_thread;
+    protocol->resume.enabled = init->resume;
+    if ( !protocol->single_thread )
+    {
+        TINY_HAL_FUNC(protocol->hal, mutex_create)(&protocol->frames.mutex);
+        TINY_HAL_FUNC(protocol->hal, events_create)(&protocol->frames.events);
+    }
     *handle = protocol;
 
     // Request remote side for ABM
@@ -618,7 +1605,7 @@ int tiny_fd_init(tiny_fd_handle_t *handle, tiny_fd_init_t *init)
             .header.address = 0xFF,
             .header.control = HDLC_P_BIT | HDLC_U_FRAME_TYPE_SABM | HDLC_U_FRAME_BITS,
         };
-        __put_u_s_frame_to_tx_queue( *handle, &frame, 2 ); */
+        __put_u_frame_to_tx_queue( *handle, &frame, 2 ); */
     return TINY_SUCCESS;
 }
 
@@ -626,23 +1613,49 @@ int tiny_fd_init(tiny_fd_handle_t *handle, tiny_fd_init_t *init)
 
 void tiny_fd_close(tiny_fd_handle_t handle)
 {
-    hdlc_ll_close(handle->_hdlc);
-    tiny_events_destroy(&handle->frames.events);
-    tiny_mutex_destroy(&handle->frames.mutex);
+    for ( uint8_t i = 0; i < handle->link_count; i++ )
+    {
+        hdlc_ll_close(handle->links[i].hdlc);
+    }
+#ifdef CONFIG_ENABLE_FD_ARENA
+    if ( handle->frames.arena )
+    {
+        __release_all_i_frame_slots(handle);
+        tiny_fd_arena_detach(handle->frames.arena, handle->frames.arena_reserve);
+    }
+#endif
+    if ( !handle->single_thread )
+    {
+        TINY_HAL_FUNC(handle->hal, events_destroy)(&handle->frames.events);
+        TINY_HAL_FUNC(handle->hal, mutex_destroy)(&handle->frames.mutex);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 int tiny_fd_on_rx_data(tiny_fd_handle_t handle, const void *data, int len)
 {
+    return tiny_fd_on_rx_data_link(handle, 0, data, len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_on_rx_data_link(tiny_fd_handle_t handle, uint8_t link_index, const void *data, int len)
+{
+    if ( link_index >= handle->link_count )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    hdlc_ll_handle_t hdlc = handle->links[link_index].hdlc;
     const uint8_t *ptr = (const uint8_t *)data;
     while ( len )
     {
         int error;
-        int processed_bytes = hdlc_ll_run_rx(handle->_hdlc, ptr, len, &error);
+        int processed_bytes = hdlc_ll_run_rx(hdlc, ptr, len, &error);
         if ( error == TINY_ERR_WRONG_CRC )
         {
             LOG(TINY_LOG_WRN, "[%p] HDLC CRC sum mismatch\n", handle);
+            STATS(handle->stats.crc_errors++);
         }
         ptr += processed_bytes;
         len -= processed_bytes;
@@ -652,6 +1665,18 @@ int tiny_fd_on_rx_data(tiny_fd_handle_t handle, const void *data, int len)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+int tiny_fd_on_rx_block(tiny_fd_handle_t handle, const void *block, int size)
+{
+    // Fill bytes can't be distinguished from the length of the frame
+    if ( handle->links[0].hdlc->framing == HDLC_FRAMING_LENGTH || size < 0 )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    return tiny_fd_on_rx_data(handle, block, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 int tiny_fd_run_rx(tiny_fd_handle_t handle, read_block_cb_t read_func)
 {
     uint8_t buf[4];
@@ -665,16 +1690,60 @@ int tiny_fd_run_rx(tiny_fd_handle_t handle, read_block_cb_t read_func)
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static uint8_t *tiny_fd_get_next_frame_to_send(tiny_fd_handle_t handle, int *len)
+#ifdef CONFIG_ENABLE_FD_JOURNAL
+static void __move_frames_from_journal(tiny_fd_handle_t handle)
+{
+    __fd_lock(handle);
+    while ( handle->state == TINY_FD_STATE_CONNECTED_ABM &&
+            __number_of_awaiting_tx_i_frames(handle) < handle->frames.max_i_frames )
+    {
+        const uint8_t *data;
+        int len;
+        uint32_t ts = __fd_millis(handle);
+        int32_t pos = tiny_journal_peek(handle->journal, ts, &data, &len);
+        if ( pos < 0 || __put_i_frame_to_tx_queue(handle, data, len, 0) != TINY_SUCCESS )
+        {
+            break;
+        }
+        // Each journal record is confirmed separately, so it takes whole I-frame
+        AGGREGATION(handle->aggregation.open = 0);
+        tiny_journal_take(handle->journal, pos, ts);
+        handle->frames.i_frames[(uint8_t)(handle->frames.last_ns - 1) & handle->frames.slot_mask].journal_pos = pos;
+    }
+    __fd_unlock(handle);
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint8_t *tiny_fd_get_next_frame_to_send(tiny_fd_handle_t handle, tiny_fd_link_t *link, int *len,
+                                               tiny_i_frame_info_t **info)
 {
     uint8_t *data = NULL;
+    *info = NULL;
+    uint32_t ts = __fd_millis(handle);
     // Tx data available
-    tiny_mutex_lock(&handle->frames.mutex);
-    if ( __has_non_sent_s_u_frames(handle) )
+    __fd_lock(handle);
+    // Stale I-frames are dropped, before they take N(S)
+    __drop_expired_i_frames(handle, true);
+    bool usable = __link_is_usable(handle, link);
+    if ( usable && __has_non_sent_s_u_frames(handle) )
     {
-        // clear queue only, when send is done, so for now, use pointer data for sending only
-        data = (uint8_t *)&handle->s_u_frames.queue[handle->s_u_frames.queue_ptr].u_frame;
-        *len = handle->s_u_frames.queue[handle->s_u_frames.queue_ptr].len;
+        // The frame is copied to the link, so other links can take next frames from the queue
+        if ( handle->s_u_frames.queue_len )
+        {
+            link->frame = handle->s_u_frames.queue[handle->s_u_frames.queue_ptr];
+            __remove_u_frame_from_tx_queue(handle);
+        }
+        else
+        {
+            link->frame.len = 2;
+            link->frame.s_frame.header.address = __get_frame_address(handle, 0);
+            link->frame.s_frame.header.control = handle->s_u_frames.s_control | (handle->frames.next_nr << 5);
+            handle->s_u_frames.s_control = 0;
+        }
+        data = (uint8_t *)&link->frame.u_frame;
+        *len = link->frame.len;
 
 #if TINY_FD_DEBUG
         if ( (data[1] & HDLC_U_FRAME_MASK) == HDLC_U_FRAME_BITS )
@@ -688,26 +1757,50 @@ static uint8_t *tiny_fd_get_next_frame_to_send(tiny_fd_handle_t handle, int *len
         }
 #endif
     }
-    else if ( __has_non_sent_i_frames(handle) && ( handle->state == TINY_FD_STATE_CONNECTED_ABM || handle->state == TINY_FD_STATE_DISCONNECTING ) )
+    else if ( usable && __has_non_sent_i_frames(handle) &&
+              ( handle->state == TINY_FD_STATE_CONNECTED_ABM || handle->state == TINY_FD_STATE_DISCONNECTING ) &&
+              !__i_frame_is_open(handle) && !__i_frame_is_sending(handle, handle->frames.next_ns) &&
+              !handle->frames.i_frames[handle->frames.next_ns & handle->frames.slot_mask].expired )
     {
-        uint8_t i = __get_i_frame_to_send_index(handle) + handle->frames.head_ptr;
-        while ( i >= handle->frames.max_i_frames )
-            i -= handle->frames.max_i_frames;
-
-        data = (uint8_t *)&handle->frames.i_frames[i]->header;
-        *len = handle->frames.i_frames[i]->len + sizeof(tiny_frame_header_t);
-        handle->frames.i_frames[i]->header.address = 0xFF;
-        handle->frames.i_frames[i]->header.control = (handle->frames.next_ns << 1) | (handle->frames.next_nr << 5);
+        tiny_i_frame_slot_t *slot = __get_i_frame_slot(handle, handle->frames.next_ns);
+        data = (uint8_t *)&slot->header;
+        *info = &handle->frames.i_frames[handle->frames.next_ns & handle->frames.slot_mask];
+        *len = (*info)->len + sizeof(tiny_frame_header_t);
+        (*info)->sent = 1;
+        slot->header.address = __get_frame_address(handle, __get_bonding_ns(handle, handle->frames.next_ns));
+        slot->header.control = (handle->frames.next_ns << 1) | (handle->frames.next_nr << 5);
+        if ( __is_last_but_one_window_frame(handle, handle->frames.next_ns) )
+        {
+            // Remote side answers to P bit right away, so the window is not stalled till the next I-frame
+            // from remote side or retry timeout
+            slot->header.control |= HDLC_P_BIT;
+        }
         LOG(TINY_LOG_INFO, "[%p] Sending I-Frame N(R)=%02X,N(S)=%02X\n", handle, handle->frames.next_nr,
             handle->frames.next_ns);
+        link->ns = handle->frames.next_ns;
         handle->frames.next_ns++;
         handle->frames.next_ns &= seq_bits_mask;
+        STATS(handle->stats.tx_i_frames++);
         // Move to different place
         handle->frames.sent_nr = handle->frames.next_nr;
-        handle->frames.last_i_ts = tiny_millis();
-        handle->frames.last_ka_ts = tiny_millis();
+        handle->frames.last_i_ts = ts;
+        handle->frames.last_ka_ts = ts;
+    }
+    else if ( __is_bonded(handle) && handle->state == TINY_FD_STATE_CONNECTED_ABM &&
+              (uint32_t)(ts - link->last_tx_ts) >= handle->ka_timeout / 2 )
+    {
+        // Idle link sends probes, so remote side knows, the link is alive
+        link->frame.len = 2;
+        link->frame.s_frame.header.address = __get_frame_address(handle, 0);
+        link->frame.s_frame.header.control = HDLC_S_FRAME_BITS | HDLC_S_FRAME_TYPE_RR | (handle->frames.next_nr << 5);
+        data = (uint8_t *)&link->frame.s_frame;
+        *len = 2;
+    }
+    if ( data )
+    {
+        link->last_tx_ts = ts;
     }
-    tiny_mutex_unlock(&handle->frames.mutex);
+    __fd_unlock(handle);
     return data;
 }
 
@@ -715,7 +1808,7 @@ static uint8_t *tiny_fd_get_next_frame_to_send(tiny_fd_handle_t handle, int *len
 
 static void tiny_fd_connected_on_idle_timeout(tiny_fd_handle_t handle)
 {
-    tiny_mutex_lock(&handle->frames.mutex);
+    __fd_lock(handle);
     if ( __has_unconfirmed_frames(handle) && __all_frames_are_sent(handle) &&
          __time_passed_since_last_i_frame(handle) >= handle->retry_timeout )
     {
@@ -725,15 +1818,20 @@ static void tiny_fd_connected_on_idle_timeout(tiny_fd_handle_t handle)
             LOG(TINY_LOG_WRN,
                 "[%p] Timeout, resending unconfirmed frames: last(%" PRIu32 " ms, now(%" PRIu32 " ms), timeout(%" PRIu32
                 " ms))\n",
-                handle, handle->frames.last_i_ts, tiny_millis(), handle->retry_timeout);
+                handle, handle->frames.last_i_ts, __fd_millis(handle), handle->retry_timeout);
             handle->frames.retries--;
+            STATS(handle->stats.timeouts++);
+            CAPTURE_EVENT(handle, TINY_CAPTURE_TX, "Retry timeout, resending unconfirmed I-frames");
             // Do not use mutex for confirm_ns value as it is byte-value
             __resend_all_unconfirmed_frames(handle, 0, handle->frames.confirm_ns);
         }
         else
         {
-            LOG(TINY_LOG_CRIT, "[%p] Remote side not responding, flushing I-frames\n", handle);
-            __switch_to_disconnected_state(handle);
+            LOG(TINY_LOG_CRIT, "[%p] Remote side not responding\n", handle);
+            CAPTURE_EVENT(handle, TINY_CAPTURE_TX,
+                          handle->resume.valid ? "Remote side not responding, session is suspended"
+                                               : "Remote side not responding, I-frames are flushed");
+            __switch_to_suspended_state(handle);
         }
     }
     else if ( __time_passed_since_last_frame_received(handle) > handle->ka_timeout )
@@ -741,52 +1839,83 @@ static void tiny_fd_connected_on_idle_timeout(tiny_fd_handle_t handle)
         if ( !handle->frames.ka_confirmed )
         {
             LOG(TINY_LOG_CRIT, "[%p] No keep alive after timeout\n", handle);
-            __switch_to_disconnected_state(handle);
+            CAPTURE_EVENT(handle, TINY_CAPTURE_TX, "No keep alive answer, disconnected");
+            __switch_to_suspended_state(handle);
         }
         else
         {
             // Nothing to send, all frames are confirmed, just send keep alive
-            tiny_s_frame_info_t frame = {
-                .header.address = 0xFF,
-                .header.control = HDLC_S_FRAME_BITS | HDLC_S_FRAME_TYPE_RR | (handle->frames.next_nr << 5) | HDLC_P_BIT,
-            };
             handle->frames.ka_confirmed = 0;
-            __put_u_s_frame_to_tx_queue(handle, &frame, 2);
+            __put_s_frame(handle, HDLC_S_FRAME_TYPE_RR | HDLC_P_BIT);
         }
-        handle->frames.last_ka_ts = tiny_millis();
+        handle->frames.last_ka_ts = __fd_millis(handle);
     }
-    tiny_mutex_unlock(&handle->frames.mutex);
+    __fd_unlock(handle);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 static void tiny_fd_disconnected_on_idle_timeout(tiny_fd_handle_t handle)
 {
-    tiny_mutex_lock(&handle->frames.mutex);
+    __fd_lock(handle);
+    // Suspended session keeps its frames in the window, so it doesn't hurry
     if ( __time_passed_since_last_frame_received(handle) >= handle->retry_timeout ||
-         __number_of_awaiting_tx_i_frames(handle) > 0 )
+         (__number_of_awaiting_tx_i_frames(handle) > 0 && !handle->resume.valid) )
     {
         LOG(TINY_LOG_ERR, "[%p] ABM connection is not established\n", handle);
         // Try to establish ABM connection
-        tiny_u_frame_info_t frame = {
-            .header.address = 0xFF,
-            .header.control = HDLC_P_BIT | HDLC_U_FRAME_TYPE_SABM | HDLC_U_FRAME_BITS,
-        };
-        __put_u_s_frame_to_tx_queue(handle, &frame, 2);
-        handle->frames.last_ka_ts = tiny_millis();
+        __put_sabm_frame(handle);
+        // UA answer must be accepted, even if remote side doesn't send its own SABM
+        handle->state = TINY_FD_STATE_CONNECTING;
+        handle->frames.last_ka_ts = __fd_millis(handle);
     }
-    tiny_mutex_unlock(&handle->frames.mutex);
+    __fd_unlock(handle);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 int tiny_fd_get_tx_data(tiny_fd_handle_t handle, void *data, int len)
 {
+    return tiny_fd_get_tx_data_link(handle, 0, data, len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_get_tx_block(tiny_fd_handle_t handle, void *block, int size)
+{
+    if ( handle->links[0].hdlc->framing == HDLC_FRAMING_LENGTH || size < 0 )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    int len = tiny_fd_get_tx_data(handle, block, size);
+    if ( len < 0 )
+    {
+        return len;
+    }
+    memset((uint8_t *)block + len, TINY_HDLC_FILL_BYTE, size - len);
+    return len;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_get_tx_data_link(tiny_fd_handle_t handle, uint8_t link_index, void *data, int len)
+{
+    if ( link_index >= handle->link_count )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    tiny_fd_link_t *link = &handle->links[link_index];
     bool repeat = true;
     int result = 0;
     while ( result < len )
     {
         int generated_data = 0;
+#ifdef CONFIG_ENABLE_FD_JOURNAL
+        if ( handle->journal )
+        {
+            __move_frames_from_journal(handle);
+        }
+#endif
         if ( handle->state == TINY_FD_STATE_CONNECTED_ABM || handle->state == TINY_FD_STATE_DISCONNECTING )
         {
             tiny_fd_connected_on_idle_timeout(handle);
@@ -796,24 +1925,40 @@ int tiny_fd_get_tx_data(tiny_fd_handle_t handle, void *data, int len)
             tiny_fd_disconnected_on_idle_timeout(handle);
         }
         // Check if send on hdlc level operation is in progress and do some work
-        if ( tiny_events_wait(&handle->frames.events, FD_EVENT_TX_SENDING, EVENT_BITS_LEAVE, 0) )
+        if ( link->sending )
         {
-            generated_data = hdlc_ll_run_tx(handle->_hdlc, ((uint8_t *)data) + result, len - result);
+            generated_data = hdlc_ll_run_tx(link->hdlc, ((uint8_t *)data) + result, len - result);
         }
-        // Since no send operation is in progress, check if we have something to send
-        else if ( tiny_events_wait(&handle->frames.events, FD_EVENT_TX_DATA_AVAILABLE, EVENT_BITS_CLEAR, 0) )
+        // Since no send operation is in progress, check if we have something to send.
+        // Bonded links share the data available event, so each idle link checks the queue itself
+        else if ( __is_bonded(handle) || __fd_events_wait(handle, FD_EVENT_TX_DATA_AVAILABLE, EVENT_BITS_CLEAR, 0) )
         {
             int frame_len = 0;
-            uint8_t *frame_data = tiny_fd_get_next_frame_to_send(handle, &frame_len);
+            tiny_i_frame_info_t *info;
+            uint8_t *frame_data = tiny_fd_get_next_frame_to_send(handle, link, &frame_len, &info);
             if ( frame_data != NULL )
             {
                 // Force to check for new frame once again
-                tiny_events_set(&handle->frames.events, FD_EVENT_TX_DATA_AVAILABLE);
-                tiny_events_set(&handle->frames.events, FD_EVENT_TX_SENDING);
+                __fd_events_set(handle, FD_EVENT_TX_DATA_AVAILABLE);
+                link->sending = 1;
                 // Do not use timeout for hdlc_send(), as hdlc level is ready to accept next frame
-                // (FD_EVENT_TX_SENDING is not set). And at this step we do not need hdlc_send() to
+                // (link is not sending). And at this step we do not need hdlc_send() to
                 // send data.
-                hdlc_ll_put(handle->_hdlc, frame_data, frame_len);
+                if ( info )
+                {
+                    // Payload of the sending frame can't change, so its crc is calculated once,
+                    // and retransmissions pass only the rewritten header through crc
+                    if ( !info->crc_valid )
+                    {
+                        info->crc = hdlc_ll_get_crc(link->hdlc, frame_data + sizeof(tiny_frame_header_t), info->len);
+                        info->crc_valid = 1;
+                    }
+                    hdlc_ll_put_with_crc(link->hdlc, frame_data, frame_len, sizeof(tiny_frame_header_t), info->crc);
+                }
+                else
+                {
+                    hdlc_ll_put(link->hdlc, frame_data, frame_len);
+                }
             }
         }
         result += generated_data;
@@ -859,44 +2004,91 @@ int tiny_fd_run_tx(tiny_fd_handle_t handle, write_block_cb_t write_func)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+/* Full window may hold expired frames, so their slots are given to the new frame, even if tx side is idle */
+static uint8_t __wait_for_free_slot(tiny_fd_handle_t handle)
+{
+    if ( __number_of_awaiting_tx_i_frames(handle) >= handle->frames.max_i_frames )
+    {
+        __fd_lock(handle);
+        __drop_expired_i_frames(handle, false);
+        __fd_unlock(handle);
+    }
+    return __fd_events_wait(handle, FD_EVENT_QUEUE_HAS_FREE_SLOTS, EVENT_BITS_CLEAR, handle->send_timeout);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 int tiny_fd_send_packet(tiny_fd_handle_t handle, const void *data, int len)
+{
+    return tiny_fd_send_packet_ttl(handle, data, len, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_send_packet_ttl(tiny_fd_handle_t handle, const void *data, int len, uint32_t ttl)
 {
     int result;
     LOG(TINY_LOG_DEB, "[%p] PUT frame\n", handle);
     // Check frame size againts mtu
     // MTU doesn't include header and crc fields, only user payload
-    if ( len > handle->frames.mtu )
+    if ( __message_size(handle, len) > handle->frames.mtu )
     {
         LOG(TINY_LOG_ERR, "[%p] PUT frame error\n", handle);
         result = TINY_ERR_DATA_TOO_LARGE;
     }
+#ifdef CONFIG_ENABLE_FD_JOURNAL
+    else if ( handle->journal && ttl )
+    {
+        result = TINY_ERR_INVALID_DATA;
+    }
+    else if ( handle->journal )
+    {
+        // Journal accepts frames in any state, they are moved to the window by tx side
+        __fd_lock(handle);
+        result = tiny_journal_append(handle->journal, data, len);
+        __fd_unlock(handle);
+        if ( result == TINY_SUCCESS )
+        {
+            __fd_events_set(handle, FD_EVENT_TX_DATA_AVAILABLE);
+        }
+    }
+#endif
+    // Small message doesn't need new I-frame, if the last one is not sent yet
+    else if ( __add_message_to_open_i_frame(handle, data, len, ttl) )
+    {
+        result = TINY_SUCCESS;
+    }
     // Wait until there is room for new frame
-    else if ( tiny_events_wait(&handle->frames.events, FD_EVENT_QUEUE_HAS_FREE_SLOTS, EVENT_BITS_CLEAR,
-                               handle->send_timeout) )
+    else if ( __wait_for_free_slot(handle) )
     {
-        tiny_mutex_lock(&handle->frames.mutex);
+        __fd_lock(handle);
         // Check if space is actually available
-        if ( __put_i_frame_to_tx_queue(handle, data, len) )
+        result = __put_i_frame_to_tx_queue(handle, data, len, ttl);
+        if ( result == TINY_SUCCESS )
         {
             if ( __number_of_awaiting_tx_i_frames(handle) < handle->frames.max_i_frames )
             {
                 LOG(TINY_LOG_INFO, "[%p] I_QUEUE is N(S)queue=%d, N(S)confirm=%d, N(S)next=%d\n", handle,
                     handle->frames.last_ns, handle->frames.confirm_ns, handle->frames.next_ns);
-                tiny_events_set(&handle->frames.events, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
+                __fd_events_set(handle, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
             }
             else
             {
                 LOG(TINY_LOG_ERR, "[%p] I_QUEUE is full N(S)queue=%d, N(S)confirm=%d, N(S)next=%d\n", handle,
                     handle->frames.last_ns, handle->frames.confirm_ns, handle->frames.next_ns);
             }
-            result = TINY_SUCCESS;
+        }
+        else if ( result == TINY_ERR_BUSY )
+        {
+            // Window has free slots, but shared arena has not, or bonded link still sends from the slot
+            LOG(TINY_LOG_WRN, "[%p] No free slots\n", handle);
+            __fd_events_set(handle, FD_EVENT_QUEUE_HAS_FREE_SLOTS);
         }
         else
         {
-            result = TINY_ERR_TIMEOUT;
             LOG(TINY_LOG_ERR, "[%p] Wrong flag FD_EVENT_QUEUE_HAS_FREE_SLOTS\n", handle);
         }
-        tiny_mutex_unlock(&handle->frames.mutex);
+        __fd_unlock(handle);
     }
     else
     {
@@ -917,13 +2109,47 @@ int tiny_fd_buffer_size_by_mtu(int mtu, int window)
 
 int tiny_fd_buffer_size_by_mtu_ex(int mtu, int window, hdlc_crc_t crc_type)
 {
-    return sizeof(tiny_fd_data_t) +
+    return sizeof(tiny_fd_data_t) + sizeof(tiny_fd_link_t) +
+           // RX side
+           hdlc_ll_get_buf_size_ex(mtu + sizeof(tiny_frame_header_t), crc_type) +
+           // TX side, slots are aligned inside the buffer
+           (sizeof(tiny_i_frame_info_t) + FD_SLOT_SIZE(mtu)) * FD_SLOTS(window) + CONFIG_FD_SLOT_ALIGN - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_buffer_size_with_arena(int mtu, int window, hdlc_crc_t crc_type)
+{
+    return sizeof(tiny_fd_data_t) + sizeof(tiny_fd_link_t) +
            // RX side
            hdlc_ll_get_buf_size_ex(mtu + sizeof(tiny_frame_header_t), crc_type) +
-           // TX side
-           (sizeof(tiny_i_frame_info_t *) + sizeof(tiny_i_frame_info_t) + mtu -
-            sizeof(((tiny_i_frame_info_t *)0)->user_payload)) *
-               window;
+           // TX side keeps only metadata of frames
+           sizeof(tiny_i_frame_info_t) * FD_SLOTS(window);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_buffer_size_fec_overhead(int mtu, hdlc_crc_t crc_type, uint8_t fec_roots)
+{
+    return hdlc_ll_get_buf_size_fec(mtu + sizeof(tiny_frame_header_t), crc_type, fec_roots) -
+           hdlc_ll_get_buf_size_ex(mtu + sizeof(tiny_frame_header_t), crc_type);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_buffer_size_links_overhead(int mtu, hdlc_crc_t crc_type, uint8_t fec_roots, uint8_t links)
+{
+    if ( links <= 1 )
+    {
+        return 0;
+    }
+    return
+        // Each additional link has its own hdlc low level buffer, aligned inside the buffer
+        (links - 1) * (sizeof(tiny_fd_link_t) +
+                       hdlc_ll_get_buf_size_fec(mtu + sizeof(tiny_frame_header_t), crc_type, fec_roots) +
+                       CONFIG_FD_SLOT_ALIGN - 1) +
+        // Reorder slots
+        FD_REORDER_SLOTS * (sizeof(int) + FD_SLOT_SIZE(mtu)) + CONFIG_FD_SLOT_ALIGN - 1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -968,12 +2194,12 @@ int tiny_fd_get_status(tiny_fd_handle_t handle)
          return TINY_ERR_INVALID_DATA;
     }
     int result = TINY_ERR_FAILED;
-    tiny_mutex_lock(&handle->frames.mutex);
+    __fd_lock(handle);
     if ( (handle->state == TINY_FD_STATE_CONNECTED_ABM) || (handle->state == TINY_FD_STATE_DISCONNECTING) )
     {
         result = TINY_SUCCESS;
     }
-    tiny_mutex_unlock(&handle->frames.mutex);
+    __fd_unlock(handle);
     return result;
 }
 
@@ -986,12 +2212,12 @@ int tiny_fd_disconnect(tiny_fd_handle_t handle)
          return TINY_ERR_INVALID_DATA;
     }
     int result = TINY_SUCCESS;
-    tiny_mutex_lock(&handle->frames.mutex);
+    __fd_lock(handle);
     tiny_u_frame_info_t frame = {
         .header.address = 0xFF,
         .header.control = HDLC_U_FRAME_TYPE_DISC | HDLC_P_BIT | HDLC_U_FRAME_BITS,
     };
-    if ( !__put_u_s_frame_to_tx_queue(handle, &frame, 2) )
+    if ( !__put_u_frame_to_tx_queue(handle, &frame, 2) )
     {
         result = TINY_ERR_FAILED;
     }
@@ -999,9 +2225,39 @@ int tiny_fd_disconnect(tiny_fd_handle_t handle)
     {
         handle->state = TINY_FD_STATE_DISCONNECTING;
     }
-    tiny_mutex_unlock(&handle->frames.mutex);
+    __fd_unlock(handle);
     return result;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+int tiny_fd_get_stats(tiny_fd_handle_t handle, tiny_fd_stats_t *stats)
+{
+    if ( !handle || !stats )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+#ifdef CONFIG_ENABLE_STATS
+    __fd_lock(handle);
+    *stats = handle->stats;
+    if ( handle->frames.window_full )
+    {
+        // The window is still full, so the time of current stall is not accounted yet
+        stats->window_full_ms += (uint32_t)(__fd_millis(handle) - handle->frames.full_ts);
+    }
+    stats->fec_corrected = 0;
+    stats->fec_failed = 0;
+    for ( uint8_t i = 0; i < handle->link_count; i++ )
+    {
+        uint32_t corrected, failed;
+        hdlc_ll_get_fec_stats(handle->links[i].hdlc, &corrected, &failed);
+        stats->fec_corrected += corrected;
+        stats->fec_failed += failed;
+    }
+    __fd_unlock(handle);
+    return TINY_SUCCESS;
+#else
+    memset(stats, 0, sizeof(tiny_fd_stats_t));
+    return TINY_ERR_FAILED;
+#endif
+}
@@ -35,6 +35,10 @@ extern "C"
 
 #include <stdint.h>
 #include "proto/crc/crc.h"
+#include "proto/hdlc/low_level/hdlc.h"
+#include "proto/capture/tiny_capture.h"
+#include "proto/fd/tiny_fd_arena.h"
+#include "proto/journal/tiny_journal.h"
 #include "hal/tiny_types.h"
 
     /**
@@ -42,14 +46,84 @@ extern "C"
      * @{
      */
 
+    /** Maximum number of physical links, bonded to single protocol instance */
+#define TINY_FD_MAX_LINKS 4
+
+    /**
+     * Maximum window size for bonded links. Frames, sent over different links, arrive out of order,
+     * and receiver keeps frames ahead of N(R) in 8 reorder slots, indexed by 3 low bits of N(S).
+     * While the run of reordered frames is passed to the application, slots of up to a window of
+     * delivered frames are still referenced, and other links fill up to a window of slots ahead,
+     * so two windows must fit the reorder slots. Extended 7-bit sequence numbers of bonded links
+     * don't change this limit.
+     */
+#define TINY_FD_BONDING_MAX_WINDOW 4
+
+#ifndef CONFIG_FD_BATCH_SIZE
+/** Maximum number of messages, passed to batch callbacks at once. Batch is kept on the stack */
+#define CONFIG_FD_BATCH_SIZE 8
+#endif
+
     struct tiny_fd_data_t;
 
+    /**
+     * Message, passed to batch callbacks. Data are valid only until the callback returns.
+     */
+    typedef struct
+    {
+        uint8_t *data; ///< message payload
+        int len;       ///< size of message payload in bytes
+    } tiny_fd_message_t;
+
+    /**
+     * Callback, which receives several messages at once, see tiny_fd_init_t::on_frame_batch_cb.
+     * @param udata user data, tiny_fd_init_t::pdata
+     * @param messages array of messages in the order of sequence numbers
+     * @param count number of messages in the array
+     */
+    typedef void (*on_frames_cb_t)(void *udata, const tiny_fd_message_t *messages, int count);
+
     /**
      * This handle points to service data, required for full-duplex
      * functioning.
      */
     typedef struct tiny_fd_data_t *tiny_fd_handle_t;
 
+    /**
+     * Protocol statistics, collected if library is built with CONFIG_ENABLE_STATS.
+     * All counters are counted since tiny_fd_init() call.
+     */
+    typedef struct
+    {
+        /// Number of I-frames sent to the channel, including retransmissions
+        uint32_t tx_i_frames;
+        /// Number of I-frames received and passed to the application
+        uint32_t rx_i_frames;
+        /// Number of I-frames scheduled for retransmission, due to REJ or retry timeout
+        uint32_t retransmits;
+        /// Number of retry timeouts happened because of missing confirmation from remote side
+        uint32_t timeouts;
+        /// Number of frames received with crc mismatch
+        uint32_t crc_errors;
+        /// Number of I-frames received out of order and dropped
+        uint32_t out_of_order;
+        /// Number of REJ frames sent to the remote side
+        uint32_t rej_sent;
+        /// Number of bytes, corrected by forward error correction
+        uint32_t fec_corrected;
+        /// Number of frames, which forward error correction failed to correct
+        uint32_t fec_failed;
+        /// Number of I-frames received ahead of missing ones over bonded links and kept for in-order delivery
+        uint32_t reordered;
+        /// Number of sessions, resumed after connection loss without flushing the window
+        uint32_t resumes;
+        /// Total time in milliseconds, while all window slots were occupied by queued or unconfirmed I-frames,
+        /// including current period, if the window is full now
+        uint32_t window_full_ms;
+        /// Number of I-frames, dropped from tx queue before sending, because their deadline passed
+        uint32_t expired;
+    } tiny_fd_stats_t;
+
     /**
      * This structure is used for initialization of Tiny Full Duplex protocol.
      */
@@ -99,6 +173,7 @@ extern "C"
          * Number of frames in window, which confirmation may be deferred for. Must be at least 1. Maximum allowable
          * value is 7. Extended HDLC format (with 127 window size) is not yet supported.
          * Smaller values reduce channel throughput, while higher values require more RAM.
+         * TX frames are stored in the ring of power of 2 size, so windows 3, 5 and 6 take the same RAM as 4, 8 and 8.
          * It is not mandatory to have the same window_frames value on both endpoints.
          */
         uint8_t window_frames;
@@ -108,6 +183,135 @@ extern "C"
          * will automatically calculate mtu based on buffer_size, window_frames.
          */
         int mtu;
+
+        /**
+         * Optional platform functions for this instance: clock, mutex and events.
+         * If NULL, or some members are NULL, global platform functions are used (tiny_millis(),
+         * tiny_mutex_lock(), etc.). Allows to run the protocol on virtual time, for example in link
+         * simulators, or to use lock-free functions in single-threaded applications.
+         * The structure is not copied, and must stay valid until tiny_fd_close().
+         */
+        const tiny_platform_hal_t *hal;
+
+        /**
+         * Set this to non-zero value, if all protocol API functions, including tiny_fd_run_rx(),
+         * tiny_fd_run_tx() and tiny_fd_send_packet(), are called from the same thread.
+         * In this mode the protocol doesn't use mutex and events, and doesn't block in
+         * tiny_fd_send_packet(): if the queue is full, it returns TINY_ERR_TIMEOUT immediately.
+         */
+        uint8_t single_thread;
+
+        /**
+         * Optional capture object to record frames and protocol events (timeouts, retransmissions),
+         * see tiny_capture_init(). Frames are captured only if library is built with CONFIG_ENABLE_CAPTURE.
+         * Capture accepts records of each direction from single thread, so bonded links (see links field)
+         * can use capture only in single thread mode.
+         */
+        tiny_capture_handle_t capture;
+
+        /**
+         * Optional shared arena to take tx frame slots from, see tiny_fd_arena_init(). If set, the
+         * buffer doesn't hold tx frames and its size is calculated by tiny_fd_buffer_size_with_arena().
+         * mtu can't be bigger than mtu of the arena, and if mtu is zero, mtu of the arena is used.
+         * Library must be built with CONFIG_ENABLE_FD_ARENA.
+         */
+        tiny_fd_arena_handle_t arena;
+
+        /**
+         * Number of arena slots, reserved for this link. Other links can't take reserved slots, so the
+         * link always can send at least arena_reserve frames. Must be not greater than window_frames.
+         */
+        uint8_t arena_reserve;
+
+        /**
+         * Optional journal of outgoing frames, see tiny_journal_init(). If set, tiny_fd_send_packet()
+         * appends frames to the journal without waiting, even if the link is down, and the protocol sends
+         * them, when the connection is established. Frames are removed from the journal on acknowledgement.
+         * Library must be built with CONFIG_ENABLE_FD_JOURNAL.
+         */
+        tiny_journal_handle_t journal;
+
+        /**
+         * Set this to non-zero value to pack several small messages to single I-frame. Each message is
+         * prefixed by its length (1 byte for messages shorter than 128 bytes, 2 bytes for messages shorter
+         * than 16384 bytes, 3 bytes for longer ones), and the messages are added to the last I-frame,
+         * until it is sent. Remote side must enable aggregation too: it unpacks I-frames and calls
+         * on_frame_cb for each message.
+         * Maximum size of the message is mtu minus length prefix. Frames from the journal are not aggregated.
+         * Library must be built with CONFIG_ENABLE_FD_AGGREGATION.
+         */
+        uint8_t aggregation;
+
+        /**
+         * Time in milliseconds to keep I-frame open for new messages, if aggregation is enabled.
+         * If zero, the messages are added to I-frame only while it waits for the channel.
+         */
+        uint16_t aggregation_delay;
+
+        /**
+         * Number of Reed-Solomon parity bytes per block of the frame, see hdlc_ll_init_t::fec_roots.
+         * Receiver corrects up to fec_roots / 2 corrupted bytes per block without retransmission.
+         * 0 disables FEC. Both sides must use the same value. The buffer must be bigger
+         * by tiny_fd_buffer_size_fec_overhead() bytes.
+         */
+        uint8_t fec_roots;
+
+        /**
+         * Framing mode, see hdlc_ll_init_t::framing. HDLC_FRAMING_COBS keeps frame overhead constant
+         * for the payloads with many 0x7E and 0x7D bytes (compressed or encrypted data).
+         * HDLC_FRAMING_LENGTH removes escaping completely for reliable byte streams (TCP, pipes),
+         * sequencing and retransmissions of full duplex protocol work the same way on top of it.
+         * Both sides must use the same mode. Modes other than HDLC_FRAMING_ASYNC require library
+         * to be built with CONFIG_ENABLE_FRAMING.
+         */
+        hdlc_framing_t framing;
+
+        /**
+         * Number of physical links, bonded to the protocol instance, up to TINY_FD_MAX_LINKS. 0 means 1 link.
+         * I-frames are taken by the links, which are ready to send, so faster links carry more traffic.
+         * All links share single sequence space, and received frames are delivered in order.
+         * The address field of I- and S-frames extends N(S) and N(R) to 7 bits, so late copies of frames
+         * from slow links are not confused with new frames after 3-bit sequence numbers wrap.
+         * The link, which receives nothing during keep alive timeout, is not used until it gets alive.
+         * Each link is served by tiny_fd_get_tx_data_link() and tiny_fd_on_rx_data_link().
+         * Bonded links require window_frames not above TINY_FD_BONDING_MAX_WINDOW, don't work with
+         * shared arena, and the buffer must be bigger by tiny_fd_buffer_size_links_overhead() bytes.
+         * More than 1 link requires library to be built with CONFIG_ENABLE_FD_BONDING.
+         */
+        uint8_t links;
+
+        /**
+         * Set this to non-zero value to keep the session, when connection is lost because of keep alive
+         * timeout or retries exhaustion. Unconfirmed frames and sequence numbers are kept, and the application
+         * can queue new frames up to the window size. On reconnect both sides exchange N(R) in SABM and UA
+         * frames and continue from the frames, which remote side didn't receive. If remote side starts new
+         * session (for example, after restart), the window is flushed as usual. tiny_fd_disconnect() always
+         * flushes the window.
+         */
+        uint8_t resume;
+
+        /**
+         * Optional callback to process received messages in batches, used instead of on_frame_cb.
+         * All messages, received at once (aggregated I-frame, frames waiting for reordering), are passed
+         * in single call up to CONFIG_FD_BATCH_SIZE messages, so the protocol releases its lock once per batch
+         * instead of once per message. Callback is called from tiny_fd_run_rx() context.
+         */
+        on_frames_cb_t on_frame_batch_cb;
+
+        /**
+         * Optional callback to get notification of sent messages in batches, used instead of on_sent_cb.
+         * Cumulative acknowledgement of several I-frames is passed in single call up to CONFIG_FD_BATCH_SIZE
+         * messages. Callback is called from tiny_fd_run_rx() context.
+         */
+        on_frames_cb_t on_sent_batch_cb;
+
+        /**
+         * Optional callback to get notification of messages, dropped before sending, because their time
+         * to live passed, see tiny_fd_send_packet_ttl(). Callback is called from tiny_fd_run_tx() or
+         * tiny_fd_send_packet_ttl() context without the protocol lock, so it can call tiny_fd API functions,
+         * for example to send the message once again.
+         */
+        on_frame_cb_t on_expired_cb;
     } tiny_fd_init_t;
 
     /**
@@ -168,6 +372,35 @@ extern "C"
      */
     extern int tiny_fd_get_tx_data(tiny_fd_handle_t handle, void *data, int len);
 
+    /**
+     * @brief runs tx processing of specified physical link to fill buffer with data.
+     *
+     * The same as tiny_fd_get_tx_data(), but for the link, bonded to the protocol
+     * (see tiny_fd_init_t::links). tiny_fd_get_tx_data() serves the link 0.
+     *
+     * @param handle handle of full-duplex protocol
+     * @param link index of the link
+     * @param data pointer to buffer to fill with tx data
+     * @param len maximum size of specified buffer
+     * @return number of bytes written to specified buffer or TINY_ERR_INVALID_DATA for wrong link index
+     */
+    extern int tiny_fd_get_tx_data_link(tiny_fd_handle_t handle, uint8_t link, void *data, int len);
+
+    /**
+     * @brief fills fixed-size block for full duplex block transport.
+     *
+     * Block transports (SPI with DMA, for example) send and receive the blocks of the same size
+     * in each transaction. The function fills the block with tx data and pads the rest of the block
+     * with TINY_HDLC_FILL_BYTE. Received blocks are passed to tiny_fd_on_rx_block().
+     * Length-prefixed framing (HDLC_FRAMING_LENGTH) is not supported.
+     *
+     * @param handle handle of full-duplex protocol
+     * @param block pointer to the block to fill
+     * @param size size of the block in bytes
+     * @return number of tx data bytes in the block (the rest is padding), or TINY_ERR_INVALID_DATA
+     */
+    extern int tiny_fd_get_tx_block(tiny_fd_handle_t handle, void *block, int size);
+
     /**
      * @brief sends tx data to the communication channel via user callback `write_func()`.
      *
@@ -198,6 +431,32 @@ extern "C"
      */
     extern int tiny_fd_on_rx_data(tiny_fd_handle_t handle, const void *data, int len);
 
+    /**
+     * @brief runs rx bytes processing for specified physical link.
+     *
+     * The same as tiny_fd_on_rx_data(), but for the link, bonded to the protocol
+     * (see tiny_fd_init_t::links). tiny_fd_on_rx_data() serves the link 0.
+     *
+     * @param handle handle of full-duplex protocol
+     * @param link index of the link
+     * @param data pointer to data to process
+     * @param len length of data to process
+     * @return TINY_SUCCESS or TINY_ERR_INVALID_DATA for wrong link index
+     */
+    extern int tiny_fd_on_rx_data_link(tiny_fd_handle_t handle, uint8_t link, const void *data, int len);
+
+    /**
+     * @brief processes fixed-size block, received from full duplex block transport.
+     *
+     * Runs of fill bytes between frames are skipped at once. See tiny_fd_get_tx_block().
+     *
+     * @param handle handle of full-duplex protocol
+     * @param block pointer to received block
+     * @param size size of the block in bytes
+     * @return TINY_SUCCESS or TINY_ERR_INVALID_DATA
+     */
+    extern int tiny_fd_on_rx_block(tiny_fd_handle_t handle, const void *block, int size);
+
     /**
      * @brief reads rx data from the communication channel via user callback `read_func()`
      *
@@ -238,9 +497,31 @@ extern "C"
      *         * TINY_ERR_TIMEOUT      if no room in internal queue to put data. Retry operation once again.
      *         * TINY_ERR_FAILED       if request was cancelled, by tiny_fd_close() or other error happened.
      *         * TINY_ERR_DATA_TOO_LARGE if user data are too big to fit in tx buffer.
+     *         * TINY_ERR_BUSY         if shared arena has no free slots, journal is full, or bonded link still
+     *                                 sends the frame from the slot. Retry operation later.
      */
     extern int tiny_fd_send_packet(tiny_fd_handle_t handle, const void *buf, int len);
 
+    /**
+     * @brief Sends userdata, which are valid for limited time only.
+     *
+     * Works as tiny_fd_send_packet(), but the message expires in ttl milliseconds. Expired message,
+     * which was not passed to the channel yet, is dropped from the tx queue and reported via
+     * tiny_fd_init_t::on_expired_cb, so the link doesn't spend time on stale data after an outage.
+     * Later frames take sequence numbers of dropped ones. Message, which was sent at least once,
+     * is retransmitted as usual, since remote side may have received it. If aggregation is enabled,
+     * I-frame expires, when all its messages expire.
+     *
+     * @param handle   tiny_fd_handle_t handle
+     * @param buf      data to send
+     * @param len      length of data to send
+     * @param ttl      time to live in milliseconds. 0 means, that the message doesn't expire.
+     *
+     * @return Same result codes as tiny_fd_send_packet(), and TINY_ERR_INVALID_DATA if ttl is
+     *         specified for the protocol with journal: frames of the journal are always delivered.
+     */
+    extern int tiny_fd_send_packet_ttl(tiny_fd_handle_t handle, const void *buf, int len, uint32_t ttl);
+
     /**
      * Returns minimum required buffer size for specified parameters.
      *
@@ -260,6 +541,37 @@ extern "C"
      */
     extern int tiny_fd_buffer_size_by_mtu_ex(int mtu, int window, hdlc_crc_t crc_type);
 
+    /**
+     * Returns minimum required buffer size for the protocol, which takes tx frame slots from
+     * shared arena (see tiny_fd_init_t::arena).
+     *
+     * @param mtu size of desired user payload in bytes.
+     * @param window maximum tx queue size of I-frames.
+     * @param crc_type crc type to be used with FD protocol
+     */
+    extern int tiny_fd_buffer_size_with_arena(int mtu, int window, hdlc_crc_t crc_type);
+
+    /**
+     * Returns number of bytes to add to the buffer size, returned by tiny_fd_buffer_size_by_mtu_ex()
+     * or tiny_fd_buffer_size_with_arena(), if forward error correction is used (see tiny_fd_init_t::fec_roots).
+     *
+     * @param mtu size of desired user payload in bytes.
+     * @param crc_type crc type to be used with FD protocol
+     * @param fec_roots number of parity bytes per block
+     */
+    extern int tiny_fd_buffer_size_fec_overhead(int mtu, hdlc_crc_t crc_type, uint8_t fec_roots);
+
+    /**
+     * Returns number of bytes to add to the buffer size, returned by tiny_fd_buffer_size_by_mtu_ex()
+     * or tiny_fd_buffer_size_with_arena(), if several links are bonded (see tiny_fd_init_t::links).
+     *
+     * @param mtu size of desired user payload in bytes.
+     * @param crc_type crc type to be used with FD protocol
+     * @param fec_roots number of parity bytes per block
+     * @param links number of physical links
+     */
+    extern int tiny_fd_buffer_size_links_overhead(int mtu, hdlc_crc_t crc_type, uint8_t fec_roots, uint8_t links);
+
     /**
      * @brief returns max packet size in bytes.
      *
@@ -297,6 +609,16 @@ extern "C"
      */
     extern void tiny_fd_set_ka_timeout(tiny_fd_handle_t handle, uint32_t keep_alive);
 
+    /**
+     * Returns protocol statistics.
+     * @param handle   tiny_fd_handle_t handle
+     * @param stats    pointer to structure to fill
+     * @return TINY_SUCCESS in case of success
+     *         TINY_ERR_INVALID_DATA if arguments are invalid
+     *         TINY_ERR_FAILED if the library is built without CONFIG_ENABLE_STATS (stats are filled with zeros)
+     */
+    extern int tiny_fd_get_stats(tiny_fd_handle_t handle, tiny_fd_stats_t *stats);
+
     /**
      * @}
      */
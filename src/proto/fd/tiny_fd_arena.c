@@ -0,0 +1,168 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tiny_fd_arena.h"
+#include "tiny_fd_int.h"
+#include "hal/tiny_types.h"
+
+#include <string.h>
+
+struct tiny_fd_arena_t
+{
+    tiny_mutex_t mutex;
+    uint8_t *free_list; ///< free slots, each free slot keeps pointer to the next one
+    int mtu;
+    int slots;
+    int free_slots;
+    int reserved;    ///< sum of reserves of all attached links
+    int outstanding; ///< reserved slots, which are not taken by the links yet
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint8_t *__slots_start(void *buffer)
+{
+    uintptr_t ptr = (uintptr_t)buffer + sizeof(struct tiny_fd_arena_t);
+    return (uint8_t *)((ptr + CONFIG_FD_SLOT_ALIGN - 1) & ~(uintptr_t)(CONFIG_FD_SLOT_ALIGN - 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_arena_buffer_size(int mtu, int slots)
+{
+    return sizeof(struct tiny_fd_arena_t) + CONFIG_FD_SLOT_ALIGN - 1 + FD_SLOT_SIZE(mtu) * slots;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_arena_init(tiny_fd_arena_handle_t *arena, void *buffer, int buffer_size, int mtu)
+{
+    *arena = NULL;
+    if ( !buffer || mtu < 1 || buffer_size < tiny_fd_arena_buffer_size(mtu, 1) )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    struct tiny_fd_arena_t *data = (struct tiny_fd_arena_t *)buffer;
+    memset(data, 0, sizeof(struct tiny_fd_arena_t));
+    data->mtu = mtu;
+    data->slots = (buffer_size - (int)(__slots_start(buffer) - (uint8_t *)buffer)) / (int)FD_SLOT_SIZE(mtu);
+    data->free_slots = data->slots;
+    /* Build the list of free slots in address order */
+    uint8_t *slot = __slots_start(buffer) + FD_SLOT_SIZE(mtu) * data->slots;
+    for ( int i = 0; i < data->slots; i++ )
+    {
+        slot -= FD_SLOT_SIZE(mtu);
+        memcpy(slot, &data->free_list, sizeof(data->free_list));
+        data->free_list = slot;
+    }
+    tiny_mutex_create(&data->mutex);
+    *arena = data;
+    return TINY_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_fd_arena_close(tiny_fd_arena_handle_t arena)
+{
+    tiny_mutex_destroy(&arena->mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_arena_get_mtu(tiny_fd_arena_handle_t arena)
+{
+    return arena->mtu;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_arena_get_free_slots(tiny_fd_arena_handle_t arena)
+{
+    tiny_mutex_lock(&arena->mutex);
+    int free_slots = arena->free_slots;
+    tiny_mutex_unlock(&arena->mutex);
+    return free_slots;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_arena_attach(tiny_fd_arena_handle_t arena, uint8_t reserve)
+{
+    int result = TINY_SUCCESS;
+    tiny_mutex_lock(&arena->mutex);
+    if ( arena->reserved + reserve > arena->slots )
+    {
+        result = TINY_ERR_INVALID_DATA;
+    }
+    else
+    {
+        arena->reserved += reserve;
+        arena->outstanding += reserve;
+    }
+    tiny_mutex_unlock(&arena->mutex);
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_fd_arena_detach(tiny_fd_arena_handle_t arena, uint8_t reserve)
+{
+    tiny_mutex_lock(&arena->mutex);
+    arena->reserved -= reserve;
+    arena->outstanding -= reserve;
+    tiny_mutex_unlock(&arena->mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void *tiny_fd_arena_alloc(tiny_fd_arena_handle_t arena, uint8_t reserve, uint8_t held)
+{
+    uint8_t *slot = NULL;
+    tiny_mutex_lock(&arena->mutex);
+    // Reserved slot is always available. Over the reserve the link can take only slots, not reserved by others
+    bool reserved = held < reserve;
+    if ( arena->free_list && (reserved || arena->free_slots > arena->outstanding) )
+    {
+        slot = arena->free_list;
+        memcpy(&arena->free_list, slot, sizeof(arena->free_list));
+        arena->free_slots--;
+        if ( reserved )
+        {
+            arena->outstanding--;
+        }
+    }
+    tiny_mutex_unlock(&arena->mutex);
+    return slot;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_fd_arena_free(tiny_fd_arena_handle_t arena, void *slot, uint8_t reserve, uint8_t held)
+{
+    tiny_mutex_lock(&arena->mutex);
+    memcpy(slot, &arena->free_list, sizeof(arena->free_list));
+    arena->free_list = (uint8_t *)slot;
+    arena->free_slots++;
+    // held is number of slots, the link holds after returning this one
+    if ( held < reserve )
+    {
+        arena->outstanding++;
+    }
+    tiny_mutex_unlock(&arena->mutex);
+}
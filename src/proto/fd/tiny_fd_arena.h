@@ -0,0 +1,103 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ This is shared memory arena for Tiny Full-Duplex protocol instances
+
+ @file
+ @brief Shared arena of I-frame slots for many tiny_fd links
+*/
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @defgroup FD_ARENA_API Tiny Full Duplex shared arena functions
+ * @{
+ *
+ * @brief shared pool of tx frame slots
+ *
+ * @details By default each tiny_fd instance keeps window_frames tx slots of mtu size in its own buffer.
+ *          If application serves many links, which are idle most of time, the links can take tx slots
+ *          from shared arena instead: the slot is taken, when application puts the frame with
+ *          tiny_fd_send_packet(), and is returned to the arena, when remote side confirms the frame.
+ *          Each link can reserve some slots (see tiny_fd_init_t::arena_reserve): reserved slots
+ *          are not held by the link, but other links can't take them. The arena is thread-safe.
+ */
+
+struct tiny_fd_arena_t;
+
+/**
+ * Handle of shared arena
+ */
+typedef struct tiny_fd_arena_t *tiny_fd_arena_handle_t;
+
+/**
+ * Returns buffer size, required for the arena with specified number of slots.
+ *
+ * @param mtu maximum payload of the frame in bytes
+ * @param slots number of tx frame slots in the arena
+ */
+extern int tiny_fd_arena_buffer_size(int mtu, int slots);
+
+/**
+ * Initializes shared arena in the user buffer. The buffer is divided into slots
+ * of the same size.
+ *
+ * @param arena pointer to arena handle variable
+ * @param buffer buffer for the arena, see tiny_fd_arena_buffer_size()
+ * @param buffer_size size of the buffer in bytes
+ * @param mtu maximum payload of the frame in bytes. Links, using the arena, can't have bigger mtu.
+ * @return TINY_SUCCESS or TINY_ERR_INVALID_DATA if buffer is too small
+ */
+extern int tiny_fd_arena_init(tiny_fd_arena_handle_t *arena, void *buffer, int buffer_size, int mtu);
+
+/**
+ * Destroys the arena. All links, using the arena, must be closed before.
+ *
+ * @param arena arena handle
+ */
+extern void tiny_fd_arena_close(tiny_fd_arena_handle_t arena);
+
+/**
+ * Returns mtu of the arena slots
+ *
+ * @param arena arena handle
+ */
+extern int tiny_fd_arena_get_mtu(tiny_fd_arena_handle_t arena);
+
+/**
+ * Returns number of slots, not held by any link. The value includes slots, reserved by the links.
+ *
+ * @param arena arena handle
+ */
+extern int tiny_fd_arena_get_free_slots(tiny_fd_arena_handle_t arena);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
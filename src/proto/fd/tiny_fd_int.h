@@ -32,11 +32,27 @@ extern "C"
 #include "proto/hdlc/low_level/hdlc.h"
 #include "proto/hdlc/low_level/hdlc_int.h"
 #include "hal/tiny_types.h"
+#include "tiny_fd.h"
 
-#define FD_MIN_BUF_SIZE(mtu, window) ( (sizeof(tiny_fd_data_t) + \
-                                      HDLC_MIN_BUF_SIZE( mtu + sizeof(tiny_frame_header_t), HDLC_CRC_16 ) + \
-                                      ( sizeof(tiny_i_frame_info_t *) + sizeof(tiny_i_frame_info_t) + mtu \
-                                                                      - sizeof(((tiny_i_frame_info_t *)0)->user_payload) ) * window )
+#ifndef CONFIG_FD_SLOT_ALIGN
+/** Alignment of I-frame slots in the tx ring. Platforms with data cache should set it to cache line size */
+#define CONFIG_FD_SLOT_ALIGN sizeof(uintptr_t)
+#endif
+
+/** Number of I-frame slots in the tx ring: window size rounded up to power of 2 */
+#define FD_SLOTS(window) ( (window) <= 2 ? 2 : (window) <= 4 ? 4 : 8 )
+
+/** Size of single I-frame slot in the tx ring: frame header and payload, aligned to CONFIG_FD_SLOT_ALIGN */
+#define FD_SLOT_SIZE(mtu) ( ((mtu) + sizeof(tiny_frame_header_t) + CONFIG_FD_SLOT_ALIGN - 1) & \
+                            ~(size_t)(CONFIG_FD_SLOT_ALIGN - 1) )
+
+/** Number of reorder slots for bonded links: slot is selected by 3 low bits of N(S), see TINY_FD_BONDING_MAX_WINDOW */
+#define FD_REORDER_SLOTS 8
+
+#define FD_MIN_BUF_SIZE(mtu, window) ( sizeof(tiny_fd_data_t) + sizeof(tiny_fd_link_t) + \
+                                       HDLC_MIN_BUF_SIZE( mtu + sizeof(tiny_frame_header_t), HDLC_CRC_16 ) + \
+                                       ( sizeof(tiny_i_frame_info_t) + FD_SLOT_SIZE(mtu) ) * FD_SLOTS(window) + \
+                                       CONFIG_FD_SLOT_ALIGN - 1 )
 
     typedef enum
     {
@@ -65,12 +81,35 @@ extern "C"
         uint8_t data3;
     } tiny_u_frame_info_t;
 
+    /**
+     * I-frame slot in the tx ring. Slots have fixed stride FD_SLOT_SIZE(mtu).
+     */
     typedef struct
     {
-        uint8_t type; ///< 0 for now
-        int len;
         tiny_frame_header_t header; ///< header, fill every time, when user payload is sending
         uint8_t user_payload;       ///< this byte and all bytes after are user payload
+    } tiny_i_frame_slot_t;
+
+    /**
+     * Metadata of I-frame in the tx ring. Metadata is kept in separate compact array, so
+     * walking the window doesn't touch frame payloads.
+     */
+    typedef struct
+    {
+        int len; ///< length of user payload
+        union
+        {
+            int32_t journal_pos; ///< position of the frame in tx journal. Not used without journal
+            uint32_t deadline;   ///< time, when unsent frame expires. Frames from journal don't expire
+        };
+#ifdef CONFIG_ENABLE_FD_ARENA
+        tiny_i_frame_slot_t *slot; ///< slot, taken from shared arena. Not used without arena
+#endif
+        crc_t crc;                 ///< crc of user payload, so retransmissions pass only the header through crc
+        uint8_t crc_valid;         ///< crc field is calculated for current payload
+        uint8_t sent;              ///< frame was passed to the channel at least once, so its N(S) is known
+        uint8_t expires;           ///< deadline field is valid
+        uint8_t expired;           ///< deadline passed, the frame is reported to the application and waits for removal
     } tiny_i_frame_info_t;
 
     typedef struct
@@ -85,9 +124,17 @@ extern "C"
 
     typedef struct
     {
-        tiny_i_frame_info_t **i_frames;
-        uint8_t max_i_frames;
-        uint8_t head_ptr;
+        tiny_i_frame_info_t *i_frames; // metadata of tx frames, indexed by N(S) & slot_mask
+        uint8_t *i_slots;              // tx frame slots, indexed by N(S) & slot_mask
+        int slot_size;                 // stride of tx frame slots
+        uint8_t max_i_frames;          // window size
+        uint8_t slot_mask;             // number of slots (power of 2) minus 1
+
+#ifdef CONFIG_ENABLE_FD_ARENA
+        tiny_fd_arena_handle_t arena; // shared arena to take slots from, or NULL
+        uint8_t arena_reserve;        // number of slots, reserved for this link in the arena
+        uint8_t arena_held;           // number of slots, currently taken from the arena
+#endif
 
         int mtu;
 
@@ -98,46 +145,134 @@ extern "C"
         uint8_t next_ns;     // next frame to be sent
         uint8_t confirm_ns;  // next frame to be confirmed
         uint8_t last_ns;     // next free frame in cycle buffer
+#ifdef CONFIG_ENABLE_FD_BONDING
+        uint8_t next_seq;    // 7-bit N(R) of bonded links, extended with the address field
+        uint8_t confirm_seq; // 7-bit N(S) of the frame to be confirmed over bonded links
+#endif
 
         uint32_t last_i_ts;  // last sent I-frame timestamp
         uint32_t last_ka_ts; // last keep alive timestamp
+#ifdef CONFIG_ENABLE_STATS
+        uint32_t full_ts;    // timestamp, when the window became full
+        uint8_t window_full; // all slots of the window are occupied by queued or unconfirmed frames
+#endif
         uint8_t ka_confirmed;
 
-        uint8_t retries; // Number of retries to perform before timeout takes place
+        uint8_t retries;    // Number of retries to perform before timeout takes place
+        uint8_t event_bits; // events, used instead of events object in single thread mode
 
         tiny_events_t events;
     } tiny_frames_info_t;
 
+    /** Callback, which passes messages to the application one by one, or in batches */
+    typedef union
+    {
+        on_frame_cb_t single;  ///< called for every message
+        on_frames_cb_t batch;  ///< called for several messages at once
+    } tiny_fd_messages_cb_t;
+
+#define FD_BATCH_ON_FRAME 0x01
+#define FD_BATCH_ON_SENT 0x02
+
+    /**
+     * Physical link of the protocol. Each link has its own hdlc low level, and all links share
+     * the sequence space of the protocol.
+     */
+    typedef struct
+    {
+        hdlc_ll_handle_t hdlc;      ///< framing of the link
+        struct tiny_fd_data_t *fd;  ///< owner of the link, used in hdlc callbacks
+        uint32_t last_rx_ts;        ///< time, when the last valid frame was received from the link
+        uint32_t last_tx_ts;        ///< time, when the last frame was passed to hdlc of the link
+        tiny_frame_info_t frame;    ///< copy of S- or U-frame being sent
+        uint8_t sending;            ///< hdlc sends the frame
+        uint8_t ns;                 ///< N(S) of I-frame being sent, or FD_NO_NS
+    } tiny_fd_link_t;
+
     typedef struct tiny_fd_data_t
     {
-        /// hdlc information
-        hdlc_ll_handle_t _hdlc;
-        /// state of hdlc protocol according to ISO & RFC
-        tiny_fd_state_t state;
-        /// Callback to process received frames
-        on_frame_cb_t on_frame_cb;
-        /// Callback to get notification of sent frames
-        on_frame_cb_t on_sent_cb;
+        /// Physical links, the first one is used by tiny_fd_run_rx() and tiny_fd_run_tx()
+        tiny_fd_link_t *links;
+        /// Number of physical links
+        uint8_t link_count;
+        /// Number of retries to perform before timeout takes place
+        uint8_t retries;
         /// Timeout for operations with acknowledge
         uint16_t send_timeout;
         /// Timeout before retrying resend I-frames
         uint16_t retry_timeout;
         /// Timeout before sending keep alive HDLC frame (RR)
         uint16_t ka_timeout;
-        /// Number of retries to perform before timeout takes place
-        uint8_t retries;
+        /// Callback to process received frames
+        tiny_fd_messages_cb_t on_frame_cb;
+        /// Callback to get notification of sent frames
+        tiny_fd_messages_cb_t on_sent_cb;
+        /// Callback to get notification of frames, dropped because of expired deadline
+        on_frame_cb_t on_expired_cb;
         /// Information for frames being processed
         tiny_frames_info_t frames;
         struct
         {
-            tiny_frame_info_t queue[TINY_FD_U_QUEUE_MAX_SIZE];
+            tiny_frame_info_t queue[TINY_FD_U_QUEUE_MAX_SIZE]; ///< U-frames to send
             uint8_t queue_ptr;
             uint8_t queue_len;
+            uint8_t s_control; ///< control field of pending S-frame without N(R), 0 if there is no S-frame
         } s_u_frames;
+        /// Non-zero if mutex and events are not used
+        uint8_t single_thread;
+        /// Callbacks, which accept messages in batches: FD_BATCH_ON_FRAME, FD_BATCH_ON_SENT
+        uint8_t batch_cb;
+        /// Resumption of the session after connection loss
+        struct
+        {
+            uint8_t enabled; ///< connection loss keeps the window and sequence numbers
+            uint8_t valid;   ///< session was established and is not reset, so it can be resumed
+        } resume;
         /// user specific data
         void *user_data;
+#ifdef CONFIG_ENABLE_FD_JOURNAL
+        /// Journal of outgoing frames, or NULL
+        tiny_journal_handle_t journal;
+#endif
+#ifdef CONFIG_ENABLE_FD_AGGREGATION
+        /// Aggregation of small messages into I-frames
+        struct
+        {
+            uint8_t enabled;
+            uint8_t open;   ///< last queued I-frame accepts new messages
+            uint16_t delay; ///< time to keep I-frame open
+            uint32_t ts;    ///< time, when the open I-frame was queued
+        } aggregation;
+#endif
+#ifdef CONFIG_ENABLE_FD_BONDING
+        /// Reordering of I-frames, received over bonded links
+        struct
+        {
+            uint8_t *slots;     ///< payloads of received frames with FD_SLOT_SIZE(mtu) stride, followed by lengths
+            uint8_t filled;     ///< bit per N(S), set if the slot holds received frame
+            uint8_t delivering; ///< some link delivers frames to the application
+        } reorder;
+#endif
+        /// Platform functions used by this instance, never NULL. NULL members fall back to global functions
+        const tiny_platform_hal_t *hal;
+        /// state of hdlc protocol according to ISO & RFC
+        tiny_fd_state_t state;
+#ifdef CONFIG_ENABLE_STATS
+        /// Protocol statistics
+        tiny_fd_stats_t stats;
+#endif
+#ifdef CONFIG_ENABLE_CAPTURE
+        /// Capture object to record protocol events
+        tiny_capture_handle_t capture;
+#endif
     } tiny_fd_data_t;
 
+    /* Internal functions of shared arena, used by tiny_fd */
+    int tiny_fd_arena_attach(tiny_fd_arena_handle_t arena, uint8_t reserve);
+    void tiny_fd_arena_detach(tiny_fd_arena_handle_t arena, uint8_t reserve);
+    void *tiny_fd_arena_alloc(tiny_fd_arena_handle_t arena, uint8_t reserve, uint8_t held);
+    void tiny_fd_arena_free(tiny_fd_arena_handle_t arena, void *slot, uint8_t reserve, uint8_t held);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,575 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tiny_fd_runtime.h"
+#include "hal/tiny_types.h"
+
+#include <string.h>
+
+#define RT_NONE (-1)
+
+#define RT_EVENT_READY 0x01
+
+/*
+ * Session is always in one state. All fields of the session, except fd and callbacks,
+ * are protected by the mutex of the shard, which owns the session. Owner is changed
+ * only when both shards are locked.
+ */
+enum
+{
+    RT_SESSION_FREE = 0,
+    RT_SESSION_ARMED,   ///< in the timer wheel of the owner
+    RT_SESSION_QUEUED,  ///< in the run queue of the owner
+    RT_SESSION_RUNNING, ///< worker of the owner runs the session
+    RT_SESSION_PENDING, ///< the session is running, and it has new work
+};
+
+typedef struct
+{
+    int32_t head;
+    int32_t tail;
+} tiny_fd_runtime_list_t;
+
+typedef struct
+{
+    tiny_fd_handle_t fd;
+    read_block_cb_t read_func;
+    write_block_cb_t write_func;
+    void *pdata;
+    uint8_t tx_buf[CONFIG_FD_RUNTIME_IO_SIZE]; ///< tx data, which the channel didn't accept yet
+    int tx_len;                                ///< number of bytes in tx_buf
+    int tx_pos;                                ///< number of bytes of tx_buf, already written
+    uint32_t deadline; ///< time to run the session by the timer wheel
+    int32_t prev;
+    int32_t next;
+    uint8_t owner;
+    uint8_t state;
+} tiny_fd_runtime_session_t;
+
+typedef struct
+{
+    tiny_mutex_t mutex;
+    tiny_events_t events;
+    tiny_fd_runtime_list_t queue;
+    tiny_fd_runtime_list_t wheel[CONFIG_FD_RUNTIME_WHEEL_SIZE];
+    uint32_t wheel_tick; ///< last processed tick of the wheel
+    tiny_fd_runtime_stats_t stats;
+} tiny_fd_runtime_shard_t;
+
+struct tiny_fd_runtime_t
+{
+    tiny_mutex_t mutex;             ///< protects allocation of sessions
+    const tiny_platform_hal_t *hal; ///< platform functions of the runtime, never NULL
+    tiny_fd_runtime_shard_t *shards;
+    tiny_fd_runtime_session_t *sessions;
+    int max_sessions;
+    uint16_t tick;
+    uint16_t poll_interval;
+    uint8_t shard_count;
+    uint8_t next_shard; ///< shard for the next new session
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint32_t __rt_millis(tiny_fd_runtime_handle_t runtime)
+{
+    return TINY_HAL_FUNC(runtime->hal, millis)();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline void __rt_lock(tiny_fd_runtime_handle_t runtime, tiny_mutex_t *mutex)
+{
+    TINY_HAL_FUNC(runtime->hal, mutex_lock)(mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline void __rt_unlock(tiny_fd_runtime_handle_t runtime, tiny_mutex_t *mutex)
+{
+    TINY_HAL_FUNC(runtime->hal, mutex_unlock)(mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __list_push(tiny_fd_runtime_handle_t runtime, tiny_fd_runtime_list_t *list, int32_t index)
+{
+    tiny_fd_runtime_session_t *session = &runtime->sessions[index];
+    session->prev = list->tail;
+    session->next = RT_NONE;
+    if ( list->tail != RT_NONE )
+    {
+        runtime->sessions[list->tail].next = index;
+    }
+    else
+    {
+        list->head = index;
+    }
+    list->tail = index;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void __list_remove(tiny_fd_runtime_handle_t runtime, tiny_fd_runtime_list_t *list, int32_t index)
+{
+    tiny_fd_runtime_session_t *session = &runtime->sessions[index];
+    if ( session->prev != RT_NONE )
+    {
+        runtime->sessions[session->prev].next = session->next;
+    }
+    else
+    {
+        list->head = session->next;
+    }
+    if ( session->next != RT_NONE )
+    {
+        runtime->sessions[session->next].prev = session->prev;
+    }
+    else
+    {
+        list->tail = session->prev;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Bucket of the first tick, which is not before the deadline, so the session is due, when its bucket is visited */
+static inline tiny_fd_runtime_list_t *__wheel_bucket(tiny_fd_runtime_handle_t runtime, tiny_fd_runtime_shard_t *shard,
+                                                     uint32_t deadline)
+{
+    return &shard->wheel[((deadline + runtime->tick - 1) / runtime->tick) % CONFIG_FD_RUNTIME_WHEEL_SIZE];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Must be called with the shard mutex locked */
+static void __enqueue(tiny_fd_runtime_handle_t runtime, tiny_fd_runtime_shard_t *shard, int32_t index)
+{
+    tiny_fd_runtime_session_t *session = &runtime->sessions[index];
+    __list_push(runtime, &shard->queue, index);
+    session->state = RT_SESSION_QUEUED;
+    // Worker doesn't wait, while the queue is not empty, so only the first session wakes it up
+    if ( ++shard->stats.queued == 1 )
+    {
+        TINY_HAL_FUNC(runtime->hal, events_set)(&shard->events, RT_EVENT_READY);
+    }
+    else if ( shard->stats.queued == 2 && runtime->shard_count > 1 )
+    {
+        // The shard has backlog, so wake up the neighbour: if it is idle, it steals the session
+        TINY_HAL_FUNC(runtime->hal, events_set)(&runtime->shards[(session->owner + 1) % runtime->shard_count].events,
+                                                RT_EVENT_READY);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Must be called with the shard mutex locked */
+static void __unlink(tiny_fd_runtime_handle_t runtime, tiny_fd_runtime_shard_t *shard, int32_t index)
+{
+    tiny_fd_runtime_session_t *session = &runtime->sessions[index];
+    if ( session->state == RT_SESSION_QUEUED )
+    {
+        __list_remove(runtime, &shard->queue, index);
+        shard->stats.queued--;
+    }
+    else if ( session->state == RT_SESSION_ARMED )
+    {
+        __list_remove(runtime, __wheel_bucket(runtime, shard, session->deadline), index);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Must be called with the shard mutex locked */
+static void __expire_timers(tiny_fd_runtime_handle_t runtime, tiny_fd_runtime_shard_t *shard, uint32_t now)
+{
+    uint32_t tick = now / runtime->tick;
+    uint32_t steps = tick - shard->wheel_tick;
+    if ( steps > CONFIG_FD_RUNTIME_WHEEL_SIZE )
+    {
+        steps = CONFIG_FD_RUNTIME_WHEEL_SIZE;
+    }
+    for ( uint32_t i = 1; i <= steps; i++ )
+    {
+        tiny_fd_runtime_list_t *bucket = &shard->wheel[(shard->wheel_tick + i) % CONFIG_FD_RUNTIME_WHEEL_SIZE];
+        int32_t index = bucket->head;
+        while ( index != RT_NONE )
+        {
+            int32_t next = runtime->sessions[index].next;
+            // Sessions with long poll interval stay in the bucket for several turns of the wheel
+            if ( (int32_t)(now - runtime->sessions[index].deadline) >= 0 )
+            {
+                __list_remove(runtime, bucket, index);
+                __enqueue(runtime, shard, index);
+                shard->stats.timer_polls++;
+            }
+            index = next;
+        }
+    }
+    shard->wheel_tick = tick;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Locks the shard, which owns the session. Owner is read without the lock, and can change,
+ * while waiting for the lock, so it is checked once again under the lock.
+ */
+static tiny_fd_runtime_shard_t *__lock_owner(tiny_fd_runtime_handle_t runtime, tiny_fd_runtime_session_t *session)
+{
+    for ( ;; )
+    {
+        uint8_t owner = session->owner;
+        tiny_fd_runtime_shard_t *shard = &runtime->shards[owner];
+        __rt_lock(runtime, &shard->mutex);
+        if ( session->owner == owner )
+        {
+            return shard;
+        }
+        __rt_unlock(runtime, &shard->mutex);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Takes the last session from the run queue of another shard. The shard with single ready session
+ * will run it soon, so the session is not moved away from its core. Both mutexes are only tried,
+ * so two stealing workers never wait for each other.
+ */
+static int32_t __steal(tiny_fd_runtime_handle_t runtime, uint8_t thief)
+{
+    tiny_fd_runtime_shard_t *own = &runtime->shards[thief];
+    for ( uint8_t i = 1; i < runtime->shard_count; i++ )
+    {
+        uint8_t victim_index = (thief + i) % runtime->shard_count;
+        tiny_fd_runtime_shard_t *victim = &runtime->shards[victim_index];
+        if ( !TINY_HAL_FUNC(runtime->hal, mutex_try_lock)(&victim->mutex) )
+        {
+            continue;
+        }
+        int32_t index = RT_NONE;
+        if ( victim->stats.queued > 1 && TINY_HAL_FUNC(runtime->hal, mutex_try_lock)(&own->mutex) )
+        {
+            index = victim->queue.tail;
+            tiny_fd_runtime_session_t *session = &runtime->sessions[index];
+            __list_remove(runtime, &victim->queue, index);
+            victim->stats.queued--;
+            victim->stats.sessions--;
+            session->owner = thief;
+            session->state = RT_SESSION_RUNNING;
+            own->stats.sessions++;
+            own->stats.stolen++;
+            __rt_unlock(runtime, &own->mutex);
+        }
+        __rt_unlock(runtime, &victim->mutex);
+        if ( index != RT_NONE )
+        {
+            return index;
+        }
+    }
+    return RT_NONE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Writes tx data of the session. Returns 0, if the channel doesn't accept all bytes */
+static int __flush_tx(tiny_fd_runtime_session_t *session)
+{
+    while ( session->tx_pos < session->tx_len )
+    {
+        int result = session->write_func(session->pdata, session->tx_buf + session->tx_pos,
+                                         session->tx_len - session->tx_pos);
+        if ( result <= 0 )
+        {
+            // Channel is busy, unsent bytes are kept until the next run of the session
+            return 0;
+        }
+        session->tx_pos += result;
+    }
+    session->tx_len = 0;
+    session->tx_pos = 0;
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Returns non-zero, if the session used the whole budget and may have more work */
+static int __run_session(tiny_fd_runtime_session_t *session, tiny_fd_runtime_stats_t *stats)
+{
+    uint8_t buf[CONFIG_FD_RUNTIME_IO_SIZE];
+    for ( int i = 0; i < CONFIG_FD_RUNTIME_BUDGET; i++ )
+    {
+        int progress = 0;
+        int len = session->read_func(session->pdata, buf, sizeof(buf));
+        if ( len > 0 )
+        {
+            tiny_fd_on_rx_data(session->fd, buf, len);
+            stats->rx_bytes += len;
+            progress = 1;
+        }
+        // Blocked session waits for notification or the timer, so other sessions of the shard are served
+        if ( !__flush_tx(session) )
+        {
+            return 0;
+        }
+        len = tiny_fd_get_tx_data(session->fd, session->tx_buf, sizeof(session->tx_buf));
+        if ( len > 0 )
+        {
+            stats->tx_bytes += len;
+            progress = 1;
+            session->tx_len = len;
+            if ( !__flush_tx(session) )
+            {
+                return 0;
+            }
+        }
+        if ( !progress )
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_runtime_buffer_size(uint8_t shards, int sessions)
+{
+    return sizeof(struct tiny_fd_runtime_t) + sizeof(tiny_fd_runtime_shard_t) * shards +
+           sizeof(tiny_fd_runtime_session_t) * sessions;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_runtime_init(tiny_fd_runtime_handle_t *runtime, const tiny_fd_runtime_init_t *init)
+{
+    *runtime = NULL;
+    if ( !init->buffer || !init->shards || init->buffer_size < tiny_fd_runtime_buffer_size(init->shards, 1) )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    struct tiny_fd_runtime_t *data = (struct tiny_fd_runtime_t *)init->buffer;
+    memset(init->buffer, 0, init->buffer_size);
+    data->shards = (tiny_fd_runtime_shard_t *)(data + 1);
+    data->sessions = (tiny_fd_runtime_session_t *)(data->shards + init->shards);
+    data->max_sessions = (init->buffer_size - tiny_fd_runtime_buffer_size(init->shards, 0)) /
+                         (int)sizeof(tiny_fd_runtime_session_t);
+    data->shard_count = init->shards;
+    data->tick = init->tick ? init->tick : 1;
+    data->poll_interval = init->poll_interval ? init->poll_interval : 10;
+    if ( data->poll_interval < data->tick )
+    {
+        data->poll_interval = data->tick;
+    }
+    data->hal = init->hal ? init->hal : &tiny_platform_hal_default;
+    uint32_t tick = __rt_millis(data) / data->tick;
+    for ( uint8_t i = 0; i < data->shard_count; i++ )
+    {
+        tiny_fd_runtime_shard_t *shard = &data->shards[i];
+        TINY_HAL_FUNC(data->hal, mutex_create)(&shard->mutex);
+        TINY_HAL_FUNC(data->hal, events_create)(&shard->events);
+        shard->queue.head = shard->queue.tail = RT_NONE;
+        for ( int j = 0; j < CONFIG_FD_RUNTIME_WHEEL_SIZE; j++ )
+        {
+            shard->wheel[j].head = shard->wheel[j].tail = RT_NONE;
+        }
+        shard->wheel_tick = tick;
+    }
+    TINY_HAL_FUNC(data->hal, mutex_create)(&data->mutex);
+    *runtime = data;
+    return TINY_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_fd_runtime_close(tiny_fd_runtime_handle_t runtime)
+{
+    for ( uint8_t i = 0; i < runtime->shard_count; i++ )
+    {
+        TINY_HAL_FUNC(runtime->hal, events_destroy)(&runtime->shards[i].events);
+        TINY_HAL_FUNC(runtime->hal, mutex_destroy)(&runtime->shards[i].mutex);
+    }
+    TINY_HAL_FUNC(runtime->hal, mutex_destroy)(&runtime->mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_runtime_add(tiny_fd_runtime_handle_t runtime, tiny_fd_handle_t fd, read_block_cb_t read_func,
+                        write_block_cb_t write_func, void *pdata)
+{
+    if ( !fd || !read_func || !write_func )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    int result = TINY_ERR_FAILED;
+    __rt_lock(runtime, &runtime->mutex);
+    // Free session is not linked anywhere, so nobody else touches it
+    for ( int32_t index = 0; index < runtime->max_sessions; index++ )
+    {
+        tiny_fd_runtime_session_t *session = &runtime->sessions[index];
+        if ( session->state != RT_SESSION_FREE )
+        {
+            continue;
+        }
+        session->fd = fd;
+        session->read_func = read_func;
+        session->write_func = write_func;
+        session->pdata = pdata;
+        session->tx_len = 0;
+        session->tx_pos = 0;
+        session->owner = runtime->next_shard;
+        runtime->next_shard = (runtime->next_shard + 1) % runtime->shard_count;
+        tiny_fd_runtime_shard_t *shard = &runtime->shards[session->owner];
+        __rt_lock(runtime, &shard->mutex);
+        shard->stats.sessions++;
+        __enqueue(runtime, shard, index);
+        __rt_unlock(runtime, &shard->mutex);
+        result = index;
+        break;
+    }
+    __rt_unlock(runtime, &runtime->mutex);
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_runtime_remove(tiny_fd_runtime_handle_t runtime, int session_id)
+{
+    if ( session_id < 0 || session_id >= runtime->max_sessions )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    tiny_fd_runtime_session_t *session = &runtime->sessions[session_id];
+    int result = TINY_SUCCESS;
+    __rt_lock(runtime, &runtime->mutex);
+    tiny_fd_runtime_shard_t *shard = __lock_owner(runtime, session);
+    if ( session->state == RT_SESSION_FREE )
+    {
+        result = TINY_ERR_INVALID_DATA;
+    }
+    else if ( session->state == RT_SESSION_RUNNING || session->state == RT_SESSION_PENDING )
+    {
+        result = TINY_ERR_BUSY;
+    }
+    else
+    {
+        __unlink(runtime, shard, session_id);
+        session->state = RT_SESSION_FREE;
+        shard->stats.sessions--;
+    }
+    __rt_unlock(runtime, &shard->mutex);
+    __rt_unlock(runtime, &runtime->mutex);
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_fd_runtime_notify(tiny_fd_runtime_handle_t runtime, int session_id)
+{
+    if ( session_id < 0 || session_id >= runtime->max_sessions )
+    {
+        return;
+    }
+    tiny_fd_runtime_session_t *session = &runtime->sessions[session_id];
+    tiny_fd_runtime_shard_t *shard = __lock_owner(runtime, session);
+    switch ( session->state )
+    {
+        case RT_SESSION_ARMED:
+            __unlink(runtime, shard, session_id);
+            __enqueue(runtime, shard, session_id);
+            break;
+        case RT_SESSION_RUNNING:
+            // The worker checks new work, when the run is complete
+            session->state = RT_SESSION_PENDING;
+            break;
+        default: break;
+    }
+    __rt_unlock(runtime, &shard->mutex);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_runtime_run(tiny_fd_runtime_handle_t runtime, uint8_t shard_index, uint32_t timeout)
+{
+    if ( shard_index >= runtime->shard_count )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    tiny_fd_runtime_shard_t *shard = &runtime->shards[shard_index];
+    __rt_lock(runtime, &shard->mutex);
+    __expire_timers(runtime, shard, __rt_millis(runtime));
+    int32_t index = shard->queue.head;
+    if ( index != RT_NONE )
+    {
+        __list_remove(runtime, &shard->queue, index);
+        shard->stats.queued--;
+        runtime->sessions[index].state = RT_SESSION_RUNNING;
+    }
+    __rt_unlock(runtime, &shard->mutex);
+    if ( index == RT_NONE )
+    {
+        index = __steal(runtime, shard_index);
+    }
+    if ( index == RT_NONE )
+    {
+        if ( timeout )
+        {
+            // Wake up at least once per tick to serve the timer wheel and to look for sessions to steal
+            TINY_HAL_FUNC(runtime->hal, events_wait)(&shard->events, RT_EVENT_READY, EVENT_BITS_CLEAR,
+                                                     timeout < runtime->tick ? timeout : runtime->tick);
+        }
+        return 0;
+    }
+    // Session in running state is not touched by other shards, so it is run without the lock
+    tiny_fd_runtime_session_t *session = &runtime->sessions[index];
+    tiny_fd_runtime_stats_t stats = {0};
+    int more = __run_session(session, &stats);
+    __rt_lock(runtime, &shard->mutex);
+    shard->stats.runs++;
+    shard->stats.rx_bytes += stats.rx_bytes;
+    shard->stats.tx_bytes += stats.tx_bytes;
+    if ( more || session->state == RT_SESSION_PENDING )
+    {
+        __enqueue(runtime, shard, index);
+    }
+    else
+    {
+        session->deadline = __rt_millis(runtime) + runtime->poll_interval;
+        session->state = RT_SESSION_ARMED;
+        __list_push(runtime, __wheel_bucket(runtime, shard, session->deadline), index);
+    }
+    __rt_unlock(runtime, &shard->mutex);
+    return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_fd_runtime_get_stats(tiny_fd_runtime_handle_t runtime, uint8_t shard_index, tiny_fd_runtime_stats_t *stats)
+{
+    if ( shard_index >= runtime->shard_count )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    tiny_fd_runtime_shard_t *shard = &runtime->shards[shard_index];
+    __rt_lock(runtime, &shard->mutex);
+    *stats = shard->stats;
+    __rt_unlock(runtime, &shard->mutex);
+    return TINY_SUCCESS;
+}
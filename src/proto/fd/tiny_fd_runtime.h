@@ -0,0 +1,195 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ This is sharded runtime for many Tiny Full-Duplex protocol instances
+
+ @file
+ @brief Runtime, which serves many tiny_fd sessions by the pool of worker threads
+*/
+#pragma once
+
+#include "tiny_fd.h"
+#include "hal/tiny_types.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @defgroup FD_RUNTIME_API Tiny Full Duplex sharded runtime functions
+ * @{
+ *
+ * @brief runs thousands of tiny_fd sessions on several cores
+ *
+ * @details Each session (tiny_fd instance with its read and write functions) belongs to one shard.
+ *          Application creates a worker thread per shard, and each worker calls tiny_fd_runtime_run()
+ *          in a loop. The worker runs only sessions of its shard, so rx and tx of the session are
+ *          processed on the same core. Session is run, when application notifies the runtime about
+ *          new data with tiny_fd_runtime_notify(), and periodically by the timer wheel of the shard,
+ *          so protocol timeouts work. Idle worker steals ready sessions from the queues of other shards,
+ *          and stolen session stays in the new shard. The runtime is thread-safe.
+ */
+
+#ifndef CONFIG_FD_RUNTIME_WHEEL_SIZE
+/** Number of buckets in the timer wheel of each shard */
+#define CONFIG_FD_RUNTIME_WHEEL_SIZE 64
+#endif
+
+#ifndef CONFIG_FD_RUNTIME_BUDGET
+/** Maximum number of read/write cycles of the session per run, before other sessions of the shard get the core */
+#define CONFIG_FD_RUNTIME_BUDGET 8
+#endif
+
+#ifndef CONFIG_FD_RUNTIME_IO_SIZE
+/** Size of the stack buffer, used to pass data between read/write functions and the session */
+#define CONFIG_FD_RUNTIME_IO_SIZE 128
+#endif
+
+struct tiny_fd_runtime_t;
+
+/**
+ * Handle of sharded runtime
+ */
+typedef struct tiny_fd_runtime_t *tiny_fd_runtime_handle_t;
+
+/**
+ * Parameters of the runtime
+ */
+typedef struct
+{
+    /// buffer for the runtime, see tiny_fd_runtime_buffer_size()
+    void *buffer;
+    /// size of the buffer in bytes. Maximum number of sessions is calculated from the buffer size
+    int buffer_size;
+    /// number of shards, usually equal to the number of worker threads
+    uint8_t shards;
+    /// resolution of the timer wheel in milliseconds, 0 means 1 ms
+    uint16_t tick;
+    /// period of running idle session in milliseconds, 0 means 10 ms
+    uint16_t poll_interval;
+    /// optional platform functions of the runtime: clock for the timer wheel, mutexes and events of shards.
+    /// NULL, or NULL members, mean global platform functions. Must stay valid until tiny_fd_runtime_close()
+    const tiny_platform_hal_t *hal;
+} tiny_fd_runtime_init_t;
+
+/**
+ * Load of the shard
+ */
+typedef struct
+{
+    int sessions;         ///< number of sessions, owned by the shard
+    int queued;           ///< number of sessions, ready to run
+    uint32_t runs;        ///< number of session runs
+    uint32_t stolen;      ///< number of sessions, taken from other shards
+    uint32_t timer_polls; ///< number of runs, requested by the timer wheel
+    uint32_t rx_bytes;    ///< bytes, passed from read functions to sessions
+    uint32_t tx_bytes;    ///< bytes, passed from sessions to write functions
+} tiny_fd_runtime_stats_t;
+
+/**
+ * Returns buffer size, required for the runtime.
+ *
+ * @param shards number of shards
+ * @param sessions maximum number of sessions
+ */
+extern int tiny_fd_runtime_buffer_size(uint8_t shards, int sessions);
+
+/**
+ * Initializes the runtime in the user buffer.
+ *
+ * @param runtime pointer to runtime handle variable
+ * @param init parameters of the runtime
+ * @return TINY_SUCCESS or TINY_ERR_INVALID_DATA if parameters are wrong or buffer is too small
+ */
+extern int tiny_fd_runtime_init(tiny_fd_runtime_handle_t *runtime, const tiny_fd_runtime_init_t *init);
+
+/**
+ * Destroys the runtime. All worker threads must be stopped before.
+ *
+ * @param runtime runtime handle
+ */
+extern void tiny_fd_runtime_close(tiny_fd_runtime_handle_t runtime);
+
+/**
+ * Adds the session to the runtime. Shards get new sessions in turn. The session is run right away.
+ *
+ * @param runtime runtime handle
+ * @param fd initialized tiny_fd instance
+ * @param read_func function to read data of the session from the channel. Must not block.
+ * @param write_func function to write data of the session to the channel. Must not block: if the channel
+ *        is busy, it returns 0 (or negative error), and unsent bytes are written on the next run of the
+ *        session, after tiny_fd_runtime_notify() or poll_interval.
+ * @param pdata user data, passed to read_func and write_func
+ * @return session id (zero or positive) or TINY_ERR_FAILED if there is no free session slots
+ */
+extern int tiny_fd_runtime_add(tiny_fd_runtime_handle_t runtime, tiny_fd_handle_t fd, read_block_cb_t read_func,
+                               write_block_cb_t write_func, void *pdata);
+
+/**
+ * Removes the session from the runtime. After successful call tiny_fd instance can be closed.
+ *
+ * @param runtime runtime handle
+ * @param session session id, returned by tiny_fd_runtime_add()
+ * @return TINY_SUCCESS, TINY_ERR_BUSY if the session is being run by a worker at the moment (repeat the call),
+ *         or TINY_ERR_INVALID_DATA
+ */
+extern int tiny_fd_runtime_remove(tiny_fd_runtime_handle_t runtime, int session);
+
+/**
+ * Notifies the runtime, that the session has work to do: new data in the channel, or new messages
+ * to send. The session is put to the run queue of its shard.
+ *
+ * @param runtime runtime handle
+ * @param session session id, returned by tiny_fd_runtime_add()
+ */
+extern void tiny_fd_runtime_notify(tiny_fd_runtime_handle_t runtime, int session);
+
+/**
+ * Runs single ready session of the shard. If the shard has no ready sessions, the function
+ * tries to steal ready session from other shards, and then waits for notification up to
+ * timeout milliseconds. Worker thread of the shard calls this function in a loop.
+ *
+ * @param runtime runtime handle
+ * @param shard index of the shard
+ * @param timeout maximum time to wait in milliseconds
+ * @return 1 if a session was run, 0 if there was no work, or TINY_ERR_INVALID_DATA
+ */
+extern int tiny_fd_runtime_run(tiny_fd_runtime_handle_t runtime, uint8_t shard, uint32_t timeout);
+
+/**
+ * Returns load of the shard.
+ *
+ * @param runtime runtime handle
+ * @param shard index of the shard
+ * @param stats pointer to the structure to fill
+ * @return TINY_SUCCESS or TINY_ERR_INVALID_DATA
+ */
+extern int tiny_fd_runtime_get_stats(tiny_fd_runtime_handle_t runtime, uint8_t shard, tiny_fd_runtime_stats_t *stats);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
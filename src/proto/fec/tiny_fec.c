@@ -0,0 +1,254 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tiny_fec.h"
+#include "hal/tiny_types.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/* GF(256) with polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11D). Exponent table is doubled to avoid modulo */
+
+static const uint8_t s_gf_exp[512] = {
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26,
+    0x4C, 0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0,
+    0x9D, 0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23,
+    0x46, 0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1,
+    0x5F, 0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0,
+    0xFD, 0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2,
+    0xD9, 0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE,
+    0x81, 0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC,
+    0x85, 0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54,
+    0xA8, 0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73,
+    0xE6, 0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF,
+    0xE3, 0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41,
+    0x82, 0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6,
+    0x51, 0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09,
+    0x12, 0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16,
+    0x2C, 0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01,
+    0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26, 0x4C,
+    0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0x9D,
+    0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23, 0x46,
+    0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1, 0x5F,
+    0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0, 0xFD,
+    0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2, 0xD9,
+    0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE, 0x81,
+    0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC, 0x85,
+    0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54, 0xA8,
+    0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73, 0xE6,
+    0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF, 0xE3,
+    0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41, 0x82,
+    0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6, 0x51,
+    0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09, 0x12,
+    0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16, 0x2C,
+    0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01, 0x02,
+};
+
+static const uint8_t s_gf_log[256] = {
+    0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1A, 0xC6, 0x03, 0xDF, 0x33, 0xEE, 0x1B, 0x68, 0xC7, 0x4B,
+    0x04, 0x64, 0xE0, 0x0E, 0x34, 0x8D, 0xEF, 0x81, 0x1C, 0xC1, 0x69, 0xF8, 0xC8, 0x08, 0x4C, 0x71,
+    0x05, 0x8A, 0x65, 0x2F, 0xE1, 0x24, 0x0F, 0x21, 0x35, 0x93, 0x8E, 0xDA, 0xF0, 0x12, 0x82, 0x45,
+    0x1D, 0xB5, 0xC2, 0x7D, 0x6A, 0x27, 0xF9, 0xB9, 0xC9, 0x9A, 0x09, 0x78, 0x4D, 0xE4, 0x72, 0xA6,
+    0x06, 0xBF, 0x8B, 0x62, 0x66, 0xDD, 0x30, 0xFD, 0xE2, 0x98, 0x25, 0xB3, 0x10, 0x91, 0x22, 0x88,
+    0x36, 0xD0, 0x94, 0xCE, 0x8F, 0x96, 0xDB, 0xBD, 0xF1, 0xD2, 0x13, 0x5C, 0x83, 0x38, 0x46, 0x40,
+    0x1E, 0x42, 0xB6, 0xA3, 0xC3, 0x48, 0x7E, 0x6E, 0x6B, 0x3A, 0x28, 0x54, 0xFA, 0x85, 0xBA, 0x3D,
+    0xCA, 0x5E, 0x9B, 0x9F, 0x0A, 0x15, 0x79, 0x2B, 0x4E, 0xD4, 0xE5, 0xAC, 0x73, 0xF3, 0xA7, 0x57,
+    0x07, 0x70, 0xC0, 0xF7, 0x8C, 0x80, 0x63, 0x0D, 0x67, 0x4A, 0xDE, 0xED, 0x31, 0xC5, 0xFE, 0x18,
+    0xE3, 0xA5, 0x99, 0x77, 0x26, 0xB8, 0xB4, 0x7C, 0x11, 0x44, 0x92, 0xD9, 0x23, 0x20, 0x89, 0x2E,
+    0x37, 0x3F, 0xD1, 0x5B, 0x95, 0xBC, 0xCF, 0xCD, 0x90, 0x87, 0x97, 0xB2, 0xDC, 0xFC, 0xBE, 0x61,
+    0xF2, 0x56, 0xD3, 0xAB, 0x14, 0x2A, 0x5D, 0x9E, 0x84, 0x3C, 0x39, 0x53, 0x47, 0x6D, 0x41, 0xA2,
+    0x1F, 0x2D, 0x43, 0xD8, 0xB7, 0x7B, 0xA4, 0x76, 0xC4, 0x17, 0x49, 0xEC, 0x7F, 0x0C, 0x6F, 0xF6,
+    0x6C, 0xA1, 0x3B, 0x52, 0x29, 0x9D, 0x55, 0xAA, 0xFB, 0x60, 0x86, 0xB1, 0xBB, 0xCC, 0x3E, 0x5A,
+    0xCB, 0x59, 0x5F, 0xB0, 0x9C, 0xA9, 0xA0, 0x51, 0x0B, 0xF5, 0x16, 0xEB, 0x7A, 0x75, 0x2C, 0xD7,
+    0x4F, 0xAE, 0xD5, 0xE9, 0xE6, 0xE7, 0xAD, 0xE8, 0x74, 0xD6, 0xF4, 0xEA, 0xA8, 0x50, 0x58, 0xAF,
+};
+
+static inline uint8_t gf_mul(uint8_t a, uint8_t b)
+{
+    return (a && b) ? s_gf_exp[s_gf_log[a] + s_gf_log[b]] : 0;
+}
+
+static inline uint8_t gf_div(uint8_t a, uint8_t b)
+{
+    return a ? s_gf_exp[s_gf_log[a] + 255 - s_gf_log[b]] : 0;
+}
+
+/* Evaluates polynomial p[0] + p[1] x + ... at x = a^e */
+static uint8_t gf_poly_eval(const uint8_t *p, int degree, int e)
+{
+    uint8_t result = 0;
+    for ( int i = degree; i >= 0; i-- )
+    {
+        result = gf_mul(result, s_gf_exp[e]) ^ p[i];
+    }
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void tiny_fec_generator(uint8_t *gen, int roots)
+{
+    memset(gen, 0, roots + 1);
+    gen[0] = 1;
+    // gen(x) = (x - a^0)(x - a^1)...(x - a^(roots-1))
+    for ( int i = 0; i < roots; i++ )
+    {
+        for ( int j = i + 1; j > 0; j-- )
+        {
+            gen[j] = gen[j - 1] ^ gf_mul(gen[j], s_gf_exp[i]);
+        }
+        gen[0] = gf_mul(gen[0], s_gf_exp[i]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void tiny_fec_encode(uint8_t *parity, const uint8_t *gen, int roots, const uint8_t *data, int len)
+{
+    // parity[0] is the highest coefficient of the remainder, it is sent first
+    while ( len-- )
+    {
+        uint8_t feedback = *data++ ^ parity[0];
+        for ( int i = 0; i < roots - 1; i++ )
+        {
+            parity[i] = parity[i + 1] ^ gf_mul(feedback, gen[roots - 1 - i]);
+        }
+        parity[roots - 1] = gf_mul(feedback, gen[0]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int tiny_fec_decode(uint8_t *block, int len, int roots)
+{
+    uint8_t syndromes[TINY_FEC_MAX_ROOTS];
+    uint8_t lambda[TINY_FEC_MAX_ROOTS + 1] = {1};
+    uint8_t prev[TINY_FEC_MAX_ROOTS + 1] = {1};
+    uint8_t omega[TINY_FEC_MAX_ROOTS];
+    if ( roots <= 0 || roots > TINY_FEC_MAX_ROOTS || len <= roots || len > TINY_FEC_BLOCK_SIZE )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    // Byte block[i] is coefficient of x^(len - 1 - i)
+    bool has_errors = false;
+    for ( int j = 0; j < roots; j++ )
+    {
+        uint8_t s = 0;
+        for ( int i = 0; i < len; i++ )
+        {
+            s = gf_mul(s, s_gf_exp[j]) ^ block[i];
+        }
+        syndromes[j] = s;
+        has_errors |= s != 0;
+    }
+    if ( !has_errors )
+    {
+        return 0;
+    }
+    // Berlekamp-Massey: error locator polynomial lambda
+    int errors = 0;
+    int shift = 1;
+    uint8_t prev_discrepancy = 1;
+    for ( int n = 0; n < roots; n++ )
+    {
+        uint8_t d = syndromes[n];
+        for ( int i = 1; i <= errors; i++ )
+        {
+            d ^= gf_mul(lambda[i], syndromes[n - i]);
+        }
+        if ( d == 0 )
+        {
+            shift++;
+            continue;
+        }
+        uint8_t coef = gf_div(d, prev_discrepancy);
+        if ( 2 * errors <= n )
+        {
+            uint8_t temp[TINY_FEC_MAX_ROOTS + 1];
+            memcpy(temp, lambda, sizeof(temp));
+            for ( int i = shift; i <= roots; i++ )
+            {
+                lambda[i] ^= gf_mul(coef, prev[i - shift]);
+            }
+            memcpy(prev, temp, sizeof(prev));
+            errors = n + 1 - errors;
+            prev_discrepancy = d;
+            shift = 1;
+        }
+        else
+        {
+            for ( int i = shift; i <= roots; i++ )
+            {
+                lambda[i] ^= gf_mul(coef, prev[i - shift]);
+            }
+            shift++;
+        }
+    }
+    if ( 2 * errors > roots )
+    {
+        return TINY_ERR_FAILED;
+    }
+    // Error evaluator omega(x) = S(x) * lambda(x) mod x^roots
+    for ( int i = 0; i < roots; i++ )
+    {
+        omega[i] = 0;
+        for ( int j = 0; j <= i && j <= errors; j++ )
+        {
+            omega[i] ^= gf_mul(syndromes[i - j], lambda[j]);
+        }
+    }
+    // Chien search and Forney algorithm. Position i has locator X = a^(len - 1 - i)
+    int found = 0;
+    for ( int i = 0; i < len && found < errors; i++ )
+    {
+        int x = len - 1 - i;
+        int x_inv = (255 - x) % 255;
+        if ( gf_poly_eval(lambda, errors, x_inv) != 0 )
+        {
+            continue;
+        }
+        // Formal derivative of lambda contains odd coefficients only
+        uint8_t derivative = 0;
+        for ( int j = 1; j <= errors; j += 2 )
+        {
+            derivative ^= gf_mul(lambda[j], s_gf_exp[(x_inv * (j - 1)) % 255]);
+        }
+        uint8_t magnitude = gf_poly_eval(omega, roots - 1, x_inv);
+        if ( derivative == 0 || magnitude == 0 )
+        {
+            return TINY_ERR_FAILED;
+        }
+        block[i] ^= gf_mul(s_gf_exp[x], gf_div(magnitude, derivative));
+        found++;
+    }
+    // Number of roots must match degree of the locator, otherwise there are too many errors
+    return found == errors ? errors : TINY_ERR_FAILED;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int tiny_fec_overhead(int len, int roots)
+{
+    if ( roots <= 0 )
+    {
+        return 0;
+    }
+    int block = TINY_FEC_BLOCK_SIZE - roots;
+    return roots * ((len + block - 1) / block);
+}
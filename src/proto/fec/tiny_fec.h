@@ -0,0 +1,98 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ This is Reed-Solomon forward error correction for Tiny Protocol
+
+ @file
+ @brief Reed-Solomon codec over GF(256) for frame level error correction
+*/
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @defgroup FEC_API Forward error correction functions
+     * @{
+     *
+     * @brief Reed-Solomon codec over GF(256)
+     *
+     * @details The frame is divided into blocks of up to 255 - roots data bytes, and each block
+     *          is followed by roots parity bytes. The decoder corrects up to roots / 2 corrupted
+     *          bytes in each block. Field polynomial is 0x11D, generator roots are a^0 ... a^(roots-1).
+     *          Hdlc low level uses these functions, if library is built with CONFIG_ENABLE_FEC
+     *          (see hdlc_ll_init_t::fec_roots).
+     */
+
+/** Maximum number of parity bytes per block */
+#define TINY_FEC_MAX_ROOTS 32
+
+/** Maximum size of the block including parity bytes */
+#define TINY_FEC_BLOCK_SIZE 255
+
+    /**
+     * Calculates generator polynomial. gen[i] is coefficient of x^i.
+     *
+     * @param gen buffer of roots + 1 bytes to store polynomial
+     * @param roots number of parity bytes, up to TINY_FEC_MAX_ROOTS
+     */
+    extern void tiny_fec_generator(uint8_t *gen, int roots);
+
+    /**
+     * Updates parity bytes of the block with new data. Parity must be initialized by zeros
+     * before the first byte of the block. The function can be called many times for the same block.
+     *
+     * @param parity parity bytes of the block
+     * @param gen generator polynomial, see tiny_fec_generator()
+     * @param roots number of parity bytes
+     * @param data data bytes
+     * @param len number of data bytes
+     */
+    extern void tiny_fec_encode(uint8_t *parity, const uint8_t *gen, int roots, const uint8_t *data, int len);
+
+    /**
+     * Corrects errors in the block in place.
+     *
+     * @param block data bytes, followed by roots parity bytes
+     * @param len size of the block including parity, up to TINY_FEC_BLOCK_SIZE
+     * @param roots number of parity bytes
+     * @return number of corrected bytes, or negative value if the block can't be corrected
+     */
+    extern int tiny_fec_decode(uint8_t *block, int len, int roots);
+
+    /**
+     * Returns number of parity bytes, added to the frame of specified size.
+     *
+     * @param len size of the frame
+     * @param roots number of parity bytes per block, 0 if FEC is not used
+     */
+    extern int tiny_fec_overhead(int len, int roots);
+
+    /**
+     * @}
+     */
+
+#ifdef __cplusplus
+}
+#endif
@@ -20,9 +20,11 @@
 #include "hdlc.h"
 #include "hdlc_int.h"
 #include "proto/crc/crc.h"
+#include "proto/fec/tiny_fec.h"
 #include "hal/tiny_debug.h"
 
 #include <stddef.h>
+#include <string.h>
 
 #ifndef TINY_HDLC_DEBUG
 #define TINY_HDLC_DEBUG 0
@@ -38,6 +40,12 @@
 #define FILL_BYTE 0xFF
 #define TINY_ESCAPE_CHAR 0x7D
 #define TINY_ESCAPE_BIT 0x20
+#define COBS_DELIMITER 0x00
+#define COBS_MAX_RUN 254
+#define LENGTH_HEADER_SIZE 2
+#define LENGTH_MAX_FRAME 0xFFFF
+/* Decoder keeps last bits in the accumulator, because they can be the beginning of the closing flag: 0 and five 1 */
+#define SYNC_FLAG_BITS 6
 
 enum
 {
@@ -50,12 +58,30 @@ enum
 static int hdlc_ll_read_start(hdlc_ll_handle_t handle, const uint8_t *data, int len);
 static int hdlc_ll_read_data(hdlc_ll_handle_t handle, const uint8_t *data, int len);
 static int hdlc_ll_read_end(hdlc_ll_handle_t handle, const uint8_t *data, int len);
+#ifdef CONFIG_ENABLE_FRAMING
+static int hdlc_ll_read_cobs_data(hdlc_ll_handle_t handle, const uint8_t *data, int len);
+static int hdlc_ll_read_length(hdlc_ll_handle_t handle, const uint8_t *data, int len);
+static int hdlc_ll_read_length_data(hdlc_ll_handle_t handle, const uint8_t *data, int len);
+static int hdlc_ll_read_sync(hdlc_ll_handle_t handle, const uint8_t *data, int len);
+#endif
+static void hdlc_ll_read_wait_frame(hdlc_ll_handle_t handle);
 
 static int hdlc_ll_send_start(hdlc_ll_handle_t handle);
 static int hdlc_ll_send_data(hdlc_ll_handle_t handle);
 static int hdlc_ll_send_tx_internal(hdlc_ll_handle_t handle, const void *data, int len);
 static int hdlc_ll_send_crc(hdlc_ll_handle_t handle);
 static int hdlc_ll_send_end(hdlc_ll_handle_t handle);
+#ifdef CONFIG_ENABLE_FRAMING
+static int hdlc_ll_send_cobs_code(hdlc_ll_handle_t handle);
+static int hdlc_ll_send_cobs_data(hdlc_ll_handle_t handle);
+static int hdlc_ll_send_length_header(hdlc_ll_handle_t handle);
+static int hdlc_ll_send_length_data(hdlc_ll_handle_t handle);
+static int hdlc_ll_send_sync(hdlc_ll_handle_t handle);
+#endif
+static void hdlc_ll_send_complete(hdlc_ll_handle_t handle);
+#ifdef CONFIG_ENABLE_FEC
+static int hdlc_ll_send_parity(hdlc_ll_handle_t handle);
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -75,6 +101,64 @@ int hdlc_ll_init(hdlc_ll_handle_t *handle, hdlc_ll_init_t *init)
     (*handle)->on_frame_read = init->on_frame_read;
     (*handle)->on_frame_sent = init->on_frame_sent;
     (*handle)->user_data = init->user_data;
+#ifdef CONFIG_ENABLE_CAPTURE
+    (*handle)->capture = init->capture;
+#endif
+    (*handle)->framing = init->framing;
+    if ( init->framing != HDLC_FRAMING_ASYNC && init->framing != HDLC_FRAMING_COBS &&
+         init->framing != HDLC_FRAMING_LENGTH && init->framing != HDLC_FRAMING_SYNC )
+    {
+        LOG(TINY_LOG_ERR, "[HDLC] failed to init hdlc. Unknown framing %i\n", init->framing);
+        *handle = NULL;
+        return TINY_ERR_INVALID_DATA;
+    }
+#ifndef CONFIG_ENABLE_FRAMING
+    if ( init->framing != HDLC_FRAMING_ASYNC )
+    {
+        LOG(TINY_LOG_ERR, "[HDLC] failed to init hdlc. Library is built without framing %i support\n", init->framing);
+        *handle = NULL;
+        return TINY_ERR_INVALID_DATA;
+    }
+#endif
+    if ( init->fec_roots && init->framing != HDLC_FRAMING_ASYNC )
+    {
+        LOG(TINY_LOG_ERR, "[HDLC] failed to init hdlc. FEC requires async framing\n");
+        *handle = NULL;
+        return TINY_ERR_INVALID_DATA;
+    }
+#ifdef CONFIG_ENABLE_FEC
+    if ( init->fec_roots > TINY_FEC_MAX_ROOTS )
+    {
+        LOG(TINY_LOG_ERR, "[HDLC] failed to init hdlc. Too many fec roots %i\n", init->fec_roots);
+        *handle = NULL;
+        return TINY_ERR_INVALID_DATA;
+    }
+    (*handle)->fec.roots = init->fec_roots;
+    (*handle)->fec.corrected = 0;
+    (*handle)->fec.failed = 0;
+    if ( init->fec_roots )
+    {
+        // Generator polynomial and parity bytes are located before rx buffer
+        int fec_size = 2 * init->fec_roots + 1;
+        if ( (*handle)->rx_buf_size < fec_size )
+        {
+            *handle = NULL;
+            return TINY_ERR_FAILED;
+        }
+        (*handle)->fec.gen = (uint8_t *)(*handle)->rx_buf;
+        (*handle)->fec.parity = (*handle)->fec.gen + init->fec_roots + 1;
+        (*handle)->rx_buf = (uint8_t *)(*handle)->rx_buf + fec_size;
+        (*handle)->rx_buf_size -= fec_size;
+        tiny_fec_generator((*handle)->fec.gen, init->fec_roots);
+    }
+#else
+    if ( init->fec_roots )
+    {
+        LOG(TINY_LOG_ERR, "[HDLC] failed to init hdlc. Library is built without FEC support\n");
+        *handle = NULL;
+        return TINY_ERR_INVALID_DATA;
+    }
+#endif
 
     // Must be last
     hdlc_ll_reset(*handle, HDLC_LL_RESET_BOTH);
@@ -102,7 +186,10 @@ void hdlc_ll_reset(hdlc_ll_handle_t handle, uint8_t flags)
 {
     if ( flags != HDLC_LL_RESET_TX_ONLY )
     {
-        handle->rx.state = hdlc_ll_read_start;
+#ifdef CONFIG_ENABLE_FRAMING
+        memset(&handle->rx.sync, 0, sizeof(handle->rx.sync));
+#endif
+        hdlc_ll_read_wait_frame(handle);
     }
     if ( flags != HDLC_LL_RESET_RX_ONLY )
     {
@@ -115,37 +202,158 @@ void hdlc_ll_reset(hdlc_ll_handle_t handle, uint8_t flags)
 
 ////////////////////////////////////////////////////////////////////////////////////////
 
-static int hdlc_ll_send_start(hdlc_ll_handle_t handle)
+static inline void hdlc_ll_fec_encode(hdlc_ll_handle_t handle, const uint8_t *data, int len)
 {
-    // Do not clear data ready bit here in case if 0x7F is failed to be sent
-    if ( !handle->tx.origin_data )
+#ifdef CONFIG_ENABLE_FEC
+    if ( handle->fec.roots )
     {
-        LOG(TINY_LOG_DEB, "[HDLC:%p] SENDING START NO DATA READY\n", handle);
-        return 0;
+        tiny_fec_encode(handle->fec.parity, handle->fec.gen, handle->fec.roots, data, len);
+        handle->fec.block_left -= len;
     }
-    LOG(TINY_LOG_INFO, "[HDLC:%p] Starting send op for HDLC frame\n", handle);
-    switch ( handle->crc_type )
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static inline void hdlc_ll_fec_start_block(hdlc_ll_handle_t handle)
+{
+#ifdef CONFIG_ENABLE_FEC
+    if ( handle->fec.roots )
+    {
+        memset(handle->fec.parity, 0, handle->fec.roots);
+        handle->fec.parity_pos = 0;
+        handle->fec.block_left = TINY_FEC_BLOCK_SIZE - handle->fec.roots;
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+/* Switches to sending parity bytes, if the block is full or if the frame is complete */
+static inline void hdlc_ll_fec_end_block(hdlc_ll_handle_t handle, bool end_of_frame)
+{
+#ifdef CONFIG_ENABLE_FEC
+    if ( handle->fec.roots &&
+         (handle->fec.block_left == 0 ||
+          (end_of_frame && handle->fec.block_left != TINY_FEC_BLOCK_SIZE - handle->fec.roots)) )
+    {
+        handle->fec.next_state = handle->tx.state;
+        handle->tx.state = hdlc_ll_send_parity;
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static crc_t hdlc_ll_calc_crc(hdlc_crc_t crc_type, const uint8_t *data, int len)
+{
+    switch ( crc_type )
+    {
+#ifdef CONFIG_ENABLE_FCS16
+        case HDLC_CRC_16: return crc16(PPPINITFCS16, data, len);
+#endif
+#ifdef CONFIG_ENABLE_FCS32
+        case HDLC_CRC_32: return crc32(PPPINITFCS32, data, len);
+#endif
+#ifdef CONFIG_ENABLE_CHECKSUM
+        case HDLC_CRC_8: return chksum(INITCHECKSUM, data, len) & 0x00FF;
+#endif
+        default: return 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+/* Returns crc of concatenated blocks from crc values of both blocks */
+static crc_t hdlc_ll_combine_crc(hdlc_crc_t crc_type, crc_t crc1, crc_t crc2, int len2)
+{
+    switch ( crc_type )
     {
 #ifdef CONFIG_ENABLE_FCS16
-        case HDLC_CRC_16: handle->tx.crc = crc16(PPPINITFCS16, handle->tx.data, handle->tx.len); break;
+        case HDLC_CRC_16: return crc16_combine(crc1, crc2, len2);
 #endif
 #ifdef CONFIG_ENABLE_FCS32
-        case HDLC_CRC_32: handle->tx.crc = crc32(PPPINITFCS32, handle->tx.data, handle->tx.len); break;
+        case HDLC_CRC_32: return crc32_combine(crc1, crc2, len2);
 #endif
 #ifdef CONFIG_ENABLE_CHECKSUM
-        case HDLC_CRC_8: handle->tx.crc = chksum(INITCHECKSUM, handle->tx.data, handle->tx.len); break;
+        case HDLC_CRC_8: return chksum_combine(crc1, crc2) & 0x00FF;
+#endif
+        default: return 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+/* Reads little-endian crc field */
+static inline crc_t hdlc_ll_read_crc(const uint8_t *field, int size)
+{
+    crc_t crc = 0;
+    while ( size-- )
+    {
+        crc = (crc << 8) | field[size];
+    }
+    return crc;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static inline uint8_t hdlc_ll_delimiter(hdlc_ll_handle_t handle)
+{
+    return handle->framing == HDLC_FRAMING_COBS ? COBS_DELIMITER : FLAG_SEQUENCE;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_send_start(hdlc_ll_handle_t handle)
+{
+    // Do not clear data ready bit here in case if 0x7F is failed to be sent
+    if ( !handle->tx.origin_data )
+    {
+        LOG(TINY_LOG_DEB, "[HDLC:%p] SENDING START NO DATA READY\n", handle);
+        return 0;
+    }
+#ifdef CONFIG_ENABLE_CAPTURE
+    tiny_capture_frame(handle->capture, TINY_CAPTURE_TX, handle->tx.data, handle->tx.len, 0);
 #endif
-        default: break;
+    LOG(TINY_LOG_INFO, "[HDLC:%p] Starting send op for HDLC frame\n", handle);
+#ifdef CONFIG_ENABLE_FRAMING
+    handle->tx.crc_len = (uint8_t)handle->crc_type / 8;
+    if ( handle->framing == HDLC_FRAMING_LENGTH )
+    {
+        handle->tx.run = 0;
+        handle->tx.state = hdlc_ll_send_length_header;
+        return hdlc_ll_send_length_header(handle);
+    }
+    if ( handle->framing == HDLC_FRAMING_SYNC )
+    {
+        // Opening flag is put to the accumulator as is, without bit stuffing
+        handle->tx.sync.bits = FLAG_SEQUENCE;
+        handle->tx.sync.nbits = 8;
+        handle->tx.sync.ones = 0;
+        handle->tx.sync.flag = 0;
+        handle->tx.state = hdlc_ll_send_sync;
+        return hdlc_ll_send_sync(handle);
     }
+#endif
 
-    uint8_t buf[1] = {FLAG_SEQUENCE};
+    uint8_t buf[1] = {hdlc_ll_delimiter(handle)};
     int result = hdlc_ll_send_tx_internal(handle, buf, sizeof(buf));
     if ( result == 1 )
     {
         LOG(TINY_LOG_DEB, "[HDLC:%p] hdlc_ll_send_data\n", handle);
         LOG(TINY_LOG_DEB, "[HDLC:%p] TX: %02X\n", handle, buf[0]);
-        handle->tx.state = hdlc_ll_send_data;
         handle->tx.escape = 0;
+#ifdef CONFIG_ENABLE_FRAMING
+        if ( handle->framing == HDLC_FRAMING_COBS )
+        {
+            handle->tx.state = hdlc_ll_send_cobs_code;
+        }
+        else
+#endif
+        {
+            handle->tx.state = hdlc_ll_send_data;
+            hdlc_ll_fec_start_block(handle);
+        }
     }
     return result;
 }
@@ -162,7 +370,15 @@ static int hdlc_ll_send_data(hdlc_ll_handle_t handle)
     //    return 0;
     //}
     int pos = 0;
-    while ( handle->tx.data[pos] != FLAG_SEQUENCE && handle->tx.data[pos] != TINY_ESCAPE_CHAR && pos < handle->tx.len )
+    int max_len = handle->tx.len;
+#ifdef CONFIG_ENABLE_FEC
+    // Parity bytes are inserted after each block
+    if ( handle->fec.roots && max_len > handle->fec.block_left )
+    {
+        max_len = handle->fec.block_left;
+    }
+#endif
+    while ( pos < max_len && handle->tx.data[pos] != FLAG_SEQUENCE && handle->tx.data[pos] != TINY_ESCAPE_CHAR )
     {
         pos++;
     }
@@ -176,6 +392,7 @@ static int hdlc_ll_send_data(hdlc_ll_handle_t handle)
             for ( int i = 0; i < result; i++ )
                 LOG(TINY_LOG_DEB, "[HDLC:%p] TX: %02X\n", handle, handle->tx.data[i]);
 #endif
+            hdlc_ll_fec_encode(handle, handle->tx.data, result);
             handle->tx.data += result;
             handle->tx.len -= result;
         }
@@ -190,6 +407,7 @@ static int hdlc_ll_send_data(hdlc_ll_handle_t handle)
             handle->tx.escape = !handle->tx.escape;
             if ( !handle->tx.escape )
             {
+                hdlc_ll_fec_encode(handle, handle->tx.data, 1);
                 handle->tx.data++;
                 handle->tx.len--;
             }
@@ -200,6 +418,7 @@ static int hdlc_ll_send_data(hdlc_ll_handle_t handle)
         LOG(TINY_LOG_DEB, "[HDLC:%p] hdlc_ll_send_crc\n", handle);
         handle->tx.state = hdlc_ll_send_crc;
     }
+    hdlc_ll_fec_end_block(handle, false);
     return result;
 }
 
@@ -211,6 +430,7 @@ static int hdlc_ll_send_crc(hdlc_ll_handle_t handle)
     if ( handle->tx.len == (uint8_t)handle->crc_type )
     {
         handle->tx.state = hdlc_ll_send_end;
+        hdlc_ll_fec_end_block(handle, true);
     }
     else
     {
@@ -221,7 +441,9 @@ static int hdlc_ll_send_crc(hdlc_ll_handle_t handle)
             if ( result == 1 )
             {
                 LOG(TINY_LOG_DEB, "[HDLC:%p] TX: %02X\n", handle, byte);
+                hdlc_ll_fec_encode(handle, &byte, 1);
                 handle->tx.len += 8;
+                hdlc_ll_fec_end_block(handle, false);
             }
         }
         else
@@ -234,7 +456,10 @@ static int hdlc_ll_send_crc(hdlc_ll_handle_t handle)
                 handle->tx.escape = !handle->tx.escape;
                 if ( !handle->tx.escape )
                 {
+                    byte = handle->tx.crc >> handle->tx.len;
+                    hdlc_ll_fec_encode(handle, &byte, 1);
                     handle->tx.len += 8;
+                    hdlc_ll_fec_end_block(handle, false);
                 }
             }
         }
@@ -244,225 +469,905 @@ static int hdlc_ll_send_crc(hdlc_ll_handle_t handle)
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
-static int hdlc_ll_send_end(hdlc_ll_handle_t handle)
-{
-    LOG(TINY_LOG_DEB, "[HDLC:%p] hdlc_ll_send_end\n", handle);
-    uint8_t buf[1] = {FLAG_SEQUENCE};
-    int result = hdlc_ll_send_tx_internal(handle, buf, sizeof(buf));
-    if ( result == 1 )
-    {
-        LOG(TINY_LOG_DEB, "[HDLC:%p] TX: %02X\n", handle, buf[0]);
-        LOG(TINY_LOG_INFO, "[HDLC:%p] hdlc_ll_send_end HDLC send op successful\n", handle);
-        handle->tx.state = hdlc_ll_send_start;
-        handle->tx.escape = 0;
-        int len = (int)(handle->tx.data - handle->tx.origin_data);
-        const void *ptr = handle->tx.origin_data;
-        handle->tx.origin_data = NULL;
-        handle->tx.data = NULL;
-        if ( handle->on_frame_sent )
-        {
-            handle->on_frame_sent(handle->user_data, ptr, len);
-        }
-    }
-    return result;
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////
-
-static int hdlc_ll_send_tx_internal(hdlc_ll_handle_t handle, const void *data, int len)
+#ifdef CONFIG_ENABLE_FEC
+static int hdlc_ll_send_parity(hdlc_ll_handle_t handle)
 {
-    const uint8_t *ptr = (const uint8_t *)data;
-    int sent = 0;
-    while ( len-- && handle->tx.out_buffer_len )
+    int result = 1;
+    if ( handle->fec.parity_pos == handle->fec.roots )
     {
-        handle->tx.out_buffer[0] = ptr[0];
-        handle->tx.out_buffer_len--;
-        handle->tx.out_buffer++;
-        ptr++;
-        sent++;
+        hdlc_ll_fec_start_block(handle);
+        handle->tx.state = handle->fec.next_state;
     }
-    return sent;
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////
-
-int hdlc_ll_run_tx(hdlc_ll_handle_t handle, void *data, int len)
-{
-    bool repeated_empty_data = false;
-    handle->tx.out_buffer = (uint8_t *)data;
-    handle->tx.out_buffer_len = len;
-    while ( handle->tx.out_buffer_len )
+    else
     {
-        int result = handle->tx.state(handle);
-        if ( result < 0 )
-        {
-#if TINY_HDLC_DEBUG
-            LOG(TINY_LOG_ERR, "[HDLC:%p] failed to run state with result: %d\n", handle, result);
-#endif
-            /*
-             * Some error happened. For we do not pass error code to upper layer.
-             * Passing error code as the result of this function can confuse user code. So
-             * need some other way to do that
-             */
-            break;
-        }
-        else if ( result == 0 )
+        uint8_t byte = handle->fec.parity[handle->fec.parity_pos];
+        if ( byte != TINY_ESCAPE_CHAR && byte != FLAG_SEQUENCE )
         {
-            /*
-             * Some tx state functions may return zero result, just in case of switching between states.
-             * Exiting in this case can cause tx user buffer to be underfilled. To avoid that, just check
-             * twice to ensure that we do not have more data to send.
-             */
-            if ( repeated_empty_data )
+            result = hdlc_ll_send_tx_internal(handle, &byte, sizeof(byte));
+            if ( result == 1 )
             {
-                break;
+                LOG(TINY_LOG_DEB, "[HDLC:%p] TX: %02X\n", handle, byte);
+                handle->fec.parity_pos++;
             }
-            repeated_empty_data = true;
         }
         else
         {
-            repeated_empty_data = false;
+            byte = handle->tx.escape ? (byte ^ TINY_ESCAPE_BIT) : TINY_ESCAPE_CHAR;
+            result = hdlc_ll_send_tx_internal(handle, &byte, sizeof(byte));
+            if ( result == 1 )
+            {
+                LOG(TINY_LOG_DEB, "[HDLC:%p] TX: %02X\n", handle, byte);
+                handle->tx.escape = !handle->tx.escape;
+                if ( !handle->tx.escape )
+                {
+                    handle->fec.parity_pos++;
+                }
+            }
         }
     }
-    return len - handle->tx.out_buffer_len;
+    return result;
 }
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
-int hdlc_ll_put(hdlc_ll_handle_t handle, const void *data, int len)
+#ifdef CONFIG_ENABLE_FRAMING
+/* Returns byte of the frame (payload followed by crc field) at specified offset from current position */
+static inline uint8_t hdlc_ll_tx_byte(hdlc_ll_handle_t handle, int offset)
 {
-    LOG(TINY_LOG_DEB, "[HDLC:%p] hdlc_ll_put\n", handle);
-    if ( !len || !data || !handle )
-    {
-        return TINY_ERR_INVALID_DATA;
-    }
-    // Check if TX thread is ready to accept new data
-    if ( handle->tx.origin_data )
+    if ( offset < handle->tx.len )
     {
-        LOG(TINY_LOG_WRN, "[HDLC:%p] hdlc_ll_put FAILED\n", handle);
-        return TINY_ERR_BUSY;
+        return handle->tx.data[offset];
     }
-    LOG(TINY_LOG_DEB, "[HDLC:%p] hdlc_ll_put SUCCESS\n", handle);
-    handle->tx.origin_data = data;
-    handle->tx.data = data;
-    handle->tx.len = len;
-    return TINY_SUCCESS;
+    offset += (uint8_t)handle->crc_type / 8 - handle->tx.crc_len - handle->tx.len;
+    return (uint8_t)(handle->tx.crc >> (offset * 8));
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
-static int hdlc_ll_read_start(hdlc_ll_handle_t handle, const uint8_t *data, int len)
+/* Skips zero byte, encoded by the code byte of the block */
+static inline void hdlc_ll_cobs_skip_zero(hdlc_ll_handle_t handle)
 {
-    if ( !len )
+    if ( handle->tx.len )
     {
-        return 0;
+        handle->tx.data++;
+        handle->tx.len--;
     }
-    if ( data[0] != FLAG_SEQUENCE )
+    else
     {
-        if ( data[0] != FILL_BYTE )
-        {
-            // TODO: Skip byte, but we received some wrong data
-        }
-        return 1;
+        handle->tx.crc_len--;
     }
-    LOG(TINY_LOG_DEB, "[HDLC:%p] RX: %02X\n", handle, data[0]);
-    handle->rx.escape = 0;
-    handle->rx.data = (uint8_t *)handle->rx_buf;
-    handle->rx.state = hdlc_ll_read_data;
-    return 1;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
-static int hdlc_ll_read_data(hdlc_ll_handle_t handle, const uint8_t *data, int len)
+static int hdlc_ll_send_cobs_code(hdlc_ll_handle_t handle)
 {
-    int result = 0;
-    while ( len > 0 )
+    int left = handle->tx.len + handle->tx.crc_len;
+    // tx.escape is set, if the last block ended with zero byte, and one more block must follow
+    if ( left == 0 && !handle->tx.escape )
     {
-        uint8_t byte = data[0];
-        LOG(TINY_LOG_DEB, "[HDLC:%p] RX: %02X\n", handle, byte);
-        if ( byte == FLAG_SEQUENCE )
+        handle->tx.state = hdlc_ll_send_end;
+        return 0;
+    }
+    int max_run = left < COBS_MAX_RUN ? left : COBS_MAX_RUN;
+    int run = max_run < handle->tx.len ? max_run : handle->tx.len;
+    const uint8_t *zero = (const uint8_t *)memchr(handle->tx.data, COBS_DELIMITER, run);
+    if ( zero )
+    {
+        run = (int)(zero - handle->tx.data);
+    }
+    else
+    {
+        while ( run < max_run && hdlc_ll_tx_byte(handle, run) != COBS_DELIMITER )
         {
-            handle->rx.state = hdlc_ll_read_end;
-            result++;
-            break;
+            run++;
         }
-        if ( byte == TINY_ESCAPE_CHAR )
+    }
+    uint8_t code = (uint8_t)(run + 1);
+    int result = hdlc_ll_send_tx_internal(handle, &code, sizeof(code));
+    if ( result == 1 )
+    {
+        LOG(TINY_LOG_DEB, "[HDLC:%p] TX: %02X\n", handle, code);
+        handle->tx.run = (uint8_t)run;
+        handle->tx.escape = run < left && run < COBS_MAX_RUN;
+        if ( run )
         {
-            handle->rx.escape = 1;
+            handle->tx.state = hdlc_ll_send_cobs_data;
         }
-        else if ( handle->rx.data - (uint8_t *)handle->rx_buf < handle->rx_buf_size )
+        else if ( handle->tx.escape )
         {
-            if ( handle->rx.escape )
-            {
-                *handle->rx.data = byte ^ TINY_ESCAPE_BIT;
-                handle->rx.escape = 0;
-            }
-            else
-            {
-                *handle->rx.data = byte;
-            }
-            handle->rx.data++;
-            // LOG(TINY_LOG_DEB, "%02X\n", handle->rx.data[ handle->rx.len ]);
+            hdlc_ll_cobs_skip_zero(handle);
         }
-        result++;
-        data++;
-        len--;
     }
     return result;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
-static int hdlc_ll_read_end(hdlc_ll_handle_t handle, const uint8_t *data, int len_bytes)
+static int hdlc_ll_send_cobs_data(hdlc_ll_handle_t handle)
 {
-    if ( handle->rx.data == handle->rx_buf )
+    int result;
+    if ( handle->tx.len )
     {
-        // Impossible, maybe frame alignment is wrong, go to read data again
-        LOG(TINY_LOG_WRN, "[HDLC:%p] RX: error in frame alignment, recovering...\n", handle);
-        handle->rx.escape = 0;
-        handle->rx.state = hdlc_ll_read_data;
-        return 0; // That's OK, we actually didn't process anything from user bytes
+        // Payload bytes of the block are sent as is
+        result = hdlc_ll_send_tx_internal(handle, handle->tx.data,
+                                          handle->tx.run < handle->tx.len ? handle->tx.run : handle->tx.len);
+        handle->tx.data += result;
+        handle->tx.len -= result;
     }
-    handle->rx.state = hdlc_ll_read_start;
-    int len = (int)(handle->rx.data - (uint8_t *)handle->rx_buf);
-    if ( len > handle->rx_buf_size )
+    else
     {
-        // Buffer size issue, too long packet
+        uint8_t byte = hdlc_ll_tx_byte(handle, 0);
+        result = hdlc_ll_send_tx_internal(handle, &byte, sizeof(byte));
+        handle->tx.crc_len -= result;
+    }
+    handle->tx.run -= result;
+    if ( !handle->tx.run )
+    {
+        if ( handle->tx.escape )
+        {
+            hdlc_ll_cobs_skip_zero(handle);
+        }
+        handle->tx.state = hdlc_ll_send_cobs_code;
+    }
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_send_length_header(hdlc_ll_handle_t handle)
+{
+    // tx.len is not changed until the header is sent
+    uint8_t header[LENGTH_HEADER_SIZE] = {(uint8_t)handle->tx.len, (uint8_t)(handle->tx.len >> 8)};
+    int result = hdlc_ll_send_tx_internal(handle, header + handle->tx.run, LENGTH_HEADER_SIZE - handle->tx.run);
+    handle->tx.run += result;
+    if ( handle->tx.run == LENGTH_HEADER_SIZE )
+    {
+        handle->tx.state = hdlc_ll_send_length_data;
+    }
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_send_length_data(hdlc_ll_handle_t handle)
+{
+    int result;
+    if ( handle->tx.len )
+    {
+        result = hdlc_ll_send_tx_internal(handle, handle->tx.data, handle->tx.len);
+        handle->tx.data += result;
+        handle->tx.len -= result;
+    }
+    else
+    {
+        uint8_t byte = hdlc_ll_tx_byte(handle, 0);
+        result = hdlc_ll_send_tx_internal(handle, &byte, sizeof(byte));
+        handle->tx.crc_len -= result;
+    }
+    if ( !handle->tx.len && !handle->tx.crc_len )
+    {
+        LOG(TINY_LOG_INFO, "[HDLC:%p] hdlc_ll_send_length_data HDLC send op successful\n", handle);
+        hdlc_ll_send_complete(handle);
+    }
+    return result;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Bit stuffing tables process 4 bits at once, the least significant bit first.
+ * Encoder entry: bits 0-4 - output bits, bits 5-7 - number of output bits, bits 8-10 - number of consecutive 1 bits.
+ * Encoder state is number of consecutive 1 bits before the nibble (0-4).
+ */
+static const uint16_t s_sync_tx_table[5][16] = {
+    {0x080, 0x081, 0x082, 0x083, 0x084, 0x085, 0x086, 0x087, 0x188, 0x189, 0x18A, 0x18B, 0x28C, 0x28D, 0x38E, 0x48F},
+    {0x080, 0x081, 0x082, 0x083, 0x084, 0x085, 0x086, 0x087, 0x188, 0x189, 0x18A, 0x18B, 0x28C, 0x28D, 0x38E, 0x0AF},
+    {0x080, 0x081, 0x082, 0x083, 0x084, 0x085, 0x086, 0x0A7, 0x188, 0x189, 0x18A, 0x18B, 0x28C, 0x28D, 0x38E, 0x1B7},
+    {0x080, 0x081, 0x082, 0x0A3, 0x084, 0x085, 0x086, 0x0AB, 0x188, 0x189, 0x18A, 0x1B3, 0x28C, 0x28D, 0x38E, 0x2BB},
+    {0x080, 0x0A1, 0x082, 0x0A5, 0x084, 0x0A9, 0x086, 0x0AD, 0x188, 0x1B1, 0x18A, 0x1B5, 0x28C, 0x2B9, 0x38E, 0x3BD},
+};
+
+/*
+ * Decoder entry: bits 0-3 - data bits, bits 4-6 - number of data bits, bits 7-9 - number of consecutive 1 bits.
+ * Decoder state is number of consecutive 1 bits before the nibble (0-7, 7 means abort or idle line).
+ * SYNC_RX_SLOW entries contain flag or abort sequence, such nibbles are processed bit by bit.
+ */
+#define SYNC_RX_SLOW 0x400
+static const uint16_t s_sync_rx_table[8][16] = {
+    {0x040, 0x041, 0x042, 0x043, 0x044, 0x045, 0x046, 0x047, 0x0C8, 0x0C9, 0x0CA, 0x0CB, 0x14C, 0x14D, 0x1CE, 0x24F},
+    {0x040, 0x041, 0x042, 0x043, 0x044, 0x045, 0x046, 0x047, 0x0C8, 0x0C9, 0x0CA, 0x0CB, 0x14C, 0x14D, 0x1CE, 0x2CF},
+    {0x040, 0x041, 0x042, 0x043, 0x044, 0x045, 0x046, 0x037, 0x0C8, 0x0C9, 0x0CA, 0x0CB, 0x14C, 0x14D, 0x1CE, 0x337},
+    {0x040, 0x041, 0x042, 0x033, 0x044, 0x045, 0x046, 0x400, 0x0C8, 0x0C9, 0x0CA, 0x0B7, 0x14C, 0x14D, 0x1CE, 0x400},
+    {0x040, 0x031, 0x042, 0x400, 0x044, 0x033, 0x046, 0x400, 0x0C8, 0x0B5, 0x0CA, 0x400, 0x14C, 0x137, 0x1CE, 0x400},
+    {0x030, 0x400, 0x031, 0x400, 0x032, 0x400, 0x033, 0x400, 0x0B4, 0x400, 0x0B5, 0x400, 0x136, 0x400, 0x1B7, 0x400},
+    {0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400, 0x400},
+    {0x040, 0x030, 0x042, 0x020, 0x044, 0x032, 0x046, 0x010, 0x0C8, 0x0B4, 0x0CA, 0x0A2, 0x14C, 0x136, 0x1CE, 0x380},
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Appends bit-stuffed byte to the accumulator */
+static inline void hdlc_ll_sync_encode(hdlc_ll_bits_t *sync, uint8_t byte)
+{
+    uint16_t entry = s_sync_tx_table[sync->ones][byte & 0x0F];
+    sync->bits |= (uint32_t)(entry & 0x1F) << sync->nbits;
+    sync->nbits += (entry >> 5) & 0x07;
+    entry = s_sync_tx_table[entry >> 8][byte >> 4];
+    sync->bits |= (uint32_t)(entry & 0x1F) << sync->nbits;
+    sync->nbits += (entry >> 5) & 0x07;
+    sync->ones = (uint8_t)(entry >> 8);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Appends closing flag to the accumulator, and pads it by 1 bits up to byte boundary */
+static inline void hdlc_ll_sync_encode_end(hdlc_ll_bits_t *sync)
+{
+    sync->bits |= (uint32_t)FLAG_SEQUENCE << sync->nbits;
+    sync->nbits += 8;
+    int pad = (8 - (sync->nbits & 0x07)) & 0x07;
+    sync->bits |= ((1UL << pad) - 1) << sync->nbits;
+    sync->nbits += pad;
+    sync->flag = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Appends data bits of the frame to the accumulator, and stores complete bytes to dst */
+static inline void hdlc_ll_sync_put_bits(hdlc_ll_bits_t *sync, uint32_t bits, int count, uint8_t *dst, int dst_size)
+{
+    if ( !sync->flag )
+    {
+        // Looking for the opening flag
+        return;
+    }
+    sync->bits |= bits << sync->nbits;
+    sync->nbits += count;
+    while ( sync->nbits >= 8 + SYNC_FLAG_BITS )
+    {
+        if ( sync->len < dst_size )
+        {
+            dst[sync->len] = (uint8_t)sync->bits;
+        }
+        sync->len++;
+        sync->bits >>= 8;
+        sync->nbits -= 8;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Processes single bit. Returns the same values as hdlc_ll_sync_decode() */
+static int hdlc_ll_sync_decode_bit(hdlc_ll_bits_t *sync, int bit, uint8_t *dst, int dst_size)
+{
+    int result = 0;
+    if ( bit )
+    {
+        if ( sync->ones < 5 )
+        {
+            hdlc_ll_sync_put_bits(sync, 1, 1, dst, dst_size);
+        }
+        else if ( sync->ones == 6 )
+        {
+            // Abort sequence, the frame is dropped
+            sync->flag = 0;
+        }
+        if ( sync->ones < 7 )
+        {
+            sync->ones++;
+        }
+        return 0;
+    }
+    if ( sync->ones == 6 )
+    {
+        // Flag: the frame must end with 0 and five 1 bits of the flag on byte boundary.
+        // Less than 8 bits between the flags are repeated flags or idle bits.
+        if ( !sync->flag || !sync->len )
+        {
+            result = 0;
+        }
+        else if ( sync->nbits != SYNC_FLAG_BITS )
+        {
+            result = TINY_ERR_WRONG_CRC;
+        }
+        else if ( sync->len > dst_size )
+        {
+            result = TINY_ERR_DATA_TOO_LARGE;
+        }
+        else
+        {
+            result = sync->len;
+        }
+        sync->flag = 1;
+        sync->len = 0;
+        sync->bits = 0;
+        sync->nbits = 0;
+    }
+    else if ( sync->ones != 5 )
+    {
+        // 0 bit after five 1 bits is inserted by transmitter
+        hdlc_ll_sync_put_bits(sync, 0, 1, dst, dst_size);
+    }
+    sync->ones = 0;
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Decodes byte of bit-stuffed stream to dst. Returns length of the frame, completed by the flag
+ * in this byte, 0 if there is no such frame, or negative error code for the broken frame.
+ * Completed frame is not overwritten by the bits of the next frame, which follow the flag in this byte.
+ */
+static int hdlc_ll_sync_decode(hdlc_ll_bits_t *sync, uint8_t byte, uint8_t *dst, int dst_size)
+{
+    int result = 0;
+    for ( int shift = 0; shift < 8; shift += 4 )
+    {
+        uint8_t nibble = (byte >> shift) & 0x0F;
+        uint16_t entry = s_sync_rx_table[sync->ones][nibble];
+        if ( entry & SYNC_RX_SLOW )
+        {
+            for ( int i = 0; i < 4; i++ )
+            {
+                int temp = hdlc_ll_sync_decode_bit(sync, (nibble >> i) & 0x01, dst, dst_size);
+                if ( temp )
+                {
+                    result = temp;
+                }
+            }
+        }
+        else
+        {
+            hdlc_ll_sync_put_bits(sync, entry & 0x0F, (entry >> 4) & 0x07, dst, dst_size);
+            sync->ones = (uint8_t)(entry >> 7);
+        }
+    }
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef CONFIG_ENABLE_FRAMING
+static int hdlc_ll_send_sync(hdlc_ll_handle_t handle)
+{
+    int result = 0;
+    while ( handle->tx.out_buffer_len )
+    {
+        if ( handle->tx.sync.nbits < 8 )
+        {
+            if ( handle->tx.len )
+            {
+                hdlc_ll_sync_encode(&handle->tx.sync, *handle->tx.data);
+                handle->tx.data++;
+                handle->tx.len--;
+            }
+            else if ( handle->tx.crc_len )
+            {
+                hdlc_ll_sync_encode(&handle->tx.sync, hdlc_ll_tx_byte(handle, 0));
+                handle->tx.crc_len--;
+            }
+            else
+            {
+                hdlc_ll_sync_encode_end(&handle->tx.sync);
+            }
+        }
+        *handle->tx.out_buffer++ = (uint8_t)handle->tx.sync.bits;
+        handle->tx.out_buffer_len--;
+        handle->tx.sync.bits >>= 8;
+        handle->tx.sync.nbits -= 8;
+        result++;
+        if ( handle->tx.sync.flag && !handle->tx.sync.nbits )
+        {
+            LOG(TINY_LOG_INFO, "[HDLC:%p] hdlc_ll_send_sync HDLC send op successful\n", handle);
+            hdlc_ll_send_complete(handle);
+            break;
+        }
+    }
+    return result;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static void hdlc_ll_send_complete(hdlc_ll_handle_t handle)
+{
+    handle->tx.state = hdlc_ll_send_start;
+    handle->tx.escape = 0;
+    int len = (int)(handle->tx.data - handle->tx.origin_data);
+    const void *ptr = handle->tx.origin_data;
+    handle->tx.origin_data = NULL;
+    handle->tx.data = NULL;
+    if ( handle->on_frame_sent )
+    {
+        handle->on_frame_sent(handle->user_data, ptr, len);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_send_end(hdlc_ll_handle_t handle)
+{
+    LOG(TINY_LOG_DEB, "[HDLC:%p] hdlc_ll_send_end\n", handle);
+    uint8_t buf[1] = {hdlc_ll_delimiter(handle)};
+    int result = hdlc_ll_send_tx_internal(handle, buf, sizeof(buf));
+    if ( result == 1 )
+    {
+        LOG(TINY_LOG_DEB, "[HDLC:%p] TX: %02X\n", handle, buf[0]);
+        LOG(TINY_LOG_INFO, "[HDLC:%p] hdlc_ll_send_end HDLC send op successful\n", handle);
+        hdlc_ll_send_complete(handle);
+    }
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_send_tx_internal(hdlc_ll_handle_t handle, const void *data, int len)
+{
+    int sent = len < handle->tx.out_buffer_len ? len : handle->tx.out_buffer_len;
+    memcpy(handle->tx.out_buffer, data, sent);
+    handle->tx.out_buffer_len -= sent;
+    handle->tx.out_buffer += sent;
+    return sent;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int hdlc_ll_run_tx(hdlc_ll_handle_t handle, void *data, int len)
+{
+    bool repeated_empty_data = false;
+    handle->tx.out_buffer = (uint8_t *)data;
+    handle->tx.out_buffer_len = len;
+    while ( handle->tx.out_buffer_len )
+    {
+        int result = handle->tx.state(handle);
+        if ( result < 0 )
+        {
+#if TINY_HDLC_DEBUG
+            LOG(TINY_LOG_ERR, "[HDLC:%p] failed to run state with result: %d\n", handle, result);
+#endif
+            /*
+             * Some error happened. For we do not pass error code to upper layer.
+             * Passing error code as the result of this function can confuse user code. So
+             * need some other way to do that
+             */
+            break;
+        }
+        else if ( result == 0 )
+        {
+            /*
+             * Some tx state functions may return zero result, just in case of switching between states.
+             * Exiting in this case can cause tx user buffer to be underfilled. To avoid that, just check
+             * twice to ensure that we do not have more data to send.
+             */
+            if ( repeated_empty_data )
+            {
+                break;
+            }
+            repeated_empty_data = true;
+        }
+        else
+        {
+            repeated_empty_data = false;
+        }
+    }
+    return len - handle->tx.out_buffer_len;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int hdlc_ll_run_tx_block(hdlc_ll_handle_t handle, void *block, int size)
+{
+    if ( handle->framing == HDLC_FRAMING_LENGTH || size < 0 )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    int len = hdlc_ll_run_tx(handle, block, size);
+    memset((uint8_t *)block + len, FILL_BYTE, size - len);
+    return len;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_put_internal(hdlc_ll_handle_t handle, const void *data, int len, int header_len,
+                                const crc_t *body_crc)
+{
+    LOG(TINY_LOG_DEB, "[HDLC:%p] hdlc_ll_put\n", handle);
+    if ( !len || !data || !handle || (handle->framing == HDLC_FRAMING_LENGTH && len > LENGTH_MAX_FRAME) )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    // Check if TX thread is ready to accept new data
+    if ( handle->tx.origin_data )
+    {
+        LOG(TINY_LOG_WRN, "[HDLC:%p] hdlc_ll_put FAILED\n", handle);
+        return TINY_ERR_BUSY;
+    }
+    LOG(TINY_LOG_DEB, "[HDLC:%p] hdlc_ll_put SUCCESS\n", handle);
+    if ( body_crc )
+    {
+        crc_t header_crc = hdlc_ll_calc_crc(handle->crc_type, (const uint8_t *)data, header_len);
+        handle->tx.crc = hdlc_ll_combine_crc(handle->crc_type, header_crc, *body_crc, len - header_len);
+    }
+    else
+    {
+        handle->tx.crc = hdlc_ll_calc_crc(handle->crc_type, (const uint8_t *)data, len);
+    }
+    handle->tx.origin_data = data;
+    handle->tx.data = data;
+    handle->tx.len = len;
+    return TINY_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int hdlc_ll_put(hdlc_ll_handle_t handle, const void *data, int len)
+{
+    return hdlc_ll_put_internal(handle, data, len, 0, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int hdlc_ll_put_with_crc(hdlc_ll_handle_t handle, const void *data, int len, int header_len, crc_t body_crc)
+{
+    if ( header_len < 0 || header_len > len )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    return hdlc_ll_put_internal(handle, data, len, header_len, &body_crc);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+crc_t hdlc_ll_get_crc(hdlc_ll_handle_t handle, const void *data, int len)
+{
+    return hdlc_ll_calc_crc(handle->crc_type, (const uint8_t *)data, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static void hdlc_ll_read_frame_start(hdlc_ll_handle_t handle)
+{
+    handle->rx.escape = 0;
+#ifdef CONFIG_ENABLE_FRAMING
+    handle->rx.code = 0;
+    handle->rx.zero = 0;
+    handle->rx.left = 0;
+    switch ( handle->framing )
+    {
+        case HDLC_FRAMING_COBS: handle->rx.state = hdlc_ll_read_cobs_data; break;
+        case HDLC_FRAMING_LENGTH: handle->rx.state = hdlc_ll_read_length; break;
+        default: handle->rx.state = hdlc_ll_read_data; break;
+    }
+#else
+    handle->rx.state = hdlc_ll_read_data;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static void hdlc_ll_read_wait_frame(hdlc_ll_handle_t handle)
+{
+#ifdef CONFIG_ENABLE_FRAMING
+    // Length-prefixed frames follow each other without delimiters
+    if ( handle->framing == HDLC_FRAMING_LENGTH )
+    {
+        hdlc_ll_read_frame_start(handle);
+    }
+    else if ( handle->framing == HDLC_FRAMING_SYNC )
+    {
+        // Bit stuffing decoder looks for the flags itself, and keeps the bits of the next frame
+        handle->rx.state = hdlc_ll_read_sync;
+    }
+    else
+#endif
+    {
+        handle->rx.state = hdlc_ll_read_start;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_read_start(hdlc_ll_handle_t handle, const uint8_t *data, int len)
+{
+    if ( !len )
+    {
+        return 0;
+    }
+    // Fill bytes and garbage between frames are skipped at once
+    const uint8_t *delimiter = (const uint8_t *)memchr(data, hdlc_ll_delimiter(handle), len);
+    if ( !delimiter )
+    {
+        return len;
+    }
+    LOG(TINY_LOG_DEB, "[HDLC:%p] RX: %02X\n", handle, delimiter[0]);
+    handle->rx.data = (uint8_t *)handle->rx_buf;
+    hdlc_ll_read_frame_start(handle);
+    return (int)(delimiter - data) + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_read_data(hdlc_ll_handle_t handle, const uint8_t *data, int len)
+{
+    int result = 0;
+    while ( len > 0 )
+    {
+        uint8_t byte = data[0];
+        LOG(TINY_LOG_DEB, "[HDLC:%p] RX: %02X\n", handle, byte);
+        if ( byte == FLAG_SEQUENCE )
+        {
+            handle->rx.state = hdlc_ll_read_end;
+            result++;
+            break;
+        }
+        if ( byte == TINY_ESCAPE_CHAR )
+        {
+            handle->rx.escape = 1;
+        }
+        else if ( handle->rx.data - (uint8_t *)handle->rx_buf < handle->rx_buf_size )
+        {
+            if ( handle->rx.escape )
+            {
+                *handle->rx.data = byte ^ TINY_ESCAPE_BIT;
+                handle->rx.escape = 0;
+            }
+            else
+            {
+                *handle->rx.data = byte;
+            }
+            handle->rx.data++;
+            // LOG(TINY_LOG_DEB, "%02X\n", handle->rx.data[ handle->rx.len ]);
+        }
+        result++;
+        data++;
+        len--;
+    }
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef CONFIG_ENABLE_FRAMING
+static int hdlc_ll_read_cobs_data(hdlc_ll_handle_t handle, const uint8_t *data, int len)
+{
+    int result = 0;
+    while ( len > 0 )
+    {
+        int space = handle->rx_buf_size - (int)(handle->rx.data - (uint8_t *)handle->rx_buf);
+        if ( data[0] == COBS_DELIMITER )
+        {
+            LOG(TINY_LOG_DEB, "[HDLC:%p] RX: %02X\n", handle, data[0]);
+            handle->rx.state = hdlc_ll_read_end;
+            result++;
+            break;
+        }
+        int processed;
+        if ( handle->rx.code == 0 )
+        {
+            LOG(TINY_LOG_DEB, "[HDLC:%p] RX: %02X\n", handle, data[0]);
+            // Zero byte is restored only if the next block follows
+            if ( handle->rx.zero && space > 0 )
+            {
+                *handle->rx.data++ = 0;
+            }
+            handle->rx.code = data[0] - 1;
+            handle->rx.zero = data[0] != COBS_MAX_RUN + 1;
+            processed = 1;
+        }
+        else
+        {
+            // Data bytes of the block are copied as is up to the delimiter, which means broken block
+            processed = len < handle->rx.code ? len : handle->rx.code;
+            const uint8_t *delimiter = (const uint8_t *)memchr(data, COBS_DELIMITER, processed);
+            if ( delimiter )
+            {
+                processed = (int)(delimiter - data);
+            }
+            int copy = processed < space ? processed : space;
+            memcpy(handle->rx.data, data, copy);
+            handle->rx.data += copy;
+            handle->rx.code -= processed;
+        }
+        result += processed;
+        data += processed;
+        len -= processed;
+    }
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_read_length(hdlc_ll_handle_t handle, const uint8_t *data, int len)
+{
+    if ( !len )
+    {
+        return 0;
+    }
+    LOG(TINY_LOG_DEB, "[HDLC:%p] RX: %02X\n", handle, data[0]);
+    handle->rx.left |= (int)data[0] << (8 * handle->rx.code);
+    handle->rx.code++;
+    if ( handle->rx.code == LENGTH_HEADER_SIZE )
+    {
+        handle->rx.left += (uint8_t)handle->crc_type / 8;
+        // Too large frame is skipped
+        handle->rx.escape = handle->rx.left > handle->rx_buf_size;
+        handle->rx.frame = (uint8_t *)handle->rx_buf;
+        handle->rx.data = (uint8_t *)handle->rx_buf;
+        handle->rx.state = handle->rx.left ? hdlc_ll_read_length_data : hdlc_ll_read_end;
+    }
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_read_length_data(hdlc_ll_handle_t handle, const uint8_t *data, int len)
+{
+    int processed = len < handle->rx.left ? len : handle->rx.left;
+    if ( handle->rx.data == handle->rx.frame && processed == handle->rx.left && !handle->rx.escape )
+    {
+        // Whole frame is in the user buffer, so pass it to the callback without copying
+        handle->rx.frame = (uint8_t *)data;
+        handle->rx.data = (uint8_t *)data + processed;
+    }
+    else if ( !handle->rx.escape )
+    {
+        memcpy(handle->rx.data, data, processed);
+        handle->rx.data += processed;
+    }
+    handle->rx.left -= processed;
+    if ( !handle->rx.left )
+    {
+        handle->rx.state = hdlc_ll_read_end;
+    }
+    return processed;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_read_sync(hdlc_ll_handle_t handle, const uint8_t *data, int len)
+{
+    for ( int i = 0; i < len; i++ )
+    {
+        int result = hdlc_ll_sync_decode(&handle->rx.sync, data[i], (uint8_t *)handle->rx_buf, handle->rx_buf_size);
+        if ( result )
+        {
+            handle->rx.left = result;
+            handle->rx.state = hdlc_ll_read_end;
+            return i + 1;
+        }
+    }
+    return len;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef CONFIG_ENABLE_FEC
+/* Corrects received blocks in place and removes parity bytes. Returns new length of the frame */
+static int hdlc_ll_fec_decode(hdlc_ll_handle_t handle, int len)
+{
+    uint8_t *src = (uint8_t *)handle->rx_buf;
+    uint8_t *dst = (uint8_t *)handle->rx_buf;
+    int corrected = 0;
+    while ( len > 0 )
+    {
+        int block = len < TINY_FEC_BLOCK_SIZE ? len : TINY_FEC_BLOCK_SIZE;
+        int result = tiny_fec_decode(src, block, handle->fec.roots);
+        if ( result < 0 )
+        {
+            handle->fec.failed++;
+            return TINY_ERR_WRONG_CRC;
+        }
+        corrected += result;
+        memmove(dst, src, block - handle->fec.roots);
+        dst += block - handle->fec.roots;
+        src += block;
+        len -= block;
+    }
+    handle->fec.corrected += corrected;
+    return (int)(dst - (uint8_t *)handle->rx_buf);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_check_frame(hdlc_ll_handle_t handle, uint8_t *frame, int len);
+
+static int hdlc_ll_read_end(hdlc_ll_handle_t handle, const uint8_t *data, int len_bytes)
+{
+#ifdef CONFIG_ENABLE_FRAMING
+    if ( handle->framing == HDLC_FRAMING_LENGTH )
+    {
+        bool too_large = handle->rx.escape;
+        hdlc_ll_read_wait_frame(handle);
+        if ( too_large )
+        {
+            LOG(TINY_LOG_ERR, "[HDLC:%p] RX: too long frame\n", handle);
+            return TINY_ERR_DATA_TOO_LARGE;
+        }
+        return hdlc_ll_check_frame(handle, handle->rx.frame, (int)(handle->rx.data - handle->rx.frame));
+    }
+    if ( handle->framing == HDLC_FRAMING_SYNC )
+    {
+        hdlc_ll_read_wait_frame(handle);
+        if ( handle->rx.left == TINY_ERR_DATA_TOO_LARGE )
+        {
+            LOG(TINY_LOG_ERR, "[HDLC:%p] RX: too long frame\n", handle);
+            return TINY_ERR_DATA_TOO_LARGE;
+        }
+        if ( handle->rx.left < 0 )
+        {
+            // Frame length is not multiple of 8 bits
+            LOG(TINY_LOG_ERR, "[HDLC:%p] RX: broken sync frame\n", handle);
+            return TINY_ERR_WRONG_CRC;
+        }
+        return hdlc_ll_check_frame(handle, (uint8_t *)handle->rx_buf, handle->rx.left);
+    }
+#endif
+    if ( handle->rx.data == handle->rx_buf )
+    {
+        // Impossible, maybe frame alignment is wrong, go to read data again
+        LOG(TINY_LOG_WRN, "[HDLC:%p] RX: error in frame alignment, recovering...\n", handle);
+        hdlc_ll_read_frame_start(handle);
+        return 0; // That's OK, we actually didn't process anything from user bytes
+    }
+    hdlc_ll_read_wait_frame(handle);
+#ifdef CONFIG_ENABLE_FRAMING
+    if ( handle->rx.code )
+    {
+        // Delimiter is received in the middle of COBS block
+        LOG(TINY_LOG_ERR, "[HDLC:%p] RX: broken cobs block\n", handle);
+#ifdef CONFIG_ENABLE_CAPTURE
+        tiny_capture_frame(handle->capture, TINY_CAPTURE_RX, handle->rx_buf,
+                           (int)(handle->rx.data - (uint8_t *)handle->rx_buf), TINY_CAPTURE_FLAG_CRC_ERROR);
+#endif
+        return TINY_ERR_WRONG_CRC;
+    }
+#endif
+    int len = (int)(handle->rx.data - (uint8_t *)handle->rx_buf);
+    if ( len > handle->rx_buf_size )
+    {
+        // Buffer size issue, too long packet
         LOG(TINY_LOG_ERR, "[HDLC:%p] RX: tool long frame\n", handle);
         return TINY_ERR_DATA_TOO_LARGE;
     }
+#ifdef CONFIG_ENABLE_FEC
+    if ( handle->fec.roots )
+    {
+        len = hdlc_ll_fec_decode(handle, len);
+        if ( len < 0 )
+        {
+            LOG(TINY_LOG_ERR, "[HDLC:%p] RX: uncorrectable frame\n", handle);
+#ifdef CONFIG_ENABLE_CAPTURE
+            tiny_capture_frame(handle->capture, TINY_CAPTURE_RX, handle->rx_buf,
+                               (int)(handle->rx.data - (uint8_t *)handle->rx_buf), TINY_CAPTURE_FLAG_CRC_ERROR);
+#endif
+            return TINY_ERR_WRONG_CRC;
+        }
+    }
+#endif
+    return hdlc_ll_check_frame(handle, (uint8_t *)handle->rx_buf, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Checks crc field of received frame and passes the frame to the user */
+static int hdlc_ll_check_frame(hdlc_ll_handle_t handle, uint8_t *frame, int len)
+{
     if ( len < (uint8_t)handle->crc_type / 8 )
     {
         // CRC size issue
         LOG(TINY_LOG_ERR, "[HDLC:%p] RX: crc field is too short\n", handle);
         return TINY_ERR_WRONG_CRC;
     }
-    crc_t calc_crc = 0;
-    crc_t read_crc = 0;
-    switch ( handle->crc_type )
-    {
-#ifdef CONFIG_ENABLE_CHECKSUM
-        case HDLC_CRC_8:
-            calc_crc = chksum(INITCHECKSUM, handle->rx_buf, len - 1) & 0x00FF;
-            read_crc = handle->rx.data[-1];
-            break;
-#endif
-#ifdef CONFIG_ENABLE_FCS16
-        case HDLC_CRC_16:
-            calc_crc = crc16(PPPINITFCS16, handle->rx_buf, len - 2);
-            read_crc = handle->rx.data[-2] | ((uint16_t)handle->rx.data[-1] << 8);
-            break;
-#endif
-#ifdef CONFIG_ENABLE_FCS32
-        case HDLC_CRC_32:
-            calc_crc = crc32(PPPINITFCS32, handle->rx_buf, len - 4);
-            read_crc = handle->rx.data[-4] | ((uint32_t)handle->rx.data[-3] << 8) |
-                       ((uint32_t)handle->rx.data[-2] << 16) | ((uint32_t)handle->rx.data[-1] << 24);
-            break;
-#endif
-        default: break;
-    }
+    int crc_size = (uint8_t)handle->crc_type / 8;
+    crc_t calc_crc = hdlc_ll_calc_crc(handle->crc_type, frame, len - crc_size);
+    crc_t read_crc = hdlc_ll_read_crc(frame + len - crc_size, crc_size);
     if ( calc_crc != read_crc )
     {
 // CRC calculate issue
@@ -470,22 +1375,26 @@ static int hdlc_ll_read_end(hdlc_ll_handle_t handle, const uint8_t *data, int le
         LOG(TINY_LOG_ERR, "[HDLC:%p] RX: WRONG CRC (calc:%08X != %08X)\n", handle, calc_crc, read_crc);
         if ( TINY_LOG_DEB < g_tiny_log_level )
             for ( int i = 0; i < len; i++ )
-                fprintf(stderr, " %c ", (char)((uint8_t *)handle->rx_buf)[i]);
+                fprintf(stderr, " %c ", (char)frame[i]);
         LOG(TINY_LOG_DEB, "\n");
         if ( TINY_LOG_DEB < g_tiny_log_level )
             for ( int i = 0; i < len; i++ )
-                fprintf(stderr, " %02X ", ((uint8_t *)handle->rx_buf)[i]);
+                fprintf(stderr, " %02X ", frame[i]);
         LOG(TINY_LOG_DEB, "\n-----------\n");
+#endif
+#ifdef CONFIG_ENABLE_CAPTURE
+        tiny_capture_frame(handle->capture, TINY_CAPTURE_RX, frame, len, TINY_CAPTURE_FLAG_CRC_ERROR);
 #endif
         return TINY_ERR_WRONG_CRC;
     }
     len -= (uint8_t)handle->crc_type / 8;
-    // Shift back data pointer, pointing to the last byte after payload
-    handle->rx.data -= (uint8_t)handle->crc_type / 8;
     LOG(TINY_LOG_INFO, "[HDLC:%p] RX: Frame success: %d bytes\n", handle, len);
+#ifdef CONFIG_ENABLE_CAPTURE
+    tiny_capture_frame(handle->capture, TINY_CAPTURE_RX, frame, len, 0);
+#endif
     if ( handle->on_frame_read )
     {
-        handle->on_frame_read(handle->user_data, handle->rx_buf, len);
+        handle->on_frame_read(handle->user_data, frame, len);
     }
     return TINY_SUCCESS;
 }
@@ -519,6 +1428,34 @@ int hdlc_ll_run_rx(hdlc_ll_handle_t handle, const void *data, int len, int *erro
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
+int hdlc_ll_run_rx_block(hdlc_ll_handle_t handle, const void *block, int size, int *error)
+{
+    if ( error )
+    {
+        *error = TINY_SUCCESS;
+    }
+    if ( handle->framing == HDLC_FRAMING_LENGTH || size < 0 )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    const uint8_t *ptr = (const uint8_t *)block;
+    while ( size )
+    {
+        int result = TINY_SUCCESS;
+        // hdlc_ll_run_rx() stops on errors, so it is called until the whole block is processed
+        int processed = hdlc_ll_run_rx(handle, ptr, size, &result);
+        if ( result != TINY_SUCCESS && error )
+        {
+            *error = result;
+        }
+        ptr += processed;
+        size -= processed;
+    }
+    return TINY_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
 int hdlc_ll_get_buf_size(int mtu)
 {
     return get_crc_field_size(HDLC_CRC_32) + sizeof(hdlc_ll_data_t) + mtu;
@@ -532,3 +1469,431 @@ int hdlc_ll_get_buf_size_ex(int mtu, hdlc_crc_t crc_type)
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
+
+int hdlc_ll_get_buf_size_fec(int mtu, hdlc_crc_t crc_type, int fec_roots)
+{
+    return hdlc_ll_get_buf_size_ex(mtu, crc_type) + tiny_fec_overhead(mtu + get_crc_field_size(crc_type), fec_roots) +
+           (fec_roots ? 2 * fec_roots + 1 : 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int hdlc_ll_get_max_encoded_size(int len, hdlc_crc_t crc_type, hdlc_framing_t framing)
+{
+    len += get_crc_field_size(crc_type);
+    if ( framing == HDLC_FRAMING_COBS )
+    {
+        // Two delimiters and code byte per each block of 254 bytes
+        return 2 + len + len / COBS_MAX_RUN + 1;
+    }
+    if ( framing == HDLC_FRAMING_LENGTH )
+    {
+        return LENGTH_HEADER_SIZE + len;
+    }
+    if ( framing == HDLC_FRAMING_SYNC )
+    {
+        // Two flags, 0 bit per each five bits of the frame, and padding up to byte boundary
+        return (16 + 8 * len + 8 * len / 5 + 7) / 8;
+    }
+    // Two flags and each byte can be escaped
+    return 2 + 2 * len;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int hdlc_ll_get_fec_stats(hdlc_ll_handle_t handle, uint32_t *corrected, uint32_t *failed)
+{
+#ifdef CONFIG_ENABLE_FEC
+    *corrected = handle->fec.corrected;
+    *failed = handle->fec.failed;
+    return TINY_SUCCESS;
+#else
+    *corrected = 0;
+    *failed = 0;
+    return TINY_ERR_FAILED;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Appends bytes to async frame with escaping. Returns new output position or NULL if buffer is too small */
+static uint8_t *hdlc_ll_encode_async(uint8_t *out, const uint8_t *end, const uint8_t *data, int len)
+{
+    while ( len-- )
+    {
+        uint8_t byte = *data++;
+        if ( byte == FLAG_SEQUENCE || byte == TINY_ESCAPE_CHAR )
+        {
+            if ( end - out < 2 )
+            {
+                return NULL;
+            }
+            *out++ = TINY_ESCAPE_CHAR;
+            byte ^= TINY_ESCAPE_BIT;
+        }
+        else if ( out == end )
+        {
+            return NULL;
+        }
+        *out++ = byte;
+    }
+    return out;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int hdlc_ll_encode(const void *data, int len, void *buf, int size, hdlc_crc_t crc_type, hdlc_framing_t framing)
+{
+    if ( !data || len <= 0 || (framing == HDLC_FRAMING_LENGTH && len > LENGTH_MAX_FRAME) )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    int crc_size = get_crc_field_size(crc_type);
+    crc_t crc = hdlc_ll_calc_crc(crc_type, (const uint8_t *)data, len);
+    uint8_t crc_field[4];
+    for ( int i = 0; i < crc_size; i++ )
+    {
+        crc_field[i] = (uint8_t)(crc >> (8 * i));
+    }
+    uint8_t *out = (uint8_t *)buf;
+    const uint8_t *end = out + size;
+    if ( framing == HDLC_FRAMING_LENGTH )
+    {
+        if ( size < LENGTH_HEADER_SIZE + len + crc_size )
+        {
+            return TINY_ERR_DATA_TOO_LARGE;
+        }
+        out[0] = (uint8_t)len;
+        out[1] = (uint8_t)(len >> 8);
+        memcpy(out + LENGTH_HEADER_SIZE, data, len);
+        memcpy(out + LENGTH_HEADER_SIZE + len, crc_field, crc_size);
+        return LENGTH_HEADER_SIZE + len + crc_size;
+    }
+    if ( framing == HDLC_FRAMING_SYNC )
+    {
+        hdlc_ll_bits_t sync = {FLAG_SEQUENCE, 0, 8, 0, 0};
+        int i = 0;
+        while ( !sync.flag || sync.nbits )
+        {
+            if ( sync.nbits < 8 )
+            {
+                if ( i < len )
+                {
+                    hdlc_ll_sync_encode(&sync, ((const uint8_t *)data)[i++]);
+                }
+                else if ( i < len + crc_size )
+                {
+                    hdlc_ll_sync_encode(&sync, crc_field[i++ - len]);
+                }
+                else
+                {
+                    hdlc_ll_sync_encode_end(&sync);
+                }
+            }
+            if ( out == end )
+            {
+                return TINY_ERR_DATA_TOO_LARGE;
+            }
+            *out++ = (uint8_t)sync.bits;
+            sync.bits >>= 8;
+            sync.nbits -= 8;
+        }
+        return (int)(out - (uint8_t *)buf);
+    }
+    if ( size < 2 )
+    {
+        return TINY_ERR_DATA_TOO_LARGE;
+    }
+    *out++ = framing == HDLC_FRAMING_COBS ? COBS_DELIMITER : FLAG_SEQUENCE;
+    // Reserve place for closing delimiter
+    end--;
+    if ( framing == HDLC_FRAMING_COBS )
+    {
+        // Code byte of each block is written, when the block is complete
+        uint8_t *code = out++;
+        int total = len + crc_size;
+        for ( int i = 0; i < total && out != NULL; i++ )
+        {
+            uint8_t byte = i < len ? ((const uint8_t *)data)[i] : crc_field[i - len];
+            if ( out >= end )
+            {
+                out = NULL;
+            }
+            else if ( byte == COBS_DELIMITER )
+            {
+                *code = (uint8_t)(out - code);
+                code = out++;
+            }
+            else
+            {
+                *out++ = byte;
+                if ( out - code == COBS_MAX_RUN + 1 && i + 1 < total )
+                {
+                    *code = COBS_MAX_RUN + 1;
+                    code = out++;
+                }
+            }
+        }
+        if ( out != NULL && out > end )
+        {
+            out = NULL;
+        }
+        if ( out != NULL )
+        {
+            *code = (uint8_t)(out - code);
+        }
+    }
+    else
+    {
+        out = hdlc_ll_encode_async(out, end, (const uint8_t *)data, len);
+        if ( out != NULL )
+        {
+            out = hdlc_ll_encode_async(out, end, crc_field, crc_size);
+        }
+    }
+    if ( out == NULL )
+    {
+        return TINY_ERR_DATA_TOO_LARGE;
+    }
+    *out++ = framing == HDLC_FRAMING_COBS ? COBS_DELIMITER : FLAG_SEQUENCE;
+    return (int)(out - (uint8_t *)buf);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Bulk scanners decode next frame at *pos to dst. They return 1 and advance *pos, if the frame is found,
+ * 0 if there is no complete frame until the end of data, or TINY_ERR_DATA_TOO_LARGE, if the frame doesn't fit dst.
+ * Decoded data never overtake the source, so dst can point to the same buffer.
+ */
+static int hdlc_ll_scan_async(const uint8_t **pos, const uint8_t *end, uint8_t *dst, int dst_size,
+                              hdlc_ll_frame_info_t *info)
+{
+    const uint8_t *src = *pos;
+    for ( ;; )
+    {
+        const uint8_t *start = (const uint8_t *)memchr(src, FLAG_SEQUENCE, end - src);
+        if ( !start )
+        {
+            *pos = end;
+            return 0;
+        }
+        src = start + 1;
+        int len = 0;
+        while ( src < end && *src != FLAG_SEQUENCE )
+        {
+            // Runs of bytes without escaping are copied at once
+            const uint8_t *run = src;
+            while ( src < end && *src != FLAG_SEQUENCE && *src != TINY_ESCAPE_CHAR )
+            {
+                src++;
+            }
+            if ( len + (src - run) <= dst_size )
+            {
+                memmove(dst + len, run, src - run);
+            }
+            len += (int)(src - run);
+            // Repeated escape chars work as single one, and escape char before the flag is dropped
+            while ( src < end && *src == TINY_ESCAPE_CHAR )
+            {
+                src++;
+            }
+            if ( src > run && src[-1] == TINY_ESCAPE_CHAR && src < end && *src != FLAG_SEQUENCE )
+            {
+                if ( len < dst_size )
+                {
+                    dst[len] = *src ^ TINY_ESCAPE_BIT;
+                }
+                len++;
+                src++;
+            }
+        }
+        if ( src == end )
+        {
+            *pos = start;
+            return 0;
+        }
+        // Like hdlc_ll_run_rx(), the frame needs its own opening flag, and empty frame means
+        // that the second flag is opening flag of the frame
+        if ( len )
+        {
+            if ( len > dst_size )
+            {
+                *pos = start;
+                return TINY_ERR_DATA_TOO_LARGE;
+            }
+            *pos = src + 1;
+            info->len = len;
+            info->error = TINY_SUCCESS;
+            return 1;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_scan_cobs(const uint8_t **pos, const uint8_t *end, uint8_t *dst, int dst_size,
+                             hdlc_ll_frame_info_t *info)
+{
+    const uint8_t *src = *pos;
+    for ( ;; )
+    {
+        const uint8_t *start = (const uint8_t *)memchr(src, COBS_DELIMITER, end - src);
+        if ( !start )
+        {
+            *pos = end;
+            return 0;
+        }
+        src = start + 1;
+        const uint8_t *delimiter = (const uint8_t *)memchr(src, COBS_DELIMITER, end - src);
+        if ( !delimiter )
+        {
+            *pos = start;
+            return 0;
+        }
+        int len = 0;
+        info->error = TINY_SUCCESS;
+        while ( src < delimiter )
+        {
+            int code = *src++;
+            int run = code - 1;
+            if ( run > delimiter - src )
+            {
+                // Delimiter in the middle of the block
+                run = (int)(delimiter - src);
+                info->error = TINY_ERR_WRONG_CRC;
+            }
+            if ( len + run > dst_size )
+            {
+                *pos = start;
+                return TINY_ERR_DATA_TOO_LARGE;
+            }
+            memmove(dst + len, src, run);
+            len += run;
+            src += run;
+            if ( code != COBS_MAX_RUN + 1 && src < delimiter )
+            {
+                if ( len == dst_size )
+                {
+                    *pos = start;
+                    return TINY_ERR_DATA_TOO_LARGE;
+                }
+                dst[len++] = 0;
+            }
+        }
+        if ( !len )
+        {
+            // Like hdlc_ll_run_rx(), frame without data means that the closing delimiter opens the next frame
+            src = delimiter;
+            continue;
+        }
+        *pos = delimiter + 1;
+        info->len = len;
+        return 1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+static int hdlc_ll_scan_length(const uint8_t **pos, const uint8_t *end, uint8_t *dst, int dst_size, int crc_size,
+                               hdlc_ll_frame_info_t *info)
+{
+    const uint8_t *src = *pos;
+    if ( end - src < LENGTH_HEADER_SIZE )
+    {
+        return 0;
+    }
+    int len = (src[0] | (src[1] << 8)) + crc_size;
+    if ( end - src < LENGTH_HEADER_SIZE + len )
+    {
+        return 0;
+    }
+    if ( len > dst_size )
+    {
+        return TINY_ERR_DATA_TOO_LARGE;
+    }
+    memmove(dst, src + LENGTH_HEADER_SIZE, len);
+    *pos = src + LENGTH_HEADER_SIZE + len;
+    info->len = len;
+    info->error = TINY_SUCCESS;
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Bit stuffing decoder state is kept between the frames, because the frames can share single flag */
+static int hdlc_ll_scan_sync(const uint8_t **pos, const uint8_t *end, uint8_t *dst, int dst_size,
+                             hdlc_ll_bits_t *sync, hdlc_ll_frame_info_t *info)
+{
+    for ( const uint8_t *src = *pos; src < end; src++ )
+    {
+        int result = hdlc_ll_sync_decode(sync, *src, dst, dst_size);
+        if ( result == TINY_ERR_DATA_TOO_LARGE )
+        {
+            return result;
+        }
+        if ( result )
+        {
+            *pos = src + 1;
+            info->len = result > 0 ? result : 0;
+            info->error = result > 0 ? TINY_SUCCESS : TINY_ERR_WRONG_CRC;
+            return 1;
+        }
+    }
+    if ( !sync->flag )
+    {
+        // There is no frame in progress
+        *pos = end;
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int hdlc_ll_scan(const void *data, int len, void *out, int out_size, hdlc_ll_frame_info_t *frames, int max_frames,
+                 hdlc_crc_t crc_type, hdlc_framing_t framing, int *processed)
+{
+    const uint8_t *pos = (const uint8_t *)data;
+    const uint8_t *end = pos + len;
+    uint8_t *dst = (uint8_t *)out;
+    int crc_size = get_crc_field_size(crc_type);
+    hdlc_ll_bits_t sync = {0, 0, 0, 0, 0};
+    int count = 0;
+    while ( count < max_frames && pos < end )
+    {
+        hdlc_ll_frame_info_t *info = &frames[count];
+        int dst_size = out_size - (int)(dst - (uint8_t *)out);
+        int result;
+        switch ( framing )
+        {
+            case HDLC_FRAMING_COBS: result = hdlc_ll_scan_cobs(&pos, end, dst, dst_size, info); break;
+            case HDLC_FRAMING_LENGTH: result = hdlc_ll_scan_length(&pos, end, dst, dst_size, crc_size, info); break;
+            case HDLC_FRAMING_SYNC: result = hdlc_ll_scan_sync(&pos, end, dst, dst_size, &sync, info); break;
+            default: result = hdlc_ll_scan_async(&pos, end, dst, dst_size, info); break;
+        }
+        if ( result <= 0 )
+        {
+            break;
+        }
+        if ( info->len < crc_size )
+        {
+            info->error = TINY_ERR_WRONG_CRC;
+            info->len = crc_size;
+        }
+        info->len -= crc_size;
+        if ( info->error == TINY_SUCCESS &&
+             hdlc_ll_calc_crc(crc_type, dst, info->len) != hdlc_ll_read_crc(dst + info->len, crc_size) )
+        {
+            info->error = TINY_ERR_WRONG_CRC;
+        }
+        info->offset = (int)(dst - (uint8_t *)out);
+        // crc field is overwritten by the next frame
+        dst += info->len;
+        count++;
+    }
+    if ( processed )
+    {
+        *processed = (int)(pos - (const uint8_t *)data);
+    }
+    return count;
+}
@@ -20,6 +20,7 @@
 
 #include "hal/tiny_types.h"
 #include "proto/crc/crc.h"
+#include "proto/capture/tiny_capture.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -53,6 +54,27 @@ extern "C"
         HDLC_LL_RESET_RX_ONLY = 0x02,
     } hdlc_ll_reset_flags_t;
 
+    /**
+     * Framing modes of hdlc low level
+     */
+    typedef enum
+    {
+        HDLC_FRAMING_ASYNC = 0, ///< Asynchronous HDLC byte stuffing (RFC 1662): 0x7E flag, 0x7D escape
+        HDLC_FRAMING_COBS = 1,  ///< Consistent Overhead Byte Stuffing: 0x00 delimiter, 1 byte overhead per 254
+        HDLC_FRAMING_LENGTH = 2, ///< 16-bit little-endian length header without escaping, for reliable streams
+        HDLC_FRAMING_SYNC = 3,   ///< Synchronous HDLC bit stuffing (ISO 13239): 0x7E flag, 0 after five 1 bits
+    } hdlc_framing_t;
+
+    /**
+     * Information about the frame, found by hdlc_ll_scan()
+     */
+    typedef struct
+    {
+        int offset; ///< offset of decoded payload in the output buffer
+        int len;    ///< size of decoded payload without crc field
+        int error;  ///< TINY_SUCCESS or TINY_ERR_WRONG_CRC
+    } hdlc_ll_frame_info_t;
+
     struct hdlc_ll_data_t;
 
     /** Handle for HDLC low level protocol */
@@ -110,6 +132,43 @@ extern "C"
 
         /** User data, which will be passed to user-defined callback as first argument */
         void *user_data;
+
+        /**
+         * Optional capture object to record received and sent frames, see tiny_capture_init().
+         * Frames are captured only if library is built with CONFIG_ENABLE_CAPTURE.
+         */
+        tiny_capture_handle_t capture;
+
+        /**
+         * Number of Reed-Solomon parity bytes, added to each block of up to 255 - fec_roots bytes of the frame
+         * (including crc field). Receiver corrects up to fec_roots / 2 corrupted bytes per block before crc check.
+         * 0 disables FEC. Both sides must use the same value. Maximum value is TINY_FEC_MAX_ROOTS.
+         * Requires library built with CONFIG_ENABLE_FEC, and rx buffer, calculated by hdlc_ll_get_buf_size_fec().
+         */
+        uint8_t fec_roots;
+
+        /**
+         * Framing mode. Default HDLC_FRAMING_ASYNC escapes 0x7E and 0x7D bytes, so the frame full of
+         * such bytes becomes twice longer. HDLC_FRAMING_COBS adds at most 1 byte per 254 bytes of the frame
+         * regardless of the content. Both sides must use the same mode. FEC is supported only for
+         * HDLC_FRAMING_ASYNC.
+         *
+         * HDLC_FRAMING_LENGTH is intended for reliable byte streams (TCP, UNIX sockets, pipes): each frame
+         * is prefixed by its payload length, and the bytes are never escaped. There are no delimiters, so the
+         * receiver can't recover from lost or extra bytes. Maximum frame size is 65535 bytes. If the whole frame
+         * is contained in the data passed to hdlc_ll_run_rx(), on_frame_read callback receives pointer to that
+         * data without copying, so the callback must not modify it.
+         *
+         * HDLC_FRAMING_SYNC is intended for bit-oriented links (SDR, FPGA, synchronous serial controllers):
+         * the stream is a sequence of bits, packed to bytes least significant bit first. Zero bit is inserted
+         * after each five consecutive 1 bits of the frame, so the frames are not aligned to byte boundaries.
+         * Transmitter pads the closing flag by 1 bits up to byte boundary, and receiver treats 7 or more 1 bits
+         * as frame abort or idle line.
+         *
+         * Modes other than HDLC_FRAMING_ASYNC require library to be built with CONFIG_ENABLE_FRAMING.
+         * hdlc_ll_encode() and hdlc_ll_scan() support all modes in any case.
+         */
+        hdlc_framing_t framing;
     } hdlc_ll_init_t;
 
     //------------------------ GENERIC FUNCIONS ------------------------------
@@ -173,6 +232,19 @@ extern "C"
      */
     int hdlc_ll_run_rx(hdlc_ll_handle_t handle, const void *data, int len, int *error);
 
+    /**
+     * Processes fixed-size block, received from full duplex block transport (SPI with DMA, for example).
+     * Runs of TINY_HDLC_FILL_BYTE between frames are skipped at once. Length-prefixed framing
+     * is not supported, because fill bytes can't be distinguished from frame length.
+     *
+     * @param handle hdlc handle
+     * @param block pointer to received block
+     * @param size size of the block in bytes
+     * @param error pointer to store the last error of the block, see hdlc_ll_run_rx(). Can be NULL.
+     * @return TINY_SUCCESS if the whole block is processed, or TINY_ERR_INVALID_DATA
+     */
+    int hdlc_ll_run_rx_block(hdlc_ll_handle_t handle, const void *block, int size, int *error);
+
     //------------------------ TX FUNCIONS ------------------------------
 
     /**
@@ -187,6 +259,19 @@ extern "C"
      */
     int hdlc_ll_run_tx(hdlc_ll_handle_t handle, void *data, int len);
 
+    /**
+     * Fills fixed-size block to send over full duplex block transport (SPI with DMA, for example).
+     * The block is filled with frame data, and the rest of the block is padded with TINY_HDLC_FILL_BYTE,
+     * so remote side receives the block of the same size every transaction. Length-prefixed framing
+     * is not supported.
+     *
+     * @param handle hdlc handle
+     * @param block pointer to the block to fill
+     * @param size size of the block in bytes
+     * @return number of frame bytes in the block (the rest is padding), or TINY_ERR_INVALID_DATA
+     */
+    int hdlc_ll_run_tx_block(hdlc_ll_handle_t handle, void *block, int size);
+
     /**
      * Puts next frame for sending.
      *
@@ -209,6 +294,31 @@ extern "C"
      */
     int hdlc_ll_put(hdlc_ll_handle_t handle, const void *data, int len);
 
+    /**
+     * Puts next frame for sending like hdlc_ll_put(), but crc of the frame body is already known.
+     * Only first header_len bytes of the frame are passed through crc calculation, and the result is
+     * combined with body_crc. This is useful for retransmissions, when only the header of the frame changes.
+     *
+     * @param handle hdlc handle
+     * @param data pointer to new data to send
+     * @param len size of data to send in bytes
+     * @param header_len number of bytes at the beginning of the frame, not covered by body_crc
+     * @param body_crc crc of the frame data after the header, returned by hdlc_ll_get_crc()
+     * @return TINY_SUCCESS, TINY_ERR_BUSY or TINY_ERR_INVALID_DATA as hdlc_ll_put()
+     */
+    int hdlc_ll_put_with_crc(hdlc_ll_handle_t handle, const void *data, int len, int header_len, crc_t body_crc);
+
+    /**
+     * Calculates crc of the data, using crc type of hdlc handle. The result can be passed to
+     * hdlc_ll_put_with_crc().
+     *
+     * @param handle hdlc handle
+     * @param data pointer to data
+     * @param len size of data in bytes
+     * @return crc value
+     */
+    crc_t hdlc_ll_get_crc(hdlc_ll_handle_t handle, const void *data, int len);
+
     /**
      * Returns minimum buffer size, required to hold hdlc low level data for desired payload size.
      *
@@ -227,6 +337,84 @@ extern "C"
      */
     int hdlc_ll_get_buf_size_ex(int mtu, hdlc_crc_t crc_type);
 
+    /**
+     * Returns minimum buffer size, required to hold hdlc low level data for desired payload size,
+     * if forward error correction is used.
+     *
+     * @param mtu size of desired max payload in bytes
+     * @param crc_type crc field type
+     * @param fec_roots number of parity bytes per block, see hdlc_ll_init_t::fec_roots
+     * @return size of the buffer required
+     */
+    int hdlc_ll_get_buf_size_fec(int mtu, hdlc_crc_t crc_type, int fec_roots);
+
+    /**
+     * Returns maximum number of bytes, sent to the channel for the frame of specified size,
+     * including crc field and frame delimiters.
+     *
+     * @param len size of the frame payload in bytes
+     * @param crc_type crc field type
+     * @param framing framing mode
+     * @return maximum size of encoded frame
+     */
+    int hdlc_ll_get_max_encoded_size(int len, hdlc_crc_t crc_type, hdlc_framing_t framing);
+
+    //------------------------ BULK FUNCIONS ------------------------------
+
+    /**
+     * Encodes single frame to the buffer. The function doesn't need hdlc handle and can be used
+     * to prepare frames in advance, or to generate streams for the tests and tools.
+     * The result is the same as hdlc_ll_run_tx() produces for the frame.
+     *
+     * @param data pointer to frame payload
+     * @param len size of the payload in bytes
+     * @param buf buffer to put encoded frame to, see hdlc_ll_get_max_encoded_size()
+     * @param size size of the buffer
+     * @param crc_type crc field type, HDLC_CRC_OFF to encode frame without crc field
+     * @param framing framing mode
+     * @return size of encoded frame,
+     *         TINY_ERR_DATA_TOO_LARGE if the buffer is too small,
+     *         TINY_ERR_INVALID_DATA if the payload is empty or too large for the framing mode
+     */
+    int hdlc_ll_encode(const void *data, int len, void *buf, int size, hdlc_crc_t crc_type, hdlc_framing_t framing);
+
+    /**
+     * Decodes all complete frames in the buffer without callbacks and returns frame index.
+     * Payloads are stored one after another to the output buffer without crc fields.
+     * Frames with wrong crc are also added to the index with TINY_ERR_WRONG_CRC error, so the tools
+     * can analyze them. The scan stops, when there are no more complete frames, max_frames frames are found,
+     * or the next frame doesn't fit the output buffer. Output buffer, which is not smaller than the input,
+     * always fits all frames. Output buffer can point to the input data to decode frames in place.
+     *
+     * To process long streams, call the function again with the data starting at processed offset
+     * (incomplete frame at the end of the data is not processed). Frames are delimited the same way as
+     * hdlc_ll_run_rx() does it. For HDLC_FRAMING_SYNC the next call must start with the opening flag of
+     * the frame, so the frames sharing single flag are lost at the boundary of processed data.
+     *
+     * @param data pointer to encoded stream
+     * @param len size of the stream in bytes
+     * @param out buffer to store decoded payloads to
+     * @param out_size size of output buffer
+     * @param frames array to store information about found frames
+     * @param max_frames maximum number of frames to store
+     * @param crc_type crc field type
+     * @param framing framing mode
+     * @param processed pointer to variable to receive number of processed bytes of the stream, can be NULL
+     * @return number of found frames
+     */
+    int hdlc_ll_scan(const void *data, int len, void *out, int out_size, hdlc_ll_frame_info_t *frames, int max_frames,
+                     hdlc_crc_t crc_type, hdlc_framing_t framing, int *processed);
+
+    /**
+     * Returns forward error correction counters.
+     *
+     * @param handle hdlc handle
+     * @param corrected pointer to variable to receive number of bytes, corrected by FEC
+     * @param failed pointer to variable to receive number of frames, which FEC failed to correct
+     * @return TINY_SUCCESS or TINY_ERR_FAILED if library is built without CONFIG_ENABLE_FEC
+     */
+    int hdlc_ll_get_fec_stats(hdlc_ll_handle_t handle, uint32_t *corrected, uint32_t *failed);
+
     /**
      * @}
      */
@@ -20,6 +20,8 @@
 
 #include "hal/tiny_types.h"
 #include "proto/crc/crc.h"
+#include "proto/capture/tiny_capture.h"
+#include "proto/fec/tiny_fec.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -43,6 +45,18 @@ extern "C"
  */
 #define HDLC_MIN_BUF_SIZE(mtu, crc) (sizeof(hdlc_ll_data_t) + (int)(crc) / 8 + (mtu))
 
+    /**
+     * State of bit stuffing codec for HDLC_FRAMING_SYNC
+     */
+    typedef struct
+    {
+        uint32_t bits; ///< bit accumulator, the earliest bit is the least significant one
+        int len;       ///< rx: number of decoded bytes of the frame
+        uint8_t nbits; ///< number of bits in the accumulator
+        uint8_t ones;  ///< number of consecutive 1 bits
+        uint8_t flag;  ///< rx: opening flag is received, tx: closing flag is added
+    } hdlc_ll_bits_t;
+
     /**
      * Structure describes configuration of lowest HDLC level
      * Initialize this structure by 0 before passing to hdlc_ll_init()
@@ -95,6 +109,14 @@ extern "C"
         /** User data, which will be passed to user-defined callback as first argument */
         void *user_data;
 
+#ifdef CONFIG_ENABLE_CAPTURE
+        /** Capture object to record received and sent frames */
+        tiny_capture_handle_t capture;
+#endif
+
+        /** Framing mode, see hdlc_framing_t */
+        uint8_t framing;
+
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
         /** Parameters in DOXYGEN_SHOULD_SKIP_THIS section should not be modified by a user */
         struct
@@ -102,6 +124,13 @@ extern "C"
             uint8_t *data;
             int (*state)(hdlc_ll_handle_t handle, const uint8_t *data, int len);
             uint8_t escape;
+#ifdef CONFIG_ENABLE_FRAMING
+            uint8_t code;        ///< COBS: bytes left in block, 0 before code byte. LENGTH: header bytes received
+            uint8_t zero;        ///< COBS: zero byte must be inserted before next block
+            uint8_t *frame;      ///< LENGTH: start of the frame, rx buffer or user data
+            int left;            ///< LENGTH: frame length, and then bytes of the frame left to receive
+            hdlc_ll_bits_t sync; ///< SYNC: bit stuffing decoder, rx.left is the result of the last frame
+#endif
         } rx;
         struct
         {
@@ -111,9 +140,27 @@ extern "C"
             const uint8_t *data;
             int len;
             crc_t crc;
-            uint8_t escape;
             int (*state)(hdlc_ll_handle_t handle);
+            uint8_t escape;
+#ifdef CONFIG_ENABLE_FRAMING
+            uint8_t run;         ///< COBS: non-zero bytes left in current block
+            uint8_t crc_len;     ///< COBS, SYNC: crc bytes left to encode
+            hdlc_ll_bits_t sync; ///< SYNC: bit stuffing encoder
+#endif
         } tx;
+#ifdef CONFIG_ENABLE_FEC
+        struct
+        {
+            uint8_t *gen;    ///< generator polynomial, located in the buffer, followed by parity bytes
+            uint8_t *parity; ///< parity bytes of current tx block
+            int (*next_state)(hdlc_ll_handle_t handle);
+            uint32_t corrected;
+            uint32_t failed;
+            uint8_t roots;
+            uint8_t block_left; ///< data bytes left in current tx block
+            uint8_t parity_pos; ///< next parity byte to send
+        } fec;
+#endif
 #endif
     } hdlc_ll_data_t;
 
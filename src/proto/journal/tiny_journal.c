@@ -0,0 +1,405 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tiny_journal.h"
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JOURNAL_FILE_SUPPORT
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define JOURNAL_BARRIER() __sync_synchronize()
+#else
+#define JOURNAL_BARRIER()
+#endif
+
+#define JOURNAL_MAGIC 0x4C4E4A54 // "TJNL"
+#define JOURNAL_RECORD_WRAP 0xFFFF
+#define JOURNAL_RECORD_DONE 0x01
+
+#define ALIGN4(x) (((x) + 3) & ~3U)
+
+/**
+ * Record in the journal ring. Frame data follow the header.
+ * Record with JOURNAL_RECORD_WRAP length marks the end of data before ring wrap.
+ */
+typedef struct
+{
+    uint16_t len;
+    uint8_t flags;
+    uint8_t reserved;
+} tiny_journal_record_t;
+
+struct tiny_journal_t
+{
+    /* Persistent part, kept in the journal memory between restarts */
+    uint32_t magic;
+    uint32_t header_size;
+    uint32_t size; ///< size of records ring
+    volatile uint32_t head; ///< first not confirmed record
+    volatile uint32_t tail; ///< free space after last record
+
+    /* Runtime part, initialized on every start */
+    uint8_t *data;
+    uint32_t backlog_pos; ///< next backlog record to send
+    uint32_t backlog_end; ///< first record, appended after connection
+    uint32_t live_pos;    ///< next new record to send
+    uint32_t last_replay_ts;
+    uint8_t replay_started;
+    uint16_t replay_rate;
+    int count;
+#ifdef JOURNAL_FILE_SUPPORT
+    int fd;
+    size_t map_size;
+#endif
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline tiny_journal_record_t *__record(tiny_journal_handle_t journal, uint32_t pos)
+{
+    return (tiny_journal_record_t *)(journal->data + pos);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint32_t __skip_wrap(tiny_journal_handle_t journal, uint32_t pos)
+{
+    if ( pos == journal->size || (pos != journal->tail && __record(journal, pos)->len == JOURNAL_RECORD_WRAP) )
+    {
+        return 0;
+    }
+    return pos;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint32_t __next(tiny_journal_handle_t journal, uint32_t pos)
+{
+    return __skip_wrap(journal, pos + ALIGN4(sizeof(tiny_journal_record_t) + __record(journal, pos)->len));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline void __normalize_cursors(tiny_journal_handle_t journal)
+{
+    // Cursor can point to the position, where wrap marker was put after the cursor was set
+    journal->backlog_pos = __skip_wrap(journal, journal->backlog_pos);
+    journal->backlog_end = __skip_wrap(journal, journal->backlog_end);
+    journal->live_pos = __skip_wrap(journal, journal->live_pos);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static bool __restore(tiny_journal_handle_t journal, uint32_t size)
+{
+    if ( journal->magic != JOURNAL_MAGIC || journal->header_size != sizeof(struct tiny_journal_t) ||
+         journal->size != size || journal->head >= size || journal->tail >= size || (journal->head & 3) ||
+         (journal->tail & 3) )
+    {
+        return false;
+    }
+    // Walk the records to check the journal consistency and count not confirmed frames
+    uint32_t pos = __skip_wrap(journal, journal->head);
+    uint32_t steps = size / sizeof(tiny_journal_record_t);
+    journal->count = 0;
+    while ( pos != journal->tail )
+    {
+        uint16_t len = __record(journal, pos)->len;
+        if ( !steps-- || len == JOURNAL_RECORD_WRAP || pos + ALIGN4(sizeof(tiny_journal_record_t) + len) > size )
+        {
+            return false;
+        }
+        if ( !(__record(journal, pos)->flags & JOURNAL_RECORD_DONE) )
+        {
+            journal->count++;
+        }
+        pos = __next(journal, pos);
+    }
+    journal->head = __skip_wrap(journal, journal->head);
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_journal_init(tiny_journal_handle_t *journal, const tiny_journal_init_t *init)
+{
+    *journal = NULL;
+    uint32_t header = ALIGN4(sizeof(struct tiny_journal_t));
+    if ( !init->buffer || ((uintptr_t)init->buffer & (sizeof(uintptr_t) - 1)) || init->buffer_size < 0 ||
+         (uint32_t)init->buffer_size < header + 2 * sizeof(tiny_journal_record_t) )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    struct tiny_journal_t *data = (struct tiny_journal_t *)init->buffer;
+    uint32_t size = ((uint32_t)init->buffer_size - header) & ~3U;
+    data->data = (uint8_t *)init->buffer + header;
+    if ( !__restore(data, size) )
+    {
+        data->magic = 0;
+        data->header_size = sizeof(struct tiny_journal_t);
+        data->size = size;
+        data->head = 0;
+        data->tail = 0;
+        data->count = 0;
+        JOURNAL_BARRIER();
+        data->magic = JOURNAL_MAGIC;
+    }
+    data->replay_rate = init->replay_rate;
+#ifdef JOURNAL_FILE_SUPPORT
+    data->fd = -1;
+    data->map_size = 0;
+#endif
+    tiny_journal_restart(data);
+    *journal = data;
+    return TINY_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_journal_open_file(tiny_journal_handle_t *journal, const char *path, const tiny_journal_init_t *init)
+{
+    *journal = NULL;
+#ifdef JOURNAL_FILE_SUPPORT
+    if ( init->buffer_size <= 0 )
+    {
+        return TINY_ERR_INVALID_DATA;
+    }
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if ( fd < 0 )
+    {
+        return TINY_ERR_FAILED;
+    }
+    struct stat st;
+    if ( fstat(fd, &st) != 0 || (st.st_size < init->buffer_size && ftruncate(fd, init->buffer_size) != 0) )
+    {
+        close(fd);
+        return TINY_ERR_FAILED;
+    }
+    void *map = mmap(NULL, init->buffer_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if ( map == MAP_FAILED )
+    {
+        close(fd);
+        return TINY_ERR_FAILED;
+    }
+    tiny_journal_init_t file_init = *init;
+    file_init.buffer = map;
+    int result = tiny_journal_init(journal, &file_init);
+    if ( result != TINY_SUCCESS )
+    {
+        munmap(map, init->buffer_size);
+        close(fd);
+        return result;
+    }
+    (*journal)->fd = fd;
+    (*journal)->map_size = init->buffer_size;
+    return TINY_SUCCESS;
+#else
+    (void)path;
+    (void)init;
+    return TINY_ERR_FAILED;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_journal_close(tiny_journal_handle_t journal)
+{
+#ifdef JOURNAL_FILE_SUPPORT
+    if ( journal->fd >= 0 )
+    {
+        int fd = journal->fd;
+        size_t map_size = journal->map_size;
+        msync(journal, map_size, MS_SYNC);
+        munmap(journal, map_size);
+        close(fd);
+    }
+#else
+    (void)journal;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_journal_sync(tiny_journal_handle_t journal)
+{
+#ifdef JOURNAL_FILE_SUPPORT
+    if ( journal->fd >= 0 && msync(journal, journal->map_size, MS_SYNC) != 0 )
+    {
+        return TINY_ERR_FAILED;
+    }
+#else
+    (void)journal;
+#endif
+    return TINY_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_journal_get_count(tiny_journal_handle_t journal)
+{
+    return journal->count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int tiny_journal_append(tiny_journal_handle_t journal, const void *data, int len)
+{
+    if ( len < 0 || len >= JOURNAL_RECORD_WRAP )
+    {
+        return TINY_ERR_DATA_TOO_LARGE;
+    }
+    uint32_t need = ALIGN4(sizeof(tiny_journal_record_t) + len);
+    uint32_t head = journal->head;
+    uint32_t tail = journal->tail;
+    uint32_t pos;
+    // Keep at least one free word, so head == tail always means empty journal
+    if ( tail >= head )
+    {
+        if ( journal->size - tail > need || (journal->size - tail == need && head > 0) )
+        {
+            pos = tail;
+        }
+        else if ( head > need )
+        {
+            pos = 0;
+        }
+        else
+        {
+            return need >= journal->size ? TINY_ERR_DATA_TOO_LARGE : TINY_ERR_BUSY;
+        }
+    }
+    else if ( head - tail > need )
+    {
+        pos = tail;
+    }
+    else
+    {
+        return TINY_ERR_BUSY;
+    }
+    tiny_journal_record_t *record = __record(journal, pos);
+    record->len = (uint16_t)len;
+    record->flags = 0;
+    record->reserved = 0;
+    memcpy(record + 1, data, len);
+    if ( pos != tail )
+    {
+        __record(journal, tail)->len = JOURNAL_RECORD_WRAP;
+    }
+    // Record must be complete in the memory before it becomes visible after restart
+    JOURNAL_BARRIER();
+    pos += need;
+    journal->tail = pos == journal->size ? 0 : pos;
+    journal->count++;
+    return TINY_SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_journal_restart(tiny_journal_handle_t journal)
+{
+    journal->backlog_pos = journal->head;
+    journal->backlog_end = journal->tail;
+    journal->live_pos = journal->tail;
+    journal->replay_started = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int32_t tiny_journal_peek(tiny_journal_handle_t journal, uint32_t ts, const uint8_t **data, int *len)
+{
+    __normalize_cursors(journal);
+    uint32_t pos = journal->live_pos;
+    if ( pos == journal->tail )
+    {
+        // No new frames, look for backlog frames, which were not confirmed during previous connection
+        while ( journal->backlog_pos != journal->backlog_end &&
+                (__record(journal, journal->backlog_pos)->flags & JOURNAL_RECORD_DONE) )
+        {
+            journal->backlog_pos = __next(journal, journal->backlog_pos);
+        }
+        pos = journal->backlog_pos;
+        if ( pos == journal->backlog_end )
+        {
+            return -1;
+        }
+        if ( journal->replay_rate && journal->replay_started &&
+             (uint32_t)(ts - journal->last_replay_ts) < 1000U / journal->replay_rate )
+        {
+            return -1;
+        }
+    }
+    *data = (const uint8_t *)(__record(journal, pos) + 1);
+    *len = __record(journal, pos)->len;
+    return (int32_t)pos;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_journal_take(tiny_journal_handle_t journal, int32_t pos, uint32_t ts)
+{
+    __normalize_cursors(journal);
+    if ( (uint32_t)pos == journal->live_pos && journal->live_pos != journal->tail )
+    {
+        journal->live_pos = __next(journal, journal->live_pos);
+    }
+    else if ( (uint32_t)pos == journal->backlog_pos )
+    {
+        journal->backlog_pos = __next(journal, journal->backlog_pos);
+        journal->last_replay_ts = ts;
+        journal->replay_started = 1;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tiny_journal_confirm(tiny_journal_handle_t journal, int32_t pos)
+{
+    tiny_journal_record_t *record = __record(journal, (uint32_t)pos);
+    if ( record->flags & JOURNAL_RECORD_DONE )
+    {
+        return;
+    }
+    record->flags |= JOURNAL_RECORD_DONE;
+    journal->count--;
+    __normalize_cursors(journal);
+    // Head can point to the wrap marker, if the ring wrapped while the journal was empty
+    journal->head = __skip_wrap(journal, journal->head);
+    // Trim confirmed records at the beginning of the journal
+    while ( journal->head != journal->tail && (__record(journal, journal->head)->flags & JOURNAL_RECORD_DONE) )
+    {
+        uint32_t next = __next(journal, journal->head);
+        if ( journal->backlog_pos == journal->head )
+        {
+            journal->backlog_pos = next;
+        }
+        if ( journal->backlog_end == journal->head )
+        {
+            journal->backlog_end = next;
+        }
+        JOURNAL_BARRIER();
+        journal->head = next;
+    }
+}
@@ -0,0 +1,176 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ This is persistent tx journal for Tiny Protocol
+
+ @file
+ @brief Append-only journal of outgoing frames for store-and-forward over intermittent links
+*/
+#pragma once
+
+#include "hal/tiny_types.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**
+     * @defgroup JOURNAL_API Tx journal API functions
+     * @{
+     *
+     * @brief append-only journal of outgoing frames
+     *
+     * @details Journal keeps frames, which are sent by the application, until the remote side confirms them.
+     *          If full duplex protocol uses the journal (see tiny_fd_init_t::journal), tiny_fd_send_packet()
+     *          appends the frame to the journal even if the link is down, and the protocol moves frames from the
+     *          journal to the window, when the connection is established. Frames are removed from the journal
+     *          on acknowledgement only, so they survive disconnects. If the journal memory survives restart
+     *          (memory mapped file, battery backed RAM), the frames survive application restart too.
+     *          Frames, which were in the window during disconnect, are sent once again after reconnect,
+     *          so the remote side can receive some frames twice.
+     *
+     *          When the connection is established, the frames appended before (backlog) are replayed with
+     *          the rate, limited by replay_rate, while new frames are sent as soon as the window allows.
+     *
+     *          Journal functions are not thread-safe, tiny_fd calls them under its own mutex.
+     */
+
+    struct tiny_journal_t;
+
+    /**
+     * Handle of the journal
+     */
+    typedef struct tiny_journal_t *tiny_journal_handle_t;
+
+    /**
+     * Journal initialization parameters. Initialize this structure by 0 before filling.
+     */
+    typedef struct
+    {
+        /// memory for the journal. If the memory keeps valid journal, its content is restored.
+        void *buffer;
+
+        /// size of the memory in bytes
+        int buffer_size;
+
+        /// maximum number of backlog frames per second, replayed after connection, 0 - no limit
+        uint16_t replay_rate;
+    } tiny_journal_init_t;
+
+    /**
+     * Initializes the journal in the user memory. If the memory contains valid journal of the same size,
+     * the journal records are restored, otherwise the journal is empty.
+     *
+     * @param journal pointer to journal handle variable
+     * @param init initialization parameters
+     * @return TINY_SUCCESS or TINY_ERR_INVALID_DATA if the memory is too small
+     */
+    extern int tiny_journal_init(tiny_journal_handle_t *journal, const tiny_journal_init_t *init);
+
+    /**
+     * Opens the journal in memory mapped file. The file is created, if it doesn't exist.
+     * Supported on Linux and macOS only.
+     *
+     * @param journal pointer to journal handle variable
+     * @param path path to the journal file
+     * @param init initialization parameters, buffer_size is size of the file, buffer is not used
+     * @return TINY_SUCCESS or TINY_ERR_FAILED if the file can't be mapped
+     */
+    extern int tiny_journal_open_file(tiny_journal_handle_t *journal, const char *path,
+                                      const tiny_journal_init_t *init);
+
+    /**
+     * Closes the journal. If the journal is opened by tiny_journal_open_file(), the file is synced and unmapped.
+     * Protocol, which uses the journal, must be closed before.
+     *
+     * @param journal journal handle
+     */
+    extern void tiny_journal_close(tiny_journal_handle_t journal);
+
+    /**
+     * Flushes the journal file to the storage. Does nothing for journal in user memory.
+     *
+     * @param journal journal handle
+     * @return TINY_SUCCESS or TINY_ERR_FAILED
+     */
+    extern int tiny_journal_sync(tiny_journal_handle_t journal);
+
+    /**
+     * Returns number of frames in the journal, which are not confirmed yet.
+     *
+     * @param journal journal handle
+     */
+    extern int tiny_journal_get_count(tiny_journal_handle_t journal);
+
+    /**
+     * Appends frame to the journal.
+     *
+     * @param journal journal handle
+     * @param data frame data
+     * @param len frame length, up to 65534 bytes
+     * @return TINY_SUCCESS, TINY_ERR_BUSY if the journal is full, or TINY_ERR_DATA_TOO_LARGE
+     */
+    extern int tiny_journal_append(tiny_journal_handle_t journal, const void *data, int len);
+
+    /**
+     * Starts new replay: all frames in the journal become backlog. Called, when connection is established.
+     *
+     * @param journal journal handle
+     */
+    extern void tiny_journal_restart(tiny_journal_handle_t journal);
+
+    /**
+     * Returns the next frame to send without taking it. New frames go first, backlog frames are
+     * returned, only if replay_rate allows.
+     *
+     * @param journal journal handle
+     * @param ts current timestamp in milliseconds, used to pace backlog replay
+     * @param data pointer to variable to receive frame data
+     * @param len pointer to variable to receive frame length
+     * @return position of the frame in the journal, or negative value if there is nothing to send
+     */
+    extern int32_t tiny_journal_peek(tiny_journal_handle_t journal, uint32_t ts, const uint8_t **data, int *len);
+
+    /**
+     * Marks frame, returned by tiny_journal_peek(), as sent.
+     *
+     * @param journal journal handle
+     * @param pos position of the frame
+     * @param ts current timestamp in milliseconds
+     */
+    extern void tiny_journal_take(tiny_journal_handle_t journal, int32_t pos, uint32_t ts);
+
+    /**
+     * Marks frame as confirmed. Confirmed frames at the beginning of the journal are trimmed.
+     *
+     * @param journal journal handle
+     * @param pos position of the frame
+     */
+    extern void tiny_journal_confirm(tiny_journal_handle_t journal, int32_t pos);
+
+    /**
+     * @}
+     */
+
+#ifdef __cplusplus
+}
+#endif
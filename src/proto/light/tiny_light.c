@@ -43,6 +43,9 @@
 #define TINY_ESCAPE_CHAR 0x7D
 #define TINY_ESCAPE_BIT 0x20
 
+/* Compilation fails here, if hdlc low level data don't fit the buffer of STinyLightData */
+typedef char tiny_light_buf_size_check_t[(sizeof(hdlc_ll_data_t) <= LIGHT_BUF_SIZE) ? 1 : -1];
+
 //////////////////////////////////////////////////////////////////////////////
 
 /**************************************************************
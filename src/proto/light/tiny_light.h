@@ -46,9 +46,14 @@ extern "C"
  *************************************************************/
 
 /**
- * This macro defines buffer size required for tiny light protocol
+ * This macro defines buffer size required for tiny light protocol.
+ * Optional features of hdlc low level (framing modes, capture, FEC) need bigger buffer.
  */
+#if defined(CONFIG_ENABLE_FRAMING) || defined(CONFIG_ENABLE_CAPTURE) || defined(CONFIG_ENABLE_FEC)
+#define LIGHT_BUF_SIZE (sizeof(uintptr_t) * 32)
+#else
 #define LIGHT_BUF_SIZE (sizeof(uintptr_t) * 16)
+#endif
 
     /**
      * This structure contains information about communication channel and its state.
@@ -25,6 +25,15 @@
 #include <thread>
 #include "helpers/tiny_fd_helper.h"
 #include "helpers/fake_connection.h"
+#include "helpers/fake_spi.h"
+#include "helpers/virtual_connection.h"
+#include "proto/fd/tiny_fd_runtime.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 TEST_GROUP(FD){void setup(){
     // ...
@@ -253,6 +262,1572 @@ TEST(FD, resend_timeout)
 
 TEST(FD, singlethread_basic)
 {
-    // TODO:
-    CHECK_EQUAL(0, 0);
+    struct Peer
+    {
+        uint8_t buffer[1024];
+        tiny_fd_handle_t handle;
+        int rx_count;
+    } peers[2]{};
+    for ( Peer &peer : peers )
+    {
+        tiny_fd_init_t init{};
+        init.pdata = &peer;
+        init.on_frame_cb = [](void *udata, uint8_t *data, int len) -> void {
+            reinterpret_cast<Peer *>(udata)->rx_count++;
+        };
+        init.buffer = peer.buffer;
+        init.buffer_size = sizeof(peer.buffer);
+        init.window_frames = 7;
+        init.send_timeout = 1000;
+        init.retry_timeout = 100;
+        init.retries = 2;
+        init.crc_type = HDLC_CRC_16;
+        init.single_thread = 1;
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_init(&peer.handle, &init));
+    }
+    int nsent = 0;
+    uint32_t start_ms = tiny_millis();
+    // Both endpoints and the line are served by the same thread
+    while ( peers[1].rx_count < 200 && static_cast<uint32_t>(tiny_millis() - start_ms) < 2000 )
+    {
+        uint8_t txbuf[4] = {0xAA, 0xFF, 0xCC, 0x66};
+        // send_timeout must be ignored in single thread mode, since nobody can free the queue
+        while ( nsent < 200 && tiny_fd_send_packet(peers[0].handle, txbuf, sizeof(txbuf)) == TINY_SUCCESS )
+        {
+            nsent++;
+        }
+        uint8_t buf[2][64];
+        int len0 = tiny_fd_get_tx_data(peers[0].handle, buf[0], sizeof(buf[0]));
+        int len1 = tiny_fd_get_tx_data(peers[1].handle, buf[1], sizeof(buf[1]));
+        tiny_fd_on_rx_data(peers[1].handle, buf[0], len0);
+        tiny_fd_on_rx_data(peers[0].handle, buf[1], len1);
+    }
+    CHECK_EQUAL(200, peers[1].rx_count);
+    for ( Peer &peer : peers )
+    {
+        tiny_fd_close(peer.handle);
+    }
+}
+
+class VirtualFdPeer
+{
+public:
+    VirtualFdPeer(int mtu, int window, uint8_t retries = 2, const tiny_platform_hal_t *hal = VirtualConnection::hal())
+        : VirtualFdPeer(mtu, window, [=](tiny_fd_init_t &init) {
+            init.retries = retries;
+            init.hal = hal;
+        })
+    {
+    }
+
+    /**
+     * Creates the peer with default settings, which are adjusted by setup callback before tiny_fd_init().
+     * The buffer is sized for the features, enabled by the callback.
+     */
+    VirtualFdPeer(int mtu, int window, const std::function<void(tiny_fd_init_t &)> &setup)
+    {
+        tiny_fd_init_t init{};
+        init.pdata = this;
+        init.on_frame_cb = onFrame;
+        init.on_expired_cb = onExpired;
+        init.window_frames = window;
+        init.send_timeout = 0;
+        init.retry_timeout = 100;
+        init.retries = 2;
+        init.crc_type = HDLC_CRC_16;
+        init.mtu = mtu;
+        init.hal = VirtualConnection::hal();
+        setup(init);
+        m_buffer.resize((init.arena ? tiny_fd_buffer_size_with_arena(mtu, window, init.crc_type)
+                                    : tiny_fd_buffer_size_by_mtu_ex(mtu, window, init.crc_type)) +
+                        tiny_fd_buffer_size_fec_overhead(mtu, init.crc_type, init.fec_roots) +
+                        tiny_fd_buffer_size_links_overhead(mtu, init.crc_type, init.fec_roots, init.links));
+        init.buffer = m_buffer.data();
+        init.buffer_size = m_buffer.size();
+        result = tiny_fd_init(&handle, &init);
+    }
+
+    /**
+     * Setup callback helper, which passes received and sent messages to the peer in batches
+     */
+    static void useBatchCallbacks(tiny_fd_init_t &init)
+    {
+        init.on_frame_cb = nullptr;
+        init.on_frame_batch_cb = onFrames;
+        init.on_sent_batch_cb = onSentFrames;
+    }
+
+    ~VirtualFdPeer()
+    {
+        if ( handle )
+        {
+            tiny_fd_close(handle);
+        }
+    }
+
+    bool connected()
+    {
+        return tiny_fd_get_status(handle) == TINY_SUCCESS;
+    }
+
+    tiny_fd_handle_t handle = nullptr;
+    int result = TINY_ERR_FAILED;
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<std::vector<uint8_t>> sent;
+    std::vector<std::vector<uint8_t>> expired;
+    int frame_calls = 0;
+    int sent_calls = 0;
+
+private:
+    std::vector<uint8_t> m_buffer;
+
+    static void onFrame(void *udata, uint8_t *data, int len)
+    {
+        reinterpret_cast<VirtualFdPeer *>(udata)->frames.emplace_back(data, data + len);
+    }
+
+    static void onExpired(void *udata, uint8_t *data, int len)
+    {
+        reinterpret_cast<VirtualFdPeer *>(udata)->expired.emplace_back(data, data + len);
+    }
+
+    static void onFrames(void *udata, const tiny_fd_message_t *messages, int count)
+    {
+        VirtualFdPeer *peer = reinterpret_cast<VirtualFdPeer *>(udata);
+        CHECK(count > 0 && count <= CONFIG_FD_BATCH_SIZE);
+        peer->frame_calls++;
+        for ( int i = 0; i < count; i++ )
+        {
+            peer->frames.emplace_back(messages[i].data, messages[i].data + messages[i].len);
+        }
+    }
+
+    static void onSentFrames(void *udata, const tiny_fd_message_t *messages, int count)
+    {
+        VirtualFdPeer *peer = reinterpret_cast<VirtualFdPeer *>(udata);
+        CHECK(count > 0 && count <= CONFIG_FD_BATCH_SIZE);
+        peer->sent_calls++;
+        for ( int i = 0; i < count; i++ )
+        {
+            peer->sent.emplace_back(messages[i].data, messages[i].data + messages[i].len);
+        }
+    }
+};
+
+/**
+ * Sends count frames with sequence number in the first 2 bytes and returns virtual time spent
+ */
+static uint64_t virtual_transfer(VirtualConnection &conn, VirtualFdPeer &src, VirtualFdPeer &dst, int count, int size)
+{
+    uint64_t start = VirtualConnection::now();
+    std::vector<uint8_t> payload(size, 0x7E);
+    for ( int i = 0; i < count; )
+    {
+        payload[0] = i & 0xFF;
+        payload[1] = i >> 8;
+        if ( tiny_fd_send_packet(src.handle, payload.data(), size) == TINY_SUCCESS )
+        {
+            i++;
+            continue;
+        }
+        // Window is full, let the line work for a while
+        conn.run(1000);
+        if ( VirtualConnection::now() - start > 60000000ULL )
+        {
+            break;
+        }
+    }
+    conn.runUntil([&]() -> bool { return dst.frames.size() >= (size_t)count; }, 10000000);
+    return VirtualConnection::now() - start;
+}
+
+TEST_GROUP(FD_SIM){};
+
+TEST(FD_SIM, connect_and_transfer)
+{
+    VirtualConnection conn;
+    VirtualFdPeer peer1(64, 7);
+    VirtualFdPeer peer2(64, 7);
+    conn.attach(peer1.handle, peer2.handle);
+    CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+    uint64_t duration = virtual_transfer(conn, peer1, peer2, 200, 32);
+    CHECK_EQUAL(200, (int)peer2.frames.size());
+    for ( int i = 0; i < 200; i++ )
+    {
+        CHECK_EQUAL(i, peer2.frames[i][0] | (peer2.frames[i][1] << 8));
+    }
+    // Each 32-byte frame takes at least 3.2 ms at 115200 baud due to byte stuffing
+    CHECK(duration >= 200 * 3200);
+    CHECK(duration < 200 * 3200 * 2);
+    tiny_fd_stats_t stats1{}, stats2{};
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_get_stats(peer1.handle, &stats1));
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_get_stats(peer2.handle, &stats2));
+    CHECK_EQUAL(200, (int)stats1.tx_i_frames);
+    CHECK_EQUAL(200, (int)stats2.rx_i_frames);
+    CHECK_EQUAL(0, (int)stats1.retransmits);
+    CHECK_EQUAL(0, (int)stats2.crc_errors);
+}
+
+TEST(FD_SIM, high_speed_link)
+{
+    VirtualConnection conn;
+    VirtualLineConfig config;
+    config.baud = 10000000;
+    config.latency_us = 200;
+    conn.setConfig(config);
+    VirtualFdPeer peer1(256, 7);
+    VirtualFdPeer peer2(256, 7);
+    conn.attach(peer1.handle, peer2.handle);
+    CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+    virtual_transfer(conn, peer1, peer2, 300, 256);
+    CHECK_EQUAL(300, (int)peer2.frames.size());
+}
+
+TEST(FD_SIM, recovery_from_line_errors)
+{
+    VirtualConnection conn(7);
+    VirtualLineConfig config;
+    config.latency_us = 2000;
+    config.jitter_us = 1000;
+    config.ber = 1e-4;
+    config.drop_rate = 1e-4;
+    conn.setConfig(config);
+    VirtualFdPeer peer1(64, 7, 10);
+    VirtualFdPeer peer2(64, 7, 10);
+    conn.attach(peer1.handle, peer2.handle);
+    CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+    virtual_transfer(conn, peer1, peer2, 200, 32);
+    CHECK(conn.corruptedBits(0) > 0);
+    CHECK_EQUAL(200, (int)peer2.frames.size());
+    tiny_fd_stats_t stats1{}, stats2{};
+    tiny_fd_get_stats(peer1.handle, &stats1);
+    tiny_fd_get_stats(peer2.handle, &stats2);
+    CHECK(stats2.crc_errors > 0);
+    CHECK(stats1.retransmits > 0);
+    CHECK_EQUAL(200 + stats1.retransmits, stats1.tx_i_frames);
+    for ( int i = 0; i < 200; i++ )
+    {
+        CHECK_EQUAL(i, peer2.frames[i][0] | (peer2.frames[i][1] << 8));
+    }
+}
+
+TEST(FD_SIM, ring_with_non_power_of_2_window)
+{
+    // Windows 3 and 5 use 4 and 8 slots in the tx ring. Frames must not overlap on ring wrap and retransmissions
+    for ( uint8_t window : {3, 5} )
+    {
+        VirtualConnection conn(window);
+        VirtualLineConfig config;
+        config.ber = 1e-4;
+        conn.setConfig(config);
+        VirtualFdPeer peer1(48, window, 10);
+        VirtualFdPeer peer2(48, window, 10);
+        conn.attach(peer1.handle, peer2.handle);
+        CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+        virtual_transfer(conn, peer1, peer2, 100, 48);
+        CHECK_EQUAL(100, (int)peer2.frames.size());
+        for ( int i = 0; i < 100; i++ )
+        {
+            CHECK_EQUAL(48, (int)peer2.frames[i].size());
+            CHECK_EQUAL(i, peer2.frames[i][0] | (peer2.frames[i][1] << 8));
+            CHECK_EQUAL(0x7E, peer2.frames[i][47]);
+        }
+    }
+}
+
+#ifdef CONFIG_ENABLE_FEC
+TEST(FD_SIM, forward_error_correction)
+{
+    // Errors of single run depend on the seed too much, so the modes are compared over several runs.
+    // FEC halves retransmissions and transfer time, and the checks require only 1.5 times to hold for any seeds
+    const int seeds = 8;
+    uint64_t durations[2]{};
+    uint32_t retransmits[2]{};
+    uint32_t corrected[2]{};
+    for ( int fec = 0; fec < 2; fec++ )
+    {
+        for ( int seed = 1; seed <= seeds; seed++ )
+        {
+            VirtualConnection conn(seed);
+            VirtualLineConfig config;
+            config.ber = 5e-4;
+            conn.setConfig(config);
+            auto setup = [&](tiny_fd_init_t &init) {
+                init.retries = 10;
+                init.fec_roots = fec ? 8 : 0;
+            };
+            VirtualFdPeer peer1(64, 7, setup);
+            VirtualFdPeer peer2(64, 7, setup);
+            conn.attach(peer1.handle, peer2.handle);
+            CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+            durations[fec] += virtual_transfer(conn, peer1, peer2, 200, 48);
+            CHECK_EQUAL(200, (int)peer2.frames.size());
+            for ( int i = 0; i < 200; i++ )
+            {
+                CHECK_EQUAL(i, peer2.frames[i][0] | (peer2.frames[i][1] << 8));
+            }
+            tiny_fd_stats_t tx_stats{};
+            tiny_fd_stats_t rx_stats{};
+            tiny_fd_get_stats(peer1.handle, &tx_stats);
+            tiny_fd_get_stats(peer2.handle, &rx_stats);
+            retransmits[fec] += tx_stats.retransmits;
+            corrected[fec] += rx_stats.fec_corrected;
+        }
+    }
+    // Corrupted bytes are corrected by receiver instead of go-back-N retransmission.
+    // Frames with corrupted flag or escape bytes are still lost and retransmitted.
+    CHECK_EQUAL(0, (int)corrected[0]);
+    CHECK(corrected[1] > 0);
+    CHECK(retransmits[1] * 3 < retransmits[0] * 2);
+    CHECK(durations[1] * 3 < durations[0] * 2);
+}
+#endif
+
+#ifdef CONFIG_ENABLE_FRAMING
+TEST(FD_SIM, framing_modes)
+{
+    // Payload of virtual_transfer() is full of 0x7E bytes, which are escaped by async framing
+    const hdlc_framing_t modes[] = {HDLC_FRAMING_ASYNC, HDLC_FRAMING_COBS, HDLC_FRAMING_LENGTH, HDLC_FRAMING_SYNC};
+    uint64_t durations[4]{};
+    for ( int mode = 0; mode < 4; mode++ )
+    {
+        VirtualConnection conn;
+        auto setup = [&](tiny_fd_init_t &init) { init.framing = modes[mode]; };
+        VirtualFdPeer peer1(64, 7, setup);
+        VirtualFdPeer peer2(64, 7, setup);
+        conn.attach(peer1.handle, peer2.handle);
+        CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+        durations[mode] = virtual_transfer(conn, peer1, peer2, 200, 48);
+        CHECK_EQUAL(200, (int)peer2.frames.size());
+        for ( int i = 0; i < 200; i++ )
+        {
+            CHECK_EQUAL(i, peer2.frames[i][0] | (peer2.frames[i][1] << 8));
+            CHECK_EQUAL(48, (int)peer2.frames[i].size());
+            CHECK_EQUAL(0x7E, peer2.frames[i][47]);
+        }
+    }
+    CHECK(durations[1] * 3 < durations[0] * 2);
+    CHECK(durations[2] * 3 < durations[0] * 2);
+    CHECK(durations[3] * 3 < durations[0] * 2);
+}
+#endif
+
+#ifdef CONFIG_ENABLE_FD_BONDING
+TEST(FD_SIM, bonded_links)
+{
+    // Link 0 is 2 times faster than link 1, so the session must be faster than over link 0 alone
+    uint64_t durations[2]{};
+    for ( uint8_t links = 1; links <= 2; links++ )
+    {
+        VirtualConnection conn;
+        auto setup = [&](tiny_fd_init_t &init) { init.links = links; };
+        VirtualFdPeer peer1(64, 4, setup);
+        VirtualFdPeer peer2(64, 4, setup);
+        CHECK_EQUAL(TINY_SUCCESS, peer1.result);
+        conn.attach(peer1.handle, peer2.handle, links);
+        VirtualLineConfig slow;
+        slow.baud = 115200 / 2;
+        slow.latency_us = 1000;
+        if ( links > 1 )
+        {
+            conn.setConfig(2, slow);
+            conn.setConfig(3, slow);
+        }
+        CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+        durations[links - 1] = virtual_transfer(conn, peer1, peer2, 200, 32);
+        CHECK_EQUAL(200, (int)peer2.frames.size());
+        for ( int i = 0; i < 200; i++ )
+        {
+            CHECK_EQUAL(i, peer2.frames[i][0] | (peer2.frames[i][1] << 8));
+        }
+        tiny_fd_stats_t stats{};
+        tiny_fd_get_stats(peer2.handle, &stats);
+        CHECK_EQUAL(links > 1, stats.reordered > 0);
+        if ( links > 1 )
+        {
+            CHECK(conn.sentBytes(2) > 200 * 32 / 10);
+        }
+    }
+    CHECK(durations[1] < durations[0]);
+}
+
+TEST(FD_SIM, bonded_links_failover)
+{
+    VirtualConnection conn;
+    auto setup = [](tiny_fd_init_t &init) { init.links = 3; };
+    VirtualFdPeer peer1(64, 4, setup);
+    VirtualFdPeer peer2(64, 4, setup);
+    conn.attach(peer1.handle, peer2.handle, 3);
+    tiny_fd_set_ka_timeout(peer1.handle, 300);
+    tiny_fd_set_ka_timeout(peer2.handle, 300);
+    CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+    virtual_transfer(conn, peer1, peer2, 100, 32);
+    CHECK_EQUAL(100, (int)peer2.frames.size());
+    // Link 1 dies in both directions: frames in flight are lost and resent over other links
+    VirtualLineConfig dead;
+    dead.drop_rate = 1.0;
+    conn.setConfig(2, dead);
+    conn.setConfig(3, dead);
+    uint64_t lost = conn.lostBytes(2);
+    peer2.frames.clear();
+    virtual_transfer(conn, peer1, peer2, 200, 32);
+    CHECK_EQUAL(200, (int)peer2.frames.size());
+    for ( int i = 0; i < 200; i++ )
+    {
+        CHECK_EQUAL(i, peer2.frames[i][0] | (peer2.frames[i][1] << 8));
+    }
+    CHECK(peer1.connected());
+    // Dead link carries only rare probes, while it is not alive
+    CHECK(conn.lostBytes(2) - lost < 200 * 32 / 10);
+    tiny_fd_stats_t stats{};
+    tiny_fd_get_stats(peer1.handle, &stats);
+    CHECK(stats.retransmits > 0);
+
+    // Link 1 comes back and is used again
+    conn.setConfig(2, VirtualLineConfig());
+    conn.setConfig(3, VirtualLineConfig());
+    conn.run(1000000);
+    uint64_t sent = conn.sentBytes(2);
+    peer2.frames.clear();
+    virtual_transfer(conn, peer1, peer2, 100, 32);
+    CHECK_EQUAL(100, (int)peer2.frames.size());
+    CHECK(conn.sentBytes(2) - sent > 100 * 32 / 10);
+}
+
+TEST(FD_SIM, bonded_links_capture)
+{
+    // Links share the capture, so they must be served by single thread
+    uint8_t capture_buffer[1024];
+    tiny_capture_init_t capture_init{};
+    capture_init.buffer = capture_buffer;
+    capture_init.buffer_size = sizeof(capture_buffer);
+    capture_init.timestamp = []() -> uint64_t { return VirtualConnection::now(); };
+    capture_init.write_func = [](void *, const void *, int len) -> int { return len; };
+    tiny_capture_handle_t capture = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, tiny_capture_init(&capture, &capture_init));
+    for ( uint8_t single_thread = 0; single_thread < 2; single_thread++ )
+    {
+        VirtualFdPeer peer(64, 4, [&](tiny_fd_init_t &init) {
+            init.links = 2;
+            init.capture = capture;
+            init.single_thread = single_thread;
+        });
+        CHECK_EQUAL(single_thread ? TINY_SUCCESS : TINY_ERR_INVALID_DATA, peer.result);
+    }
+    tiny_capture_close(capture);
+}
+
+TEST(FD_SIM, bonded_links_noisy)
+{
+    // Slow links keep late copies of retransmitted frames on the wire, while the fast link wraps
+    // sequence numbers. Late copy must not be taken for the new frame with the same N(S)
+    for ( int seed = 1; seed <= 10; seed++ )
+    {
+        VirtualConnection conn(seed);
+        VirtualLineConfig noisy;
+        noisy.ber = 3e-4;
+        noisy.jitter_us = 3000;
+        conn.setConfig(noisy);
+        auto setup = [](tiny_fd_init_t &init) {
+            init.retries = 10;
+            init.links = 3;
+        };
+        VirtualFdPeer peer1(32, 4, setup);
+        VirtualFdPeer peer2(32, 4, setup);
+        conn.attach(peer1.handle, peer2.handle, 3);
+        VirtualLineConfig slow = noisy;
+        slow.baud = 19200;
+        slow.latency_us = 5000;
+        for ( int direction = 2; direction < 6; direction++ )
+        {
+            conn.setConfig(direction, slow);
+        }
+        CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+        virtual_transfer(conn, peer1, peer2, 500, 32);
+        CHECK_EQUAL(500, (int)peer2.frames.size());
+        for ( int i = 0; i < 500; i++ )
+        {
+            CHECK_EQUAL(i, peer2.frames[i][0] | (peer2.frames[i][1] << 8));
+        }
+    }
+}
+#endif
+
+TEST(FD_SIM, session_resumption)
+{
+    // Line goes down, while the window is full of frames. Resumed session delivers every frame exactly once,
+    // while new session loses the frames of flushed window
+    for ( uint8_t resume = 0; resume < 2; resume++ )
+    {
+        VirtualConnection conn;
+        auto setup = [&](tiny_fd_init_t &init) { init.resume = resume; };
+        VirtualFdPeer peer1(64, 7, setup);
+        VirtualFdPeer peer2(64, 7, setup);
+        tiny_fd_set_ka_timeout(peer1.handle, 300);
+        tiny_fd_set_ka_timeout(peer2.handle, 300);
+        conn.attach(peer1.handle, peer2.handle);
+        CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+        uint8_t payload[16] = {0};
+        auto send = [&](int first, int count) {
+            for ( int i = first; i < first + count; )
+            {
+                payload[0] = i;
+                if ( tiny_fd_send_packet(peer1.handle, payload, sizeof(payload)) == TINY_SUCCESS )
+                {
+                    i++;
+                }
+                else
+                {
+                    conn.run(1000);
+                }
+            }
+        };
+
+        send(0, 20);
+        CHECK(conn.runUntil([&]() -> bool { return peer2.frames.size() == 20; }, 1000000));
+        VirtualLineConfig dead;
+        dead.drop_rate = 1.0;
+        conn.setConfig(dead);
+        send(20, 5);
+        conn.run(2000000);
+        CHECK(!peer1.connected());
+        CHECK(!peer2.connected());
+
+        conn.setConfig(VirtualLineConfig());
+        CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 2000000));
+        send(25, 20);
+        conn.run(1000000);
+        tiny_fd_stats_t stats1{}, stats2{};
+        tiny_fd_get_stats(peer1.handle, &stats1);
+        tiny_fd_get_stats(peer2.handle, &stats2);
+        if ( resume )
+        {
+            CHECK_EQUAL(45, (int)peer2.frames.size());
+            for ( int i = 0; i < 45; i++ )
+            {
+                CHECK_EQUAL(i, peer2.frames[i][0]);
+            }
+            CHECK(stats1.resumes > 0);
+            CHECK(stats2.resumes > 0);
+        }
+        else
+        {
+            CHECK_EQUAL(40, (int)peer2.frames.size());
+            CHECK_EQUAL(19, peer2.frames[19][0]);
+            CHECK_EQUAL(25, peer2.frames[20][0]);
+            CHECK_EQUAL(0, (int)stats1.resumes);
+        }
+    }
+}
+
+#ifdef CONFIG_ENABLE_FD_ARENA
+TEST(FD_SIM, shared_arena)
+{
+    std::vector<uint8_t> buffer(tiny_fd_arena_buffer_size(64, 4));
+    tiny_fd_arena_handle_t arena = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_arena_init(&arena, buffer.data(), buffer.size(), 64));
+    CHECK_EQUAL(4, tiny_fd_arena_get_free_slots(arena));
+    {
+        VirtualConnection conn1;
+        VirtualConnection conn2;
+        VirtualFdPeer a1(64, 7, [&](tiny_fd_init_t &init) {
+            init.arena = arena;
+            init.arena_reserve = 2;
+        });
+        VirtualFdPeer a2(64, 7);
+        VirtualFdPeer b1(64, 7, [&](tiny_fd_init_t &init) {
+            init.arena = arena;
+            init.arena_reserve = 1;
+        });
+        VirtualFdPeer b2(64, 7);
+        CHECK_EQUAL(TINY_SUCCESS, a1.result);
+        CHECK_EQUAL(TINY_SUCCESS, b1.result);
+        // Only 1 slot is not reserved
+        VirtualFdPeer c1(64, 7, [&](tiny_fd_init_t &init) {
+            init.arena = arena;
+            init.arena_reserve = 2;
+        });
+        CHECK_EQUAL(TINY_ERR_INVALID_DATA, c1.result);
+        conn1.attach(a1.handle, a2.handle);
+        conn2.attach(b1.handle, b2.handle);
+        CHECK(conn1.runUntil([&]() -> bool { return a1.connected() && a2.connected(); }, 1000000));
+        CHECK(conn2.runUntil([&]() -> bool { return b1.connected() && b2.connected(); }, 1000000));
+        CHECK_EQUAL(4, tiny_fd_arena_get_free_slots(arena));
+
+        // a1 takes own reserve and the only unreserved slot, reserve of b1 is kept
+        uint8_t payload[64]{};
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(a1.handle, payload, sizeof(payload)));
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(a1.handle, payload, sizeof(payload)));
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(a1.handle, payload, sizeof(payload)));
+        CHECK_EQUAL(TINY_ERR_BUSY, tiny_fd_send_packet(a1.handle, payload, sizeof(payload)));
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(b1.handle, payload, sizeof(payload)));
+        CHECK_EQUAL(TINY_ERR_BUSY, tiny_fd_send_packet(b1.handle, payload, sizeof(payload)));
+        CHECK_EQUAL(0, tiny_fd_arena_get_free_slots(arena));
+        // Confirmed frames return slots to the arena
+        CHECK(conn1.runUntil([&]() -> bool { return a2.frames.size() == 3; }, 1000000));
+        CHECK(conn2.runUntil([&]() -> bool { return b2.frames.size() == 1; }, 1000000));
+        conn1.run(100000);
+        conn2.run(100000);
+        CHECK_EQUAL(4, tiny_fd_arena_get_free_slots(arena));
+
+        a2.frames.clear();
+        virtual_transfer(conn1, a1, a2, 100, 64);
+        CHECK_EQUAL(100, (int)a2.frames.size());
+        for ( int i = 0; i < 100; i++ )
+        {
+            CHECK_EQUAL(i, a2.frames[i][0] | (a2.frames[i][1] << 8));
+        }
+        // Unconfirmed frames are returned on close
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(b1.handle, payload, sizeof(payload)));
+    }
+    CHECK_EQUAL(4, tiny_fd_arena_get_free_slots(arena));
+    tiny_fd_arena_close(arena);
+}
+#endif
+
+#ifdef CONFIG_ENABLE_FD_AGGREGATION
+TEST(FD_SIM, aggregation_of_small_messages)
+{
+    uint64_t durations[2]{};
+    uint32_t i_frames[2]{};
+    for ( int aggregation = 0; aggregation < 2; aggregation++ )
+    {
+        VirtualConnection conn;
+        auto setup = [&](tiny_fd_init_t &init) { init.aggregation = aggregation; };
+        VirtualFdPeer peer1(64, 4, setup);
+        VirtualFdPeer peer2(64, 4, setup);
+        conn.attach(peer1.handle, peer2.handle);
+        CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+        durations[aggregation] = virtual_transfer(conn, peer1, peer2, 300, 2);
+        CHECK_EQUAL(300, (int)peer2.frames.size());
+        for ( int i = 0; i < 300; i++ )
+        {
+            CHECK_EQUAL(2, (int)peer2.frames[i].size());
+            CHECK_EQUAL(i, peer2.frames[i][0] | (peer2.frames[i][1] << 8));
+        }
+        tiny_fd_stats_t stats{};
+        tiny_fd_get_stats(peer1.handle, &stats);
+        i_frames[aggregation] = stats.tx_i_frames;
+    }
+    // Each I-frame carries many messages, and the line is not busy with headers and confirmations
+    CHECK_EQUAL(300, (int)i_frames[0]);
+    CHECK(i_frames[1] * 4 < i_frames[0]);
+    CHECK(durations[1] * 2 < durations[0]);
+}
+
+TEST(FD_SIM, batched_callbacks)
+{
+    VirtualConnection conn;
+    auto setup = [](tiny_fd_init_t &init) {
+        init.aggregation = 1;
+        VirtualFdPeer::useBatchCallbacks(init);
+    };
+    VirtualFdPeer peer1(64, 4, setup);
+    VirtualFdPeer peer2(64, 4, setup);
+    CHECK_EQUAL(TINY_SUCCESS, peer1.result);
+    conn.attach(peer1.handle, peer2.handle);
+    CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+
+    virtual_transfer(conn, peer1, peer2, 300, 2);
+    CHECK(conn.runUntil([&]() -> bool { return peer1.sent.size() >= 300; }, 1000000));
+    CHECK_EQUAL(300, (int)peer2.frames.size());
+    CHECK_EQUAL(300, (int)peer1.sent.size());
+    for ( int i = 0; i < 300; i++ )
+    {
+        CHECK_EQUAL(i, peer2.frames[i][0] | (peer2.frames[i][1] << 8));
+        CHECK_EQUAL(i, peer1.sent[i][0] | (peer1.sent[i][1] << 8));
+    }
+    // Messages of aggregated I-frames and cumulative confirmations come to the application in batches
+    CHECK(peer2.frame_calls * 4 < 300);
+    CHECK(peer1.sent_calls * 4 < 300);
+}
+
+TEST(FD_SIM, aggregation_message_size)
+{
+    VirtualConnection conn;
+    auto setup = [](tiny_fd_init_t &init) { init.aggregation = 1; };
+    VirtualFdPeer peer1(200, 4, setup);
+    VirtualFdPeer peer2(200, 4, setup);
+    conn.attach(peer1.handle, peer2.handle);
+    CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+    uint8_t payload[200]{};
+    // Messages of 128 bytes and longer need 2 bytes length prefix
+    CHECK_EQUAL(TINY_ERR_DATA_TOO_LARGE, tiny_fd_send_packet(peer1.handle, payload, 200));
+    CHECK_EQUAL(TINY_ERR_DATA_TOO_LARGE, tiny_fd_send_packet(peer1.handle, payload, 199));
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer1.handle, payload, 198));
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer1.handle, payload, 127));
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer1.handle, payload, 0));
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer1.handle, payload, 1));
+    CHECK(conn.runUntil([&]() -> bool { return peer2.frames.size() >= 4; }, 1000000));
+    CHECK_EQUAL(198, (int)peer2.frames[0].size());
+    CHECK_EQUAL(127, (int)peer2.frames[1].size());
+    CHECK_EQUAL(0, (int)peer2.frames[2].size());
+    CHECK_EQUAL(1, (int)peer2.frames[3].size());
+}
+
+TEST(FD_SIM, aggregation_delay)
+{
+    VirtualConnection conn;
+    auto setup = [](tiny_fd_init_t &init) {
+        init.aggregation = 1;
+        init.aggregation_delay = 50;
+    };
+    VirtualFdPeer peer1(64, 4, setup);
+    VirtualFdPeer peer2(64, 4, setup);
+    conn.attach(peer1.handle, peer2.handle);
+    CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+    uint8_t payload[4]{};
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer1.handle, payload, sizeof(payload)));
+    conn.run(20000);
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer1.handle, payload, sizeof(payload)));
+    conn.run(20000);
+    // I-frame is still open for new messages
+    CHECK_EQUAL(0, (int)peer2.frames.size());
+    conn.run(30000);
+    CHECK_EQUAL(2, (int)peer2.frames.size());
+    tiny_fd_stats_t stats{};
+    tiny_fd_get_stats(peer1.handle, &stats);
+    CHECK_EQUAL(1, (int)stats.tx_i_frames);
+}
+#endif
+
+#ifdef CONFIG_ENABLE_FD_JOURNAL
+static tiny_journal_handle_t init_journal(std::vector<uint8_t> &buffer, uint16_t replay_rate)
+{
+    tiny_journal_init_t init{};
+    init.buffer = buffer.data();
+    init.buffer_size = buffer.size();
+    init.replay_rate = replay_rate;
+    tiny_journal_handle_t journal = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, tiny_journal_init(&journal, &init));
+    return journal;
+}
+
+TEST(FD_SIM, journal_ring_wrap)
+{
+    std::vector<uint8_t> buffer(384);
+    tiny_journal_handle_t journal = init_journal(buffer, 0);
+    uint8_t payload[60]{};
+    const uint8_t *data;
+    int len;
+    // Ring wraps, while the journal is empty
+    for ( int i = 0; i < 50; i++ )
+    {
+        payload[0] = i;
+        CHECK_EQUAL(TINY_SUCCESS, tiny_journal_append(journal, payload, sizeof(payload)));
+        int32_t pos = tiny_journal_peek(journal, 0, &data, &len);
+        CHECK(pos >= 0);
+        CHECK_EQUAL(i, data[0]);
+        tiny_journal_take(journal, pos, 0);
+        tiny_journal_confirm(journal, pos);
+        CHECK_EQUAL(0, tiny_journal_get_count(journal));
+    }
+    // Ring wraps, while the journal keeps some records
+    std::vector<int32_t> sent;
+    for ( int i = 0; i < 50; i++ )
+    {
+        payload[0] = i;
+        CHECK_EQUAL(TINY_SUCCESS, tiny_journal_append(journal, payload, sizeof(payload)));
+        int32_t pos = tiny_journal_peek(journal, 0, &data, &len);
+        CHECK(pos >= 0);
+        CHECK_EQUAL(i, data[0]);
+        tiny_journal_take(journal, pos, 0);
+        sent.push_back(pos);
+        if ( sent.size() > 2 )
+        {
+            tiny_journal_confirm(journal, sent.front());
+            sent.erase(sent.begin());
+        }
+        CHECK_EQUAL((int)sent.size(), tiny_journal_get_count(journal));
+    }
+    tiny_journal_close(journal);
+}
+
+TEST(FD_SIM, journal_store_and_forward)
+{
+    std::vector<uint8_t> buffer(4096);
+    tiny_journal_handle_t journal = init_journal(buffer, 0);
+    {
+        VirtualConnection conn;
+        VirtualFdPeer peer1(64, 4, [&](tiny_fd_init_t &init) { init.journal = journal; });
+        VirtualFdPeer peer2(64, 4);
+        // Link is down, but frames are accepted
+        uint8_t payload[48]{};
+        for ( int i = 0; i < 20; i++ )
+        {
+            payload[0] = i;
+            CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer1.handle, payload, sizeof(payload)));
+        }
+        CHECK_EQUAL(20, tiny_journal_get_count(journal));
+        conn.attach(peer1.handle, peer2.handle);
+        CHECK(conn.runUntil([&]() -> bool { return peer2.frames.size() >= 20; }, 10000000));
+        conn.run(100000);
+        CHECK_EQUAL(20, (int)peer2.frames.size());
+        for ( int i = 0; i < 20; i++ )
+        {
+            CHECK_EQUAL(i, peer2.frames[i][0]);
+        }
+        // All frames are confirmed and removed from the journal
+        CHECK_EQUAL(0, tiny_journal_get_count(journal));
+    }
+    tiny_journal_close(journal);
+}
+
+TEST(FD_SIM, journal_survives_restart)
+{
+    std::vector<uint8_t> buffer(4096);
+    tiny_journal_handle_t journal = init_journal(buffer, 0);
+    {
+        VirtualFdPeer peer1(64, 4, [&](tiny_fd_init_t &init) { init.journal = journal; });
+        uint8_t payload[32]{};
+        for ( int i = 0; i < 5; i++ )
+        {
+            payload[0] = i;
+            CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer1.handle, payload, sizeof(payload)));
+        }
+    }
+    tiny_journal_close(journal);
+
+    // Application restarts with the same memory
+    journal = init_journal(buffer, 0);
+    CHECK_EQUAL(5, tiny_journal_get_count(journal));
+    {
+        VirtualConnection conn;
+        VirtualFdPeer peer1(64, 4, [&](tiny_fd_init_t &init) { init.journal = journal; });
+        VirtualFdPeer peer2(64, 4);
+        conn.attach(peer1.handle, peer2.handle);
+        CHECK(conn.runUntil([&]() -> bool { return peer2.frames.size() >= 5; }, 10000000));
+        for ( int i = 0; i < 5; i++ )
+        {
+            CHECK_EQUAL(i, peer2.frames[i][0]);
+        }
+        conn.run(100000);
+        CHECK_EQUAL(0, tiny_journal_get_count(journal));
+    }
+    tiny_journal_close(journal);
+}
+
+TEST(FD_SIM, journal_paced_replay)
+{
+    std::vector<uint8_t> buffer(8192);
+    // Only 10 backlog frames per second
+    tiny_journal_handle_t journal = init_journal(buffer, 10);
+    {
+        VirtualConnection conn;
+        VirtualFdPeer peer1(64, 4, [&](tiny_fd_init_t &init) { init.journal = journal; });
+        VirtualFdPeer peer2(64, 4);
+        uint8_t payload[32]{};
+        for ( int i = 0; i < 50; i++ )
+        {
+            payload[0] = i;
+            CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer1.handle, payload, sizeof(payload)));
+        }
+        conn.attach(peer1.handle, peer2.handle);
+        CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+        conn.run(1000000);
+        CHECK(peer2.frames.size() >= 8 && peer2.frames.size() <= 12);
+
+        // New frame doesn't wait for the backlog
+        size_t delivered = peer2.frames.size();
+        payload[0] = 0xFF;
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer1.handle, payload, sizeof(payload)));
+        CHECK(conn.runUntil([&]() -> bool { return peer2.frames.back()[0] == 0xFF; }, 50000));
+        CHECK(peer2.frames.size() <= delivered + 1);
+    }
+    tiny_journal_close(journal);
+}
+#endif
+
+TEST(FD_SIM, reproducible_runs)
+{
+    uint64_t durations[2];
+    for ( uint64_t &duration : durations )
+    {
+        VirtualConnection conn(42);
+        VirtualLineConfig config;
+        config.jitter_us = 500;
+        config.ber = 1e-4;
+        conn.setConfig(config);
+        VirtualFdPeer peer1(64, 4, 10);
+        VirtualFdPeer peer2(64, 4, 10);
+        conn.attach(peer1.handle, peer2.handle);
+        conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000);
+        duration = virtual_transfer(conn, peer1, peer2, 50, 32);
+    }
+    CHECK_EQUAL(durations[0], durations[1]);
+}
+
+TEST(FD_SIM, partial_hal_overrides_clock_only)
+{
+    // Mutex and events of the platform are used, while timeouts are counted on virtual time
+    tiny_platform_hal_t hal{};
+    hal.millis = VirtualConnection::millis;
+    VirtualConnection conn;
+    VirtualFdPeer peer1(64, 4, 2, &hal);
+    VirtualFdPeer peer2(64, 4, 2, &hal);
+    conn.attach(peer1.handle, peer2.handle);
+    CHECK(conn.runUntil([&]() -> bool { return peer1.connected() && peer2.connected(); }, 1000000));
+    virtual_transfer(conn, peer1, peer2, 10, 32);
+    CHECK_EQUAL(10, (int)peer2.frames.size());
+}
+
+/**
+ * Passes all tx data of src peer to dst peer and returns number of passed bytes
+ */
+static int pump_tx_data(VirtualFdPeer &src, VirtualFdPeer &dst, std::vector<uint8_t> *captured = nullptr)
+{
+    uint8_t buf[256];
+    int total = 0;
+    int len;
+    while ( (len = tiny_fd_get_tx_data(src.handle, buf, sizeof(buf))) > 0 )
+    {
+        tiny_fd_on_rx_data(dst.handle, buf, len);
+        if ( captured )
+        {
+            captured->insert(captured->end(), buf, buf + len);
+        }
+        total += len;
+    }
+    return total;
+}
+
+/**
+ * Connects peers, and passes data between them, until both become idle
+ */
+static void connect_peers(VirtualConnection &conn, VirtualFdPeer &a, VirtualFdPeer &b)
+{
+    for ( int i = 0; i < 10 && !(a.connected() && b.connected()); i++ )
+    {
+        pump_tx_data(a, b);
+        pump_tx_data(b, a);
+        conn.run(50000);
+    }
+    CHECK(a.connected() && b.connected());
+    while ( pump_tx_data(a, b) + pump_tx_data(b, a) )
+    {
+    }
+}
+
+/**
+ * Returns control fields of all frames in the captured stream
+ */
+static std::vector<uint8_t> captured_controls(const std::vector<uint8_t> &captured)
+{
+    std::vector<uint8_t> out(captured.size());
+    std::vector<hdlc_ll_frame_info_t> frames(captured.size() / 4 + 1);
+    int count = hdlc_ll_scan(captured.data(), captured.size(), out.data(), out.size(), frames.data(), frames.size(),
+                             HDLC_CRC_16, HDLC_FRAMING_ASYNC, nullptr);
+    std::vector<uint8_t> controls;
+    for ( int i = 0; i < count; i++ )
+    {
+        controls.push_back(out[frames[i].offset + 1]);
+    }
+    return controls;
+}
+
+TEST(FD_SIM, acknowledgements_are_coalesced)
+{
+    VirtualConnection conn;
+    VirtualFdPeer master(64, 7);
+    VirtualFdPeer slave(64, 7);
+    connect_peers(conn, master, slave);
+    // Slave receives all frames of the window, before it gets the chance to send anything
+    uint8_t payload[8] = {0x11};
+    for ( int i = 0; i < 7; i++ )
+    {
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(master.handle, payload, sizeof(payload)));
+    }
+    pump_tx_data(master, slave);
+    CHECK_EQUAL(7, (int)slave.frames.size());
+    std::vector<uint8_t> captured;
+    pump_tx_data(slave, master, &captured);
+    // Only single RR with the last N(R) is sent
+    std::vector<uint8_t> controls = captured_controls(captured);
+    CHECK_EQUAL(1, (int)controls.size());
+    CHECK_EQUAL(0x01 | (7 << 5), controls[0]);
+}
+
+TEST(FD_SIM, poll_before_window_is_full)
+{
+    VirtualConnection conn;
+    VirtualFdPeer master(64, 4);
+    VirtualFdPeer slave(64, 4);
+    connect_peers(conn, master, slave);
+    uint8_t payload[8] = {0x22};
+    // Slave has own frames to send, so it doesn't confirm received frames with separate RR
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(slave.handle, payload, sizeof(payload)));
+    for ( int i = 0; i < 4; i++ )
+    {
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(master.handle, payload, sizeof(payload)));
+    }
+    std::vector<uint8_t> captured;
+    pump_tx_data(master, slave, &captured);
+    std::vector<uint8_t> controls = captured_controls(captured);
+    CHECK_EQUAL(4, (int)controls.size());
+    // Only I-frame, which leaves single free slot in the window, has P bit
+    CHECK_EQUAL(0, controls[1] & 0x10);
+    CHECK_EQUAL(0x10, controls[2] & 0x10);
+    CHECK_EQUAL(0, controls[3] & 0x10);
+    // The window stays full, until the answer arrives
+    conn.run(30000);
+    tiny_fd_stats_t stats{};
+    if ( tiny_fd_get_stats(master.handle, &stats) == TINY_SUCCESS )
+    {
+        // Current stall is reported, while the window is still full
+        CHECK(stats.window_full_ms >= 30);
+    }
+    captured.clear();
+    pump_tx_data(slave, master, &captured);
+    controls = captured_controls(captured);
+    CHECK(controls.size() >= 2);
+    // RR is sent before slave I-frame
+    CHECK_EQUAL(0x01, controls[0] & 0x0F);
+    CHECK_EQUAL(4, (int)slave.frames.size());
+    CHECK_EQUAL(1, (int)master.frames.size());
+    if ( tiny_fd_get_stats(master.handle, &stats) == TINY_SUCCESS )
+    {
+        CHECK(stats.window_full_ms >= 30);
+    }
+}
+
+TEST(FD_SIM, expired_frames_are_dropped)
+{
+    // Frames are moved inside the ring of the link, or their slots are swapped, if they are taken from shared arena
+#ifdef CONFIG_ENABLE_FD_ARENA
+    const uint8_t arena_modes = 2;
+#else
+    const uint8_t arena_modes = 1;
+#endif
+    for ( uint8_t use_arena = 0; use_arena < arena_modes; use_arena++ )
+    {
+        std::vector<uint8_t> buffer(tiny_fd_arena_buffer_size(64, 4));
+        tiny_fd_arena_handle_t arena = nullptr;
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_arena_init(&arena, buffer.data(), buffer.size(), 64));
+        VirtualConnection conn;
+        VirtualFdPeer master(64, 4, [&](tiny_fd_init_t &init) {
+            init.arena = use_arena ? arena : nullptr;
+            init.arena_reserve = use_arena ? 4 : 0;
+        });
+        VirtualFdPeer slave(64, 4);
+        connect_peers(conn, master, slave);
+        uint8_t payload[8] = {0};
+        // The frame, which was sent once, is retransmitted after its deadline, since remote side may have it
+        payload[0] = 1;
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet_ttl(master.handle, payload, sizeof(payload), 10));
+        uint8_t buf[256];
+        while ( tiny_fd_get_tx_data(master.handle, buf, sizeof(buf)) > 0 )
+        {
+        }
+        // Window is full of frames, which wait for the line
+        const uint32_t ttl[] = {10, 0, 10};
+        for ( int i = 0; i < 3; i++ )
+        {
+            payload[0] = 2 + i;
+            CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet_ttl(master.handle, payload, sizeof(payload), ttl[i]));
+        }
+        payload[0] = 5;
+        CHECK_EQUAL(TINY_ERR_TIMEOUT, tiny_fd_send_packet(master.handle, payload, sizeof(payload)));
+        conn.run(20000);
+        // Expired frames give their slots to fresh data
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(master.handle, payload, sizeof(payload)));
+        CHECK_EQUAL(2, (int)master.expired.size());
+        CHECK_EQUAL(2, master.expired[0][0]);
+        CHECK_EQUAL(4, master.expired[1][0]);
+        for ( int i = 0; i < 10 && slave.frames.size() < 3; i++ )
+        {
+            conn.run(100000);
+            pump_tx_data(master, slave);
+            pump_tx_data(slave, master);
+        }
+        // Sequence numbers of the dropped frames are taken by the next ones
+        CHECK_EQUAL(3, (int)slave.frames.size());
+        CHECK_EQUAL(1, slave.frames[0][0]);
+        CHECK_EQUAL(3, slave.frames[1][0]);
+        CHECK_EQUAL(5, slave.frames[2][0]);
+        payload[0] = 6;
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet_ttl(master.handle, payload, sizeof(payload), 10));
+        pump_tx_data(master, slave);
+        pump_tx_data(slave, master);
+        CHECK_EQUAL(4, (int)slave.frames.size());
+        CHECK_EQUAL(6, slave.frames[3][0]);
+        CHECK_EQUAL(4, tiny_fd_arena_get_free_slots(arena));
+        tiny_fd_stats_t stats{};
+        if ( tiny_fd_get_stats(master.handle, &stats) == TINY_SUCCESS )
+        {
+            CHECK_EQUAL(2, (int)stats.expired);
+        }
+    }
+}
+
+static int s_expired_locks = 0;
+
+TEST(FD_SIM, expired_frames_are_reported_without_lock)
+{
+    // Callback can call the protocol back, so the lock is released, and the queue is kept until the callback returns
+    tiny_platform_hal_t hal = *VirtualConnection::hal();
+    hal.mutex_lock = [](tiny_mutex_t *) { s_expired_locks++; };
+    hal.mutex_unlock = [](tiny_mutex_t *) { s_expired_locks--; };
+    VirtualConnection conn;
+    VirtualFdPeer master(64, 4, [&](tiny_fd_init_t &init) {
+        init.hal = &hal;
+        init.on_expired_cb = [](void *udata, uint8_t *data, int len) {
+            VirtualFdPeer *peer = reinterpret_cast<VirtualFdPeer *>(udata);
+            CHECK_EQUAL(0, s_expired_locks);
+            peer->expired.emplace_back(data, data + len);
+            // Expired message is sent once again without deadline
+            CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet(peer->handle, data, len));
+        };
+    });
+    VirtualFdPeer slave(64, 4);
+    connect_peers(conn, master, slave);
+    uint8_t payload[8] = {0};
+    for ( int i = 0; i < 2; i++ )
+    {
+        payload[0] = 1 + i;
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_send_packet_ttl(master.handle, payload, sizeof(payload), 10));
+    }
+    conn.run(20000);
+    pump_tx_data(master, slave);
+    pump_tx_data(slave, master);
+    CHECK_EQUAL(0, s_expired_locks);
+    CHECK_EQUAL(2, (int)master.expired.size());
+    CHECK_EQUAL(2, (int)slave.frames.size());
+    CHECK_EQUAL(1, slave.frames[0][0]);
+    CHECK_EQUAL(2, slave.frames[1][0]);
+    tiny_fd_stats_t stats{};
+    if ( tiny_fd_get_stats(master.handle, &stats) == TINY_SUCCESS )
+    {
+        CHECK_EQUAL(2, (int)stats.expired);
+    }
+}
+
+TEST(FD_SIM, spi_block_exchange)
+{
+    VirtualConnection conn;
+    VirtualFdPeer master(64, 4, 5);
+    VirtualFdPeer slave(64, 4, 5);
+    FakeSpi spi(64);
+    spi.generate_error_every_n_byte(997);
+    auto transaction = [&]() {
+        CHECK(tiny_fd_get_tx_block(master.handle, spi.masterTx(), spi.blockSize()) >= 0);
+        CHECK(tiny_fd_get_tx_block(slave.handle, spi.slaveTx(), spi.blockSize()) >= 0);
+        spi.transfer();
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_on_rx_block(master.handle, spi.masterRx(), spi.blockSize()));
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_on_rx_block(slave.handle, spi.slaveRx(), spi.blockSize()));
+        // 64-byte transaction at 4 MHz clock
+        conn.run(128);
+    };
+    while ( !(master.connected() && slave.connected()) && spi.transactions() < 10000 )
+    {
+        transaction();
+    }
+    CHECK(master.connected() && slave.connected());
+    uint8_t payload[32]{};
+    int master_sent = 0;
+    int slave_sent = 0;
+    while ( master_sent < 100 || slave_sent < 100 )
+    {
+        payload[0] = master_sent;
+        if ( master_sent < 100 && tiny_fd_send_packet(master.handle, payload, sizeof(payload)) == TINY_SUCCESS )
+        {
+            master_sent++;
+        }
+        payload[0] = slave_sent;
+        if ( slave_sent < 100 && tiny_fd_send_packet(slave.handle, payload, sizeof(payload)) == TINY_SUCCESS )
+        {
+            slave_sent++;
+        }
+        transaction();
+    }
+    while ( (slave.frames.size() < 100 || master.frames.size() < 100) && spi.transactions() < 100000 )
+    {
+        transaction();
+    }
+    CHECK_EQUAL(100, (int)slave.frames.size());
+    CHECK_EQUAL(100, (int)master.frames.size());
+    for ( int i = 0; i < 100; i++ )
+    {
+        CHECK_EQUAL(i, slave.frames[i][0]);
+        CHECK_EQUAL(i, master.frames[i][0]);
+    }
+#ifdef CONFIG_ENABLE_FRAMING
+    uint8_t block[16];
+    VirtualFdPeer length(64, 4, [](tiny_fd_init_t &init) { init.framing = HDLC_FRAMING_LENGTH; });
+    CHECK_EQUAL(TINY_ERR_INVALID_DATA, tiny_fd_get_tx_block(length.handle, block, sizeof(block)));
+    CHECK_EQUAL(TINY_ERR_INVALID_DATA, tiny_fd_on_rx_block(length.handle, block, sizeof(block)));
+#endif
+}
+
+/**
+ * Session of the runtime test. Pairs of sessions are connected by in-memory pipes, and each write
+ * notifies the runtime about new data for the remote session.
+ */
+class RuntimePeer
+{
+public:
+    RuntimePeer(tiny_fd_runtime_handle_t runtime)
+        : m_runtime(runtime)
+        , m_buffer(tiny_fd_buffer_size_by_mtu(32, 4))
+    {
+        tiny_fd_init_t init{};
+        init.pdata = this;
+        init.on_frame_cb = onFrame;
+        init.buffer = m_buffer.data();
+        init.buffer_size = m_buffer.size();
+        init.window_frames = 4;
+        init.send_timeout = 0;
+        init.retry_timeout = 100;
+        init.retries = 5;
+        init.crc_type = HDLC_CRC_16;
+        init.mtu = 32;
+        tiny_fd_init(&handle, &init);
+    }
+
+    ~RuntimePeer()
+    {
+        tiny_fd_close(handle);
+    }
+
+    void connect(RuntimePeer &remote)
+    {
+        m_remote = &remote;
+        remote.m_remote = this;
+        session = tiny_fd_runtime_add(m_runtime, handle, readData, writeData, this);
+        remote.session = tiny_fd_runtime_add(m_runtime, remote.handle, readData, writeData, &remote);
+    }
+
+    int send(const void *data, int len)
+    {
+        int result = tiny_fd_send_packet(handle, data, len);
+        if ( result == TINY_SUCCESS )
+        {
+            tiny_fd_runtime_notify(m_runtime, session);
+        }
+        return result;
+    }
+
+    tiny_fd_handle_t handle = nullptr;
+    int session = -1;
+    std::atomic<int> rx_count{0};
+    std::atomic<int> out_of_order{0};
+    bool throttled = false;
+
+    static int readData(void *pdata, void *buffer, int size)
+    {
+        RuntimePeer *peer = reinterpret_cast<RuntimePeer *>(pdata);
+        std::lock_guard<std::mutex> lock(peer->m_mutex);
+        int len = std::min(size, (int)peer->m_rx.size());
+        std::copy(peer->m_rx.begin(), peer->m_rx.begin() + len, (uint8_t *)buffer);
+        peer->m_rx.erase(peer->m_rx.begin(), peer->m_rx.begin() + len);
+        return len;
+    }
+
+    static int writeData(void *pdata, const void *buffer, int size)
+    {
+        RuntimePeer *peer = reinterpret_cast<RuntimePeer *>(pdata);
+        RuntimePeer *remote = peer->m_remote;
+        {
+            std::lock_guard<std::mutex> lock(remote->m_mutex);
+            if ( peer->throttled )
+            {
+                // Channel buffer is small, and it is busy, until remote session reads the data
+                size = std::min(size, 24 - (int)remote->m_rx.size());
+                if ( size <= 0 )
+                {
+                    return 0;
+                }
+            }
+            remote->m_rx.insert(remote->m_rx.end(), (const uint8_t *)buffer, (const uint8_t *)buffer + size);
+        }
+        tiny_fd_runtime_notify(remote->m_runtime, remote->session);
+        return size;
+    }
+
+private:
+    tiny_fd_runtime_handle_t m_runtime;
+    std::vector<uint8_t> m_buffer;
+    RuntimePeer *m_remote = nullptr;
+    std::mutex m_mutex;
+    std::deque<uint8_t> m_rx;
+
+    static void onFrame(void *udata, uint8_t *data, int len)
+    {
+        RuntimePeer *peer = reinterpret_cast<RuntimePeer *>(udata);
+        if ( data[0] != (peer->rx_count & 0xFF) )
+        {
+            peer->out_of_order++;
+        }
+        peer->rx_count++;
+    }
+};
+
+/**
+ * Worker threads of the runtime, one per shard
+ */
+class RuntimeWorkers
+{
+public:
+    RuntimeWorkers(tiny_fd_runtime_handle_t runtime)
+        : m_runtime(runtime)
+    {
+    }
+
+    ~RuntimeWorkers()
+    {
+        m_stop = true;
+        for ( auto &thread : m_threads )
+        {
+            thread.join();
+        }
+    }
+
+    void start(uint8_t shard)
+    {
+        m_threads.emplace_back([this, shard]() {
+            while ( !m_stop )
+            {
+                tiny_fd_runtime_run(m_runtime, shard, 10);
+            }
+        });
+    }
+
+private:
+    tiny_fd_runtime_handle_t m_runtime;
+    std::atomic<bool> m_stop{false};
+    std::vector<std::thread> m_threads;
+};
+
+static bool send_to_all(std::vector<std::unique_ptr<RuntimePeer>> &peers, int count)
+{
+    std::vector<int> sent(peers.size() / 2);
+    uint32_t start = tiny_millis();
+    for ( bool done = false; !done; )
+    {
+        done = true;
+        for ( size_t i = 0; i < sent.size(); i++ )
+        {
+            uint8_t payload[8] = {static_cast<uint8_t>(sent[i])};
+            if ( sent[i] < count && peers[2 * i]->send(payload, sizeof(payload)) == TINY_SUCCESS )
+            {
+                sent[i]++;
+            }
+            done = done && peers[2 * i + 1]->rx_count >= count;
+        }
+        if ( tiny_millis() - start > 10000 )
+        {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+TEST_GROUP(FD_RUNTIME){};
+
+TEST(FD_RUNTIME, sessions_are_served_by_all_shards)
+{
+    const int shards = 4;
+    const int pairs = 16;
+    std::vector<uint8_t> buffer(tiny_fd_runtime_buffer_size(shards, pairs * 2));
+    tiny_fd_runtime_init_t init{};
+    init.buffer = buffer.data();
+    init.buffer_size = buffer.size();
+    init.shards = shards;
+    tiny_fd_runtime_handle_t runtime = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_init(&runtime, &init));
+    std::vector<std::unique_ptr<RuntimePeer>> peers;
+    for ( int i = 0; i < pairs * 2; i++ )
+    {
+        peers.emplace_back(new RuntimePeer(runtime));
+    }
+    for ( int i = 0; i < pairs; i++ )
+    {
+        peers[2 * i]->connect(*peers[2 * i + 1]);
+        CHECK(peers[2 * i + 1]->session >= 0);
+    }
+    // All session slots are taken
+    CHECK_EQUAL(TINY_ERR_FAILED, tiny_fd_runtime_add(runtime, peers[0]->handle, RuntimePeer::readData,
+                                                     RuntimePeer::writeData, peers[0].get()));
+    {
+        RuntimeWorkers workers(runtime);
+        for ( int i = 0; i < shards; i++ )
+        {
+            workers.start(i);
+        }
+        CHECK(send_to_all(peers, 100));
+        // Idle sessions are run by timer wheels
+        tiny_sleep(50);
+    }
+    int sessions = 0;
+    for ( int i = 0; i < shards; i++ )
+    {
+        tiny_fd_runtime_stats_t stats{};
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_get_stats(runtime, i, &stats));
+        CHECK(stats.runs > 0);
+        CHECK(stats.timer_polls > 0);
+        CHECK(stats.rx_bytes > 0);
+        sessions += stats.sessions;
+    }
+    CHECK_EQUAL(pairs * 2, sessions);
+    for ( auto &peer : peers )
+    {
+        CHECK_EQUAL(0, (int)peer->out_of_order);
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_remove(runtime, peer->session));
+    }
+    CHECK_EQUAL(TINY_ERR_INVALID_DATA, tiny_fd_runtime_remove(runtime, peers[0]->session));
+    tiny_fd_runtime_close(runtime);
+}
+
+TEST(FD_RUNTIME, timer_wheel_with_coarse_tick)
+{
+    std::vector<uint8_t> buffer(tiny_fd_runtime_buffer_size(1, 2));
+    tiny_fd_runtime_init_t init{};
+    init.buffer = buffer.data();
+    init.buffer_size = buffer.size();
+    init.shards = 1;
+    init.tick = 10;
+    // Deadlines are not aligned to ticks of the wheel
+    init.poll_interval = 13;
+    tiny_fd_runtime_handle_t runtime = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_init(&runtime, &init));
+    RuntimePeer peer1(runtime);
+    RuntimePeer peer2(runtime);
+    peer1.connect(peer2);
+    tiny_fd_runtime_stats_t stats{};
+    {
+        RuntimeWorkers workers(runtime);
+        workers.start(0);
+        tiny_sleep(300);
+    }
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_get_stats(runtime, 0, &stats));
+    // Each idle session is polled once in 2 ticks, not once per turn of the wheel
+    CHECK(stats.timer_polls >= 10);
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_remove(runtime, peer1.session));
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_remove(runtime, peer2.session));
+    tiny_fd_runtime_close(runtime);
+}
+
+TEST(FD_RUNTIME, timer_wheel_uses_runtime_clock)
+{
+    // Timer wheel is served by the clock of the runtime HAL, and the worker is run by the test thread
+    VirtualConnection conn;
+    std::vector<uint8_t> buffer(tiny_fd_runtime_buffer_size(1, 2));
+    tiny_fd_runtime_init_t init{};
+    init.buffer = buffer.data();
+    init.buffer_size = buffer.size();
+    init.shards = 1;
+    init.poll_interval = 10;
+    init.hal = VirtualConnection::hal();
+    tiny_fd_runtime_handle_t runtime = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_init(&runtime, &init));
+    RuntimePeer peer1(runtime);
+    RuntimePeer peer2(runtime);
+    peer1.connect(peer2);
+    tiny_fd_runtime_stats_t stats{};
+    tiny_sleep(20);
+    while ( tiny_fd_runtime_run(runtime, 0, 0) > 0 )
+    {
+    }
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_get_stats(runtime, 0, &stats));
+    CHECK_EQUAL(0, (int)stats.timer_polls);
+    conn.run(10000);
+    while ( tiny_fd_runtime_run(runtime, 0, 0) > 0 )
+    {
+    }
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_get_stats(runtime, 0, &stats));
+    CHECK(stats.timer_polls >= 2);
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_remove(runtime, peer1.session));
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_remove(runtime, peer2.session));
+    tiny_fd_runtime_close(runtime);
+}
+
+TEST(FD_RUNTIME, busy_channel_does_not_block_shard)
+{
+    const int pairs = 2;
+    std::vector<uint8_t> buffer(tiny_fd_runtime_buffer_size(1, pairs * 2));
+    tiny_fd_runtime_init_t init{};
+    init.buffer = buffer.data();
+    init.buffer_size = buffer.size();
+    init.shards = 1;
+    tiny_fd_runtime_handle_t runtime = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_init(&runtime, &init));
+    std::vector<std::unique_ptr<RuntimePeer>> peers;
+    for ( int i = 0; i < pairs * 2; i++ )
+    {
+        peers.emplace_back(new RuntimePeer(runtime));
+    }
+    // Sessions of the first pair write to the busy channel, and the channel is released only by the same worker
+    peers[0]->throttled = true;
+    peers[1]->throttled = true;
+    for ( int i = 0; i < pairs; i++ )
+    {
+        peers[2 * i]->connect(*peers[2 * i + 1]);
+    }
+    {
+        RuntimeWorkers workers(runtime);
+        workers.start(0);
+        CHECK(send_to_all(peers, 50));
+    }
+    for ( auto &peer : peers )
+    {
+        CHECK_EQUAL(0, (int)peer->out_of_order);
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_remove(runtime, peer->session));
+    }
+    tiny_fd_runtime_close(runtime);
+}
+
+TEST(FD_RUNTIME, idle_worker_steals_ready_sessions)
+{
+    const int pairs = 8;
+    std::vector<uint8_t> buffer(tiny_fd_runtime_buffer_size(2, pairs * 2));
+    tiny_fd_runtime_init_t init{};
+    init.buffer = buffer.data();
+    init.buffer_size = buffer.size();
+    init.shards = 2;
+    tiny_fd_runtime_handle_t runtime = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_init(&runtime, &init));
+    std::vector<std::unique_ptr<RuntimePeer>> peers;
+    for ( int i = 0; i < pairs * 2; i++ )
+    {
+        peers.emplace_back(new RuntimePeer(runtime));
+    }
+    for ( int i = 0; i < pairs; i++ )
+    {
+        peers[2 * i]->connect(*peers[2 * i + 1]);
+    }
+    tiny_fd_runtime_stats_t stats[2]{};
+    {
+        // Worker of shard 0 is busy at start, so new sessions of shard 0 wait in its queue
+        RuntimeWorkers workers(runtime);
+        workers.start(1);
+        uint32_t start = tiny_millis();
+        while ( stats[1].stolen == 0 && tiny_millis() - start < 1000 )
+        {
+            tiny_fd_runtime_get_stats(runtime, 1, &stats[1]);
+        }
+        // Stolen sessions stay in the new shard
+        CHECK(stats[1].sessions > pairs);
+        workers.start(0);
+        CHECK(send_to_all(peers, 50));
+    }
+    tiny_fd_runtime_get_stats(runtime, 0, &stats[0]);
+    tiny_fd_runtime_get_stats(runtime, 1, &stats[1]);
+    CHECK(stats[1].stolen > 0);
+    CHECK_EQUAL(pairs * 2, stats[0].sessions + stats[1].sessions);
+    for ( auto &peer : peers )
+    {
+        CHECK_EQUAL(0, (int)peer->out_of_order);
+        CHECK_EQUAL(TINY_SUCCESS, tiny_fd_runtime_remove(runtime, peer->session));
+    }
+    tiny_fd_runtime_close(runtime);
 }
@@ -27,6 +27,7 @@
 #include "hal/tiny_list.h"
 #include "hal/tiny_debug.h"
 #include "proto/crc/crc.h"
+#include "proto/fec/tiny_fec.h"
 
 TEST_GROUP(HAL){void setup(){
     // ...
@@ -120,3 +121,35 @@ TEST(HAL, crc)
                                                                (crc32_num >> 16) & 0xFF),
                                                     (crc32_num >> 24))));
 }
+
+TEST(HAL, fec)
+{
+    const int roots = 8;
+    uint8_t gen[roots + 1];
+    tiny_fec_generator(gen, roots);
+    uint8_t block[TINY_FEC_BLOCK_SIZE];
+    uint8_t origin[TINY_FEC_BLOCK_SIZE];
+    for ( int len : {roots + 1, 100, TINY_FEC_BLOCK_SIZE} )
+    {
+        for ( int i = 0; i < len - roots; i++ )
+            block[i] = i * 7 + len;
+        // Parity can be calculated in parts
+        uint8_t parity[roots]{};
+        tiny_fec_encode(parity, gen, roots, block, 1);
+        tiny_fec_encode(parity, gen, roots, block + 1, len - roots - 1);
+        memcpy(block + len - roots, parity, roots);
+        memcpy(origin, block, len);
+        CHECK_EQUAL(0, tiny_fec_decode(block, len, roots));
+        for ( int errors = 1; errors <= roots / 2; errors++ )
+        {
+            for ( int i = 0; i < errors; i++ )
+                block[(i * 37 + errors) % len] ^= 0x5A + i;
+            CHECK_EQUAL(errors, tiny_fec_decode(block, len, roots));
+            MEMCMP_EQUAL(origin, block, len);
+        }
+    }
+    CHECK(tiny_fec_decode(block, roots, roots) < 0);
+    CHECK_EQUAL(0, tiny_fec_overhead(100, 0));
+    CHECK_EQUAL(8, tiny_fec_overhead(247, 8));
+    CHECK_EQUAL(16, tiny_fec_overhead(248, 8));
+}
@@ -18,12 +18,14 @@
  */
 
 #include <functional>
+#include <vector>
 #include <CppUTest/TestHarness.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include "helpers/tiny_hdlc_helper.h"
 #include "helpers/fake_connection.h"
+#include "helpers/fake_spi.h"
 #include <TinyProtocolHdlc.h>
 
 // Including private header for check_buf_size_calculations test
@@ -298,3 +300,668 @@ TEST(HDLC, check_buf_size_calculations)
     CHECK_EQUAL( sizeof(hdlc_ll_data_t) + 12, hdlc_ll_get_buf_size_ex(10, HDLC_CRC_16) );
     CHECK_EQUAL( sizeof(hdlc_ll_data_t) + 14, hdlc_ll_get_buf_size_ex(10, HDLC_CRC_32) );
 }
+
+#ifdef CONFIG_ENABLE_CAPTURE
+static int capture_write(void *pdata, const void *data, int len)
+{
+    std::vector<uint8_t> *stream = static_cast<std::vector<uint8_t> *>(pdata);
+    stream->insert(stream->end(), (const uint8_t *)data, (const uint8_t *)data + len);
+    return len;
+}
+
+static uint64_t capture_timestamp(void)
+{
+    static uint64_t ts = 0;
+    return ++ts;
+}
+
+TEST(HDLC, hdlc_ll_capture)
+{
+    std::vector<uint8_t> stream;
+    uint8_t capture_buffer[1024];
+    tiny_capture_init_t capture_init{};
+    capture_init.buffer = capture_buffer;
+    capture_init.buffer_size = sizeof(capture_buffer);
+    capture_init.timestamp = capture_timestamp;
+    capture_init.write_func = capture_write;
+    capture_init.pdata = &stream;
+    tiny_capture_handle_t capture = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, tiny_capture_init(&capture, &capture_init));
+
+    uint8_t buffer[hdlc_ll_get_buf_size_ex(64, HDLC_CRC_16)];
+    hdlc_ll_init_t init{};
+    init.buf = buffer;
+    init.buf_size = sizeof(buffer);
+    init.crc_type = HDLC_CRC_16;
+    init.capture = capture;
+    hdlc_ll_handle_t handle = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+
+    // Send frame and pass it back to the same hdlc instance: tx and rx frames are captured
+    const uint8_t frame[] = {0x01, 0x3F, 0x55};
+    uint8_t wire[32];
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_put(handle, frame, sizeof(frame)));
+    int wire_len = hdlc_ll_run_tx(handle, wire, sizeof(wire));
+    CHECK(wire_len > 0);
+    int error;
+    hdlc_ll_run_rx(handle, wire, wire_len, &error);
+    tiny_capture_event(capture, TINY_CAPTURE_RX, "test event");
+    // Corrupt payload: frame with wrong crc is captured too
+    wire[2] ^= 0x01;
+    hdlc_ll_run_rx(handle, wire, wire_len, &error);
+    CHECK_EQUAL(TINY_ERR_WRONG_CRC, error);
+    hdlc_ll_close(handle);
+    tiny_capture_close(capture);
+    CHECK_EQUAL(0, tiny_capture_get_dropped(capture));
+
+    // Walk pcapng blocks: SHB, IDB, 4 EPB, ISB
+    std::vector<uint32_t> types;
+    std::vector<size_t> offsets;
+    size_t pos = 0;
+    while ( pos + 12 <= stream.size() )
+    {
+        uint32_t type, total;
+        memcpy(&type, &stream[pos], 4);
+        memcpy(&total, &stream[pos + 4], 4);
+        CHECK(total >= 12 && (total & 3) == 0 && pos + total <= stream.size());
+        uint32_t trailer;
+        memcpy(&trailer, &stream[pos + total - 4], 4);
+        CHECK_EQUAL(total, trailer);
+        types.push_back(type);
+        offsets.push_back(pos);
+        pos += total;
+    }
+    CHECK_EQUAL(stream.size(), pos);
+    const std::vector<uint32_t> expected = {0x0A0D0D0A, 1, 6, 6, 6, 6, 5};
+    CHECK(expected == types);
+    uint32_t magic;
+    memcpy(&magic, &stream[8], 4);
+    CHECK_EQUAL(0x1A2B3C4D, magic);
+
+    // Frames go in time order: tx frame, rx frame, event, rx frame with wrong crc
+    const uint8_t *tx = &stream[offsets[2]];
+    const uint8_t *rx = &stream[offsets[3]];
+    const uint8_t *bad = &stream[offsets[5]];
+    uint32_t caplen;
+    memcpy(&caplen, tx + 20, 4);
+    CHECK_EQUAL(sizeof(frame) + 1, caplen);
+    CHECK_EQUAL(1, tx[28]);
+    MEMCMP_EQUAL(frame, tx + 29, sizeof(frame));
+    CHECK_EQUAL(0, rx[28]);
+    MEMCMP_EQUAL(frame, rx + 29, sizeof(frame));
+    memcpy(&caplen, bad + 20, 4);
+    CHECK_EQUAL(sizeof(frame) + 2 + 1, caplen);
+    uint32_t flags;
+    memcpy(&flags, bad + 28 + 8 + 4, 4);
+    CHECK_EQUAL(TINY_CAPTURE_FLAG_CRC_ERROR | 0x01, flags);
+}
+#endif
+
+#ifdef CONFIG_ENABLE_FEC
+TEST(HDLC, hdlc_ll_fec)
+{
+    // 600 bytes of frame and crc are sent as 3 blocks, each block corrects up to 4 bytes
+    std::vector<uint8_t> buffer(hdlc_ll_get_buf_size_fec(600, HDLC_CRC_32, 8));
+    hdlc_ll_init_t init{};
+    init.buf = buffer.data();
+    init.buf_size = buffer.size();
+    init.crc_type = HDLC_CRC_32;
+    init.fec_roots = 8;
+    std::vector<uint8_t> received;
+    init.user_data = &received;
+    init.on_frame_read = [](void *user_data, void *data, int len) -> int {
+        static_cast<std::vector<uint8_t> *>(user_data)->assign((uint8_t *)data, (uint8_t *)data + len);
+        return 0;
+    };
+    hdlc_ll_handle_t handle = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+
+    std::vector<uint8_t> frame(596);
+    for ( size_t i = 0; i < frame.size(); i++ )
+        frame[i] = i * 13;
+    std::vector<uint8_t> wire(2 * (600 + 24) + 2);
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_put(handle, frame.data(), frame.size()));
+    wire.resize(hdlc_ll_run_tx(handle, wire.data(), wire.size()));
+    // Corrupt up to 4 bytes in each block, but keep flags and escape sequences
+    auto can_corrupt = [&wire](size_t pos) -> bool {
+        return wire[pos - 1] != 0x7D && wire[pos] != 0x7D && wire[pos] != 0x7E && wire[pos] != (0x7D ^ 0x55) &&
+               wire[pos] != (0x7E ^ 0x55);
+    };
+    int corrupted = 0;
+    for ( size_t pos = 2; corrupted < 8; pos += 70 )
+    {
+        while ( !can_corrupt(pos) )
+            pos++;
+        wire[pos] ^= 0x55;
+        corrupted++;
+    }
+    int error;
+    hdlc_ll_run_rx(handle, wire.data(), wire.size(), &error);
+    CHECK_EQUAL(TINY_SUCCESS, error);
+    CHECK(frame == received);
+    uint32_t corrected = 0, failed = 0;
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_get_fec_stats(handle, &corrected, &failed));
+    CHECK_EQUAL(8, (int)corrected);
+    CHECK_EQUAL(0, (int)failed);
+
+    // Too many errors in single block
+    for ( size_t pos = 10; pos < 30; pos++ )
+        if ( can_corrupt(pos) )
+            wire[pos] ^= 0x55;
+    hdlc_ll_run_rx(handle, wire.data(), wire.size(), &error);
+    CHECK_EQUAL(TINY_ERR_WRONG_CRC, error);
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_get_fec_stats(handle, &corrected, &failed));
+    CHECK_EQUAL(1, (int)failed);
+    hdlc_ll_close(handle);
+}
+#endif
+
+#ifdef CONFIG_ENABLE_FRAMING
+static std::vector<uint8_t> ll_encode(hdlc_ll_handle_t handle, const std::vector<uint8_t> &frame, int chunk)
+{
+    std::vector<uint8_t> wire;
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_put(handle, frame.data(), frame.size()));
+    for ( ;; )
+    {
+        uint8_t buf[chunk];
+        int len = hdlc_ll_run_tx(handle, buf, chunk);
+        if ( len == 0 )
+            break;
+        wire.insert(wire.end(), buf, buf + len);
+    }
+    return wire;
+}
+
+TEST(HDLC, hdlc_ll_cobs_encode)
+{
+    uint8_t buffer[hdlc_ll_get_buf_size_ex(512, HDLC_CRC_OFF)];
+    hdlc_ll_init_t init{};
+    init.buf = buffer;
+    init.buf_size = sizeof(buffer);
+    init.crc_type = HDLC_CRC_OFF;
+    init.framing = HDLC_FRAMING_COBS;
+    hdlc_ll_handle_t handle = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+
+    std::vector<uint8_t> wire = ll_encode(handle, {0x11, 0x00, 0x7E}, 64);
+    std::vector<uint8_t> expected = {0x00, 0x02, 0x11, 0x02, 0x7E, 0x00};
+    CHECK(expected == wire);
+
+    wire = ll_encode(handle, {0x00, 0x00}, 64);
+    expected = {0x00, 0x01, 0x01, 0x01, 0x00};
+    CHECK(expected == wire);
+
+    // 254 non-zero bytes are encoded as single block without zero byte
+    std::vector<uint8_t> frame(254, 0x7E);
+    wire = ll_encode(handle, frame, 64);
+    CHECK_EQUAL(254 + 3, (int)wire.size());
+    CHECK_EQUAL(0xFF, wire[1]);
+
+    frame.push_back(0x7D);
+    wire = ll_encode(handle, frame, 64);
+    CHECK_EQUAL(255 + 4, (int)wire.size());
+    CHECK_EQUAL(0x02, wire[256]);
+    CHECK_EQUAL(hdlc_ll_get_max_encoded_size(255, HDLC_CRC_OFF, HDLC_FRAMING_COBS), (int)wire.size());
+    hdlc_ll_close(handle);
+}
+
+TEST(HDLC, hdlc_ll_cobs_send_receive)
+{
+    std::vector<uint8_t> buffer(hdlc_ll_get_buf_size_ex(1024, HDLC_CRC_16));
+    hdlc_ll_init_t init{};
+    init.buf = buffer.data();
+    init.buf_size = buffer.size();
+    init.crc_type = HDLC_CRC_16;
+    init.framing = HDLC_FRAMING_COBS;
+    std::vector<std::vector<uint8_t>> received;
+    init.user_data = &received;
+    init.on_frame_read = [](void *user_data, void *data, int len) -> int {
+        static_cast<std::vector<std::vector<uint8_t>> *>(user_data)->emplace_back((uint8_t *)data,
+                                                                                   (uint8_t *)data + len);
+        return 0;
+    };
+    hdlc_ll_handle_t handle = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+
+    srand(1);
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> stream;
+    for ( int i = 0; i < 200; i++ )
+    {
+        std::vector<uint8_t> frame(1 + rand() % 1024);
+        for ( auto &byte : frame )
+            byte = (rand() % 4) ? rand() : 0;
+        std::vector<uint8_t> wire = ll_encode(handle, frame, 1 + rand() % 300);
+        CHECK(wire.size() <= (size_t)hdlc_ll_get_max_encoded_size(frame.size(), HDLC_CRC_16, HDLC_FRAMING_COBS));
+        stream.insert(stream.end(), wire.begin(), wire.end());
+        frames.push_back(frame);
+    }
+    for ( size_t pos = 0; pos < stream.size(); )
+    {
+        int len = std::min<int>(1 + rand() % 100, stream.size() - pos);
+        pos += hdlc_ll_run_rx(handle, stream.data() + pos, len, nullptr);
+    }
+    CHECK(frames == received);
+
+    // Frame, which is full of hdlc flag and escape bytes, is not expanded
+    std::vector<uint8_t> frame(1000, 0x7E);
+    CHECK_EQUAL(1000 + 2 + 2 + 4, (int)ll_encode(handle, frame, 1024).size());
+
+    // Delimiter in the middle of the block breaks the frame
+    std::vector<uint8_t> wire = {0x00, 0x05, 0x11, 0x00, 0x22, 0x33, 0x00};
+    int error;
+    hdlc_ll_run_rx(handle, wire.data(), wire.size(), &error);
+    CHECK_EQUAL(TINY_ERR_WRONG_CRC, error);
+    hdlc_ll_close(handle);
+}
+
+TEST(HDLC, hdlc_ll_length_framing)
+{
+    std::vector<uint8_t> buffer(hdlc_ll_get_buf_size_ex(300, HDLC_CRC_16));
+    hdlc_ll_init_t init{};
+    init.buf = buffer.data();
+    init.buf_size = buffer.size();
+    init.crc_type = HDLC_CRC_16;
+    init.framing = HDLC_FRAMING_LENGTH;
+    struct Received
+    {
+        std::vector<std::vector<uint8_t>> frames;
+        std::vector<const uint8_t *> pointers;
+    } received;
+    init.user_data = &received;
+    init.on_frame_read = [](void *user_data, void *data, int len) -> int {
+        Received *r = static_cast<Received *>(user_data);
+        r->frames.emplace_back((uint8_t *)data, (uint8_t *)data + len);
+        r->pointers.push_back((const uint8_t *)data);
+        return 0;
+    };
+    hdlc_ll_handle_t handle = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+
+    // Bytes are not escaped
+    std::vector<uint8_t> wire = ll_encode(handle, {0x7E, 0x7D, 0x00}, 1);
+    uint16_t crc = crc16(PPPINITFCS16, (const uint8_t *)"\x7E\x7D\x00", 3);
+    std::vector<uint8_t> expected = {0x03, 0x00, 0x7E, 0x7D, 0x00, (uint8_t)crc, (uint8_t)(crc >> 8)};
+    CHECK(expected == wire);
+    CHECK_EQUAL(hdlc_ll_get_max_encoded_size(3, HDLC_CRC_16, HDLC_FRAMING_LENGTH), (int)wire.size());
+
+    // Whole frame in the input buffer is passed to the callback without copying
+    int error;
+    CHECK_EQUAL((int)wire.size(), hdlc_ll_run_rx(handle, wire.data(), wire.size(), &error));
+    CHECK_EQUAL(TINY_SUCCESS, error);
+    CHECK_EQUAL(1, (int)received.frames.size());
+    CHECK(received.frames[0] == std::vector<uint8_t>({0x7E, 0x7D, 0x00}));
+    CHECK_EQUAL(wire.data() + 2, received.pointers[0]);
+
+    // Frames, split to chunks, are copied to rx buffer. Too large frame is skipped
+    std::vector<std::vector<uint8_t>> frames = {std::vector<uint8_t>(300, 0x7E), std::vector<uint8_t>(301, 0x11),
+                                                std::vector<uint8_t>(1, 0x7D)};
+    std::vector<uint8_t> stream;
+    for ( auto &frame : frames )
+    {
+        wire = ll_encode(handle, frame, 7);
+        stream.insert(stream.end(), wire.begin(), wire.end());
+    }
+    std::vector<int> errors;
+    for ( size_t pos = 0; pos < stream.size(); )
+    {
+        pos += hdlc_ll_run_rx(handle, stream.data() + pos, std::min<int>(64, stream.size() - pos), &error);
+        if ( error != TINY_SUCCESS )
+            errors.push_back(error);
+    }
+    CHECK_EQUAL(1, (int)errors.size());
+    CHECK_EQUAL(TINY_ERR_DATA_TOO_LARGE, errors[0]);
+    CHECK_EQUAL(3, (int)received.frames.size());
+    CHECK(frames[0] == received.frames[1]);
+    CHECK(frames[2] == received.frames[2]);
+    CHECK((const uint8_t *)buffer.data() < received.pointers[1] &&
+          received.pointers[1] < (const uint8_t *)buffer.data() + buffer.size());
+
+    // Length header is 16 bits
+    std::vector<uint8_t> big(65536);
+    CHECK_EQUAL(TINY_ERR_INVALID_DATA, hdlc_ll_put(handle, big.data(), big.size()));
+    hdlc_ll_close(handle);
+}
+
+TEST(HDLC, hdlc_ll_sync_framing)
+{
+    std::vector<uint8_t> buffer(hdlc_ll_get_buf_size_ex(1024, HDLC_CRC_16));
+    hdlc_ll_init_t init{};
+    init.buf = buffer.data();
+    init.buf_size = buffer.size();
+    init.crc_type = HDLC_CRC_OFF;
+    init.framing = HDLC_FRAMING_SYNC;
+    std::vector<std::vector<uint8_t>> received;
+    init.user_data = &received;
+    init.on_frame_read = [](void *user_data, void *data, int len) -> int {
+        static_cast<std::vector<std::vector<uint8_t>> *>(user_data)->emplace_back((uint8_t *)data,
+                                                                                   (uint8_t *)data + len);
+        return 0;
+    };
+    hdlc_ll_handle_t handle = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+
+    // Flag, 11111 0 111, flag and 1 bits up to byte boundary, least significant bit first
+    std::vector<uint8_t> wire = ll_encode(handle, {0xFF}, 64);
+    std::vector<uint8_t> expected = {0x7E, 0xDF, 0xFD, 0xFE};
+    CHECK(expected == wire);
+    CHECK_EQUAL(4, hdlc_ll_get_max_encoded_size(1, HDLC_CRC_OFF, HDLC_FRAMING_SYNC));
+    hdlc_ll_close(handle);
+
+    init.crc_type = HDLC_CRC_16;
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+    srand(3);
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> stream;
+    for ( int i = 0; i < 200; i++ )
+    {
+        std::vector<uint8_t> frame(1 + rand() % 1024);
+        const uint8_t special[] = {0x7E, 0xFF, 0x3F, 0xFC};
+        for ( auto &byte : frame )
+            byte = (rand() % 2) ? rand() : special[rand() % 4];
+        wire = ll_encode(handle, frame, 1 + rand() % 300);
+        CHECK(wire.size() <= (size_t)hdlc_ll_get_max_encoded_size(frame.size(), HDLC_CRC_16, HDLC_FRAMING_SYNC));
+        stream.insert(stream.end(), wire.begin(), wire.end());
+        frames.push_back(frame);
+    }
+    // Frames are not aligned to byte boundary on the line: add 3 idle bits before the stream
+    std::vector<uint8_t> shifted(stream.size() + 1);
+    for ( size_t i = 0; i <= stream.size(); i++ )
+    {
+        uint8_t prev = i ? stream[i - 1] : 0xFF;
+        uint8_t next = i < stream.size() ? stream[i] : 0xFF;
+        shifted[i] = (uint8_t)((next << 3) | (prev >> 5));
+    }
+    for ( auto *data : {&stream, &shifted} )
+    {
+        received.clear();
+        for ( size_t pos = 0; pos < data->size(); )
+        {
+            int len = std::min<int>(1 + rand() % 100, data->size() - pos);
+            int error;
+            pos += hdlc_ll_run_rx(handle, data->data() + pos, len, &error);
+            CHECK_EQUAL(TINY_SUCCESS, error);
+        }
+        CHECK(frames == received);
+    }
+
+    // Seven 1 bits abort the frame, and corrupted bit breaks crc or frame alignment
+    int error;
+    wire = ll_encode(handle, {0x11, 0x22, 0x33}, 64);
+    std::vector<uint8_t> aborted = wire;
+    aborted[2] = 0xFF;
+    received.clear();
+    hdlc_ll_run_rx(handle, aborted.data(), aborted.size(), &error);
+    CHECK_EQUAL(TINY_SUCCESS, error);
+    CHECK_EQUAL(0, (int)received.size());
+    wire[2] ^= 0x01;
+    hdlc_ll_run_rx(handle, wire.data(), wire.size(), &error);
+    CHECK_EQUAL(TINY_ERR_WRONG_CRC, error);
+    CHECK_EQUAL(0, (int)received.size());
+    hdlc_ll_close(handle);
+
+    // Too large frame is dropped
+    init.buf_size = hdlc_ll_get_buf_size_ex(4, HDLC_CRC_16);
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+    wire = ll_encode(handle, {0x11, 0x22, 0x33, 0x44, 0x55}, 64);
+    hdlc_ll_run_rx(handle, wire.data(), wire.size(), &error);
+    CHECK_EQUAL(TINY_ERR_DATA_TOO_LARGE, error);
+    hdlc_ll_close(handle);
+}
+
+TEST(HDLC, hdlc_ll_bulk_encode_and_scan)
+{
+    const hdlc_framing_t modes[] = {HDLC_FRAMING_ASYNC, HDLC_FRAMING_COBS, HDLC_FRAMING_LENGTH, HDLC_FRAMING_SYNC};
+    const hdlc_crc_t crcs[] = {HDLC_CRC_OFF, HDLC_CRC_8, HDLC_CRC_16, HDLC_CRC_32};
+    srand(2);
+    for ( auto framing : modes )
+    {
+        for ( auto crc : crcs )
+        {
+            std::vector<uint8_t> buffer(hdlc_ll_get_buf_size_ex(600, crc));
+            hdlc_ll_init_t init{};
+            init.buf = buffer.data();
+            init.buf_size = buffer.size();
+            init.crc_type = crc;
+            init.framing = framing;
+            hdlc_ll_handle_t handle = nullptr;
+            CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+
+            // Encoded frames are the same as produced by the state machine
+            std::vector<std::vector<uint8_t>> frames;
+            std::vector<uint8_t> stream;
+            for ( int i = 0; i < 50; i++ )
+            {
+                std::vector<uint8_t> frame(1 + rand() % 600);
+                const uint8_t special[] = {0x00, 0x7E, 0x7D, 0xFF};
+                for ( auto &byte : frame )
+                    byte = (rand() % 3) ? rand() : special[rand() % 4];
+                std::vector<uint8_t> wire = ll_encode(handle, frame, 64);
+                std::vector<uint8_t> encoded(hdlc_ll_get_max_encoded_size(frame.size(), crc, framing));
+                CHECK_EQUAL((int)wire.size(),
+                            hdlc_ll_encode(frame.data(), frame.size(), encoded.data(), encoded.size(), crc, framing));
+                encoded.resize(wire.size());
+                CHECK(wire == encoded);
+                CHECK_EQUAL(TINY_ERR_DATA_TOO_LARGE,
+                            hdlc_ll_encode(frame.data(), frame.size(), encoded.data(), wire.size() - 1, crc, framing));
+                stream.insert(stream.end(), wire.begin(), wire.end());
+                frames.push_back(frame);
+            }
+            hdlc_ll_close(handle);
+
+            // Scan the stream by chunks, incomplete frame is processed with the next chunk
+            std::vector<uint8_t> out(stream.size());
+            std::vector<std::vector<uint8_t>> decoded;
+            hdlc_ll_frame_info_t info[8];
+            size_t pos = 0;
+            while ( pos < stream.size() )
+            {
+                size_t chunk = std::min<size_t>(stream.size() - pos, 1000);
+                int processed = 0;
+                int count = hdlc_ll_scan(stream.data() + pos, chunk, out.data(), out.size(), info, 8, crc, framing,
+                                         &processed);
+                for ( int i = 0; i < count; i++ )
+                {
+                    CHECK_EQUAL(TINY_SUCCESS, info[i].error);
+                    decoded.emplace_back(out.data() + info[i].offset, out.data() + info[i].offset + info[i].len);
+                }
+                CHECK(count > 0 || chunk < 1000);
+                pos += processed;
+                if ( count == 0 )
+                    break;
+            }
+            CHECK(frames == decoded);
+
+            // Decode in place
+            int processed = 0;
+            std::vector<hdlc_ll_frame_info_t> index(frames.size() + 1);
+            CHECK_EQUAL((int)frames.size(), hdlc_ll_scan(stream.data(), stream.size(), stream.data(), stream.size(),
+                                                         index.data(), index.size(), crc, framing, &processed));
+            CHECK_EQUAL((int)stream.size(), processed);
+            for ( size_t i = 0; i < frames.size(); i++ )
+            {
+                CHECK_EQUAL((int)frames[i].size(), index[i].len);
+                MEMCMP_EQUAL(frames[i].data(), stream.data() + index[i].offset, index[i].len);
+            }
+        }
+    }
+}
+#endif
+
+TEST(HDLC, hdlc_ll_bulk_scan_errors)
+{
+    uint8_t stream[64];
+    const uint8_t frame[] = {0x11, 0x7E, 0x22, 0x33};
+    int len1 = hdlc_ll_encode(frame, sizeof(frame), stream, sizeof(stream), HDLC_CRC_16, HDLC_FRAMING_ASYNC);
+    int len2 = hdlc_ll_encode(frame, sizeof(frame), stream + len1, sizeof(stream) - len1, HDLC_CRC_16,
+                              HDLC_FRAMING_ASYNC);
+    CHECK_EQUAL(9, len1);
+    stream[len1 + 3] ^= 0x01;
+
+    uint8_t out[64];
+    hdlc_ll_frame_info_t info[4];
+    int processed;
+    CHECK_EQUAL(2, hdlc_ll_scan(stream, len1 + len2, out, sizeof(out), info, 4, HDLC_CRC_16, HDLC_FRAMING_ASYNC,
+                                &processed));
+    CHECK_EQUAL(TINY_SUCCESS, info[0].error);
+    CHECK_EQUAL(TINY_ERR_WRONG_CRC, info[1].error);
+    CHECK_EQUAL(4, info[1].offset);
+    CHECK_EQUAL(4, info[1].len);
+
+    // Output buffer is too small for the second frame
+    CHECK_EQUAL(1, hdlc_ll_scan(stream, len1 + len2, out, 7, info, 4, HDLC_CRC_16, HDLC_FRAMING_ASYNC, &processed));
+    CHECK_EQUAL(len1, processed);
+
+    // Incomplete frame is not processed, garbage before the flag is skipped
+    const uint8_t garbage[] = {0x01, 0x02, 0x7E, 0x11, 0x22};
+    CHECK_EQUAL(0, hdlc_ll_scan(garbage, sizeof(garbage), out, sizeof(out), info, 4, HDLC_CRC_16, HDLC_FRAMING_ASYNC,
+                                &processed));
+    CHECK_EQUAL(2, processed);
+
+    // COBS frame without data is alignment error, and its closing delimiter opens the next frame
+    const uint8_t cobs[] = {0x00, 0x01, 0x00, 0x02, 0x41, 0x00};
+    CHECK_EQUAL(1, hdlc_ll_scan(cobs, sizeof(cobs), out, sizeof(out), info, 4, HDLC_CRC_OFF, HDLC_FRAMING_COBS,
+                                &processed));
+    CHECK_EQUAL(1, info[0].len);
+    CHECK_EQUAL(0x41, out[info[0].offset]);
+    CHECK_EQUAL((int)sizeof(cobs), processed);
+
+    CHECK_EQUAL(TINY_ERR_INVALID_DATA, hdlc_ll_encode(frame, 0, stream, sizeof(stream), HDLC_CRC_16, HDLC_FRAMING_COBS));
+}
+
+TEST(HDLC, hdlc_ll_block_exchange)
+{
+#ifdef CONFIG_ENABLE_FRAMING
+    const hdlc_framing_t modes[] = {HDLC_FRAMING_ASYNC, HDLC_FRAMING_COBS, HDLC_FRAMING_SYNC};
+#else
+    const hdlc_framing_t modes[] = {HDLC_FRAMING_ASYNC};
+#endif
+    for ( hdlc_framing_t framing : modes )
+    {
+        std::vector<uint8_t> tx_buffer(hdlc_ll_get_buf_size_ex(256, HDLC_CRC_16));
+        std::vector<uint8_t> rx_buffer(hdlc_ll_get_buf_size_ex(256, HDLC_CRC_16));
+        hdlc_ll_init_t init{};
+        init.crc_type = HDLC_CRC_16;
+        init.framing = framing;
+        init.buf = tx_buffer.data();
+        init.buf_size = tx_buffer.size();
+        hdlc_ll_handle_t tx = nullptr;
+        CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&tx, &init));
+        std::vector<std::vector<uint8_t>> received;
+        init.buf = rx_buffer.data();
+        init.buf_size = rx_buffer.size();
+        init.user_data = &received;
+        init.on_frame_read = [](void *user_data, void *data, int len) -> int {
+            static_cast<std::vector<std::vector<uint8_t>> *>(user_data)->emplace_back((uint8_t *)data,
+                                                                                       (uint8_t *)data + len);
+            return 0;
+        };
+        hdlc_ll_handle_t rx = nullptr;
+        CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&rx, &init));
+
+        srand(7);
+        std::vector<std::vector<uint8_t>> frames;
+        for ( int i = 0; i < 50; i++ )
+        {
+            std::vector<uint8_t> frame(1 + rand() % 256);
+            for ( auto &byte : frame )
+                byte = (rand() % 4) ? rand() : TINY_HDLC_FILL_BYTE;
+            frames.push_back(frame);
+        }
+        FakeSpi spi(64);
+        size_t next = 0;
+        int padded_blocks = 0;
+        while ( received.size() < frames.size() && spi.transactions() < 1000 )
+        {
+            if ( next < frames.size() && hdlc_ll_put(tx, frames[next].data(), frames[next].size()) == TINY_SUCCESS )
+            {
+                next++;
+            }
+            int len = hdlc_ll_run_tx_block(tx, spi.masterTx(), spi.blockSize());
+            CHECK(len >= 0 && len <= spi.blockSize());
+            for ( int i = len; i < spi.blockSize(); i++ )
+            {
+                CHECK_EQUAL(TINY_HDLC_FILL_BYTE, spi.masterTx()[i]);
+            }
+            padded_blocks += len < spi.blockSize();
+            spi.transfer();
+            int error = TINY_ERR_FAILED;
+            CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_run_rx_block(rx, spi.slaveRx(), spi.blockSize(), &error));
+            CHECK_EQUAL(TINY_SUCCESS, error);
+        }
+        CHECK(frames == received);
+        CHECK(padded_blocks > 0);
+        // Idle line carries only fill bytes
+        CHECK_EQUAL(0, hdlc_ll_run_tx_block(tx, spi.masterTx(), spi.blockSize()));
+        CHECK_EQUAL(TINY_HDLC_FILL_BYTE, spi.masterTx()[0]);
+        hdlc_ll_close(tx);
+        hdlc_ll_close(rx);
+    }
+}
+
+#ifdef CONFIG_ENABLE_FRAMING
+TEST(HDLC, hdlc_ll_block_exchange_needs_delimiters)
+{
+    std::vector<uint8_t> buffer(hdlc_ll_get_buf_size_ex(64, HDLC_CRC_16));
+    hdlc_ll_init_t init{};
+    init.crc_type = HDLC_CRC_16;
+    init.framing = HDLC_FRAMING_LENGTH;
+    init.buf = buffer.data();
+    init.buf_size = buffer.size();
+    hdlc_ll_handle_t handle = nullptr;
+    CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+    uint8_t block[16];
+    CHECK_EQUAL(TINY_ERR_INVALID_DATA, hdlc_ll_run_tx_block(handle, block, sizeof(block)));
+    CHECK_EQUAL(TINY_ERR_INVALID_DATA, hdlc_ll_run_rx_block(handle, block, sizeof(block), nullptr));
+    hdlc_ll_close(handle);
+}
+#endif
+
+TEST(HDLC, crc_combine)
+{
+    uint8_t data[300];
+    for ( size_t i = 0; i < sizeof(data); i++ )
+    {
+        data[i] = (uint8_t)(i * 37 + 11);
+    }
+    for ( int split : {0, 1, 2, 17, 255, 299} )
+    {
+        int len2 = sizeof(data) - split;
+        CHECK_EQUAL(crc16(PPPINITFCS16, data, sizeof(data)),
+                    crc16_combine(crc16(PPPINITFCS16, data, split), crc16(PPPINITFCS16, data + split, len2), len2));
+        CHECK_EQUAL(crc32(PPPINITFCS32, data, sizeof(data)),
+                    crc32_combine(crc32(PPPINITFCS32, data, split), crc32(PPPINITFCS32, data + split, len2), len2));
+        CHECK_EQUAL(chksum(INITCHECKSUM, data, sizeof(data)),
+                    chksum_combine(chksum(INITCHECKSUM, data, split), chksum(INITCHECKSUM, data + split, len2)));
+    }
+}
+
+TEST(HDLC, hdlc_ll_put_with_crc)
+{
+    // Frame with escaped bytes in the header and in the body
+    uint8_t frame[40] = {0xFF, 0x7E};
+    for ( size_t i = 2; i < sizeof(frame); i++ )
+    {
+        frame[i] = (uint8_t)(0x7A + i % 6);
+    }
+    for ( hdlc_crc_t crc_type : {HDLC_CRC_8, HDLC_CRC_16, HDLC_CRC_32, HDLC_CRC_OFF} )
+    {
+        std::vector<uint8_t> buffer(hdlc_ll_get_buf_size_ex(64, crc_type));
+        hdlc_ll_init_t init{};
+        init.crc_type = crc_type;
+        init.buf = buffer.data();
+        init.buf_size = buffer.size();
+        hdlc_ll_handle_t handle = nullptr;
+        CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_init(&handle, &init));
+        uint8_t expected[128];
+        uint8_t actual[128];
+        CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_put(handle, frame, sizeof(frame)));
+        int expected_len = hdlc_ll_run_tx(handle, expected, sizeof(expected));
+        crc_t body_crc = hdlc_ll_get_crc(handle, frame + 2, sizeof(frame) - 2);
+        CHECK_EQUAL(TINY_SUCCESS, hdlc_ll_put_with_crc(handle, frame, sizeof(frame), 2, body_crc));
+        CHECK_EQUAL(expected_len, hdlc_ll_run_tx(handle, actual, sizeof(actual)));
+        MEMCMP_EQUAL(expected, actual, expected_len);
+        CHECK_EQUAL(TINY_ERR_INVALID_DATA, hdlc_ll_put_with_crc(handle, frame, sizeof(frame), sizeof(frame) + 1, body_crc));
+        hdlc_ll_close(handle);
+    }
+}
@@ -0,0 +1,46 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fake_spi.h"
+
+FakeSpi::FakeSpi(int block_size)
+    : m_blockSize(block_size)
+    , m_masterTx(block_size)
+    , m_masterRx(block_size)
+    , m_slaveTx(block_size)
+    , m_slaveRx(block_size)
+{
+}
+
+void FakeSpi::transfer()
+{
+    m_slaveRx = m_masterTx;
+    m_masterRx = m_slaveTx;
+    if ( m_errorPeriod )
+    {
+        for ( auto &byte : m_slaveRx )
+        {
+            if ( ++m_bytes % m_errorPeriod == 0 )
+            {
+                byte ^= 0x10;
+            }
+        }
+    }
+    m_transactions++;
+}
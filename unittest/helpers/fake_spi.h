@@ -0,0 +1,86 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Loopback model of full duplex block transport like SPI with DMA. Each transaction
+ * exchanges tx blocks of master and slave at once, and both blocks have the same size.
+ */
+class FakeSpi
+{
+public:
+    explicit FakeSpi(int block_size);
+
+    int blockSize() const
+    {
+        return m_blockSize;
+    }
+
+    /** Block, which master sends in the next transaction */
+    uint8_t *masterTx()
+    {
+        return m_masterTx.data();
+    }
+
+    /** Block, which master received in the last transaction */
+    const uint8_t *masterRx() const
+    {
+        return m_masterRx.data();
+    }
+
+    /** Block, which slave sends in the next transaction */
+    uint8_t *slaveTx()
+    {
+        return m_slaveTx.data();
+    }
+
+    /** Block, which slave received in the last transaction */
+    const uint8_t *slaveRx() const
+    {
+        return m_slaveRx.data();
+    }
+
+    /** Corrupts single bit of every n-th byte, sent by master */
+    void generate_error_every_n_byte(int n)
+    {
+        m_errorPeriod = n;
+    }
+
+    /** Exchanges tx blocks of master and slave */
+    void transfer();
+
+    int transactions() const
+    {
+        return m_transactions;
+    }
+
+private:
+    int m_blockSize;
+    std::vector<uint8_t> m_masterTx;
+    std::vector<uint8_t> m_masterRx;
+    std::vector<uint8_t> m_slaveTx;
+    std::vector<uint8_t> m_slaveRx;
+    int m_errorPeriod = 0;
+    int m_bytes = 0;
+    int m_transactions = 0;
+};
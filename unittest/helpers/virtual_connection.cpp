@@ -0,0 +1,302 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "virtual_connection.h"
+#include <algorithm>
+#include <math.h>
+
+uint64_t VirtualConnection::s_now_us = 0;
+
+static void virtual_mutex_stub(tiny_mutex_t *mutex)
+{
+}
+
+static uint8_t virtual_mutex_try_lock(tiny_mutex_t *mutex)
+{
+    return 1;
+}
+
+static void virtual_events_create(tiny_events_t *events)
+{
+    events->bits = 0;
+}
+
+static void virtual_events_destroy(tiny_events_t *events)
+{
+}
+
+static uint8_t virtual_events_check_int(tiny_events_t *events, uint8_t bits, uint8_t clear)
+{
+    uint8_t locked = events->bits;
+    if ( !(locked & bits) )
+        return 0;
+    if ( clear )
+        events->bits &= ~bits;
+    return locked;
+}
+
+static uint8_t virtual_events_wait(tiny_events_t *events, uint8_t bits, uint8_t clear, uint32_t timeout)
+{
+    // Virtual time doesn't go while the simulator thread waits, so never block
+    return virtual_events_check_int(events, bits, clear);
+}
+
+static void virtual_events_set(tiny_events_t *events, uint8_t bits)
+{
+    events->bits |= bits;
+}
+
+static void virtual_events_clear(tiny_events_t *events, uint8_t bits)
+{
+    events->bits &= ~bits;
+}
+
+static void virtual_sleep(uint32_t ms)
+{
+}
+
+const tiny_platform_hal_t *VirtualConnection::hal()
+{
+    static tiny_platform_hal_t hal{};
+    hal.mutex_create = virtual_mutex_stub;
+    hal.mutex_destroy = virtual_mutex_stub;
+    hal.mutex_try_lock = virtual_mutex_try_lock;
+    hal.mutex_unlock = virtual_mutex_stub;
+    hal.mutex_lock = virtual_mutex_stub;
+    hal.events_create = virtual_events_create;
+    hal.events_destroy = virtual_events_destroy;
+    hal.events_wait = virtual_events_wait;
+    hal.events_check_int = virtual_events_check_int;
+    hal.events_set = virtual_events_set;
+    hal.events_clear = virtual_events_clear;
+    hal.sleep = virtual_sleep;
+    hal.millis = millis;
+    return &hal;
+}
+
+VirtualConnection::VirtualConnection(uint32_t seed)
+    : m_lines(2)
+    , m_rng(seed ? seed : 1)
+{
+    s_now_us = 0;
+    setConfig(VirtualLineConfig());
+}
+
+void VirtualConnection::setConfig(const VirtualLineConfig &config)
+{
+    for ( size_t i = 0; i < m_lines.size(); i++ )
+    {
+        setConfig(static_cast<int>(i), config);
+    }
+}
+
+void VirtualConnection::setConfig(int direction, const VirtualLineConfig &config)
+{
+    Line &line = m_lines[direction];
+    line.config = config;
+    line.bits_to_error = nextGap(config.ber);
+    line.bytes_to_drop = nextGap(config.drop_rate);
+}
+
+void VirtualConnection::attach(tiny_fd_handle_t a, tiny_fd_handle_t b, uint8_t links)
+{
+    Line config = m_lines[0];
+    m_lines.resize(2 * links, config);
+    for ( uint8_t i = 0; i < links; i++ )
+    {
+        m_lines[2 * i].src = a;
+        m_lines[2 * i].dst = b;
+        m_lines[2 * i + 1].src = b;
+        m_lines[2 * i + 1].dst = a;
+        m_lines[2 * i].link = i;
+        m_lines[2 * i + 1].link = i;
+    }
+}
+
+uint64_t VirtualConnection::random()
+{
+    // xorshift64
+    m_rng ^= m_rng << 13;
+    m_rng ^= m_rng >> 7;
+    m_rng ^= m_rng << 17;
+    return m_rng;
+}
+
+uint64_t VirtualConnection::nextGap(double probability)
+{
+    // Number of successful trials before next failure (geometric distribution),
+    // so there is no need to roll the dice for every bit
+    if ( probability <= 0.0 )
+    {
+        return UINT64_MAX;
+    }
+    if ( probability >= 1.0 )
+    {
+        return 0;
+    }
+    double u = (random() >> 11) * (1.0 / 9007199254740992.0);
+    return static_cast<uint64_t>(floor(log(1.0 - u) / log(1.0 - probability)));
+}
+
+void VirtualConnection::transmit(int direction)
+{
+    Line &line = m_lines[direction];
+    if ( line.src == nullptr )
+    {
+        // Detached connection only runs the virtual clock
+        line.next_poll = UINT64_MAX;
+        return;
+    }
+    if ( line.busy_until > s_now_us || line.next_poll > s_now_us )
+    {
+        return;
+    }
+    // Take from the endpoint about 1 millisecond of line time at once, since
+    // protocol timeouts have millisecond resolution
+    int max_len = std::min<int>(std::max<int>(line.config.baud / 10000, 1), 4096);
+    std::vector<uint8_t> data(max_len);
+    int len = tiny_fd_get_tx_data_link(line.src, line.link, data.data(), max_len);
+    if ( len <= 0 )
+    {
+        line.next_poll = s_now_us + 1000;
+        return;
+    }
+    data.resize(len);
+    uint64_t duration = ((uint64_t)len * 10 * 1000000 + line.config.baud - 1) / line.config.baud;
+    line.busy_until = s_now_us + duration;
+    line.sent_bytes += len;
+    // Drop bytes
+    std::vector<uint8_t> delivered;
+    delivered.reserve(len);
+    for ( uint8_t byte : data )
+    {
+        if ( line.bytes_to_drop == 0 )
+        {
+            line.bytes_to_drop = nextGap(line.config.drop_rate);
+            line.lost_bytes++;
+            continue;
+        }
+        if ( line.bytes_to_drop != UINT64_MAX )
+        {
+            line.bytes_to_drop--;
+        }
+        delivered.push_back(byte);
+    }
+    // Invert bits
+    uint64_t total_bits = delivered.size() * 8;
+    uint64_t pos = 0;
+    while ( line.bits_to_error < total_bits - pos )
+    {
+        pos += line.bits_to_error;
+        delivered[pos / 8] ^= static_cast<uint8_t>(1 << (pos % 8));
+        line.corrupted_bits++;
+        pos++;
+        line.bits_to_error = nextGap(line.config.ber);
+    }
+    if ( line.bits_to_error != UINT64_MAX )
+    {
+        line.bits_to_error -= total_bits - pos;
+    }
+    if ( delivered.empty() )
+    {
+        return;
+    }
+    uint64_t delay = line.config.latency_us;
+    if ( line.config.jitter_us )
+    {
+        delay += random() % (line.config.jitter_us + 1);
+    }
+    // Jitter must not reorder bytes on the line
+    line.last_delivery = std::max(line.busy_until + delay, line.last_delivery);
+    line.in_flight.push_back({line.last_delivery, std::move(delivered)});
+}
+
+void VirtualConnection::deliver(int direction)
+{
+    Line &line = m_lines[direction];
+    bool delivered = false;
+    while ( !line.in_flight.empty() && line.in_flight.front().deliver_at <= s_now_us )
+    {
+        Chunk &chunk = line.in_flight.front();
+        tiny_fd_on_rx_data_link(line.dst, line.link, chunk.data.data(), static_cast<int>(chunk.data.size()));
+        line.in_flight.pop_front();
+        delivered = true;
+    }
+    if ( delivered )
+    {
+        // Give the receiver a chance to answer immediately
+        m_lines[direction ^ 1].next_poll = s_now_us;
+    }
+}
+
+uint64_t VirtualConnection::nextEventTime() const
+{
+    uint64_t ts = UINT64_MAX;
+    for ( const Line &line : m_lines )
+    {
+        ts = std::min(ts, std::max(line.busy_until, line.next_poll));
+        if ( !line.in_flight.empty() )
+        {
+            ts = std::min(ts, line.in_flight.front().deliver_at);
+        }
+    }
+    return std::max(ts, s_now_us);
+}
+
+void VirtualConnection::step()
+{
+    for ( size_t i = 0; i < m_lines.size(); i++ )
+    {
+        deliver(static_cast<int>(i));
+    }
+    for ( size_t i = 0; i < m_lines.size(); i++ )
+    {
+        transmit(static_cast<int>(i));
+    }
+}
+
+void VirtualConnection::run(uint64_t duration_us)
+{
+    runUntil([]() -> bool { return false; }, duration_us);
+}
+
+bool VirtualConnection::runUntil(const std::function<bool()> &condition, uint64_t timeout_us)
+{
+    uint64_t end = s_now_us + timeout_us;
+    // Application could put new frames to the queue, so check endpoints right now
+    for ( Line &line : m_lines )
+    {
+        line.next_poll = s_now_us;
+    }
+    for ( ;; )
+    {
+        if ( condition() )
+        {
+            return true;
+        }
+        uint64_t ts = nextEventTime();
+        if ( ts > end )
+        {
+            s_now_us = end;
+            return condition();
+        }
+        s_now_us = ts;
+        step();
+    }
+}
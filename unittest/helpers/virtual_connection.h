@@ -0,0 +1,156 @@
+/*
+    Copyright 2021 (C) Alexey Dynda
+
+    This file is part of Tiny Protocol Library.
+
+    Protocol Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Protocol Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Protocol Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "proto/fd/tiny_fd.h"
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/**
+ * Parameters of single direction of virtual line
+ */
+struct VirtualLineConfig
+{
+    /// Line speed in bits per second, each byte takes 10 bits (start, 8 data bits, stop)
+    uint32_t baud = 115200;
+    /// Propagation delay in microseconds
+    uint32_t latency_us = 0;
+    /// Maximum random delay in microseconds, added to latency. Order of bytes is preserved.
+    uint32_t jitter_us = 0;
+    /// Bit error rate: probability of single bit to be inverted
+    double ber = 0.0;
+    /// Probability of single byte to be lost on the line
+    double drop_rate = 0.0;
+};
+
+/**
+ * Single-threaded discrete-event simulator of full duplex line between two tiny_fd endpoints.
+ * The simulator owns virtual clock, which must be passed to both endpoints via tiny_fd_init_t::hal
+ * (see VirtualConnection::hal()).
+ * Nothing depends on the host time and scheduler, so the same seed always gives the same result.
+ * Only one instance of simulator can be used at the same time, since the clock is global.
+ */
+class VirtualConnection
+{
+public:
+    explicit VirtualConnection(uint32_t seed = 1);
+
+    /**
+     * Configures both directions of all lines
+     */
+    void setConfig(const VirtualLineConfig &config);
+
+    /**
+     * Configures single direction of the line: 0 - from endpoint A to B, 1 - from B to A.
+     * Directions of bonded link N are 2 * N and 2 * N + 1.
+     */
+    void setConfig(int direction, const VirtualLineConfig &config);
+
+    /**
+     * Attaches endpoints to the line. Both handles must be initialized with VirtualConnection::hal().
+     * If links is above 1, endpoints are connected with several lines (see tiny_fd_init_t::links),
+     * which are configured as all lines before the call.
+     */
+    void attach(tiny_fd_handle_t a, tiny_fd_handle_t b, uint8_t links = 1);
+
+    /**
+     * Runs simulation for specified period of virtual time
+     */
+    void run(uint64_t duration_us);
+
+    /**
+     * Runs simulation until condition becomes true or virtual timeout expires
+     * @return true if condition is met
+     */
+    bool runUntil(const std::function<bool()> &condition, uint64_t timeout_us);
+
+    /**
+     * Current virtual time in microseconds
+     */
+    static uint64_t now()
+    {
+        return s_now_us;
+    }
+
+    /**
+     * Clock source, returning virtual time in milliseconds
+     */
+    static uint32_t millis()
+    {
+        return static_cast<uint32_t>(s_now_us / 1000);
+    }
+
+    /**
+     * Platform functions for tiny_fd_init_t::hal: virtual clock and lock-free mutex and events,
+     * since everything runs in the simulator thread and nobody can wait for real time.
+     */
+    static const tiny_platform_hal_t *hal();
+
+    uint64_t sentBytes(int direction) const
+    {
+        return m_lines[direction].sent_bytes;
+    }
+    uint64_t lostBytes(int direction) const
+    {
+        return m_lines[direction].lost_bytes;
+    }
+    uint64_t corruptedBits(int direction) const
+    {
+        return m_lines[direction].corrupted_bits;
+    }
+
+private:
+    struct Chunk
+    {
+        uint64_t deliver_at;
+        std::vector<uint8_t> data;
+    };
+
+    struct Line
+    {
+        VirtualLineConfig config;
+        tiny_fd_handle_t src = nullptr;
+        tiny_fd_handle_t dst = nullptr;
+        uint8_t link = 0;
+        uint64_t busy_until = 0;
+        uint64_t next_poll = 0;
+        uint64_t last_delivery = 0;
+        uint64_t bits_to_error = 0;
+        uint64_t bytes_to_drop = 0;
+        uint64_t sent_bytes = 0;
+        uint64_t lost_bytes = 0;
+        uint64_t corrupted_bits = 0;
+        std::deque<Chunk> in_flight;
+    };
+
+    static uint64_t s_now_us;
+
+    std::vector<Line> m_lines;
+    uint64_t m_rng;
+
+    uint64_t random();
+    uint64_t nextGap(double probability);
+    void transmit(int direction);
+    void deliver(int direction);
+    uint64_t nextEventTime() const;
+    void step();
+};